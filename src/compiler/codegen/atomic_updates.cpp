@@ -0,0 +1,115 @@
+#include "compiler/codegen/atomic_updates.h"
+#include "compiler/codegen/liveness.h"
+
+namespace {
+
+// GetGlobal r, g; Add/Sub t, r, d; SetGlobal g, t at `pc`
+bool matchArithmetic(const std::vector<Instruction>& code, size_t pc, int32_t* operand) {
+    const Instruction& load = code[pc];
+    const Instruction& update = code[pc + 1];
+    const Instruction& store = code[pc + 2];
+    if (store.op != Opcode::SetGlobal || store.a != load.b || store.b != update.a) {
+        return false;
+    }
+    // Not d + r: for strings that prepends, and the atomic form appends
+    int32_t loaded = load.a;
+    if ((update.op == Opcode::Add || update.op == Opcode::Sub) && update.b == loaded && update.c != loaded) {
+        *operand = update.c;
+        return true;
+    }
+    return false;
+}
+
+// GetGlobal r, g; Eq t, r, e; JumpIfFalse t, L; SetGlobal g, n; L: at `pc`
+bool matchCompareAndSet(const std::vector<Instruction>& code, const StackMap& liveness, size_t pc,
+                        int32_t* expected) {
+    const Instruction& load = code[pc];
+    const Instruction& compare = code[pc + 1];
+    const Instruction& branch = code[pc + 2];
+    const Instruction& store = code[pc + 3];
+    int32_t loaded = load.a;
+    int32_t result = compare.a;
+    if (compare.op != Opcode::Eq || branch.op != Opcode::JumpIfFalse || branch.a != result ||
+        branch.b != static_cast<int32_t>(pc + 4) || store.op != Opcode::SetGlobal || store.a != load.b) {
+        return false;
+    }
+    if (compare.b == loaded && compare.c != loaded) {
+        *expected = compare.c;
+    } else if (compare.c == loaded && compare.b != loaded) {
+        *expected = compare.b;
+    } else {
+        return false;
+    }
+    // The new value is read before the comparison now, and the loaded
+    // value is never written to its register
+    return result != loaded && store.b != loaded && store.b != result && !liveness.isLive(pc + 2, loaded);
+}
+
+} // namespace
+
+std::vector<AtomicSite> lowerAtomicUpdates(FunctionProto& proto) {
+    std::vector<Instruction>& code = proto.code;
+    size_t count = code.size();
+    std::vector<AtomicSite> sites;
+    std::vector<bool> isTarget(count + 1);
+    bool anyLoad = false;
+    for (const Instruction& insn : code) {
+        if (insn.op == Opcode::Jump) {
+            isTarget[static_cast<size_t>(insn.a)] = true;
+        } else if (insn.op == Opcode::JumpIfTrue || insn.op == Opcode::JumpIfFalse) {
+            isTarget[static_cast<size_t>(insn.b)] = true;
+        }
+        anyLoad |= insn.op == Opcode::GetGlobal;
+    }
+    if (!anyLoad) {
+        return sites;
+    }
+
+    // Lowering only ever makes registers less live, so the liveness of the
+    // original code stays valid for every later site
+    StackMap liveness = computeStackMap(proto);
+    int32_t pair = -1; // Operand pair shared by all CompareAndSetGlobal sites
+    std::vector<bool> removed(count);
+    for (size_t pc = 0; pc + 2 < count; ++pc) {
+        if (code[pc].op != Opcode::GetGlobal || isTarget[pc + 1] || isTarget[pc + 2]) {
+            continue;
+        }
+        Instruction load = code[pc];
+        int32_t operand;
+        if (matchArithmetic(code, pc, &operand)) {
+            Opcode op = code[pc + 1].op == Opcode::Add ? Opcode::AtomicAddGlobal : Opcode::AtomicSubGlobal;
+            code[pc] = Instruction{op, load.a, load.b, operand};
+            // The store's value is the old one updated once more, locally
+            removed[pc + 2] = true;
+            sites.push_back(AtomicSite{static_cast<int>(pc), load.b, op});
+            pc += 2;
+        } else if (pc + 3 < count && !isTarget[pc + 3] && matchCompareAndSet(code, liveness, pc, &operand)) {
+            if (pair < 0) {
+                pair = proto.numRegisters;
+                proto.numRegisters += 2;
+            }
+            int32_t result = code[pc + 1].a;
+            int32_t desired = code[pc + 3].b;
+            code[pc] = Instruction{Opcode::Move, pair, operand, 0};
+            code[pc + 1] = Instruction{Opcode::Move, pair + 1, desired, 0};
+            code[pc + 2] = Instruction{Opcode::CompareAndSetGlobal, result, load.b, pair};
+            removed[pc + 3] = true;
+            sites.push_back(AtomicSite{static_cast<int>(pc + 2), load.b, Opcode::CompareAndSetGlobal});
+            pc += 3;
+        }
+    }
+    if (sites.empty()) {
+        return sites;
+    }
+
+    // Removed stores were never jump targets
+    std::vector<int> shift(count + 1);
+    for (size_t pc = 0; pc < count; ++pc) {
+        shift[pc + 1] = shift[pc] + (removed[pc] ? 1 : 0);
+    }
+    for (AtomicSite& site : sites) {
+        site.pc -= shift[static_cast<size_t>(site.pc)];
+    }
+    eraseInstructions(proto, removed);
+    return sites;
+}
@@ -0,0 +1,37 @@
+#ifndef ATOMIC_UPDATES_H
+#define ATOMIC_UPDATES_H
+
+#include "runtime/vm/function_proto.h"
+#include <vector>
+
+// A read-modify-write of a global that lowerAtomicUpdates() turned into a
+// single atomic instruction
+struct AtomicSite {
+    int pc;     // Index of the atomic instruction in the lowered code
+    int global; // Global slot it updates
+    Opcode op;  // AtomicAddGlobal, AtomicSubGlobal or CompareAndSetGlobal
+};
+
+// Lowers read-modify-write sequences on global slots, the variables `run`
+// tasks share, into atomic instructions:
+//
+//   GetGlobal r, g; Add t, r, d; SetGlobal g, t
+//     -> AtomicAddGlobal r, g, d; Add t, r, d   (likewise Sub)
+//   GetGlobal r, g; Eq t, r, e; JumpIfFalse t, L; SetGlobal g, n; L:
+//     -> Move s, e; Move s+1, n; CompareAndSetGlobal t, g, s
+//
+// These are what `counter++`, Run.getAndChange and Run.update with an
+// `x + k` or `x - k` function, and Run.compareAndSet compile to. Without
+// the lowering another task could write the global between the read and
+// the store, and one of the two updates would be lost. The add form keeps
+// the Add so that both the old and the new value stay available; the
+// compare-and-set form needs the loaded value to be dead afterwards, and
+// takes two extra registers for its operand pair. None of the sequence
+// may be a jump target except its first instruction.
+//
+// Lowered instructions update ints with one compare-and-swap (a loop only
+// while other threads keep winning), and fall back to the generic
+// operation for other values. Returns the sites lowered.
+std::vector<AtomicSite> lowerAtomicUpdates(FunctionProto& proto);
+
+#endif // ATOMIC_UPDATES_H
@@ -0,0 +1,831 @@
+#include "compiler/codegen/baseline_jit.h"
+#include "runtime/vm/config.h"
+#include "runtime/vm/shape.h"
+#include "runtime/vm/slow_paths.h"
+#include "runtime/vm/vm.h"
+#include "runtime/vm/wild_object.h"
+#include <cstddef>
+
+#if SE_ENABLE_JIT
+#include "compiler/codegen/x64_assembler.h"
+#endif
+
+#if SE_ENABLE_JIT
+
+using namespace x64;
+
+// Register assignment inside compiled code:
+//   rbx = register window (Value*), r12 = JitContext*
+//   rax, rcx, rdx, rsi, rdi, r8, r9 = scratch
+static constexpr Reg kRegs = RBX;
+static constexpr Reg kCtx = R12;
+
+// Encoding constants from the NaN-boxed Value layout
+static constexpr int32_t kIntHigh = static_cast<int32_t>(Value::boxHigh(Value::kTagInt));
+static constexpr int32_t kObjectHigh = static_cast<int32_t>(Value::boxHigh(Value::kTagObject));
+static const uint64_t kIntBox = Value::boxHigh(Value::kTagInt) << Value::kTagShift;
+static const uint64_t kFalseBits = Value::boolean(false).rawBits();
+static const uint64_t kTrueBits = Value::boolean(true).rawBits();
+
+// Byte offset of a field of a heap object type. Heap types derive from
+// HeapObject, so they are not standard-layout and offsetof does not apply.
+template <typename T, typename M>
+static int32_t fieldOffset(M T::*field) {
+    alignas(T) static unsigned char storage[sizeof(T)];
+    const T* object = reinterpret_cast<const T*>(storage);
+    return static_cast<int32_t>(reinterpret_cast<const char*>(&(object->*field)) -
+                                reinterpret_cast<const char*>(object));
+}
+
+// ---------------------------------------------------------------------------
+// Helpers called from compiled code. They never let a C++ exception escape
+// into machine code without unwind information: on failure they return 0
+// and the compiled code deoptimizes, so the interpreter re-executes the
+// instruction and raises the error itself.
+// ---------------------------------------------------------------------------
+
+static int jitGetPropertyMiss(JitContext* ctx, Value* regs, const Instruction* insn, PropertyCache* cache) {
+    try {
+        regs[insn->a] = getPropertyMiss(*ctx->vm, regs[insn->b], *cache);
+        return 1;
+    } catch (...) {
+        return 0;
+    }
+}
+
+static int jitSetPropertyMiss(JitContext* ctx, Value* regs, const Instruction* insn, PropertyCache* cache) {
+    try {
+        setPropertyMiss(*ctx->vm, regs[insn->a], *cache, regs[insn->c]);
+        return 1;
+    } catch (...) {
+        return 0;
+    }
+}
+
+static int jitNewInstance(JitContext* ctx, Value* regs, const Instruction* insn, const ClassLayout* layout) {
+    try {
+        regs[insn->a] = Value::object(ctx->vm->getHeap().allocateInstance(layout));
+        return 1;
+    } catch (...) {
+        return 0;
+    }
+}
+
+// `Run.lock`; errors are left to the interpreter
+static int jitLock(JitContext* ctx, Value* regs, const Instruction* insn, LockSite* site) {
+    try {
+        Value target = regs[insn->b];
+        if (!target.isWild() || target.asWild()->isDestroyed()) {
+            return 0;
+        }
+        WildObject* obj = target.asWild();
+        regs[insn->a] = obj->lock.tryLock() ? target : ctx->vm->lockContended(obj, *site);
+        return 1;
+    } catch (...) {
+        return 0;
+    }
+}
+
+// Field accesses the compiled code does not handle inline: other classes,
+// non-instances, unboxed types it does not load itself, failed type checks
+static int jitGetField(JitContext* ctx, Value* regs, const Instruction* insn, const FieldRef* ref) {
+    try {
+        Value target = regs[insn->b];
+        const FieldInfo& field = ref->layout->field(ref->index);
+        if (isInstance(target) && asInstance(target)->layout == ref->layout) {
+            regs[insn->a] = loadField(asInstance(target), field);
+        } else {
+            regs[insn->a] = slowGetProperty(*ctx->vm, target, field.name);
+        }
+        return 1;
+    } catch (...) {
+        return 0;
+    }
+}
+
+static int jitSetField(JitContext* ctx, Value* regs, const Instruction* insn, const FieldRef* ref) {
+    try {
+        Value target = regs[insn->a];
+        const FieldInfo& field = ref->layout->field(ref->index);
+        if (isInstance(target) && asInstance(target)->layout == ref->layout) {
+            storeField(ctx->vm->getHeap(), asInstance(target), field, regs[insn->c]);
+        } else {
+            slowSetProperty(*ctx->vm, target, field.name, regs[insn->c]);
+        }
+        return 1;
+    } catch (...) {
+        return 0;
+    }
+}
+
+static void jitWriteBarrier(JitContext* ctx, HeapObject* holder, uint64_t bits) {
+    ctx->vm->getHeap().writeBarrier(holder, Value::fromBits(bits));
+}
+
+// Generic implementation of simple register-to-register instructions
+static int jitGeneric(JitContext* ctx, Value* regs, const Instruction* insn) {
+    try {
+        Value b = regs[insn->b];
+        Value c = regs[insn->c];
+        switch (insn->op) {
+            case Opcode::Div:
+            case Opcode::Mod:
+                regs[insn->a] = slowArithmetic(insn->op, b, c);
+                return 1;
+            case Opcode::Neg:
+                regs[insn->a] = b.isInt() && b.asInt() != 0 ? Value::fromInt64(-b.asInt()) : slowNegate(b);
+                return 1;
+            case Opcode::Not:
+                regs[insn->a] = Value::boolean(!(b.isBoolean() ? b.asBoolean() : toBoolean(b)));
+                return 1;
+            case Opcode::Eq:
+                regs[insn->a] = Value::boolean(strictEquals(b, c));
+                return 1;
+            case Opcode::Ne:
+                regs[insn->a] = Value::boolean(!strictEquals(b, c));
+                return 1;
+            case Opcode::NewObject:
+                regs[insn->a] = Value::object(ctx->vm->getHeap().allocateObject(ctx->vm->getShapes().root()));
+                return 1;
+            case Opcode::NewWild:
+                regs[insn->a] = Value::wild(WildObject::create(ctx->vm->getWildHeap(), static_cast<uint32_t>(insn->b)));
+                return 1;
+            case Opcode::NewScopedWild:
+                regs[insn->a] = Value::wild(WildObject::createScoped(ctx->vm->getRegions(), static_cast<uint32_t>(insn->b)));
+                return 1;
+            case Opcode::EnterRegion:
+                ctx->vm->getRegions().enter();
+                return 1;
+            case Opcode::ExitRegion:
+                ctx->vm->getRegions().exit();
+                return 1;
+            case Opcode::WildRetain:
+            case Opcode::WildCheck:
+            case Opcode::WildRelease:
+            case Opcode::Destroy: {
+                Value a = regs[insn->a];
+                if (!a.isWild()) {
+                    return insn->op != Opcode::Destroy; // The interpreter raises the error
+                }
+                WildObject* obj = a.asWild();
+                if (insn->op == Opcode::WildRetain) {
+                    obj->retain();
+                } else if (insn->op == Opcode::WildCheck) {
+                    return !obj->isDestroyed();
+                } else if (insn->op == Opcode::WildRelease) {
+                    obj->release();
+                } else {
+                    obj->destroy();
+                }
+                return 1;
+            }
+            case Opcode::Unlock:
+                if (!regs[insn->a].isWild() || !regs[insn->a].asWild()->lock.isLocked()) {
+                    return 0; // The interpreter raises the error
+                }
+                regs[insn->a].asWild()->lock.unlock();
+                return 1;
+            case Opcode::AtomicAddGlobal:
+            case Opcode::AtomicSubGlobal: {
+                Opcode op = insn->op == Opcode::AtomicAddGlobal ? Opcode::Add : Opcode::Sub;
+                regs[insn->a] = atomicArithmetic(*ctx->vm, op, &ctx->globals[insn->b], c);
+                return 1;
+            }
+            case Opcode::CompareAndSetGlobal:
+                regs[insn->a] = Value::boolean(atomicCompareAndSet(&ctx->globals[insn->b], c, regs[insn->c + 1]));
+                return 1;
+            case Opcode::Transfer: {
+                Value source = regs[insn->b];
+                if (!source.isWild() || source.asWild()->isDestroyed()) {
+                    return 0; // The interpreter raises the error
+                }
+                regs[insn->b] = Value::wild(WildObject::transferred());
+                regs[insn->a] = source;
+                return 1;
+            }
+            default:
+                return 0;
+        }
+    } catch (...) {
+        return 0;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Code generator
+// ---------------------------------------------------------------------------
+
+namespace {
+
+class Compiler {
+public:
+    explicit Compiler(const FunctionProto& p)
+        : proto(p), insnLabels(p.code.size()), deoptLabels(p.code.size()), safepointLabels(p.code.size()) {}
+
+    std::vector<uint8_t> compile() {
+        emitPrologue();
+        for (size_t pc = 0; pc < proto.code.size(); ++pc) {
+            masm.bind(insnLabels[pc]);
+            emitInstruction(static_cast<int32_t>(pc), proto.code[pc]);
+        }
+        emitDeoptStubs();
+        emitEpilogue();
+        emitEntryTable();
+        return masm.code();
+    }
+
+private:
+    const FunctionProto& proto;
+    Assembler masm;
+    std::vector<Assembler::Label> insnLabels;   // Start of each instruction
+    std::vector<Assembler::Label> deoptLabels;  // Deopt exit for each instruction
+    std::vector<Assembler::Label> safepointLabels; // Safepoint exit for each loop header
+    Assembler::Label epilogue;
+    Assembler::Label entryTable;
+
+    static Mem reg(int32_t index) { return Mem(kRegs, index * static_cast<int32_t>(sizeof(Value))); }
+    static Mem ctxField(size_t offset) { return Mem(kCtx, static_cast<int32_t>(offset)); }
+
+    void emitPrologue() {
+        // Six 8-byte slots (return address + 5 pushes) keep rsp 16-byte
+        // aligned for the helper calls below
+        masm.push(RBP);
+        masm.mov(RBP, RSP);
+        masm.push(RBX);
+        masm.push(R12);
+        masm.push(R13);
+        masm.push(R14);
+        masm.mov(kCtx, RDI);
+        masm.mov(kRegs, RSI);
+        // Dispatch to the requested bytecode index through the entry table
+        masm.leaRip(RAX, entryTable);
+        masm.movsxd(RCX, Mem(RAX, RDX, 4));
+        masm.add(RAX, RCX);
+        masm.jmp(RAX);
+    }
+
+    void emitEpilogue() {
+        masm.bind(epilogue);
+        masm.pop(R14);
+        masm.pop(R13);
+        masm.pop(R12);
+        masm.pop(RBX);
+        masm.pop(RBP);
+        masm.ret();
+    }
+
+    // Table of int32 offsets from the table start to each instruction
+    void emitEntryTable() {
+        masm.bind(entryTable);
+        std::vector<size_t> slots;
+        for (size_t pc = 0; pc < insnLabels.size(); ++pc) {
+            slots.push_back(masm.emit32(0));
+        }
+        for (size_t pc = 0; pc < insnLabels.size(); ++pc) {
+            masm.patch32(slots[pc], insnLabels[pc].position - entryTable.position);
+        }
+    }
+
+    // Exit to the interpreter with `status`, resuming at `pc`
+    void emitExit(JitExit status, int32_t pc) {
+        masm.mov32(ctxField(offsetof(JitContext, pc)), pc);
+        masm.movImm(RAX, static_cast<uint32_t>(status));
+        masm.jmp(epilogue);
+    }
+
+    void emitDeoptStubs() {
+        for (size_t pc = 0; pc < deoptLabels.size(); ++pc) {
+            if (!deoptLabels[pc].fixups.empty()) {
+                masm.bind(deoptLabels[pc]);
+                emitExit(JitExit::Deopt, static_cast<int32_t>(pc));
+            }
+            if (!safepointLabels[pc].fixups.empty()) {
+                masm.bind(safepointLabels[pc]);
+                emitExit(JitExit::Safepoint, static_cast<int32_t>(pc));
+            }
+        }
+    }
+
+    // Jumps to `target`. Loop back-edges first check for a pending garbage
+    // collection and leave compiled code to run it (unless the program runs
+    // without a collector).
+    void emitBranch(int32_t pc, int32_t target) {
+        if (target <= pc && !proto.gcFree) {
+            masm.mov(RDX, ctxField(offsetof(JitContext, gcRequested)));
+            masm.cmp8(Mem(RDX), 0);
+            masm.jcc(NotEqual, safepointLabels[target]);
+        }
+        masm.jmp(insnLabels[target]);
+    }
+
+    // Jumps to `fail` unless `value` holds an int (clobbers rdx)
+    void guardInt(Reg value, Assembler::Label& fail) {
+        masm.mov(RDX, value);
+        masm.shr(RDX, Value::kTagShift);
+        masm.cmpImm(RDX, kIntHigh);
+        masm.jcc(NotEqual, fail);
+    }
+
+    // Sign-extends the 48-bit payload
+    void unboxInt(Reg r) {
+        masm.shl(r, 16);
+        masm.sar(r, 16);
+    }
+
+    // Jumps to `fail` unless `r` fits in 48 bits (clobbers rdx)
+    void guardFits48(Reg r, Assembler::Label& fail) {
+        masm.mov(RDX, r);
+        masm.shl(RDX, 16);
+        masm.sar(RDX, 16);
+        masm.cmp(RDX, r);
+        masm.jcc(NotEqual, fail);
+    }
+
+    // Boxes an in-range int64 (clobbers rdx)
+    void boxInt(Reg r) {
+        masm.movImm(RDX, Value::kPayloadMask);
+        masm.and_(r, RDX);
+        masm.movImm(RDX, kIntBox);
+        masm.or_(r, RDX);
+    }
+
+    // Calls helper(ctx, regs, insn[, extra]) and deopts when it returns 0
+    void emitHelperCall(const void* helper, int32_t pc, const void* extra = nullptr) {
+        masm.mov(RDI, kCtx);
+        masm.mov(RSI, kRegs);
+        masm.movImm(RDX, reinterpret_cast<uint64_t>(&proto.code[pc]));
+        masm.movImm(RCX, reinterpret_cast<uint64_t>(extra));
+        masm.movImm(RAX, reinterpret_cast<uint64_t>(helper));
+        masm.call(RAX);
+        masm.cmp32(RAX, 0);
+        masm.jcc(Equal, deoptLabels[pc]);
+    }
+
+    void emitIntArithmetic(int32_t pc, const Instruction& insn) {
+        Assembler::Label& deopt = deoptLabels[pc];
+        masm.mov(RAX, reg(insn.b));
+        masm.mov(RCX, reg(insn.c));
+        guardInt(RAX, deopt);
+        guardInt(RCX, deopt);
+        unboxInt(RAX);
+        unboxInt(RCX);
+        if (insn.op == Opcode::Add) {
+            masm.add(RAX, RCX);
+        } else if (insn.op == Opcode::Sub) {
+            masm.sub(RAX, RCX);
+        } else {
+            // A zero product with a negative operand would be -0
+            masm.mov(R8, RAX);
+            masm.or_(R8, RCX);
+            masm.imul(RAX, RCX);
+            masm.jcc(Overflow, deopt);
+            Assembler::Label nonZero;
+            masm.cmpImm(RAX, 0);
+            masm.jcc(NotEqual, nonZero);
+            masm.cmpImm(R8, 0);
+            masm.jcc(Less, deopt);
+            masm.bind(nonZero);
+        }
+        guardFits48(RAX, deopt);
+        boxInt(RAX);
+        masm.mov(reg(insn.a), RAX);
+    }
+
+    void emitCompare(int32_t pc, const Instruction& insn, Cond cond) {
+        Assembler::Label generic, done;
+        bool equality = insn.op == Opcode::Eq || insn.op == Opcode::Ne;
+        // Equality also handles strings, null checks etc.; use the generic
+        // helper for those instead of deoptimizing
+        Assembler::Label& fail = equality ? generic : deoptLabels[pc];
+        masm.mov(RAX, reg(insn.b));
+        masm.mov(RCX, reg(insn.c));
+        guardInt(RAX, fail);
+        guardInt(RCX, fail);
+        unboxInt(RAX);
+        unboxInt(RCX);
+        masm.cmp(RAX, RCX);
+        masm.setcc(cond, RAX);
+        masm.movzxb(RAX, RAX);
+        masm.movImm(RDX, kFalseBits);
+        masm.or_(RAX, RDX);
+        masm.mov(reg(insn.a), RAX);
+        if (equality) {
+            masm.jmp(done);
+            masm.bind(generic);
+            emitHelperCall(reinterpret_cast<const void*>(&jitGeneric), pc);
+            masm.bind(done);
+        }
+    }
+
+    void emitConditionalJump(int32_t pc, const Instruction& insn, bool jumpWhen) {
+        Assembler::Label notTaken;
+        masm.mov(RAX, reg(insn.a));
+        masm.movImm(RDX, jumpWhen ? kTrueBits : kFalseBits);
+        masm.cmp(RAX, RDX);
+        masm.jcc(NotEqual, notTaken);
+        emitBranch(pc, insn.b);
+        masm.bind(notTaken);
+        masm.movImm(RDX, jumpWhen ? kFalseBits : kTrueBits);
+        masm.cmp(RAX, RDX);
+        masm.jcc(NotEqual, deoptLabels[pc]); // Not a boolean
+    }
+
+    // Loads the object pointer from `value` into rax, or jumps to `miss`
+    // when it is not a heap object of `kind`
+    void loadObject(Reg value, ObjectKind kind, Assembler::Label& miss) {
+        masm.mov(RDX, value);
+        masm.shr(RDX, Value::kTagShift);
+        masm.cmpImm(RDX, kObjectHigh);
+        masm.jcc(NotEqual, miss);
+        masm.movImm(RDX, Value::kPayloadMask);
+        masm.mov(RAX, value);
+        masm.and_(RAX, RDX);
+        masm.cmp8(Mem(RAX, static_cast<int32_t>(offsetof(HeapObject, kind))), static_cast<uint8_t>(kind));
+        masm.jcc(NotEqual, miss);
+    }
+
+    // Computes the address of slot `rsi` of object `rax` into rdi
+    void slotAddress() {
+        Assembler::Label overflow, done;
+        masm.cmp32(RSI, static_cast<int32_t>(Object::kInlineSlots));
+        masm.jcc(AboveOrEqual, overflow);
+        masm.lea(RDI, Mem(RAX, RSI, 8, fieldOffset(&Object::inlineSlots)));
+        masm.jmp(done);
+        masm.bind(overflow);
+        masm.mov(RDI, Mem(RAX, fieldOffset(&Object::overflow)));
+        masm.lea(RDI, Mem(RDI, RSI, 8,
+                          static_cast<int32_t>(sizeof(ValueArray)) -
+                              static_cast<int32_t>(Object::kInlineSlots * sizeof(Value))));
+        masm.bind(done);
+    }
+
+    // Probes every inline cache entry; jumps to `hit` with the entry's slot
+    // in rsi, or falls through on a miss. Entries past `count` are zeroed,
+    // so they never match a real shape.
+    void probeCache(const PropertyCache& cache, bool requireNoTransition, Assembler::Label& hit,
+                    Assembler::Label& miss) {
+        masm.mov(RCX, Mem(RAX, fieldOffset(&Object::shape)));
+        masm.movImm(R8, reinterpret_cast<uint64_t>(&cache.entries[0]));
+        for (int i = 0; i < PropertyCache::kMaxEntries; ++i) {
+            int32_t base = static_cast<int32_t>(i * sizeof(PropertyCache::Entry));
+            Assembler::Label next;
+            masm.cmp(RCX, Mem(R8, base + static_cast<int32_t>(offsetof(PropertyCache::Entry, shape))));
+            masm.jcc(NotEqual, next);
+            if (requireNoTransition) {
+                masm.cmpMemImm(Mem(R8, base + static_cast<int32_t>(offsetof(PropertyCache::Entry, newShape))), 0);
+                masm.jcc(NotEqual, miss);
+            }
+            masm.mov32(RSI, Mem(R8, base + static_cast<int32_t>(offsetof(PropertyCache::Entry, slot))));
+            masm.jmp(hit);
+            masm.bind(next);
+        }
+    }
+
+    void emitGetProp(int32_t pc, const Instruction& insn) {
+        const PropertyCache& cache = proto.propertyCaches[insn.c];
+        Assembler::Label miss, hit, done;
+        masm.mov(R9, reg(insn.b));
+        loadObject(R9, ObjectKind::Object, miss);
+        probeCache(cache, false, hit, miss);
+        masm.jmp(miss);
+        masm.bind(hit);
+        slotAddress();
+        masm.mov(RAX, Mem(RDI));
+        masm.mov(reg(insn.a), RAX);
+        masm.jmp(done);
+        masm.bind(miss);
+        emitHelperCall(reinterpret_cast<const void*>(&jitGetPropertyMiss), pc, &cache);
+        masm.bind(done);
+    }
+
+    void emitSetProp(int32_t pc, const Instruction& insn) {
+        const PropertyCache& cache = proto.propertyCaches[insn.b];
+        Assembler::Label miss, hit, done;
+        // Incremental marking in progress: let the runtime record the
+        // overwritten value
+        if (!proto.gcFree) {
+            masm.mov(RDX, ctxField(offsetof(JitContext, gcMarking)));
+            masm.cmp8(Mem(RDX), 0);
+            masm.jcc(NotEqual, miss);
+        }
+        masm.mov(R9, reg(insn.a));
+        loadObject(R9, ObjectKind::Object, miss);
+        probeCache(cache, true, hit, miss);
+        masm.jmp(miss);
+        masm.bind(hit);
+        // Overflow storage may be replaced by a task adding a property
+        // meanwhile; the runtime redoes such stores (see object.h)
+        masm.cmp32(RSI, static_cast<int32_t>(Object::kInlineSlots));
+        masm.jcc(AboveOrEqual, miss);
+        masm.lea(RDI, Mem(RAX, RSI, 8, fieldOffset(&Object::inlineSlots)));
+        masm.mov(RCX, reg(insn.c));
+        masm.mov(Mem(RDI), RCX);
+        if (!proto.gcFree) {
+            // Write barrier, only needed when storing an object
+            masm.mov(RDX, RCX);
+            masm.shr(RDX, Value::kTagShift);
+            masm.cmpImm(RDX, kObjectHigh);
+            masm.jcc(NotEqual, done);
+            masm.mov(RDI, kCtx);
+            masm.mov(RSI, RAX);
+            masm.mov(RDX, RCX);
+            masm.movImm(RAX, reinterpret_cast<uint64_t>(&jitWriteBarrier));
+            masm.call(RAX);
+        }
+        masm.jmp(done);
+        masm.bind(miss);
+        emitHelperCall(reinterpret_cast<const void*>(&jitSetPropertyMiss), pc, &cache);
+        masm.bind(done);
+    }
+
+    // Loads instance `value` into rax, or jumps to `miss` unless it is an
+    // instance of `layout`
+    void loadInstance(Reg value, const ClassLayout* layout, Assembler::Label& miss) {
+        loadObject(value, ObjectKind::Instance, miss);
+        masm.movImm(RCX, reinterpret_cast<uint64_t>(layout));
+        masm.cmp(RCX, Mem(RAX, fieldOffset(&Instance::layout)));
+        masm.jcc(NotEqual, miss);
+    }
+
+    // Any and Int32 fields are accessed inline at their fixed offset; the
+    // rarer Float64 and Boolean fields go through the helper
+    void emitGetField(int32_t pc, const Instruction& insn) {
+        const FieldRef& ref = proto.fieldRefs[insn.c];
+        const FieldInfo& field = ref.layout->field(ref.index);
+        Assembler::Label miss, done;
+        if (field.type != FieldType::Any && field.type != FieldType::Int32) {
+            emitHelperCall(reinterpret_cast<const void*>(&jitGetField), pc, &ref);
+            return;
+        }
+        masm.mov(R9, reg(insn.b));
+        loadInstance(R9, ref.layout, miss);
+        Mem slot(RAX, static_cast<int32_t>(field.offset));
+        if (field.type == FieldType::Any) {
+            masm.mov(RAX, slot);
+        } else {
+            masm.movsxd(RAX, slot);
+            boxInt(RAX);
+        }
+        masm.mov(reg(insn.a), RAX);
+        masm.jmp(done);
+        masm.bind(miss);
+        emitHelperCall(reinterpret_cast<const void*>(&jitGetField), pc, &ref);
+        masm.bind(done);
+    }
+
+    void emitSetField(int32_t pc, const Instruction& insn) {
+        const FieldRef& ref = proto.fieldRefs[insn.b];
+        const FieldInfo& field = ref.layout->field(ref.index);
+        Assembler::Label miss, done;
+        if (field.type != FieldType::Any && field.type != FieldType::Int32) {
+            emitHelperCall(reinterpret_cast<const void*>(&jitSetField), pc, &ref);
+            return;
+        }
+        if (field.type == FieldType::Any && !proto.gcFree) {
+            masm.mov(RDX, ctxField(offsetof(JitContext, gcMarking)));
+            masm.cmp8(Mem(RDX), 0);
+            masm.jcc(NotEqual, miss);
+        }
+        masm.mov(R9, reg(insn.a));
+        loadInstance(R9, ref.layout, miss);
+        masm.mov(RCX, reg(insn.c));
+        Mem slot(RAX, static_cast<int32_t>(field.offset));
+        if (field.type == FieldType::Int32) {
+            // Integers outside int32 range fail the type check in the helper
+            guardInt(RCX, miss);
+            unboxInt(RCX);
+            masm.mov(RDX, RCX);
+            masm.shl(RDX, 32);
+            masm.sar(RDX, 32);
+            masm.cmp(RDX, RCX);
+            masm.jcc(NotEqual, miss);
+            masm.mov32(slot, RCX);
+            masm.jmp(done);
+        } else {
+            masm.mov(slot, RCX);
+            if (!proto.gcFree) {
+                masm.mov(RDX, RCX);
+                masm.shr(RDX, Value::kTagShift);
+                masm.cmpImm(RDX, kObjectHigh);
+                masm.jcc(NotEqual, done);
+                masm.mov(RDI, kCtx);
+                masm.mov(RSI, RAX);
+                masm.mov(RDX, RCX);
+                masm.movImm(RAX, reinterpret_cast<uint64_t>(&jitWriteBarrier));
+                masm.call(RAX);
+            }
+            masm.jmp(done);
+        }
+        masm.bind(miss);
+        emitHelperCall(reinterpret_cast<const void*>(&jitSetField), pc, &ref);
+        masm.bind(done);
+    }
+
+    // Int updates that stay in range: a compare-and-swap loop on the global,
+    // retried with the value another thread stored. Anything else goes to
+    // the helper, which loops the same way with the generic operation.
+    void emitAtomicArithmetic(int32_t pc, const Instruction& insn) {
+        Assembler::Label retry, generic, done;
+        Mem slot(R8, insn.b * static_cast<int32_t>(sizeof(Value)));
+        masm.mov(RCX, reg(insn.c));
+        guardInt(RCX, generic);
+        unboxInt(RCX);
+        masm.mov(R8, ctxField(offsetof(JitContext, globals)));
+        masm.mov(RAX, slot);
+        masm.bind(retry);
+        guardInt(RAX, generic);
+        masm.mov(RSI, RAX);
+        unboxInt(RSI);
+        if (insn.op == Opcode::AtomicAddGlobal) {
+            masm.add(RSI, RCX);
+        } else {
+            masm.sub(RSI, RCX);
+        }
+        guardFits48(RSI, generic);
+        boxInt(RSI);
+        masm.lockCmpxchg(slot, RSI);
+        masm.jcc(NotEqual, retry);
+        masm.mov(reg(insn.a), RAX);
+        masm.jmp(done);
+        masm.bind(generic);
+        emitHelperCall(reinterpret_cast<const void*>(&jitGeneric), pc);
+        masm.bind(done);
+    }
+
+    // An int expected value is strictly equal exactly to the same bits,
+    // unless the global holds a double; that and other expected values go
+    // to the helper
+    void emitCompareAndSet(int32_t pc, const Instruction& insn) {
+        Assembler::Label success, generic, done;
+        masm.mov(RAX, reg(insn.c));
+        guardInt(RAX, generic);
+        masm.mov(R8, ctxField(offsetof(JitContext, globals)));
+        masm.mov(RCX, reg(insn.c + 1));
+        masm.lockCmpxchg(Mem(R8, insn.b * static_cast<int32_t>(sizeof(Value))), RCX);
+        masm.jcc(Equal, success);
+        guardInt(RAX, generic); // rax now holds the global
+        masm.movImm(RAX, kFalseBits);
+        masm.mov(reg(insn.a), RAX);
+        masm.jmp(done);
+        masm.bind(success);
+        masm.movImm(RAX, kTrueBits);
+        masm.mov(reg(insn.a), RAX);
+        masm.jmp(done);
+        masm.bind(generic);
+        emitHelperCall(reinterpret_cast<const void*>(&jitGeneric), pc);
+        masm.bind(done);
+    }
+
+    void emitInstruction(int32_t pc, const Instruction& insn) {
+        switch (insn.op) {
+            case Opcode::LoadConst:
+                masm.movImm(RAX, reinterpret_cast<uint64_t>(&proto.constants[insn.b]));
+                masm.mov(RAX, Mem(RAX));
+                masm.mov(reg(insn.a), RAX);
+                break;
+            case Opcode::LoadInt:
+                masm.movImm(RAX, Value::integer(insn.b).rawBits());
+                masm.mov(reg(insn.a), RAX);
+                break;
+            case Opcode::LoadUndefined:
+                masm.movImm(RAX, Value::undefined().rawBits());
+                masm.mov(reg(insn.a), RAX);
+                break;
+            case Opcode::LoadNull:
+                masm.movImm(RAX, Value::null().rawBits());
+                masm.mov(reg(insn.a), RAX);
+                break;
+            case Opcode::LoadTrue:
+                masm.movImm(RAX, kTrueBits);
+                masm.mov(reg(insn.a), RAX);
+                break;
+            case Opcode::LoadFalse:
+                masm.movImm(RAX, kFalseBits);
+                masm.mov(reg(insn.a), RAX);
+                break;
+            case Opcode::Move:
+                masm.mov(RAX, reg(insn.b));
+                masm.mov(reg(insn.a), RAX);
+                break;
+            case Opcode::Add:
+            case Opcode::Sub:
+            case Opcode::Mul:
+                emitIntArithmetic(pc, insn);
+                break;
+            case Opcode::Div:
+            case Opcode::Mod:
+            case Opcode::Neg:
+            case Opcode::Not:
+            case Opcode::NewObject:
+            case Opcode::NewWild:
+            case Opcode::WildRetain:
+            case Opcode::WildCheck:
+            case Opcode::WildRelease:
+            case Opcode::Destroy:
+            case Opcode::Transfer:
+            case Opcode::EnterRegion:
+            case Opcode::ExitRegion:
+            case Opcode::NewScopedWild:
+            case Opcode::Unlock:
+                emitHelperCall(reinterpret_cast<const void*>(&jitGeneric), pc);
+                break;
+            case Opcode::Lock:
+                emitHelperCall(reinterpret_cast<const void*>(&jitLock), pc, &proto.lockSites[static_cast<size_t>(insn.c)]);
+                break;
+            case Opcode::Eq: emitCompare(pc, insn, Equal); break;
+            case Opcode::Ne: emitCompare(pc, insn, NotEqual); break;
+            case Opcode::Lt: emitCompare(pc, insn, Less); break;
+            case Opcode::Le: emitCompare(pc, insn, LessOrEqual); break;
+            case Opcode::Gt: emitCompare(pc, insn, Greater); break;
+            case Opcode::Ge: emitCompare(pc, insn, GreaterOrEqual); break;
+            case Opcode::Jump:
+                emitBranch(pc, insn.a);
+                break;
+            case Opcode::JumpIfTrue:
+                emitConditionalJump(pc, insn, true);
+                break;
+            case Opcode::JumpIfFalse:
+                emitConditionalJump(pc, insn, false);
+                break;
+            case Opcode::GetGlobal:
+                masm.mov(RAX, ctxField(offsetof(JitContext, globals)));
+                masm.mov(RAX, Mem(RAX, insn.b * static_cast<int32_t>(sizeof(Value))));
+                masm.mov(reg(insn.a), RAX);
+                break;
+            case Opcode::SetGlobal:
+                masm.mov(RAX, ctxField(offsetof(JitContext, globals)));
+                masm.mov(RCX, reg(insn.b));
+                masm.mov(Mem(RAX, insn.a * static_cast<int32_t>(sizeof(Value))), RCX);
+                break;
+            case Opcode::AtomicAddGlobal:
+            case Opcode::AtomicSubGlobal:
+                emitAtomicArithmetic(pc, insn);
+                break;
+            case Opcode::CompareAndSetGlobal:
+                emitCompareAndSet(pc, insn);
+                break;
+            case Opcode::GetProp:
+                emitGetProp(pc, insn);
+                break;
+            case Opcode::SetProp:
+                emitSetProp(pc, insn);
+                break;
+            case Opcode::NewInstance:
+                emitHelperCall(reinterpret_cast<const void*>(&jitNewInstance), pc, proto.classes[insn.b]);
+                break;
+            case Opcode::GetField:
+                emitGetField(pc, insn);
+                break;
+            case Opcode::SetField:
+                emitSetField(pc, insn);
+                break;
+            case Opcode::Call:
+            case Opcode::Await: // Suspending pops the frame; the interpreter does that
+                emitExit(JitExit::Call, pc);
+                break;
+            case Opcode::Return:
+                masm.mov(RAX, reg(insn.a));
+                masm.mov(ctxField(offsetof(JitContext, result)), RAX);
+                masm.movImm(RAX, static_cast<uint32_t>(JitExit::Return));
+                masm.jmp(epilogue);
+                break;
+            case Opcode::ReturnUndefined:
+                masm.movImm(RAX, Value::undefined().rawBits());
+                masm.mov(ctxField(offsetof(JitContext, result)), RAX);
+                masm.movImm(RAX, static_cast<uint32_t>(JitExit::Return));
+                masm.jmp(epilogue);
+                break;
+        }
+    }
+};
+
+} // namespace
+
+bool BaselineJit::isSupported() {
+    return true;
+}
+
+std::shared_ptr<JitCode> BaselineJit::compile(const FunctionProto& proto) {
+    if (proto.code.empty()) {
+        return nullptr;
+    }
+    std::vector<uint8_t> machineCode = Compiler(proto).compile();
+    auto jit = std::make_shared<JitCode>();
+    if (!jit->memory.install(machineCode)) {
+        return nullptr;
+    }
+    jit->entry = reinterpret_cast<JitEntry>(const_cast<void*>(jit->memory.data()));
+    return jit;
+}
+
+#else // !SE_ENABLE_JIT
+
+bool BaselineJit::isSupported() {
+    return false;
+}
+
+std::shared_ptr<JitCode> BaselineJit::compile(const FunctionProto&) {
+    return nullptr;
+}
+
+#endif
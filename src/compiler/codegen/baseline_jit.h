@@ -0,0 +1,69 @@
+#ifndef BASELINE_JIT_H
+#define BASELINE_JIT_H
+
+#include "runtime/memory/executable_memory.h"
+#include "runtime/vm/function_proto.h"
+#include <cstdint>
+#include <memory>
+
+class VM;
+
+// State shared between the interpreter and JIT-compiled code
+struct JitContext {
+    VM* vm;
+    Value* globals;   // VM global slots (refreshed on every entry)
+    const uint8_t* gcRequested; // Non-zero when the heap wants a safepoint
+    const uint8_t* gcMarking;   // Non-zero while stores need the SATB barrier
+    uint64_t result;  // Return value bits when the code exits with Return
+    int32_t pc;       // Instruction to resume at for Call and Deopt exits
+};
+
+// Why compiled code handed control back to the interpreter
+enum class JitExit : uint32_t {
+    Return = 0, // The function returned; result is in JitContext::result
+    Call = 1,   // The Call or Await instruction at pc must be performed by the interpreter
+    Deopt = 2,  // A type guard failed; interpret from pc
+    Safepoint = 3 // A collection is pending at the loop header at pc
+};
+
+// Entry point of compiled code. Execution starts at bytecode index
+// `startPc`, so the interpreter can enter at function entry, after a call
+// returns, or at a loop header (on-stack replacement).
+using JitEntry = uint32_t (*)(JitContext* ctx, Value* regs, uint64_t startPc);
+
+// Machine code for one function
+struct JitCode {
+    ExecutableMemory memory;
+    JitEntry entry = nullptr;
+};
+
+// Baseline (template) JIT for x86-64.
+//
+// Every bytecode instruction is translated to a fixed machine code pattern
+// operating directly on the interpreter's register window, so interpreter
+// and compiled code share frames and can hand over at any instruction.
+// Int arithmetic, comparisons, branches, globals and inline-cache hits run
+// natively; property cache misses and generic operations call C++ helpers;
+// calls and returns exit to the interpreter, which manages frames, and so
+// do loop back-edges while a garbage collection is pending. A failed
+// int or boolean type guard deoptimizes: compiled code exits at that
+// instruction and the interpreter carries on from there.
+class BaselineJit {
+public:
+    // A function is compiled once its hotness (invocations plus loop
+    // back-edges) reaches this threshold
+    static constexpr uint32_t kHotnessThreshold = 1000;
+
+    // Functions that deoptimize more often than this lose their code and
+    // stay in the interpreter
+    static constexpr uint32_t kMaxDeopts = 1000;
+
+    // True when this build can generate and run machine code
+    static bool isSupported();
+
+    // Compiles `proto`. Returns nullptr when the JIT is unsupported or the
+    // platform refuses executable memory.
+    static std::shared_ptr<JitCode> compile(const FunctionProto& proto);
+};
+
+#endif // BASELINE_JIT_H
@@ -0,0 +1,140 @@
+#include "compiler/codegen/bytecode_builder.h"
+#include "compiler/codegen/atomic_updates.h"
+#include "compiler/codegen/liveness.h"
+#include "compiler/codegen/ownership.h"
+#include "compiler/codegen/wild_refcount.h"
+#include "runtime/vm/class_layout.h"
+#include "runtime/vm/string_ops.h"
+#include <algorithm>
+#include <stdexcept>
+
+BytecodeBuilder::BytecodeBuilder(std::string name, int numParams)
+    : proto(std::make_unique<FunctionProto>()) {
+    proto->name = std::move(name);
+    proto->numParams = numParams;
+    proto->numRegisters = numParams;
+}
+
+int BytecodeBuilder::emit(Opcode op, int32_t a, int32_t b, int32_t c) {
+    // Grow the register window to cover every register operand
+    const OpcodeInfo& info = opcodeInfo(op);
+    const int32_t operands[3] = {a, b, c};
+    for (int i = 0; i < 3; ++i) {
+        if (info.operands[i] == OperandKind::RegRead || info.operands[i] == OperandKind::RegWrite) {
+            proto->numRegisters = std::max(proto->numRegisters, operands[i] + 1);
+        } else if (info.operands[i] == OperandKind::RegPair) {
+            proto->numRegisters = std::max(proto->numRegisters, operands[i] + 2);
+        }
+    }
+    if (op == Opcode::Call) {
+        // Arguments occupy the registers after the callee
+        proto->numRegisters = std::max(proto->numRegisters, b + c + 1);
+    }
+    proto->code.push_back(Instruction{op, a, b, c});
+    return currentOffset() - 1;
+}
+
+int BytecodeBuilder::emitJump(Label target) {
+    patches.emplace_back(currentOffset(), target.id);
+    return emit(Opcode::Jump, 0);
+}
+
+int BytecodeBuilder::emitJumpIfTrue(int condition, Label target) {
+    patches.emplace_back(currentOffset(), target.id);
+    return emit(Opcode::JumpIfTrue, condition, 0);
+}
+
+int BytecodeBuilder::emitJumpIfFalse(int condition, Label target) {
+    patches.emplace_back(currentOffset(), target.id);
+    return emit(Opcode::JumpIfFalse, condition, 0);
+}
+
+BytecodeBuilder::Label BytecodeBuilder::newLabel() {
+    labelOffsets.push_back(-1);
+    return Label{static_cast<int>(labelOffsets.size()) - 1};
+}
+
+void BytecodeBuilder::bind(Label label) {
+    labelOffsets[label.id] = currentOffset();
+}
+
+int BytecodeBuilder::addConstant(Value value) {
+    // Reuse identical constants (interned strings compare by identity)
+    auto& constants = proto->constants;
+    auto it = std::find(constants.begin(), constants.end(), value);
+    if (it != constants.end()) {
+        return static_cast<int>(it - constants.begin());
+    }
+    constants.push_back(value);
+    return static_cast<int>(constants.size()) - 1;
+}
+
+int BytecodeBuilder::addPropertyCache(const String* key) {
+    proto->propertyCaches.emplace_back(key);
+    return static_cast<int>(proto->propertyCaches.size()) - 1;
+}
+
+int BytecodeBuilder::addClass(const ClassLayout* layout) {
+    auto& classes = proto->classes;
+    auto it = std::find(classes.begin(), classes.end(), layout);
+    if (it != classes.end()) {
+        return static_cast<int>(it - classes.begin());
+    }
+    classes.push_back(layout);
+    return static_cast<int>(classes.size()) - 1;
+}
+
+int BytecodeBuilder::addFieldRef(const ClassLayout* layout, const String* name) {
+    int index = layout->fieldIndex(name);
+    if (index < 0) {
+        throw std::logic_error("Class " + layout->name() + " declares no field '" + toUtf8(name) + "'");
+    }
+    auto& refs = proto->fieldRefs;
+    for (size_t i = 0; i < refs.size(); ++i) {
+        if (refs[i].layout == layout && refs[i].index == static_cast<uint32_t>(index)) {
+            return static_cast<int>(i);
+        }
+    }
+    refs.push_back(FieldRef{layout, static_cast<uint32_t>(index)});
+    return static_cast<int>(refs.size()) - 1;
+}
+
+int BytecodeBuilder::addLockSite() {
+    proto->lockSites.emplace_back();
+    return static_cast<int>(proto->lockSites.size()) - 1;
+}
+
+std::unique_ptr<FunctionProto> BytecodeBuilder::finish() {
+    // Falling off the end returns undefined; a label bound past the last
+    // instruction also needs something to land on
+    bool labelAtEnd = std::find(labelOffsets.begin(), labelOffsets.end(), currentOffset()) != labelOffsets.end();
+    if (proto->code.empty() || labelAtEnd ||
+        (proto->code.back().op != Opcode::Return && proto->code.back().op != Opcode::ReturnUndefined)) {
+        emit(Opcode::ReturnUndefined);
+    }
+    for (const auto& [index, labelId] : patches) {
+        int target = labelOffsets[labelId];
+        if (target < 0) {
+            throw std::logic_error("Unbound label in function " + proto->name);
+        }
+        Instruction& insn = proto->code[index];
+        if (insn.op == Opcode::Jump) {
+            insn.a = target;
+        } else {
+            insn.b = target;
+        }
+    }
+    patches.clear();
+    // Only a coroutine's own frame can suspend, and the collector must be
+    // free to run while it is suspended
+    bool awaits = std::any_of(proto->code.begin(), proto->code.end(),
+                              [](const Instruction& insn) { return insn.op == Opcode::Await; });
+    if (awaits && !proto->isAsync) {
+        throw std::logic_error("Await outside an async function in " + proto->name);
+    }
+    cancelWildRefPairs(*proto);
+    checkOwnership(*proto); // After pair cancellation, which leaves checks behind
+    atomicSites = lowerAtomicUpdates(*proto);
+    proto->stackMap = computeStackMap(*proto);
+    return std::move(proto);
+}
@@ -0,0 +1,79 @@
+#ifndef BYTECODE_BUILDER_H
+#define BYTECODE_BUILDER_H
+
+#include "compiler/codegen/atomic_updates.h"
+#include "runtime/vm/function_proto.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Assembles the bytecode of one function.
+// Jumps may refer to labels that are bound later; finish() patches them and
+// computes the register window size from the operands that were emitted.
+class BytecodeBuilder {
+public:
+    struct Label {
+        int id;
+    };
+
+    BytecodeBuilder(std::string name, int numParams);
+
+    // Emits one instruction and returns its index
+    int emit(Opcode op, int32_t a = 0, int32_t b = 0, int32_t c = 0);
+
+    // Jump helpers taking a label instead of an absolute target
+    int emitJump(Label target);
+    int emitJumpIfTrue(int condition, Label target);
+    int emitJumpIfFalse(int condition, Label target);
+
+    Label newLabel();
+    void bind(Label label); // Binds the label to the next emitted instruction
+
+    // Adds a value to the constant pool and returns its index
+    int addConstant(Value value);
+
+    // Adds an inline cache for a GetProp/SetProp site accessing `key` (an
+    // interned string) and returns its index. Every site needs its own cache.
+    int addPropertyCache(const String* key);
+
+    // Operand of NewInstance for a class, and of GetField/SetField for its
+    // field called `name` (interned). Unlike caches these are shared by
+    // every site. Throws std::logic_error when the class has no such field.
+    int addClass(const ClassLayout* layout);
+    int addFieldRef(const ClassLayout* layout, const String* name);
+
+    // Adds the contention counters of a Lock site and returns their index
+    int addLockSite();
+
+    // Marks the function as a `wild function`: the collector is suspended
+    // while it (and anything it calls) runs. A wild async function lets it
+    // run again while suspended at an Await.
+    void setWild(bool wild = true) { proto->isWild = wild; }
+
+    // Marks the function as an `async function`: calls run it as a
+    // coroutine and return its promise, and it may use Await
+    void setAsync(bool async = true) { proto->isAsync = async; }
+
+    // Index of the next instruction to be emitted
+    int currentOffset() const { return static_cast<int>(proto->code.size()); }
+
+    // Resolves jumps and returns the finished function, appending a
+    // ReturnUndefined when control can fall off the end.
+    // Throws std::logic_error when a used label was never bound, Await
+    // appears outside an async function, and
+    // OwnershipError when a wild object is definitely used after a destroy
+    // or transfer (see checkOwnership).
+    std::unique_ptr<FunctionProto> finish();
+
+    // Read-modify-write sites of globals that finish() lowered to atomic
+    // instructions (see lowerAtomicUpdates)
+    const std::vector<AtomicSite>& loweredAtomicSites() const { return atomicSites; }
+
+private:
+    std::unique_ptr<FunctionProto> proto;
+    std::vector<AtomicSite> atomicSites;
+    std::vector<int> labelOffsets;               // -1 while unbound
+    std::vector<std::pair<int, int>> patches;    // (instruction, label id)
+};
+
+#endif // BYTECODE_BUILDER_H
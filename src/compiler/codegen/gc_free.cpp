@@ -0,0 +1,234 @@
+#include "compiler/codegen/gc_free.h"
+#include "runtime/vm/heap_object.h"
+#include <cstdint>
+#include <string>
+
+namespace {
+
+// Kinds of values a register may hold, as a bit set
+using Kinds = uint8_t;
+constexpr Kinds kPrimitive = 1; // Numbers, booleans, undefined, null
+constexpr Kinds kString = 2;
+constexpr Kinds kObject = 4;
+constexpr Kinds kFunction = 8;
+constexpr Kinds kWild = 16;
+
+Kinds kindOf(Value v) {
+    if (v.isWild()) {
+        return kWild;
+    }
+    if (!v.isObject()) {
+        return kPrimitive;
+    }
+    if (isString(v)) {
+        return kString;
+    }
+    return isFunction(v) ? kFunction : kObject;
+}
+
+// Per-function dataflow; `inputs` are the kinds of values from outside the
+// function. Returns the kinds the function lets out (stores, arguments,
+// return values) and reports its first allocation site in `reason`.
+Kinds analyzeFunction(const FunctionProto& proto, Kinds inputs, std::string& reason) {
+    const std::vector<Instruction>& code = proto.code;
+    size_t count = code.size();
+    size_t registers = static_cast<size_t>(proto.numRegisters);
+    if (count == 0) {
+        return 0;
+    }
+    std::vector<std::vector<Kinds>> in(count);
+    std::vector<bool> reached(count);
+    reached[0] = true;
+    in[0].assign(registers, kPrimitive);
+    for (size_t r = 0; r < static_cast<size_t>(proto.numParams); ++r) {
+        in[0][r] = inputs;
+    }
+
+    auto join = [&](size_t target, const std::vector<Kinds>& state) {
+        if (!reached[target]) {
+            reached[target] = true;
+            in[target] = state;
+            return true;
+        }
+        bool changed = false;
+        for (size_t r = 0; r < registers; ++r) {
+            Kinds merged = in[target][r] | state[r];
+            changed |= merged != in[target][r];
+            in[target][r] = merged;
+        }
+        return changed;
+    };
+
+    Kinds escaping = 0;
+    std::vector<Kinds> out;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        escaping = 0;
+        reason.clear();
+        for (size_t pc = 0; pc < count; ++pc) {
+            if (!reached[pc]) {
+                continue;
+            }
+            const Instruction& insn = code[pc];
+            out = in[pc];
+            auto reg = [&](int32_t index) -> Kinds& { return out[static_cast<size_t>(index)]; };
+            auto allocates = [&](const char* what) {
+                if (reason.empty()) {
+                    reason = "function " + proto.name + ", instruction " + std::to_string(pc) + ": " + what;
+                }
+            };
+            switch (insn.op) {
+                case Opcode::LoadConst:
+                    reg(insn.a) = kindOf(proto.constants[static_cast<size_t>(insn.b)]);
+                    break;
+                case Opcode::Move:
+                    reg(insn.a) = reg(insn.b);
+                    break;
+                case Opcode::Add: {
+                    Kinds operands = reg(insn.b) | reg(insn.c);
+                    if (operands & kString) {
+                        allocates("string concatenation");
+                        reg(insn.a) = kPrimitive | kString;
+                    } else {
+                        reg(insn.a) = kPrimitive;
+                    }
+                    break;
+                }
+                case Opcode::NewObject:
+                    allocates("object creation");
+                    reg(insn.a) = kObject;
+                    break;
+                case Opcode::NewInstance:
+                    allocates("instance creation");
+                    reg(insn.a) = kObject;
+                    break;
+                case Opcode::NewWild:
+                case Opcode::NewScopedWild:
+                    reg(insn.a) = kWild;
+                    break;
+                case Opcode::Transfer:
+                    reg(insn.a) = reg(insn.b);
+                    reg(insn.b) = kWild;
+                    break;
+                case Opcode::Lock:
+                    allocates("Run.lock (its promise when the lock is held)");
+                    reg(insn.a) = kWild | kObject;
+                    break;
+                case Opcode::GetGlobal:
+                case Opcode::GetProp:
+                case Opcode::GetField:
+                case Opcode::Await:
+                    reg(insn.a) = inputs;
+                    break;
+                case Opcode::SetGlobal:
+                    escaping |= reg(insn.b);
+                    break;
+                case Opcode::AtomicAddGlobal:
+                    if ((inputs | reg(insn.c)) & kString) {
+                        allocates("string concatenation");
+                        escaping |= kString;
+                    }
+                    reg(insn.a) = inputs;
+                    break;
+                case Opcode::AtomicSubGlobal:
+                    reg(insn.a) = inputs;
+                    break;
+                case Opcode::CompareAndSetGlobal:
+                    escaping |= reg(insn.c + 1);
+                    reg(insn.a) = kPrimitive;
+                    break;
+                case Opcode::SetProp:
+                case Opcode::SetField: // Misses store by name, possibly into an expando
+                    if (reg(insn.a) & kObject) {
+                        allocates("property store into an object");
+                    }
+                    escaping |= reg(insn.c);
+                    break;
+                case Opcode::Call:
+                    for (int32_t r = insn.b + 1; r <= insn.b + insn.c; ++r) {
+                        escaping |= reg(r);
+                    }
+                    for (size_t r = static_cast<size_t>(insn.b) + 1; r < registers; ++r) {
+                        out[r] = inputs; // Clobbered by the callee's window
+                    }
+                    reg(insn.a) = inputs;
+                    break;
+                case Opcode::Return:
+                    escaping |= reg(insn.a);
+                    break;
+                default: {
+                    // Everything else produces primitives
+                    const OpcodeInfo& info = opcodeInfo(insn.op);
+                    const int32_t operands[3] = {insn.a, insn.b, insn.c};
+                    for (int i = 0; i < 3; ++i) {
+                        if (info.operands[i] == OperandKind::RegWrite) {
+                            reg(operands[i]) = kPrimitive;
+                        }
+                    }
+                    break;
+                }
+            }
+            switch (insn.op) {
+                case Opcode::Jump:
+                    changed |= join(static_cast<size_t>(insn.a), out);
+                    break;
+                case Opcode::JumpIfTrue:
+                case Opcode::JumpIfFalse:
+                    changed |= join(static_cast<size_t>(insn.b), out);
+                    if (pc + 1 < count) {
+                        changed |= join(pc + 1, out);
+                    }
+                    break;
+                case Opcode::Return:
+                case Opcode::ReturnUndefined:
+                    break;
+                default:
+                    if (pc + 1 < count) {
+                        changed |= join(pc + 1, out);
+                    }
+                    break;
+            }
+        }
+    }
+    if (proto.isAsync && reason.empty()) {
+        reason = "function " + proto.name + ": async call (coroutine frame)";
+    }
+    return escaping;
+}
+
+} // namespace
+
+GcFreeReport analyzeGcFree(const std::vector<const FunctionProto*>& program, const std::vector<Value>& globals) {
+    Kinds inputs = kPrimitive | kWild;
+    for (Value global : globals) {
+        inputs |= kindOf(global);
+    }
+    for (const FunctionProto* proto : program) {
+        for (Value constant : proto->constants) {
+            if (isFunction(constant)) {
+                inputs |= kFunction; // Could be stored anywhere
+            }
+        }
+    }
+
+    // Whatever one function lets out, every other one may see; iterate
+    // until the set of kinds is stable (it only grows, and is small)
+    GcFreeReport report;
+    while (true) {
+        Kinds escaping = 0;
+        report = GcFreeReport();
+        for (const FunctionProto* proto : program) {
+            std::string reason;
+            escaping |= analyzeFunction(*proto, inputs, reason);
+            if (!reason.empty() && report.gcFree) {
+                report.gcFree = false;
+                report.reason = reason;
+            }
+        }
+        if ((inputs | escaping) == inputs) {
+            return report;
+        }
+        inputs |= escaping;
+    }
+}
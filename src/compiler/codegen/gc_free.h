@@ -0,0 +1,32 @@
+#ifndef GC_FREE_H
+#define GC_FREE_H
+
+#include "runtime/vm/function_proto.h"
+#include <string>
+#include <vector>
+
+// Outcome of analyzeGcFree()
+struct GcFreeReport {
+    bool gcFree = true;
+    std::string reason; // First allocation site found, when not GC-free
+};
+
+// Whole-program analysis proving that running `program` never allocates
+// on the collected heap. Such a program can run with the collector
+// switched off: its functions need no safepoint polls, write barriers or
+// stack maps (see VM::enableCollectorless).
+//
+// Values are classified by kind (primitive, string, object, function,
+// wild) with a forward dataflow analysis in every function. Parameters,
+// globals, property reads and call results can be anything the program
+// stores, passes, returns or finds in `globals`; values passed in by the
+// host are assumed to be primitives or wild objects. Allowed are objects
+// with a static lifetime: constants (including string literals), interned
+// strings and the function objects themselves.
+//
+// A site allocates when it is a NewObject, an Add that may see a string
+// (concatenation), or a property store into a possible object (which may
+// grow its slot storage).
+GcFreeReport analyzeGcFree(const std::vector<const FunctionProto*>& program, const std::vector<Value>& globals);
+
+#endif // GC_FREE_H
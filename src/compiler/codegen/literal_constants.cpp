@@ -0,0 +1,15 @@
+#include "compiler/codegen/literal_constants.h"
+#include "runtime/vm/vm.h"
+
+std::optional<Value> literalConstant(VM& vm, const Expression& expr) {
+    if (auto* integer = dynamic_cast<const IntegerLiteral*>(&expr)) {
+        return Value::fromInt64(integer->value);
+    }
+    if (auto* floating = dynamic_cast<const FloatLiteral*>(&expr)) {
+        return Value::number(floating->value);
+    }
+    if (auto* string = dynamic_cast<const StringLiteral*>(&expr)) {
+        return Value::object(vm.intern(string->value));
+    }
+    return std::nullopt;
+}
@@ -0,0 +1,17 @@
+#ifndef LITERAL_CONSTANTS_H
+#define LITERAL_CONSTANTS_H
+
+#include "compiler/ast/expression.h"
+#include "runtime/vm/value.h"
+#include <optional>
+
+class VM;
+
+// Returns the constant Value denoted by a literal AST node, or nullopt when
+// the expression is not a literal.
+//   IntegerLiteral -> int when it fits 48 bits, otherwise double
+//   FloatLiteral   -> double
+//   StringLiteral  -> interned string
+std::optional<Value> literalConstant(VM& vm, const Expression& expr);
+
+#endif // LITERAL_CONSTANTS_H
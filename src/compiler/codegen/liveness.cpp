@@ -0,0 +1,94 @@
+#include "compiler/codegen/liveness.h"
+#include <algorithm>
+
+namespace {
+
+// Bit set helpers over one stack map row
+void setBit(std::vector<uint64_t>& set, int reg) {
+    set[static_cast<size_t>(reg) / 64] |= uint64_t(1) << (reg % 64);
+}
+
+void clearBit(std::vector<uint64_t>& set, int reg) {
+    set[static_cast<size_t>(reg) / 64] &= ~(uint64_t(1) << (reg % 64));
+}
+
+void unionRow(std::vector<uint64_t>& set, const uint64_t* row) {
+    for (size_t i = 0; i < set.size(); ++i) {
+        set[i] |= row[i];
+    }
+}
+
+} // namespace
+
+StackMap computeStackMap(const FunctionProto& proto) {
+    size_t count = proto.code.size();
+    StackMap map(count, proto.numRegisters);
+    size_t words = map.wordsPerInstruction();
+    std::vector<uint64_t> live(words);
+
+    // Iterate to a fixed point; loops need more than one backward pass
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t pc = count; pc-- > 0;) {
+            const Instruction& insn = proto.code[pc];
+
+            // Live-out: union of the successors' live-in sets
+            std::fill(live.begin(), live.end(), 0);
+            switch (insn.op) {
+                case Opcode::Jump:
+                    unionRow(live, map.row(static_cast<size_t>(insn.a)));
+                    break;
+                case Opcode::JumpIfTrue:
+                case Opcode::JumpIfFalse:
+                    unionRow(live, map.row(static_cast<size_t>(insn.b)));
+                    if (pc + 1 < count) {
+                        unionRow(live, map.row(pc + 1));
+                    }
+                    break;
+                case Opcode::Return:
+                case Opcode::ReturnUndefined:
+                    break;
+                default:
+                    if (pc + 1 < count) {
+                        unionRow(live, map.row(pc + 1));
+                    }
+                    break;
+            }
+
+            // Live-in = (live-out - defs) + uses
+            const OpcodeInfo& info = opcodeInfo(insn.op);
+            const int32_t operands[3] = {insn.a, insn.b, insn.c};
+            for (int i = 0; i < 3; ++i) {
+                if (info.operands[i] == OperandKind::RegWrite) {
+                    clearBit(live, operands[i]);
+                }
+            }
+            if (insn.op == Opcode::Call) {
+                for (int reg = insn.b + 1; reg < proto.numRegisters; ++reg) {
+                    clearBit(live, reg);
+                }
+                for (int reg = insn.b; reg <= insn.b + insn.c; ++reg) {
+                    setBit(live, reg);
+                }
+            }
+            for (int i = 0; i < 3; ++i) {
+                if (info.operands[i] == OperandKind::RegRead) {
+                    setBit(live, operands[i]);
+                } else if (info.operands[i] == OperandKind::RegPair) {
+                    setBit(live, operands[i]);
+                    setBit(live, operands[i] + 1);
+                }
+            }
+
+            uint64_t* row = map.row(pc);
+            for (size_t w = 0; w < words; ++w) {
+                if (row[w] != live[w]) {
+                    row[w] = live[w];
+                    changed = true;
+                }
+            }
+        }
+    }
+    return map;
+}
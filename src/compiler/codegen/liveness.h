@@ -0,0 +1,15 @@
+#ifndef LIVENESS_H
+#define LIVENESS_H
+
+#include "runtime/vm/function_proto.h"
+#include "runtime/vm/stack_map.h"
+
+// Computes the register liveness of a function's bytecode (a backward
+// dataflow analysis over the operand kinds in opcodeInfo) and returns it as
+// the stack map used by the garbage collector.
+//
+// A Call clobbers every register above its callee register, so those are
+// dead before the call unless they are its arguments.
+StackMap computeStackMap(const FunctionProto& proto);
+
+#endif // LIVENESS_H
@@ -0,0 +1,256 @@
+#include "compiler/codegen/ownership.h"
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+// What a register holds: a NewWild site index (the most recent object
+// allocated there), or one of these
+constexpr int32_t kUntracked = -1;   // Anything, including wild objects
+constexpr int32_t kTransferred = -2; // The transferred marker
+
+enum class SiteState : uint8_t { Live, Destroyed, Unknown };
+
+struct State {
+    bool reached = false;
+    std::vector<int32_t> regs;
+    std::vector<SiteState> sites;
+    std::vector<bool> escaped; // A call or untracked register may destroy it
+};
+
+// Folds `from` into `into` and returns whether `into` changed
+bool join(State& into, const State& from) {
+    if (!into.reached) {
+        into = from;
+        return true;
+    }
+    bool changed = false;
+    for (size_t r = 0; r < into.regs.size(); ++r) {
+        if (into.regs[r] == from.regs[r]) {
+            continue;
+        }
+        // The object stays reachable through a register no longer tracked
+        for (int32_t site : {into.regs[r], from.regs[r]}) {
+            if (site >= 0 && !into.escaped[static_cast<size_t>(site)]) {
+                into.escaped[static_cast<size_t>(site)] = true;
+                changed = true;
+            }
+        }
+        if (into.regs[r] != kUntracked) {
+            into.regs[r] = kUntracked;
+            changed = true;
+        }
+    }
+    for (size_t s = 0; s < into.sites.size(); ++s) {
+        if (into.sites[s] != from.sites[s] && into.sites[s] != SiteState::Unknown) {
+            into.sites[s] = SiteState::Unknown;
+            changed = true;
+        }
+        if (from.escaped[s] && !into.escaped[s]) {
+            into.escaped[s] = true;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+void escape(State& state, int reg) {
+    int32_t site = state.regs[static_cast<size_t>(reg)];
+    if (site >= 0) {
+        state.escaped[static_cast<size_t>(site)] = true;
+    }
+}
+
+// Anything that may destroy an escaped object just did
+void forgetEscaped(State& state) {
+    for (size_t s = 0; s < state.sites.size(); ++s) {
+        if (state.escaped[s]) {
+            state.sites[s] = SiteState::Unknown;
+        }
+    }
+}
+
+// `scoped` flags the sites allocating in a region scope
+void step(const Instruction& insn, int site, const std::vector<bool>& scoped, State& state) {
+    auto reg = [&](int32_t index) -> int32_t& { return state.regs[static_cast<size_t>(index)]; };
+    switch (insn.op) {
+        case Opcode::NewWild:
+        case Opcode::NewScopedWild:
+            // Registers still naming this site hold an older instance
+            for (int32_t& held : state.regs) {
+                if (held == site) {
+                    held = kUntracked;
+                }
+            }
+            state.sites[static_cast<size_t>(site)] = SiteState::Live;
+            state.escaped[static_cast<size_t>(site)] = false;
+            reg(insn.a) = site;
+            return;
+        case Opcode::Move:
+            reg(insn.a) = reg(insn.b);
+            return;
+        case Opcode::Transfer: {
+            int32_t source = reg(insn.b);
+            reg(insn.b) = kTransferred;
+            reg(insn.a) = source;
+            return;
+        }
+        case Opcode::Destroy:
+            if (reg(insn.a) >= 0) {
+                state.sites[static_cast<size_t>(reg(insn.a))] = SiteState::Destroyed;
+            } else {
+                forgetEscaped(state);
+            }
+            return;
+        case Opcode::ExitRegion:
+            // Destroys the objects of the innermost scope, whichever that is
+            for (size_t s = 0; s < state.sites.size(); ++s) {
+                if (scoped[s]) {
+                    state.sites[s] = SiteState::Unknown;
+                }
+            }
+            return;
+        case Opcode::SetProp:
+        case Opcode::SetField:
+            escape(state, insn.c);
+            return;
+        case Opcode::SetGlobal:
+            escape(state, insn.b);
+            return;
+        case Opcode::CompareAndSetGlobal:
+            escape(state, insn.c + 1);
+            reg(insn.a) = kUntracked;
+            return;
+        case Opcode::Call:
+            for (int32_t r = insn.b; r <= insn.b + insn.c; ++r) {
+                escape(state, r);
+            }
+            forgetEscaped(state);
+            // The callee's window clobbers everything above the callee
+            for (size_t r = static_cast<size_t>(insn.b) + 1; r < state.regs.size(); ++r) {
+                state.regs[r] = kUntracked;
+            }
+            reg(insn.a) = kUntracked;
+            return;
+        default: {
+            const OpcodeInfo& info = opcodeInfo(insn.op);
+            const int32_t operands[3] = {insn.a, insn.b, insn.c};
+            for (int i = 0; i < 3; ++i) {
+                if (info.operands[i] == OperandKind::RegWrite) {
+                    reg(operands[i]) = kUntracked;
+                }
+            }
+            return;
+        }
+    }
+}
+
+// Error for a use of the wild operand that is invalid on every path, or
+// nullptr
+const char* definiteError(const Instruction& insn, const State& state) {
+    int32_t operand = insn.op == Opcode::Transfer ? insn.b : insn.a;
+    int32_t held = state.regs[static_cast<size_t>(operand)];
+    if (held == kTransferred) {
+        return "Accessed transferred wild object";
+    }
+    if (held < 0 || state.sites[static_cast<size_t>(held)] != SiteState::Destroyed) {
+        return nullptr;
+    }
+    return insn.op == Opcode::Destroy ? "Wild object already destroyed" : "Reference to destroyed wild object";
+}
+
+} // namespace
+
+int checkOwnership(FunctionProto& proto) {
+    const std::vector<Instruction>& code = proto.code;
+    size_t count = code.size();
+    std::vector<int> sites(count, -1);
+    std::vector<bool> scoped;
+    size_t siteCount = 0;
+    bool transfers = false;
+    for (size_t pc = 0; pc < count; ++pc) {
+        if (code[pc].op == Opcode::NewWild || code[pc].op == Opcode::NewScopedWild) {
+            sites[pc] = static_cast<int>(siteCount++);
+            scoped.push_back(code[pc].op == Opcode::NewScopedWild);
+        }
+        transfers |= code[pc].op == Opcode::Transfer;
+    }
+    if (siteCount == 0 && !transfers) {
+        return 0; // Nothing to prove
+    }
+
+    // In-state of every instruction; parameters and everything else start
+    // untracked
+    std::vector<State> in(count);
+    in[0].reached = true;
+    in[0].regs.assign(static_cast<size_t>(proto.numRegisters), kUntracked);
+    in[0].sites.assign(siteCount, SiteState::Unknown);
+    in[0].escaped.assign(siteCount, false);
+
+    bool changed = true;
+    State out;
+    while (changed) {
+        changed = false;
+        for (size_t pc = 0; pc < count; ++pc) {
+            if (!in[pc].reached) {
+                continue;
+            }
+            const Instruction& insn = code[pc];
+            out = in[pc];
+            step(insn, sites[pc], scoped, out);
+            switch (insn.op) {
+                case Opcode::Jump:
+                    changed |= join(in[static_cast<size_t>(insn.a)], out);
+                    break;
+                case Opcode::JumpIfTrue:
+                case Opcode::JumpIfFalse:
+                    changed |= join(in[static_cast<size_t>(insn.b)], out);
+                    if (pc + 1 < count) {
+                        changed |= join(in[pc + 1], out);
+                    }
+                    break;
+                case Opcode::Return:
+                case Opcode::ReturnUndefined:
+                    break;
+                default:
+                    if (pc + 1 < count) {
+                        changed |= join(in[pc + 1], out);
+                    }
+                    break;
+            }
+        }
+    }
+
+    std::vector<bool> removed(count);
+    int elided = 0;
+    for (size_t pc = 0; pc < count; ++pc) {
+        const Instruction& insn = code[pc];
+        const State& state = in[pc];
+        if (!state.reached) {
+            continue;
+        }
+        switch (insn.op) {
+            case Opcode::WildRetain:
+            case Opcode::WildCheck:
+            case Opcode::Destroy:
+            case Opcode::Transfer:
+                if (const char* error = definiteError(insn, state)) {
+                    throw OwnershipError(std::string(error) + " in function " + proto.name, static_cast<int>(pc));
+                }
+                break;
+            default:
+                break;
+        }
+        if (insn.op == Opcode::WildCheck) {
+            int32_t held = state.regs[static_cast<size_t>(insn.a)];
+            if (held >= 0 && state.sites[static_cast<size_t>(held)] == SiteState::Live) {
+                removed[pc] = true;
+                ++elided;
+            }
+        }
+    }
+    if (elided > 0) {
+        eraseInstructions(proto, removed);
+    }
+    return elided;
+}
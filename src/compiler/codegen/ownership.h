@@ -0,0 +1,36 @@
+#ifndef OWNERSHIP_H
+#define OWNERSHIP_H
+
+#include "runtime/vm/function_proto.h"
+#include <stdexcept>
+#include <string>
+
+// Compile error for a use of a wild object that is invalid on every path
+// reaching it: a definite use-after-destroy, use-after-transfer or double
+// destroy
+class OwnershipError : public std::runtime_error {
+public:
+    OwnershipError(const std::string& message, int instruction)
+        : std::runtime_error(message), instruction(instruction) {}
+
+    int instruction; // Index of the offending instruction
+};
+
+// Flow-sensitive ownership analysis of a function's wild objects (a forward
+// dataflow analysis over the bytecode, iterated to a fixed point).
+//
+// Objects are tracked per allocation site (NewWild, NewScopedWild),
+// through moves and transfers, as live, destroyed or unknown. Only the
+// function itself can destroy an object it allocated until the object
+// escapes (is passed to a call, stored in a property or global, or reaches
+// a register the analysis lost track of); from then on every call may
+// destroy it. Leaving a region scope may destroy any scoped object.
+//
+// WildCheck instructions on objects proven live are deleted. Retains,
+// checks, transfers and destroys proven invalid throw OwnershipError; those
+// the proof does not cover keep their runtime checks.
+//
+// Returns the number of checks deleted.
+int checkOwnership(FunctionProto& proto);
+
+#endif // OWNERSHIP_H
@@ -0,0 +1,86 @@
+#include "compiler/codegen/wild_refcount.h"
+#include <vector>
+
+namespace {
+
+// Instructions a pair may not span
+bool endsWindow(Opcode op) {
+    switch (op) {
+        case Opcode::Jump:
+        case Opcode::JumpIfTrue:
+        case Opcode::JumpIfFalse:
+        case Opcode::Call:
+        case Opcode::Return:
+        case Opcode::ReturnUndefined:
+        case Opcode::Destroy:
+        case Opcode::Transfer: // Replaces its source with the transferred marker
+        case Opcode::ExitRegion:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool writesRegister(const Instruction& insn, int reg) {
+    const OpcodeInfo& info = opcodeInfo(insn.op);
+    const int32_t operands[3] = {insn.a, insn.b, insn.c};
+    for (int i = 0; i < 3; ++i) {
+        if (info.operands[i] == OperandKind::RegWrite && operands[i] == reg) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+int cancelWildRefPairs(FunctionProto& proto) {
+    std::vector<Instruction>& code = proto.code;
+    size_t count = code.size();
+    std::vector<bool> isTarget(count + 1);
+    for (const Instruction& insn : code) {
+        if (insn.op == Opcode::Jump) {
+            isTarget[static_cast<size_t>(insn.a)] = true;
+        } else if (insn.op == Opcode::JumpIfTrue || insn.op == Opcode::JumpIfFalse) {
+            isTarget[static_cast<size_t>(insn.b)] = true;
+        }
+    }
+
+    // Nested pairs on one register cancel innermost first, so repeat until
+    // nothing changes
+    std::vector<bool> removed(count);
+    int cancelled = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < count; ++i) {
+            if (code[i].op != Opcode::WildRetain) {
+                continue;
+            }
+            int reg = code[i].a;
+            for (size_t j = i + 1; j < count && !isTarget[j]; ++j) {
+                const Instruction& insn = code[j];
+                if (removed[j]) {
+                    continue;
+                }
+                if (insn.op == Opcode::WildRelease && insn.a == reg) {
+                    code[i].op = Opcode::WildCheck;
+                    removed[j] = true;
+                    ++cancelled;
+                    changed = true;
+                    break;
+                }
+                if (endsWindow(insn.op) || (insn.op == Opcode::WildRetain && insn.a == reg) || writesRegister(insn, reg)) {
+                    break;
+                }
+            }
+        }
+    }
+    if (cancelled == 0) {
+        return 0;
+    }
+
+    // Removed releases were never jump targets (the windows stop at them)
+    eraseInstructions(proto, removed);
+    return cancelled;
+}
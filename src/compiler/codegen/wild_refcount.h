@@ -0,0 +1,16 @@
+#ifndef WILD_REFCOUNT_H
+#define WILD_REFCOUNT_H
+
+#include "runtime/vm/function_proto.h"
+
+// Cancels WildRetain/WildRelease pairs on the same register within one
+// basic block. A `ref` to a local temporary that is released before
+// anything could destroy the object or observe its count (a call, a
+// destroy, a branch or a jump target) needs no count at all. The retain is
+// turned into a WildCheck, which keeps its "Reference to destroyed wild
+// object" error, and the release is deleted, with jump targets remapped.
+//
+// Returns the number of pairs cancelled.
+int cancelWildRefPairs(FunctionProto& proto);
+
+#endif // WILD_REFCOUNT_H
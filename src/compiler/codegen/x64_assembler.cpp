@@ -0,0 +1,275 @@
+#include "compiler/codegen/x64_assembler.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace x64 {
+
+void Assembler::bind(Label& label) {
+    label.position = static_cast<int>(buffer.size());
+    for (size_t at : label.fixups) {
+        patchRel32(at, label.position);
+    }
+    label.fixups.clear();
+}
+
+// Writes the displacement from the end of the rel32 field at `at` to `target`
+void Assembler::patchRel32(size_t at, int target) {
+    int32_t rel = target - static_cast<int32_t>(at + 4);
+    std::memcpy(&buffer[at], &rel, 4);
+}
+
+size_t Assembler::emit32(int32_t value) {
+    size_t at = buffer.size();
+    buffer.resize(at + 4);
+    std::memcpy(&buffer[at], &value, 4);
+    return at;
+}
+
+void Assembler::patch32(size_t at, int32_t value) {
+    std::memcpy(&buffer[at], &value, 4);
+}
+
+// REX prefix; omitted when no bit is needed unless `force` is set
+void Assembler::rex(bool w, uint8_t reg, uint8_t index, uint8_t base, bool force) {
+    uint8_t value = 0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((index & 8) ? 2 : 0) | ((base & 8) ? 1 : 0);
+    if (value != 0x40 || force) {
+        byte(value);
+    }
+}
+
+void Assembler::modrmReg(uint8_t reg, uint8_t rm) {
+    byte(static_cast<uint8_t>(0xC0 | ((reg & 7) << 3) | (rm & 7)));
+}
+
+// ModRM (+ SIB) + disp32 for a memory operand. Always uses the disp32 form,
+// which also sidesteps the rbp/r13 "no base" special case.
+void Assembler::modrmMem(uint8_t reg, const Mem& mem) {
+    if (mem.hasIndex) {
+        uint8_t scaleBits = mem.scale == 8 ? 3 : mem.scale == 4 ? 2 : mem.scale == 2 ? 1 : 0;
+        byte(static_cast<uint8_t>(0x80 | ((reg & 7) << 3) | 4));
+        byte(static_cast<uint8_t>((scaleBits << 6) | ((mem.index & 7) << 3) | (mem.base & 7)));
+    } else if ((mem.base & 7) == RSP) {
+        // rsp/r12 as base require a SIB byte
+        byte(static_cast<uint8_t>(0x80 | ((reg & 7) << 3) | 4));
+        byte(0x24);
+    } else {
+        byte(static_cast<uint8_t>(0x80 | ((reg & 7) << 3) | (mem.base & 7)));
+    }
+    emit32(mem.disp);
+}
+
+void Assembler::aluRegReg(uint8_t opcode, Reg dst, Reg src) {
+    rex(true, src, 0, dst);
+    byte(opcode);
+    modrmReg(src, dst);
+}
+
+void Assembler::mov(Reg dst, Reg src) { aluRegReg(0x89, dst, src); }
+
+void Assembler::mov(Reg dst, const Mem& src) {
+    rex(true, dst, src.hasIndex ? src.index : 0, src.base);
+    byte(0x8B);
+    modrmMem(dst, src);
+}
+
+void Assembler::mov(const Mem& dst, Reg src) {
+    rex(true, src, dst.hasIndex ? dst.index : 0, dst.base);
+    byte(0x89);
+    modrmMem(src, dst);
+}
+
+void Assembler::mov32(Reg dst, const Mem& src) {
+    rex(false, dst, src.hasIndex ? src.index : 0, src.base);
+    byte(0x8B);
+    modrmMem(dst, src);
+}
+
+void Assembler::mov32(const Mem& dst, int32_t imm) {
+    rex(false, 0, dst.hasIndex ? dst.index : 0, dst.base);
+    byte(0xC7);
+    modrmMem(0, dst);
+    emit32(imm);
+}
+
+void Assembler::mov32(const Mem& dst, Reg src) {
+    rex(false, src, dst.hasIndex ? dst.index : 0, dst.base);
+    byte(0x89);
+    modrmMem(src, dst);
+}
+
+void Assembler::movImm(Reg dst, uint64_t imm) {
+    if (imm <= 0xFFFFFFFFull) {
+        // mov r32, imm32 zero-extends into the full register
+        rex(false, 0, 0, dst);
+        byte(static_cast<uint8_t>(0xB8 | (dst & 7)));
+        emit32(static_cast<int32_t>(static_cast<uint32_t>(imm)));
+        return;
+    }
+    rex(true, 0, 0, dst);
+    byte(static_cast<uint8_t>(0xB8 | (dst & 7)));
+    for (int i = 0; i < 8; ++i) {
+        byte(static_cast<uint8_t>(imm >> (8 * i)));
+    }
+}
+
+void Assembler::movsxd(Reg dst, const Mem& src) {
+    rex(true, dst, src.hasIndex ? src.index : 0, src.base);
+    byte(0x63);
+    modrmMem(dst, src);
+}
+
+void Assembler::lea(Reg dst, const Mem& src) {
+    rex(true, dst, src.hasIndex ? src.index : 0, src.base);
+    byte(0x8D);
+    modrmMem(dst, src);
+}
+
+void Assembler::leaRip(Reg dst, Label& target) {
+    rex(true, dst, 0, 0);
+    byte(0x8D);
+    byte(static_cast<uint8_t>(((dst & 7) << 3) | 5)); // mod=00 rm=101: rip-relative
+    jumpRel32(target);
+}
+
+void Assembler::movzxb(Reg dst, Reg src) {
+    if (src > RBX) {
+        throw std::logic_error("movzxb only supports al..bl sources");
+    }
+    rex(false, dst, 0, src);
+    byte(0x0F);
+    byte(0xB6);
+    modrmReg(dst, src);
+}
+
+void Assembler::add(Reg dst, Reg src) { aluRegReg(0x01, dst, src); }
+void Assembler::sub(Reg dst, Reg src) { aluRegReg(0x29, dst, src); }
+void Assembler::and_(Reg dst, Reg src) { aluRegReg(0x21, dst, src); }
+void Assembler::or_(Reg dst, Reg src) { aluRegReg(0x09, dst, src); }
+void Assembler::cmp(Reg a, Reg b) { aluRegReg(0x39, a, b); }
+
+void Assembler::imul(Reg dst, Reg src) {
+    rex(true, dst, 0, src);
+    byte(0x0F);
+    byte(0xAF);
+    modrmReg(dst, src);
+}
+
+void Assembler::cmp(Reg a, const Mem& b) {
+    rex(true, a, b.hasIndex ? b.index : 0, b.base);
+    byte(0x3B);
+    modrmMem(a, b);
+}
+
+void Assembler::cmpImm(Reg a, int32_t imm) {
+    rex(true, 0, 0, a);
+    byte(0x81);
+    modrmReg(7, a);
+    emit32(imm);
+}
+
+void Assembler::cmp8(const Mem& a, uint8_t imm) {
+    rex(false, 0, a.hasIndex ? a.index : 0, a.base);
+    byte(0x80);
+    modrmMem(7, a);
+    byte(imm);
+}
+
+void Assembler::cmp32(Reg a, int32_t imm) {
+    rex(false, 0, 0, a);
+    byte(0x81);
+    modrmReg(7, a);
+    emit32(imm);
+}
+
+void Assembler::cmpMemImm(const Mem& a, int32_t imm) {
+    rex(true, 0, a.hasIndex ? a.index : 0, a.base);
+    byte(0x81);
+    modrmMem(7, a);
+    emit32(imm);
+}
+
+void Assembler::shl(Reg dst, uint8_t amount) {
+    rex(true, 0, 0, dst);
+    byte(0xC1);
+    modrmReg(4, dst);
+    byte(amount);
+}
+
+void Assembler::sar(Reg dst, uint8_t amount) {
+    rex(true, 0, 0, dst);
+    byte(0xC1);
+    modrmReg(7, dst);
+    byte(amount);
+}
+
+void Assembler::shr(Reg dst, uint8_t amount) {
+    rex(true, 0, 0, dst);
+    byte(0xC1);
+    modrmReg(5, dst);
+    byte(amount);
+}
+
+void Assembler::setcc(Cond cond, Reg dst) {
+    if (dst > RBX) {
+        throw std::logic_error("setcc only supports al..bl destinations");
+    }
+    byte(0x0F);
+    byte(static_cast<uint8_t>(0x90 | cond));
+    modrmReg(0, dst);
+}
+
+void Assembler::lockCmpxchg(const Mem& dst, Reg src) {
+    byte(0xF0); // lock prefix precedes REX
+    rex(true, src, dst.hasIndex ? dst.index : 0, dst.base);
+    byte(0x0F);
+    byte(0xB1);
+    modrmMem(src, dst);
+}
+
+// Emits a rel32 field referring to `target`, recording a fixup if unbound
+void Assembler::jumpRel32(Label& target) {
+    size_t at = buffer.size();
+    emit32(0);
+    if (target.position >= 0) {
+        patchRel32(at, target.position);
+    } else {
+        target.fixups.push_back(at);
+    }
+}
+
+void Assembler::jmp(Label& target) {
+    byte(0xE9);
+    jumpRel32(target);
+}
+
+void Assembler::jcc(Cond cond, Label& target) {
+    byte(0x0F);
+    byte(static_cast<uint8_t>(0x80 | cond));
+    jumpRel32(target);
+}
+
+void Assembler::jmp(Reg target) {
+    rex(false, 0, 0, target);
+    byte(0xFF);
+    modrmReg(4, target);
+}
+
+void Assembler::call(Reg target) {
+    rex(false, 0, 0, target);
+    byte(0xFF);
+    modrmReg(2, target);
+}
+
+void Assembler::ret() { byte(0xC3); }
+
+void Assembler::push(Reg r) {
+    rex(false, 0, 0, r);
+    byte(static_cast<uint8_t>(0x50 | (r & 7)));
+}
+
+void Assembler::pop(Reg r) {
+    rex(false, 0, 0, r);
+    byte(static_cast<uint8_t>(0x58 | (r & 7)));
+}
+
+} // namespace x64
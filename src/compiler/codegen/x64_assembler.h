@@ -0,0 +1,115 @@
+#ifndef X64_ASSEMBLER_H
+#define X64_ASSEMBLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Minimal x86-64 machine code emitter for the baseline JIT.
+// Only the instruction forms the JIT needs are provided. Memory operands are
+// always [base + disp32] or [base + index*scale + disp32]; the assembler
+// picks the encoding (SIB byte for rsp/r12 bases, disp32 for rbp/r13).
+namespace x64 {
+
+enum Reg : uint8_t {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+// Condition codes as encoded in Jcc/SETcc
+enum Cond : uint8_t {
+    Overflow = 0x0, NoOverflow = 0x1,
+    Below = 0x2, AboveOrEqual = 0x3,
+    Equal = 0x4, NotEqual = 0x5,
+    BelowOrEqual = 0x6, Above = 0x7,
+    Less = 0xC, GreaterOrEqual = 0xD,
+    LessOrEqual = 0xE, Greater = 0xF
+};
+
+// Memory operand
+struct Mem {
+    Reg base;
+    int32_t disp;
+    bool hasIndex;
+    Reg index;
+    uint8_t scale; // 1, 2, 4 or 8
+
+    Mem(Reg b, int32_t d = 0) : base(b), disp(d), hasIndex(false), index(RAX), scale(1) {}
+    Mem(Reg b, Reg i, uint8_t s, int32_t d = 0) : base(b), disp(d), hasIndex(true), index(i), scale(s) {}
+};
+
+class Assembler {
+public:
+    // A jump target. Jumps to unbound labels are patched when it is bound.
+    struct Label {
+        int position = -1;
+        std::vector<size_t> fixups; // Offsets of rel32 fields to patch
+    };
+
+    const std::vector<uint8_t>& code() const { return buffer; }
+    size_t size() const { return buffer.size(); }
+
+    void bind(Label& label);
+
+    // Moves
+    void mov(Reg dst, Reg src);                // mov r64, r64
+    void mov(Reg dst, const Mem& src);         // mov r64, [m]
+    void mov(const Mem& dst, Reg src);         // mov [m], r64
+    void mov32(Reg dst, const Mem& src);       // mov r32, [m] (zero-extends)
+    void mov32(const Mem& dst, int32_t imm);   // mov dword [m], imm32
+    void mov32(const Mem& dst, Reg src);       // mov dword [m], r32
+    void movImm(Reg dst, uint64_t imm);        // mov r64, imm64 (shortest form)
+    void movsxd(Reg dst, const Mem& src);      // movsxd r64, dword [m]
+    void lea(Reg dst, const Mem& src);         // lea r64, [m]
+    void leaRip(Reg dst, Label& target);       // lea r64, [rip + target]
+    void movzxb(Reg dst, Reg src);             // movzx r32, r8
+
+    // Arithmetic and logic (64-bit)
+    void add(Reg dst, Reg src);
+    void sub(Reg dst, Reg src);
+    void imul(Reg dst, Reg src);
+    void and_(Reg dst, Reg src);
+    void or_(Reg dst, Reg src);
+    void cmp(Reg a, Reg b);
+    void cmp(Reg a, const Mem& b);
+    void cmpImm(Reg a, int32_t imm);
+    void cmp8(const Mem& a, uint8_t imm);     // cmp byte [m], imm8
+    void cmp32(Reg a, int32_t imm);            // cmp r32, imm32
+    void cmpMemImm(const Mem& a, int32_t imm); // cmp qword [m], imm32
+    void shl(Reg dst, uint8_t amount);
+    void sar(Reg dst, uint8_t amount);
+    void shr(Reg dst, uint8_t amount);
+    void setcc(Cond cond, Reg dst);            // dst must be rax..rbx
+
+    // Atomics
+    void lockCmpxchg(const Mem& dst, Reg src); // lock cmpxchg [m], r64: [m] = src if [m] == rax, else rax = [m]
+
+    // Control flow
+    void jmp(Label& target);
+    void jcc(Cond cond, Label& target);
+    void jmp(Reg target);
+    void call(Reg target);
+    void ret();
+    void push(Reg r);
+    void pop(Reg r);
+
+    // Raw data (jump tables). emit32 returns the offset of the value so it
+    // can be patched later with patch32.
+    size_t emit32(int32_t value);
+    void patch32(size_t at, int32_t value);
+
+private:
+    std::vector<uint8_t> buffer;
+
+    void byte(uint8_t b) { buffer.push_back(b); }
+    void rex(bool w, uint8_t reg, uint8_t index, uint8_t base, bool force = false);
+    void modrmReg(uint8_t reg, uint8_t rm);
+    void modrmMem(uint8_t reg, const Mem& mem);
+    void aluRegReg(uint8_t opcode, Reg dst, Reg src);
+    void jumpRel32(Label& target);
+    void patchRel32(size_t at, int target);
+};
+
+} // namespace x64
+
+#endif // X64_ASSEMBLER_H
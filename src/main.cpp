@@ -1,13 +1,48 @@
+#include "runtime/vm/heap_object.h"
+#include "runtime/vm/snapshot.h"
+#include "runtime/vm/vm.h"
 #include <iostream>
 #include <vector>
 #include <string>
 
+namespace {
+
+void printUsage() {
+    std::cerr << "Usage: superecma <script_file | image_file>" << std::endl;
+}
+
+// Starts from a heap image: the initialization already ran when it was
+// written, so only the global `main`, if any, and the jobs it queues run
+int runImage(const std::string& imageFile) {
+    try {
+        std::unique_ptr<VM> vm = Snapshot::load(imageFile);
+        int slot = vm->lookupGlobal("main");
+        if (slot >= 0 && isFunction(vm->getGlobal(slot))) {
+            vm->call(vm->getGlobal(slot), {});
+        }
+        while (vm->hasPendingJobs()) {
+            vm->waitForLocks();
+            vm->runPendingJobs();
+        }
+    } catch (const std::exception& error) {
+        std::cerr << imageFile << ": " << error.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace
+
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cerr << "Usage: superecma <script_file>" << std::endl;
+        printUsage();
         return 1;
     }
 
+    if (Snapshot::isImage(argv[1])) {
+        return runImage(argv[1]);
+    }
+
     std::string scriptFile = argv[1];
     std::cout << "Executing SuperECMA script: " << scriptFile << std::endl;
 
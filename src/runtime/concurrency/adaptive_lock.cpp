@@ -0,0 +1,233 @@
+#include "runtime/concurrency/adaptive_lock.h"
+#include "runtime/concurrency/futex.h"
+#include <chrono>
+#include <cstddef>
+
+namespace {
+
+// The parking lot: waiters of every lock, in FIFO lists hashed by the
+// lock's address. Buckets only see traffic from contended locks.
+struct alignas(64) Bucket {
+    std::mutex lock;
+    LockWaiter* head = nullptr;
+    LockWaiter* tail = nullptr;
+};
+
+constexpr size_t kBucketBits = 8;
+
+Bucket& bucketFor(const void* address) {
+    static Bucket buckets[size_t(1) << kBucketBits];
+    uint64_t hash = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(address)) * 0x9E3779B97F4A7C15ull;
+    return buckets[hash >> (64 - kBucketBits)];
+}
+
+// Removes `waiter` from its bucket; `previous` is the waiter before it
+void unlink(Bucket& bucket, LockWaiter* previous, LockWaiter* waiter) {
+    (previous ? previous->nextWaiter : bucket.head) = waiter->nextWaiter;
+    if (bucket.tail == waiter) {
+        bucket.tail = previous;
+    }
+}
+
+bool hasWaiters(const LockWaiter* from, const void* address) {
+    for (; from; from = from->nextWaiter) {
+        if (from->address == address) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Collects contention of locks taken without a site
+LockSite& unattributedSite() {
+    static LockSite site;
+    return site;
+}
+
+uint64_t nowNs() {
+    auto elapsed = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// lock(): the calling thread itself waits, on a futex
+struct ThreadWaiter : LockWaiter {
+    std::atomic<uint32_t> released{0};
+
+    ThreadWaiter() : LockWaiter(&wake) {}
+
+    static void wake(Task* task) {
+        auto* self = static_cast<ThreadWaiter*>(static_cast<LockWaiter*>(task));
+        self->released.store(1, std::memory_order_release);
+        futexWake(self->released, 1);
+    }
+
+    void wait() {
+        while (released.load(std::memory_order_acquire) == 0) {
+            futexWait(released, 0);
+        }
+        released.store(0, std::memory_order_relaxed);
+    }
+};
+
+} // namespace
+
+LockStats LockSite::getStats() const {
+    LockStats stats;
+    stats.contended = contended.load(std::memory_order_relaxed);
+    stats.spinAcquired = spinAcquired.load(std::memory_order_relaxed);
+    stats.parks = parks.load(std::memory_order_relaxed);
+    stats.handoffs = handoffs.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void AdaptiveLock::lockSlow(LockSite* site) {
+    ThreadWaiter waiter;
+    while (!acquireSlow(&waiter, site)) {
+        waiter.wait();
+        if (waiter.acquired) {
+            return;
+        }
+    }
+}
+
+bool AdaptiveLock::acquireSlow(LockWaiter* waiter, LockSite* given) {
+    LockSite& site = given ? *given : unattributedSite();
+    if (waiter->parkedAt == 0) {
+        site.contended.fetch_add(1, std::memory_order_relaxed); // Not again when retrying after a wake
+    }
+
+    // Spin while the holder runs. Once waiters are parked, spinning would
+    // only let this one overtake them.
+    uint32_t budget = site.spinBudget();
+    int64_t estimate = site.spinEstimate.load(std::memory_order_relaxed);
+    for (uint32_t spins = 0; spins < budget; ++spins) {
+        uint32_t state = word.load(std::memory_order_relaxed);
+        if (!(state & kLocked)) {
+            if (word.compare_exchange_weak(state, state | kLocked, std::memory_order_acquire,
+                                           std::memory_order_relaxed)) {
+                estimate += (static_cast<int64_t>(spins) - estimate) / 8;
+                site.spinEstimate.store(static_cast<uint32_t>(estimate), std::memory_order_relaxed);
+                site.spinAcquired.fetch_add(1, std::memory_order_relaxed);
+                waiter->parkedAt = 0;
+                return true;
+            }
+            continue;
+        }
+        if (state & kQueued) {
+            break;
+        }
+        cpuRelax();
+    }
+    // Spinning did not pay off this time
+    site.spinEstimate.store(static_cast<uint32_t>(estimate - estimate / 8), std::memory_order_relaxed);
+    return park(waiter, site);
+}
+
+bool AdaptiveLock::park(LockWaiter* waiter, LockSite& site) {
+    Bucket& bucket = bucketFor(this);
+    std::lock_guard<std::mutex> guard(bucket.lock);
+    // kQueued is only set and cleared under the bucket lock, so once it is
+    // set here, the release that sees it will find this waiter
+    uint32_t state = word.load(std::memory_order_relaxed);
+    for (;;) {
+        if (!(state & kLocked)) {
+            if (word.compare_exchange_weak(state, state | kLocked, std::memory_order_acquire,
+                                           std::memory_order_relaxed)) {
+                waiter->parkedAt = 0;
+                return true;
+            }
+        } else if ((state & kQueued) || word.compare_exchange_weak(state, state | kQueued, std::memory_order_relaxed,
+                                                                   std::memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    waiter->address = this;
+    waiter->site = &site;
+    waiter->acquired = false;
+    if (waiter->parkedAt == 0) {
+        waiter->parkedAt = nowNs();
+        waiter->nextWaiter = nullptr;
+        if (bucket.tail) {
+            bucket.tail->nextWaiter = waiter;
+        } else {
+            bucket.head = waiter;
+        }
+        bucket.tail = waiter;
+    } else {
+        // Woken as the oldest waiter and overtaken: keeps its place, and
+        // the time it has waited counts towards a handoff
+        waiter->nextWaiter = bucket.head;
+        bucket.head = waiter;
+        if (!bucket.tail) {
+            bucket.tail = waiter;
+        }
+    }
+    site.parks.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void AdaptiveLock::unlockSlow() {
+    Bucket& bucket = bucketFor(this);
+    LockWaiter* waiter;
+    bool handoff;
+    {
+        std::lock_guard<std::mutex> guard(bucket.lock);
+        LockWaiter* previous = nullptr;
+        waiter = bucket.head;
+        while (waiter && waiter->address != this) {
+            previous = waiter;
+            waiter = waiter->nextWaiter;
+        }
+        if (!waiter) {
+            word.store(0, std::memory_order_release);
+            return;
+        }
+        unlink(bucket, previous, waiter);
+        bool more = hasWaiters(waiter->nextWaiter, this);
+        handoff = nowNs() - waiter->parkedAt >= kFairnessWindow;
+        word.store((more ? kQueued : 0) | (handoff ? kLocked : 0), std::memory_order_release);
+    }
+
+    waiter->acquired = handoff;
+    if (handoff) {
+        waiter->site->handoffs.fetch_add(1, std::memory_order_relaxed);
+        waiter->parkedAt = 0;
+    }
+    // The waiter may be gone as soon as it runs
+    if (Scheduler* scheduler = waiter->scheduler) {
+        scheduler->spawn(waiter);
+    } else {
+        waiter->invoke(waiter);
+    }
+}
+
+bool AdaptiveLock::cancel(LockWaiter* waiter) {
+    Bucket& bucket = bucketFor(this);
+    std::lock_guard<std::mutex> guard(bucket.lock);
+    LockWaiter* previous = nullptr;
+    LockWaiter* current = bucket.head;
+    bool more = false;
+    while (current && current != waiter) {
+        more = more || current->address == this;
+        previous = current;
+        current = current->nextWaiter;
+    }
+    if (!current) {
+        return false;
+    }
+    unlink(bucket, previous, waiter);
+    if (!more && !hasWaiters(waiter->nextWaiter, this)) {
+        word.fetch_and(~kQueued, std::memory_order_relaxed);
+    }
+    waiter->parkedAt = 0;
+    return true;
+}
@@ -0,0 +1,163 @@
+#ifndef ADAPTIVE_LOCK_H
+#define ADAPTIVE_LOCK_H
+
+#include "runtime/concurrency/scheduler.h"
+#include "runtime/vm/config.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+// Contention counters of a LockSite
+struct LockStats {
+    uint64_t contended = 0; // Acquisitions that found the lock held
+    uint64_t spinAcquired = 0; // Of those, acquired while spinning
+    uint64_t parks = 0;     // Times a waiter was parked
+    uint64_t handoffs = 0;  // Releases that passed the lock straight to a waiter
+};
+
+// A place that takes AdaptiveLocks: one `Run.lock` in the source, say.
+// Only contended acquisitions touch their site, so its counters cost the
+// uncontended path nothing. A site also learns how long to spin: its
+// estimate follows the spins that acquisitions needed and decays whenever
+// spinning did not pay off, so a site whose lock is held for long soon
+// parks right away.
+struct LockSite {
+    static constexpr uint32_t kMinSpins = 16;
+    static constexpr uint32_t kMaxSpins = 1024;
+
+    std::atomic<uint64_t> contended{0};
+    std::atomic<uint64_t> spinAcquired{0};
+    std::atomic<uint64_t> parks{0};
+    std::atomic<uint64_t> handoffs{0};
+    std::atomic<uint32_t> spinEstimate{kMinSpins};
+
+    // Spins to try before parking
+    uint32_t spinBudget() const {
+        uint32_t budget = 2 * spinEstimate.load(std::memory_order_relaxed) + kMinSpins;
+        return budget < kMaxSpins ? budget : kMaxSpins;
+    }
+
+    LockStats getStats() const;
+};
+
+// A task waiting for an AdaptiveLock. Callers embed it in (or derive from)
+// the state of the suspended task, like IoOp. Once the lock is released to
+// the waiter its Task is spawned on `scheduler`, or invoked by the
+// releasing thread when that is null, and `acquired` tells whether it now
+// holds the lock or has to call lockAsync() again.
+struct LockWaiter : Task {
+    Scheduler* scheduler = nullptr;
+    bool acquired = false;
+
+    // Parking lot state
+    const void* address = nullptr;
+    LockSite* site = nullptr;
+    uint64_t parkedAt = 0;           // When the waiter first parked (ns), 0 while not waiting
+    LockWaiter* nextWaiter = nullptr;
+
+    explicit LockWaiter(void (*fn)(Task*)) : Task(fn) {}
+};
+
+// One-word lock for `Run.lock`, small enough to live in an object header.
+//
+// Acquiring a free lock is a single CAS, and so is releasing one nobody
+// waits for. A contended acquisition spins for its site's adaptive budget
+// while the holder is running and nobody is queued yet, then parks. Parked
+// waiters live in a global parking lot hashed by lock address, so a lock
+// needs no storage beyond its word: kQueued only says the lot has waiters
+// for it.
+//
+// Parking suspends the task, not its thread: lockAsync() queues a
+// LockWaiter and returns, leaving the worker free, and the release resumes
+// the waiter's task. lock() parks the calling thread on a futex instead,
+// for callers outside any scheduler.
+//
+// A release normally wakes the oldest waiter to compete for the lock
+// again, which keeps the lock busy when new arrivals barge in. Fairness
+// bounds the barging: once a waiter has been parked for kFairnessWindow,
+// the release hands the lock over to it directly, still locked.
+class AdaptiveLock {
+public:
+    static constexpr uint32_t kLocked = 1;
+    static constexpr uint32_t kQueued = 2; // The parking lot has waiters for this lock
+    static constexpr uint64_t kFairnessWindow = 1000000; // ns
+
+    AdaptiveLock() = default;
+    AdaptiveLock(const AdaptiveLock&) = delete;
+    AdaptiveLock& operator=(const AdaptiveLock&) = delete;
+
+    bool tryLock() {
+        uint32_t expected = 0;
+        return word.compare_exchange_strong(expected, kLocked, std::memory_order_acquire,
+                                            std::memory_order_relaxed);
+    }
+
+    // Blocks the calling thread until the lock is held
+    void lock(LockSite* site = nullptr) {
+        if (SE_UNLIKELY(!tryLock())) {
+            lockSlow(site);
+        }
+    }
+
+    // Acquires the lock for a task. True when it is now held; otherwise
+    // `waiter` was parked and will be resumed when the lock is released.
+    bool lockAsync(LockWaiter* waiter, LockSite* site = nullptr) {
+        if (SE_LIKELY(tryLock())) {
+            waiter->parkedAt = 0; // Ends a wait that was woken without the lock
+            return true;
+        }
+        return acquireSlow(waiter, site);
+    }
+
+    void unlock() {
+        uint32_t expected = kLocked;
+        if (SE_UNLIKELY(!word.compare_exchange_strong(expected, 0, std::memory_order_release,
+                                                      std::memory_order_relaxed))) {
+            unlockSlow();
+        }
+    }
+
+    // Takes a waiter parked by lockAsync() out of the parking lot. False
+    // when it is not parked: a release has resumed it or is about to.
+    bool cancel(LockWaiter* waiter);
+
+    bool isLocked() const { return (word.load(std::memory_order_relaxed) & kLocked) != 0; }
+
+private:
+    std::atomic<uint32_t> word{0};
+
+    SE_NOINLINE void lockSlow(LockSite* site);
+    // Spins, then parks `waiter`; true when the lock was acquired instead
+    SE_NOINLINE bool acquireSlow(LockWaiter* waiter, LockSite* site);
+    bool park(LockWaiter* waiter, LockSite& site);
+    SE_NOINLINE void unlockSlow();
+};
+
+// Holds an AdaptiveLock until the end of a scope: the release at `using`
+// block exit. Adopts a lock already acquired through lockAsync().
+class LockGuard {
+public:
+    explicit LockGuard(AdaptiveLock& lock, LockSite* site = nullptr) : held(&lock) { lock.lock(site); }
+    LockGuard(AdaptiveLock& lock, std::adopt_lock_t) : held(&lock) {}
+    ~LockGuard() {
+        if (held) {
+            held->unlock();
+        }
+    }
+
+    LockGuard(const LockGuard&) = delete;
+    LockGuard& operator=(const LockGuard&) = delete;
+
+    // Releases early
+    void unlock() {
+        held->unlock();
+        held = nullptr;
+    }
+
+private:
+    AdaptiveLock* held;
+};
+
+static_assert(sizeof(AdaptiveLock) == sizeof(uint32_t), "AdaptiveLock must stay one word");
+
+#endif // ADAPTIVE_LOCK_H
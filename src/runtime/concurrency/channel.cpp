@@ -0,0 +1,211 @@
+#include "runtime/concurrency/channel.h"
+#include "runtime/concurrency/futex.h"
+#include <cstdint>
+
+namespace {
+
+// ChannelWaiter::state
+constexpr uint32_t kParked = 0;
+constexpr uint32_t kWoken = 1;
+// park() is still registering nodes: a waker must not resume the waiter
+// yet, it only marks the wake so park() tries again instead
+constexpr uint32_t kRegistering = 2;
+constexpr uint32_t kWokenRegistering = 3;
+
+} // namespace
+
+void BlockingWaiter::wait() {
+    while (released.load(std::memory_order_acquire) == 0) {
+        futexWait(released, 0);
+    }
+    released.store(0, std::memory_order_relaxed);
+}
+
+void BlockingWaiter::wake(Task* task) {
+    auto* self = static_cast<BlockingWaiter*>(static_cast<ChannelWaiter*>(task));
+    self->released.store(1, std::memory_order_release);
+    futexWake(self->released, 1);
+}
+
+bool ChannelBase::close() {
+    if (sendPos.fetch_or(kClosed, std::memory_order_acq_rel) & kClosed) {
+        return false;
+    }
+    // Waiters registering from now on see the flag when they look again
+    wake(true, SIZE_MAX);
+    wake(false, SIZE_MAX);
+    return true;
+}
+
+void ChannelBase::link(WaitNode* node) {
+    List& list = node->sending ? senders : receivers;
+    node->prev = list.tail;
+    node->next = nullptr;
+    (list.tail ? list.tail->next : list.head) = node;
+    list.tail = node;
+    node->linked = true;
+    (node->sending ? senderCount : receiverCount).fetch_add(1, std::memory_order_seq_cst);
+}
+
+void ChannelBase::unlink(WaitNode* node) {
+    List& list = node->sending ? senders : receivers;
+    (node->prev ? node->prev->next : list.head) = node->next;
+    (node->next ? node->next->prev : list.tail) = node->prev;
+    node->prev = nullptr;
+    node->next = nullptr;
+    node->linked = false;
+    (node->sending ? senderCount : receiverCount).fetch_sub(1, std::memory_order_relaxed);
+}
+
+void ChannelBase::wake(bool sending, size_t count) {
+    ChannelWaiter* first = nullptr;
+    ChannelWaiter* last = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(waitLock);
+        List& list = sending ? senders : receivers;
+        while (count > 0 && list.head) {
+            WaitNode* node = list.head;
+            unlink(node);
+            // A Select is registered with several channels; only the first
+            // wake counts, the others move on to the next waiter
+            ChannelWaiter* waiter = node->waiter;
+            uint32_t expected = kParked;
+            if (waiter->state.compare_exchange_strong(expected, kWoken, std::memory_order_acq_rel)) {
+                waiter->nextWoken = nullptr;
+                (last ? last->nextWoken : first) = waiter;
+                last = waiter;
+                --count;
+            } else if (expected == kRegistering &&
+                       waiter->state.compare_exchange_strong(expected, kWokenRegistering,
+                                                             std::memory_order_acq_rel)) {
+                --count;
+            }
+        }
+    }
+
+    while (first) {
+        ChannelWaiter* waiter = first;
+        first = waiter->nextWoken; // The waiter may be gone as soon as it runs
+        if (Scheduler* scheduler = waiter->scheduler) {
+            scheduler->spawn(waiter);
+        } else {
+            waiter->invoke(waiter);
+        }
+    }
+}
+
+ChannelStatus ChannelBase::park(ChannelWaiter* waiter, WaitNode* nodes, size_t count) {
+    waiter->state.store(kRegistering, std::memory_order_relaxed);
+    for (size_t i = 0; i < count; ++i) {
+        WaitNode& node = nodes[i];
+        ChannelBase& channel = *node.channel;
+        node.waiter = waiter;
+        {
+            std::lock_guard<std::mutex> guard(channel.waitLock);
+            channel.link(&node);
+        }
+        // Pairs with the fence in notifySenders/notifyReceivers
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (node.sending ? channel.canSend() : channel.canReceive()) {
+            unpark(nodes, i + 1);
+            return ChannelStatus::WouldBlock;
+        }
+    }
+    uint32_t expected = kRegistering;
+    if (waiter->state.compare_exchange_strong(expected, kParked, std::memory_order_acq_rel)) {
+        return ChannelStatus::Parked;
+    }
+    // Woken while registering
+    unpark(nodes, count);
+    return ChannelStatus::WouldBlock;
+}
+
+void ChannelBase::unpark(WaitNode* nodes, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        WaitNode& node = nodes[i];
+        std::lock_guard<std::mutex> guard(node.channel->waitLock);
+        if (node.linked) {
+            node.channel->unlink(&node);
+        }
+    }
+}
+
+int Select::addCase(ChannelBase* channel, void* items, size_t count, bool sending, Attempt attempt) {
+    cases.push_back(Case{items, count, attempt});
+    WaitNode node;
+    node.channel = channel;
+    node.sending = sending;
+    nodes.push_back(node);
+    return static_cast<int>(cases.size() - 1);
+}
+
+Select::Result Select::trySelect() {
+    Result result;
+    size_t count = cases.size();
+    for (size_t k = 0; k < count; ++k) {
+        size_t i = (start + k) % count;
+        size_t done = 0;
+        ChannelStatus status = cases[i].attempt(nodes[i].channel, cases[i].items, cases[i].count, done);
+        if (status != ChannelStatus::WouldBlock) {
+            start = i + 1;
+            result.index = static_cast<int>(i);
+            result.status = status;
+            result.count = done;
+            return result;
+        }
+    }
+    return result;
+}
+
+Select::Result Select::selectOrPark(ChannelWaiter* waiter) {
+    bool woken = parked;
+    if (parked) {
+        ChannelBase::unpark(nodes.data(), nodes.size());
+        parked = false;
+    }
+    if (cases.empty()) {
+        return Result{};
+    }
+    for (;;) {
+        Result result = trySelect();
+        if (result.index >= 0) {
+            if (woken) {
+                forwardWakes(static_cast<size_t>(result.index));
+            }
+            return result;
+        }
+        // Set first: once parked, the waiter may run this again at any time
+        parked = true;
+        if (ChannelBase::park(waiter, nodes.data(), nodes.size()) == ChannelStatus::Parked) {
+            result.status = ChannelStatus::Parked;
+            return result;
+        }
+        parked = false;
+        woken = true; // Whichever case that wake was for
+    }
+}
+
+Select::Result Select::select() {
+    BlockingWaiter waiter;
+    Result result;
+    while ((result = selectOrPark(&waiter)).status == ChannelStatus::Parked) {
+        waiter.wait();
+    }
+    return result;
+}
+
+void Select::forwardWakes(size_t performed) {
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        ChannelBase* channel = nodes[i].channel;
+        if (i == performed) {
+            continue;
+        }
+        if (nodes[i].sending ? channel->canSend() : channel->canReceive()) {
+            if (nodes[i].sending) {
+                channel->notifySenders(1);
+            } else {
+                channel->notifyReceivers(1);
+            }
+        }
+    }
+}
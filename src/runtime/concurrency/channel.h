@@ -0,0 +1,409 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include "runtime/concurrency/scheduler.h"
+#include "runtime/vm/config.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Outcome of a channel operation
+enum class ChannelStatus : uint8_t {
+    Ok,         // Transferred at least one item
+    WouldBlock, // try*: the channel is full (send) or empty (receive)
+    Parked,     // *OrPark: the waiter was parked and will be resumed to try again
+    Closed      // Send: the channel is closed. Receive: closed and drained.
+};
+
+class ChannelBase;
+struct ChannelWaiter;
+
+// Entry of a waiter in one channel's list of blocked senders or receivers
+struct WaitNode {
+    ChannelWaiter* waiter = nullptr;
+    ChannelBase* channel = nullptr;
+    bool sending = false;
+    bool linked = false; // Guarded by the channel's wait lock
+    WaitNode* prev = nullptr;
+    WaitNode* next = nullptr;
+};
+
+// A task blocked on a channel, or on several through a Select. Callers
+// embed it in (or derive from) the state of the suspended task, as with
+// IoOp. Once an operation it waits for may proceed, the waiter's Task is
+// spawned on `scheduler` (or invoked by the waking thread when that is
+// null) and retries. After an operation returns Parked, the caller must
+// leave the waiter alone: it may already be running again.
+struct ChannelWaiter : Task {
+    Scheduler* scheduler = nullptr;
+    std::atomic<uint32_t> state{0}; // Parking state; the first waker wins
+    ChannelWaiter* nextWoken = nullptr;
+    WaitNode node; // For single-channel operations
+
+    explicit ChannelWaiter(void (*fn)(Task*)) : Task(fn) { node.waiter = this; }
+};
+
+// The calling thread itself waits, on a futex: the blocking operations
+class BlockingWaiter : public ChannelWaiter {
+public:
+    BlockingWaiter() : ChannelWaiter(&wake) {}
+    // Until resumed
+    void wait();
+
+private:
+    std::atomic<uint32_t> released{0};
+    static void wake(Task* task);
+};
+
+// Untyped half of a Channel: positions, close and the parked waiters.
+//
+// Waiting never slows down the transfers themselves. A blocked task
+// registers in the channel's list under the wait lock, and counts itself
+// in senderCount or receiverCount, then looks at the ring once more before
+// it parks. After a transfer the other side checks that count, past a
+// fence, and only then takes the lock to wake waiters. One of the two
+// always sees the other, so no wakeup is lost, and while nobody waits a
+// transfer costs the fence and a load.
+//
+// Woken waiters retry rather than being handed an item, so a transfer may
+// race past a woken waiter, which then parks again. A Select woken by one
+// channel that ends up performing another case passes the wake on.
+class ChannelBase {
+public:
+    ChannelBase(const ChannelBase&) = delete;
+    ChannelBase& operator=(const ChannelBase&) = delete;
+
+    size_t capacity() const { return slots; }
+
+    // Items buffered right now; approximate while transfers run
+    size_t size() const {
+        uint64_t sent = sendPos.load(std::memory_order_acquire) & ~kClosed;
+        uint64_t received = receivePos.load(std::memory_order_acquire);
+        return sent > received ? static_cast<size_t>(sent - received) : 0;
+    }
+
+    // Stops further sends and wakes every waiter. Receivers still get the
+    // items already sent. False when it was closed already.
+    bool close();
+    bool isClosed() const { return (sendPos.load(std::memory_order_acquire) & kClosed) != 0; }
+
+    // Registers `count` nodes (one Select case each) with their channels
+    // and parks their waiter, unless one of the operations became possible
+    // meanwhile: then returns WouldBlock for the caller to try again
+    static ChannelStatus park(ChannelWaiter* waiter, WaitNode* nodes, size_t count);
+    // Takes nodes out of the channels they are still registered with
+    static void unpark(WaitNode* nodes, size_t count);
+
+protected:
+    // Set in sendPos by close(), so a send can never claim a slot afterwards
+    static constexpr uint64_t kClosed = uint64_t(1) << 63;
+
+    explicit ChannelBase(size_t capacity) : slots(capacity < 1 ? 1 : capacity) {}
+    virtual ~ChannelBase() = default;
+
+    // Whether a send or receive would not block (closed counts as ready)
+    virtual bool canSend() const = 0;
+    virtual bool canReceive() const = 0;
+
+    void notifySenders(size_t count) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (SE_UNLIKELY(senderCount.load(std::memory_order_relaxed) != 0)) {
+            wake(true, count);
+        }
+    }
+    void notifyReceivers(size_t count) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (SE_UNLIKELY(receiverCount.load(std::memory_order_relaxed) != 0)) {
+            wake(false, count);
+        }
+    }
+
+    const size_t slots;
+    alignas(64) std::atomic<uint64_t> sendPos{0};
+    alignas(64) std::atomic<uint64_t> receivePos{0};
+
+private:
+    struct List {
+        WaitNode* head = nullptr;
+        WaitNode* tail = nullptr;
+    };
+
+    alignas(64) std::atomic<uint32_t> senderCount{0};
+    std::atomic<uint32_t> receiverCount{0};
+    std::mutex waitLock;
+    List senders;
+    List receivers;
+
+    friend class Select;
+
+    // Resumes up to `count` waiters of one side
+    SE_NOINLINE void wake(bool sending, size_t count);
+    void link(WaitNode* node);
+    void unlink(WaitNode* node);
+};
+
+// Bounded multi-producer, multi-consumer channel between `run` tasks:
+// what `Run.channel(capacity)` creates.
+//
+// The buffer is a ring of `capacity` cells, each with a sequence number
+// telling which position it is ready for, and whether to be filled or
+// emptied there (Vyukov's bounded queue, with the two states kept apart
+// so a single cell works too).
+// A sender claims the next position with a CAS on sendPos, once the cell
+// there is free for that lap, moves its item in and publishes it by
+// bumping the sequence; receivers mirror this on receivePos. No lock is
+// taken and senders and receivers touch different counters. Batches claim
+// a run of consecutive cells with one CAS, and wake waiters once.
+//
+// Operations come in three flavors: try* never waits, *OrPark parks a
+// ChannelWaiter task when the channel is full or empty (the worker thread
+// moves on), and the plain ones block the calling thread.
+template <typename T>
+class Channel : public ChannelBase {
+public:
+    explicit Channel(size_t capacity) : ChannelBase(capacity), cells(new Cell[slots]) {
+        for (size_t i = 0; i < slots; ++i) {
+            cells[i].sequence.store(emptyAt(i), std::memory_order_relaxed);
+        }
+    }
+
+    // Sends up to `count` items from `items`, moving them out; `sent` tells
+    // how many (all or a prefix). Ok when at least one was sent.
+    ChannelStatus trySendBatch(T* items, size_t count, size_t& sent) {
+        sent = 0;
+        if (count == 0) {
+            return ChannelStatus::Ok;
+        }
+        uint64_t pos = sendPos.load(std::memory_order_relaxed);
+        for (;;) {
+            if (pos & kClosed) {
+                return ChannelStatus::Closed;
+            }
+            size_t free = 0;
+            while (free < count && cellAt(pos + free).sequence.load(std::memory_order_acquire) == emptyAt(pos + free)) {
+                ++free;
+            }
+            if (free == 0) {
+                // The cell still holds an item from the previous lap: full
+                if (cellAt(pos).sequence.load(std::memory_order_acquire) < emptyAt(pos)) {
+                    return ChannelStatus::WouldBlock;
+                }
+                pos = sendPos.load(std::memory_order_relaxed); // Another sender got it
+                continue;
+            }
+            // Cells free for this lap can only be taken by claiming them
+            if (sendPos.compare_exchange_weak(pos, pos + free, std::memory_order_relaxed)) {
+                for (size_t i = 0; i < free; ++i) {
+                    Cell& cell = cellAt(pos + i);
+                    cell.value = std::move(items[i]);
+                    cell.sequence.store(filledAt(pos + i), std::memory_order_release);
+                }
+                sent = free;
+                notifyReceivers(free);
+                return ChannelStatus::Ok;
+            }
+        }
+    }
+
+    // Receives up to `max` items into `out`; `received` tells how many
+    ChannelStatus tryReceiveBatch(T* out, size_t max, size_t& received) {
+        received = 0;
+        if (max == 0) {
+            return ChannelStatus::Ok;
+        }
+        uint64_t pos = receivePos.load(std::memory_order_relaxed);
+        for (;;) {
+            size_t ready = 0;
+            while (ready < max && cellAt(pos + ready).sequence.load(std::memory_order_acquire) == filledAt(pos + ready)) {
+                ++ready;
+            }
+            if (ready == 0) {
+                if (cellAt(pos).sequence.load(std::memory_order_acquire) < filledAt(pos)) {
+                    // Empty, or a sender has claimed the cell but not filled it yet
+                    uint64_t sent = sendPos.load(std::memory_order_acquire);
+                    return (sent & kClosed) && (sent & ~kClosed) == pos ? ChannelStatus::Closed
+                                                                        : ChannelStatus::WouldBlock;
+                }
+                pos = receivePos.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (receivePos.compare_exchange_weak(pos, pos + ready, std::memory_order_relaxed)) {
+                for (size_t i = 0; i < ready; ++i) {
+                    Cell& cell = cellAt(pos + i);
+                    out[i] = std::move(cell.value);
+                    cell.sequence.store(emptyAt(pos + i + slots), std::memory_order_release);
+                }
+                received = ready;
+                notifySenders(ready);
+                return ChannelStatus::Ok;
+            }
+        }
+    }
+
+    ChannelStatus trySend(T value) {
+        size_t sent;
+        return trySendBatch(&value, 1, sent);
+    }
+    ChannelStatus tryReceive(T& out) {
+        size_t received;
+        return tryReceiveBatch(&out, 1, received);
+    }
+
+    ChannelStatus sendBatchOrPark(T* items, size_t count, size_t& sent, ChannelWaiter* waiter) {
+        for (;;) {
+            ChannelStatus status = trySendBatch(items, count, sent);
+            if (status != ChannelStatus::WouldBlock || parkOn(waiter, true) == ChannelStatus::Parked) {
+                return status == ChannelStatus::WouldBlock ? ChannelStatus::Parked : status;
+            }
+        }
+    }
+    ChannelStatus receiveBatchOrPark(T* out, size_t max, size_t& received, ChannelWaiter* waiter) {
+        for (;;) {
+            ChannelStatus status = tryReceiveBatch(out, max, received);
+            if (status != ChannelStatus::WouldBlock || parkOn(waiter, false) == ChannelStatus::Parked) {
+                return status == ChannelStatus::WouldBlock ? ChannelStatus::Parked : status;
+            }
+        }
+    }
+    // On Parked, `value` is left for the retry
+    ChannelStatus sendOrPark(T& value, ChannelWaiter* waiter) {
+        size_t sent;
+        return sendBatchOrPark(&value, 1, sent, waiter);
+    }
+    ChannelStatus receiveOrPark(T& out, ChannelWaiter* waiter) {
+        size_t received;
+        return receiveBatchOrPark(&out, 1, received, waiter);
+    }
+
+    // Block the calling thread; Ok or Closed
+    ChannelStatus sendBatch(T* items, size_t count, size_t& sent) {
+        BlockingWaiter waiter;
+        ChannelStatus status;
+        while ((status = sendBatchOrPark(items, count, sent, &waiter)) == ChannelStatus::Parked) {
+            waiter.wait();
+        }
+        return status;
+    }
+    ChannelStatus receiveBatch(T* out, size_t max, size_t& received) {
+        BlockingWaiter waiter;
+        ChannelStatus status;
+        while ((status = receiveBatchOrPark(out, max, received, &waiter)) == ChannelStatus::Parked) {
+            waiter.wait();
+        }
+        return status;
+    }
+    ChannelStatus send(T value) {
+        size_t sent;
+        return sendBatch(&value, 1, sent);
+    }
+    ChannelStatus receive(T& out) {
+        size_t received;
+        return receiveBatch(&out, 1, received);
+    }
+
+private:
+    struct Cell {
+        std::atomic<uint64_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+
+    Cell& cellAt(uint64_t pos) const { return cells[static_cast<size_t>(pos % slots)]; }
+    // Sequence of a cell waiting to be filled, or emptied, at `pos`
+    static uint64_t emptyAt(uint64_t pos) { return 2 * pos; }
+    static uint64_t filledAt(uint64_t pos) { return 2 * pos + 1; }
+
+    ChannelStatus parkOn(ChannelWaiter* waiter, bool sending) {
+        waiter->node.channel = this;
+        waiter->node.sending = sending;
+        return park(waiter, &waiter->node, 1);
+    }
+
+    bool canSend() const override {
+        uint64_t pos = sendPos.load(std::memory_order_acquire);
+        return (pos & kClosed) || cellAt(pos).sequence.load(std::memory_order_acquire) == emptyAt(pos);
+    }
+    bool canReceive() const override {
+        uint64_t pos = receivePos.load(std::memory_order_acquire);
+        return cellAt(pos).sequence.load(std::memory_order_acquire) == filledAt(pos) ||
+               sendPos.load(std::memory_order_acquire) == (pos | kClosed);
+    }
+};
+
+// `select` over channel operations: performs exactly one of its cases,
+// whichever is ready first, waiting for one when none is. Cases are
+// tried starting from a different one each time, so a busy channel cannot
+// starve the others. A closed channel makes its cases ready (with status
+// Closed).
+//
+// A Select that parked must not be destroyed before its waiter has been
+// resumed and has run it again.
+class Select {
+public:
+    struct Result {
+        int index = -1; // Case performed, -1 for none
+        ChannelStatus status = ChannelStatus::WouldBlock;
+        size_t count = 0; // Items transferred
+    };
+
+    Select() = default;
+    Select(const Select&) = delete;
+    Select& operator=(const Select&) = delete;
+    ~Select() {
+        if (parked) {
+            ChannelBase::unpark(nodes.data(), nodes.size());
+        }
+    }
+
+    // Adds a case sending (a batch of) `count` items, or receiving up to
+    // `max`; returns its index
+    template <typename T>
+    int send(Channel<T>& channel, T* items, size_t count = 1) {
+        return addCase(&channel, items, count, true, &attemptSend<T>);
+    }
+    template <typename T>
+    int receive(Channel<T>& channel, T* out, size_t max = 1) {
+        return addCase(&channel, out, max, false, &attemptReceive<T>);
+    }
+
+    // Performs a ready case, or returns index -1 with WouldBlock
+    Result trySelect();
+    // Performs a ready case, or parks `waiter` (Parked) until one may be
+    Result selectOrPark(ChannelWaiter* waiter);
+    // Blocks the calling thread until a case is performed
+    Result select();
+
+private:
+    using Attempt = ChannelStatus (*)(ChannelBase* channel, void* items, size_t count, size_t& done);
+
+    struct Case {
+        void* items;
+        size_t count;
+        Attempt attempt;
+    };
+
+    std::vector<Case> cases;
+    std::vector<WaitNode> nodes; // One per case, registered while parked
+    size_t start = 0;
+    bool parked = false; // Nodes may still be registered
+
+    int addCase(ChannelBase* channel, void* items, size_t count, bool sending, Attempt attempt);
+    // After a wake: other cases that became ready wake someone else
+    void forwardWakes(size_t performed);
+
+    template <typename T>
+    static ChannelStatus attemptSend(ChannelBase* channel, void* items, size_t count, size_t& done) {
+        return static_cast<Channel<T>*>(channel)->trySendBatch(static_cast<T*>(items), count, done);
+    }
+    template <typename T>
+    static ChannelStatus attemptReceive(ChannelBase* channel, void* items, size_t count, size_t& done) {
+        return static_cast<Channel<T>*>(channel)->tryReceiveBatch(static_cast<T*>(items), count, done);
+    }
+};
+
+#endif // CHANNEL_H
@@ -0,0 +1,276 @@
+#ifndef CONCURRENT_HASH_MAP_H
+#define CONCURRENT_HASH_MAP_H
+
+#include "runtime/concurrency/epoch.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+// Hash map behind the script-level Map when it is shared between `run`
+// tasks: writes to different keys proceed in parallel and reads never
+// block.
+//
+// Buckets hold singly linked chains of immutable nodes. Readers pin the
+// epoch domain and walk a chain with acquire loads only: no lock, no
+// reference count, no write to shared memory. Writers lock one of
+// kStripes stripes (the bucket index modulo kStripes, so a bucket always
+// belongs to the same stripe whatever the table size) and publish a new
+// node with a release store: inserting at the head, replacing the node of
+// an existing key with an updated copy, or unlinking it. Replaced and
+// unlinked nodes are retired to the epoch domain, so readers still on them
+// finish undisturbed.
+//
+// When the chains of a stripe average kMaxLoad nodes the table doubles:
+// the grower takes every stripe, copies the nodes into a new table,
+// publishes it and retires the old one with its nodes. Readers in the old
+// table meanwhile still see a consistent (slightly older) map.
+//
+// Keys and values are copied into nodes (and again when growing) and out
+// to readers, so both must be copyable. Iteration is weakly consistent:
+// it sees every entry present throughout and possibly some of those
+// written meanwhile.
+template <typename K, typename V, typename Hash = std::hash<K>, typename Eq = std::equal_to<K>>
+class ConcurrentHashMap {
+public:
+    static constexpr size_t kStripes = 64;
+    static constexpr size_t kMaxLoad = 2;
+
+    explicit ConcurrentHashMap(EpochDomain& domain = EpochDomain::global(), size_t capacity = 0)
+        : domain(domain), table(new Table(tableSizeFor(capacity))) {}
+
+    // Not concurrent with anything
+    ~ConcurrentHashMap() {
+        Table* current = table.load(std::memory_order_relaxed);
+        for (size_t i = 0; i <= current->mask; ++i) {
+            Node* node = current->buckets[i].load(std::memory_order_relaxed);
+            while (node) {
+                Node* next = node->next.load(std::memory_order_relaxed);
+                delete node;
+                node = next;
+            }
+        }
+        delete current;
+    }
+
+    ConcurrentHashMap(const ConcurrentHashMap&) = delete;
+    ConcurrentHashMap& operator=(const ConcurrentHashMap&) = delete;
+
+    // Copies the value of `key` to `value` (when not null); false when absent
+    bool get(const K& key, V* value) const {
+        size_t hash = hashOf(key);
+        EpochDomain::Guard guard(domain);
+        if (const Node* node = findNode(table.load(std::memory_order_acquire), hash, key)) {
+            if (value) {
+                *value = node->value;
+            }
+            return true;
+        }
+        return false;
+    }
+    bool contains(const K& key) const { return get(key, nullptr); }
+
+    // Stores `value` under `key`; true when the key was new
+    bool set(const K& key, V value) { return store(key, std::move(value), true); }
+    // Stores `value` only when `key` is absent; true when it was stored
+    bool insert(const K& key, V value) { return store(key, std::move(value), false); }
+
+    // Removes `key`; false when it was absent
+    bool erase(const K& key) {
+        size_t hash = hashOf(key);
+        Stripe& stripe = stripes[hash % kStripes];
+        std::lock_guard<std::mutex> lock(stripe.lock);
+        // Growing takes every stripe, so the table is stable while we hold one
+        Table* current = table.load(std::memory_order_acquire);
+        std::atomic<Node*>* link = &current->buckets[hash & current->mask];
+        for (Node* node = link->load(std::memory_order_relaxed); node;
+             link = &node->next, node = link->load(std::memory_order_relaxed)) {
+            if (node->hash == hash && equal(node->key, key)) {
+                // The unlinked node keeps its successor for readers still on it
+                link->store(node->next.load(std::memory_order_relaxed), std::memory_order_release);
+                stripe.count.store(stripe.count.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+                domain.retire(node);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Approximate while writers are active
+    size_t size() const {
+        size_t total = 0;
+        for (const Stripe& stripe : stripes) {
+            total += stripe.count.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    size_t bucketCount() const { return table.load(std::memory_order_acquire)->mask + 1; }
+
+    // fn(key, value) for every entry; see the class comment for consistency
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        EpochDomain::Guard guard(domain);
+        const Table* current = table.load(std::memory_order_acquire);
+        for (size_t i = 0; i <= current->mask; ++i) {
+            for (const Node* node = current->buckets[i].load(std::memory_order_acquire); node;
+                 node = node->next.load(std::memory_order_acquire)) {
+                fn(node->key, node->value);
+            }
+        }
+    }
+
+private:
+    struct Node {
+        Node(size_t h, const K& k, V v, Node* n) : hash(h), key(k), value(std::move(v)), next(n) {}
+
+        size_t hash;
+        K key;
+        V value;
+        std::atomic<Node*> next;
+    };
+
+    struct Table {
+        explicit Table(size_t size) : mask(size - 1), buckets(new std::atomic<Node*>[size]) {
+            for (size_t i = 0; i < size; ++i) {
+                buckets[i].store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        size_t mask;
+        std::unique_ptr<std::atomic<Node*>[]> buckets;
+    };
+
+    // Writers of different stripes never share a cache line
+    struct alignas(64) Stripe {
+        std::mutex lock;
+        std::atomic<size_t> count{0}; // Entries in the stripe's buckets; written under `lock`
+    };
+
+    EpochDomain& domain;
+    std::atomic<Table*> table;
+    Stripe stripes[kStripes];
+    Hash hasher;
+    Eq equal;
+
+    static size_t tableSizeFor(size_t capacity) {
+        size_t size = kStripes;
+        while (size * kMaxLoad < capacity) {
+            size *= 2;
+        }
+        return size;
+    }
+
+    // std::hash is the identity for integers; spread the bits so that
+    // both the bucket (low bits) and the stripe see all of them
+    size_t hashOf(const K& key) const {
+        uint64_t h = static_cast<uint64_t>(hasher(key));
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        return static_cast<size_t>(h);
+    }
+
+    const Node* findNode(const Table* current, size_t hash, const K& key) const {
+        for (const Node* node = current->buckets[hash & current->mask].load(std::memory_order_acquire); node;
+             node = node->next.load(std::memory_order_acquire)) {
+            if (node->hash == hash && equal(node->key, key)) {
+                return node;
+            }
+        }
+        return nullptr;
+    }
+
+    bool store(const K& key, V value, bool replace) {
+        size_t hash = hashOf(key);
+        Stripe& stripe = stripes[hash % kStripes];
+        size_t stripeCount;
+        size_t buckets;
+        {
+            std::lock_guard<std::mutex> lock(stripe.lock);
+            Table* current = table.load(std::memory_order_acquire);
+            std::atomic<Node*>& head = current->buckets[hash & current->mask];
+            std::atomic<Node*>* link = &head;
+            for (Node* node = link->load(std::memory_order_relaxed); node;
+                 link = &node->next, node = link->load(std::memory_order_relaxed)) {
+                if (node->hash == hash && equal(node->key, key)) {
+                    if (replace) {
+                        Node* updated = new Node(hash, node->key, std::move(value),
+                                                 node->next.load(std::memory_order_relaxed));
+                        link->store(updated, std::memory_order_release);
+                        domain.retire(node);
+                    }
+                    return false;
+                }
+            }
+            head.store(new Node(hash, key, std::move(value), head.load(std::memory_order_relaxed)),
+                       std::memory_order_release);
+            stripeCount = stripe.count.load(std::memory_order_relaxed) + 1;
+            stripe.count.store(stripeCount, std::memory_order_relaxed);
+            buckets = current->mask + 1;
+        }
+        if (stripeCount > kMaxLoad * (buckets / kStripes)) {
+            grow(buckets);
+        }
+        return true;
+    }
+
+    void grow(size_t observedBuckets) {
+        std::unique_lock<std::mutex> locks[kStripes];
+        for (size_t i = 0; i < kStripes; ++i) {
+            locks[i] = std::unique_lock<std::mutex>(stripes[i].lock);
+        }
+        Table* old = table.load(std::memory_order_relaxed);
+        if (old->mask + 1 != observedBuckets) {
+            return; // Another writer grew it first
+        }
+        auto* grown = new Table(2 * (old->mask + 1));
+        for (size_t i = 0; i <= old->mask; ++i) {
+            for (Node* node = old->buckets[i].load(std::memory_order_relaxed); node;
+                 node = node->next.load(std::memory_order_relaxed)) {
+                std::atomic<Node*>& head = grown->buckets[node->hash & grown->mask];
+                head.store(new Node(node->hash, node->key, node->value, head.load(std::memory_order_relaxed)),
+                           std::memory_order_relaxed);
+            }
+        }
+        table.store(grown, std::memory_order_release);
+        for (size_t i = 0; i <= old->mask; ++i) {
+            Node* node = old->buckets[i].load(std::memory_order_relaxed);
+            while (node) {
+                Node* next = node->next.load(std::memory_order_relaxed);
+                domain.retire(node);
+                node = next;
+            }
+        }
+        domain.retire(old);
+    }
+};
+
+// Set counterpart of ConcurrentHashMap, behind the script-level Set
+template <typename K, typename Hash = std::hash<K>, typename Eq = std::equal_to<K>>
+class ConcurrentHashSet {
+public:
+    explicit ConcurrentHashSet(EpochDomain& domain = EpochDomain::global(), size_t capacity = 0)
+        : map(domain, capacity) {}
+
+    // True when `key` was not in the set yet
+    bool insert(const K& key) { return map.insert(key, Present()); }
+    bool contains(const K& key) const { return map.contains(key); }
+    bool erase(const K& key) { return map.erase(key); }
+    size_t size() const { return map.size(); }
+
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        map.forEach([&](const K& key, const Present&) { fn(key); });
+    }
+
+private:
+    struct Present {};
+
+    ConcurrentHashMap<K, Present, Hash, Eq> map;
+};
+
+#endif // CONCURRENT_HASH_MAP_H
@@ -0,0 +1,155 @@
+#include "runtime/concurrency/epoch.h"
+#include <vector>
+
+struct EpochDomain::Record {
+    struct Retired {
+        void* node;
+        void (*deleter)(void*);
+    };
+
+    // Announced epoch << 1 | pinned; read by other threads in tryAdvance()
+    alignas(64) std::atomic<uint64_t> state{0};
+    // The rest is owned by the thread, except `pending` which anyone may read
+    uint32_t nesting = 0;
+    uint32_t sinceCollect = 0;
+    std::vector<Retired> bags[3]; // By retirement epoch modulo 3
+    uint64_t bagEpoch[3] = {0, 0, 0};
+    std::atomic<size_t> pending{0};
+    Record* next = nullptr;
+
+    void freeBag(int bag) {
+        for (const Retired& retired : bags[bag]) {
+            retired.deleter(retired.node);
+        }
+        pending.store(pending.load(std::memory_order_relaxed) - bags[bag].size(), std::memory_order_relaxed);
+        bags[bag].clear();
+    }
+};
+
+namespace {
+
+std::atomic<uint64_t> nextDomainId{1};
+
+struct CachedRecord {
+    uint64_t domain;
+    void* record;
+};
+
+// Records of the calling thread, by domain id. Ids are never reused, so an
+// entry for a destroyed domain is merely never looked up again.
+thread_local uint64_t lastDomain = 0;
+thread_local void* lastRecord = nullptr;
+thread_local std::vector<CachedRecord> threadRecords;
+
+} // namespace
+
+EpochDomain::EpochDomain() : id(nextDomainId.fetch_add(1, std::memory_order_relaxed)) {}
+
+EpochDomain::~EpochDomain() {
+    Record* record = records.load(std::memory_order_acquire);
+    while (record) {
+        for (int bag = 0; bag < 3; ++bag) {
+            record->freeBag(bag);
+        }
+        Record* next = record->next;
+        delete record;
+        record = next;
+    }
+}
+
+EpochDomain& EpochDomain::global() {
+    static EpochDomain domain;
+    return domain;
+}
+
+EpochDomain::Record* EpochDomain::threadRecord() {
+    if (lastDomain == id) {
+        return static_cast<Record*>(lastRecord);
+    }
+    Record* record = nullptr;
+    for (const CachedRecord& cached : threadRecords) {
+        if (cached.domain == id) {
+            record = static_cast<Record*>(cached.record);
+            break;
+        }
+    }
+    if (!record) {
+        record = new Record();
+        record->next = records.load(std::memory_order_relaxed);
+        while (!records.compare_exchange_weak(record->next, record, std::memory_order_release,
+                                              std::memory_order_relaxed)) {
+        }
+        threadRecords.push_back(CachedRecord{id, record});
+    }
+    lastDomain = id;
+    lastRecord = record;
+    return record;
+}
+
+EpochDomain::Guard::Guard(EpochDomain& domain) : record(domain.threadRecord()) {
+    if (record->nesting++ == 0) {
+        uint64_t epoch = domain.globalEpoch.load(std::memory_order_seq_cst);
+        record->state.store(epoch << 1 | 1, std::memory_order_relaxed);
+        // The announcement must be visible before any shared pointer is read
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+}
+
+EpochDomain::Guard::~Guard() {
+    if (--record->nesting == 0) {
+        record->state.store(0, std::memory_order_release);
+    }
+}
+
+void EpochDomain::retire(void* node, void (*deleter)(void*)) {
+    Record* record = threadRecord();
+    uint64_t epoch = globalEpoch.load(std::memory_order_seq_cst);
+    int bag = static_cast<int>(epoch % 3);
+    if (record->bagEpoch[bag] != epoch) {
+        // Last filled three or more epochs ago: safe
+        record->freeBag(bag);
+        record->bagEpoch[bag] = epoch;
+    }
+    record->bags[bag].push_back(Record::Retired{node, deleter});
+    record->pending.store(record->pending.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (++record->sinceCollect >= kCollectInterval) {
+        collect();
+    }
+}
+
+void EpochDomain::collect() {
+    Record* record = threadRecord();
+    record->sinceCollect = 0;
+    tryAdvance();
+    freeSafeBags(*record, globalEpoch.load(std::memory_order_seq_cst));
+}
+
+bool EpochDomain::tryAdvance() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t epoch = globalEpoch.load(std::memory_order_seq_cst);
+    for (Record* record = records.load(std::memory_order_acquire); record; record = record->next) {
+        uint64_t state = record->state.load(std::memory_order_seq_cst);
+        if ((state & 1) && (state >> 1) != epoch) {
+            return false; // Still inside an operation begun in an older epoch
+        }
+    }
+    // Losing the race means another thread advanced it just now
+    globalEpoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst);
+    return true;
+}
+
+void EpochDomain::freeSafeBags(Record& record, uint64_t epoch) {
+    for (int bag = 0; bag < 3; ++bag) {
+        if (!record.bags[bag].empty() && record.bagEpoch[bag] + 2 <= epoch) {
+            record.freeBag(bag);
+        }
+    }
+}
+
+size_t EpochDomain::pendingCount() const {
+    size_t count = 0;
+    for (Record* record = records.load(std::memory_order_acquire); record; record = record->next) {
+        count += record->pending.load(std::memory_order_relaxed);
+    }
+    return count;
+}
@@ -0,0 +1,80 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Epoch-based reclamation for lock-free readers.
+//
+// Readers pin the domain for the duration of an operation (Guard) and may
+// then follow pointers to shared nodes without any lock or reference count.
+// Writers that unlink a node retire() it instead of deleting it. A node
+// retired during global epoch e is freed once the epoch has reached e + 2:
+// the epoch only advances when every pinned thread has announced the
+// current one, so by then no reader that could have seen the node is still
+// inside its operation.
+//
+// Pinning costs a store and a fence on a thread-private cache line. Each
+// thread keeps its retired nodes in three bags by epoch and frees a bag
+// when it comes round again; whatever is left when the domain is destroyed
+// is freed then. Threads register with a domain on first use; the record
+// stays with the domain after the thread exits, and garbage the thread
+// left behind is freed with the domain.
+class EpochDomain {
+    struct Record;
+
+public:
+    EpochDomain();
+    // No thread may be pinned. Frees everything still retired.
+    ~EpochDomain();
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    // Process-wide domain used by default
+    static EpochDomain& global();
+
+    // Keeps nodes retired from now on alive until destroyed. Nestable.
+    class Guard {
+    public:
+        explicit Guard(EpochDomain& domain);
+        ~Guard();
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+    private:
+        Record* record;
+    };
+
+    // Frees `node` with `deleter` once no reader can hold it. The caller
+    // must have made it unreachable for new readers first.
+    void retire(void* node, void (*deleter)(void*));
+    template <typename T>
+    void retire(T* node) {
+        retire(static_cast<void*>(node), [](void* p) { delete static_cast<T*>(p); });
+    }
+
+    // Tries to advance the epoch and frees the calling thread's bags that
+    // have become safe. retire() does this every so often by itself.
+    void collect();
+
+    uint64_t epoch() const { return globalEpoch.load(std::memory_order_relaxed); }
+    // Retired nodes not yet freed, over all threads (approximate while
+    // other threads retire)
+    size_t pendingCount() const;
+
+private:
+    static constexpr uint32_t kCollectInterval = 64; // Retirements between collect() calls
+
+    std::atomic<uint64_t> globalEpoch{2};
+    std::atomic<Record*> records{nullptr}; // Push-only list
+    uint64_t id;                           // Unique per domain, for the thread caches
+
+    Record* threadRecord();
+    bool tryAdvance();
+    void freeSafeBags(Record& record, uint64_t epoch);
+};
+
+#endif // EPOCH_H
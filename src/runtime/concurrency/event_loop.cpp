@@ -0,0 +1,671 @@
+#include "runtime/concurrency/event_loop.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unordered_map>
+#endif
+
+namespace {
+
+uint64_t steadyMilliseconds() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+[[noreturn]] void throwErrno(const char* what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+} // namespace
+
+#ifdef __linux__
+
+// The io_uring instance: the submission and completion rings shared with
+// the kernel, set up with raw system calls
+struct EventLoop::Ring {
+    int fd = -1;
+    uint32_t entries = 0;
+    void* sqMemory = MAP_FAILED;
+    size_t sqSize = 0;
+    void* cqMemory = MAP_FAILED;
+    size_t cqSize = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqesSize = 0;
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+    bool buffersRegistered = false;
+
+    std::mutex lock;          // Submission side; operations start on any thread
+    unsigned unsubmitted = 0; // Written to the ring, not yet entered
+
+    ~Ring() {
+        if (sqes != MAP_FAILED) {
+            munmap(sqes, sqesSize);
+        }
+        if (cqMemory != MAP_FAILED && cqMemory != sqMemory) {
+            munmap(cqMemory, cqSize);
+        }
+        if (sqMemory != MAP_FAILED) {
+            munmap(sqMemory, sqSize);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    // A ring supporting every operation IoOp needs, or null
+    static std::unique_ptr<Ring> create(uint32_t entries) {
+        auto ring = std::make_unique<Ring>();
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ring->fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (ring->fd < 0 || !ring->supportsOperations() || !ring->map(params)) {
+            return nullptr;
+        }
+        ring->entries = params.sq_entries;
+        return ring;
+    }
+
+    bool supportsOperations() {
+        constexpr unsigned kOps = 256;
+        std::vector<uint8_t> memory(sizeof(io_uring_probe) + kOps * sizeof(io_uring_probe_op));
+        auto* probe = reinterpret_cast<io_uring_probe*>(memory.data());
+        if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, kOps) < 0) {
+            return false; // Older than the probe, and so than IORING_OP_READ
+        }
+        for (int op : {IORING_OP_READ, IORING_OP_WRITE, IORING_OP_READ_FIXED, IORING_OP_CONNECT}) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool map(const io_uring_params& params) {
+        sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) {
+            sqSize = cqSize = std::max(sqSize, cqSize);
+        }
+        sqMemory = mmap(nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqMemory == MAP_FAILED) {
+            return false;
+        }
+        cqMemory = single ? sqMemory
+                          : mmap(nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                                 IORING_OFF_CQ_RING);
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqeMemory =
+            mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        sqes = static_cast<io_uring_sqe*>(sqeMemory);
+        if (cqMemory == MAP_FAILED || sqeMemory == MAP_FAILED) {
+            return false;
+        }
+        auto* sq = static_cast<uint8_t*>(sqMemory);
+        auto* cq = static_cast<uint8_t*>(cqMemory);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    // Hands the unsubmitted entries to the kernel. `lock` must be held.
+    void submitLocked() {
+        while (unsubmitted != 0) {
+            long done = syscall(__NR_io_uring_enter, fd, unsubmitted, 0, 0, nullptr, 0);
+            if (done > 0) {
+                unsubmitted -= static_cast<unsigned>(done);
+            } else if (done < 0 && errno != EINTR) {
+                return; // EAGAIN/EBUSY: retried on the next flush
+            }
+        }
+    }
+};
+
+// Operations of the epoll backend waiting for their fd to become ready,
+// first come first served per direction. Touched by the poller only.
+struct EventLoop::Readiness {
+    struct Queue {
+        IoOp* head = nullptr;
+        IoOp* tail = nullptr;
+
+        bool empty() const { return head == nullptr; }
+        void push(IoOp* op) {
+            op->nextOp = nullptr;
+            (tail ? tail->nextOp : head) = op;
+            tail = op;
+        }
+        IoOp* pop() {
+            IoOp* op = head;
+            head = op->nextOp;
+            if (!head) {
+                tail = nullptr;
+            }
+            return op;
+        }
+    };
+
+    struct Waiters {
+        Queue readers;
+        Queue writers;
+        uint32_t registered = 0; // Events the epoll set watches for
+    };
+
+    std::unordered_map<int, Waiters> fds;
+
+    // Makes the epoll set watch `fd` for what its waiters need
+    static bool watch(int waitFd, int fd, Waiters& waiters) {
+        uint32_t wanted = (waiters.readers.empty() ? 0u : uint32_t(EPOLLIN)) |
+                          (waiters.writers.empty() ? 0u : uint32_t(EPOLLOUT));
+        if (wanted == waiters.registered) {
+            return true;
+        }
+        epoll_event event{};
+        event.events = wanted;
+        event.data.fd = fd;
+        int how = wanted == 0 ? EPOLL_CTL_DEL : waiters.registered == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+        if (epoll_ctl(waitFd, how, fd, &event) != 0) {
+            return false;
+        }
+        waiters.registered = wanted;
+        return true;
+    }
+};
+
+#else
+
+struct EventLoop::Ring {
+    int fd = -1;
+    std::mutex lock;
+    unsigned unsubmitted = 0;
+};
+struct EventLoop::Readiness {};
+
+#endif
+
+EventLoop::EventLoop(Options options) : epochMs(steadyMilliseconds()) {
+    if (pipe(wakeFds) != 0) {
+        throwErrno("event loop wake pipe");
+    }
+    for (int fd : wakeFds) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+#ifdef __linux__
+    waitFd = epoll_create1(EPOLL_CLOEXEC);
+    if (waitFd < 0) {
+        throwErrno("event loop epoll set");
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = wakeFds[0];
+    epoll_ctl(waitFd, EPOLL_CTL_ADD, wakeFds[0], &event);
+    if (options.allowIoUring) {
+        ring = Ring::create(options.entries);
+    }
+    if (ring) {
+        kind = Backend::IoUring;
+        // The ring's fd is readable while completions are waiting
+        event.data.fd = ring->fd;
+        epoll_ctl(waitFd, EPOLL_CTL_ADD, ring->fd, &event);
+    } else {
+        kind = Backend::Epoll;
+        readiness = std::make_unique<Readiness>();
+    }
+#else
+    (void)options;
+    kind = Backend::Blocking;
+#endif
+}
+
+EventLoop::~EventLoop() {
+    ring.reset();
+    if (waitFd >= 0) {
+        close(waitFd);
+    }
+    close(wakeFds[0]);
+    close(wakeFds[1]);
+}
+
+uint64_t EventLoop::nowTick() const {
+    return steadyMilliseconds() - epochMs;
+}
+
+void EventLoop::read(IoOp* op, int fd, void* buffer, uint32_t length, int64_t offset) {
+    op->kind = IoOp::Kind::Read;
+    op->fd = fd;
+    op->buffer = buffer;
+    op->length = length;
+    op->offset = offset;
+    start(op);
+}
+
+void EventLoop::write(IoOp* op, int fd, const void* buffer, uint32_t length, int64_t offset) {
+    op->kind = IoOp::Kind::Write;
+    op->fd = fd;
+    op->buffer = const_cast<void*>(buffer);
+    op->length = length;
+    op->offset = offset;
+    start(op);
+}
+
+void EventLoop::readFixed(IoOp* op, int fd, uint32_t bufferIndex, uint32_t length, int64_t offset) {
+    op->kind = IoOp::Kind::ReadFixed;
+    op->fd = fd;
+    op->bufferIndex = bufferIndex;
+    op->buffer = registered[bufferIndex].first;
+    op->length = length;
+    op->offset = offset;
+    start(op);
+}
+
+void EventLoop::connect(IoOp* op, int fd, const sockaddr* address, uint32_t addressLength) {
+    op->kind = IoOp::Kind::Connect;
+    op->fd = fd;
+    op->address = address;
+    op->addressLength = addressLength;
+    start(op);
+}
+
+void EventLoop::sleep(IoOp* op, uint64_t milliseconds) {
+    op->kind = IoOp::Kind::Sleep;
+    inFlight.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> guard(timerLock);
+        // The current tick is partly over: one more so sleeps never end early
+        timers.schedule(op, nowTick() + milliseconds + 1);
+    }
+    // A waiting poller may have computed its timeout without this timer
+    if (waiting.load(std::memory_order_seq_cst)) {
+        wake();
+    }
+}
+
+int EventLoop::registerBuffers(std::vector<std::pair<void*, size_t>> buffers) {
+#ifdef __linux__
+    if (ring) {
+        if (ring->buffersRegistered) {
+            syscall(__NR_io_uring_register, ring->fd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+            ring->buffersRegistered = false;
+        }
+        std::vector<iovec> iovecs;
+        for (const auto& [base, size] : buffers) {
+            iovecs.push_back(iovec{base, size});
+        }
+        if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, iovecs.data(),
+                    static_cast<unsigned>(iovecs.size())) < 0) {
+            registered.clear();
+            return -errno;
+        }
+        ring->buffersRegistered = true;
+    }
+#endif
+    registered = std::move(buffers);
+    return 0;
+}
+
+void EventLoop::start(IoOp* op) {
+    inFlight.fetch_add(1, std::memory_order_relaxed);
+    if (ring) {
+        submitToRing(op);
+    } else {
+        queueStart(op);
+    }
+    // Pairs with waitForEvents(): either the poller sees the operation
+    // before it blocks, or this sees it waiting
+    if (waiting.load(std::memory_order_seq_cst)) {
+        wake();
+    }
+}
+
+void EventLoop::submitToRing(IoOp* op) {
+#ifdef __linux__
+    std::lock_guard<std::mutex> guard(ring->lock);
+    unsigned tail = *ring->sqTail;
+    while (tail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE) == ring->entries) {
+        // Ring full: hand the batch over now
+        ring->submitLocked();
+        if (tail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE) == ring->entries) {
+            std::this_thread::yield();
+        }
+    }
+    unsigned index = tail & ring->sqMask;
+    io_uring_sqe& sqe = ring->sqes[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.fd = op->fd;
+    switch (op->kind) {
+        case IoOp::Kind::Read:
+        case IoOp::Kind::Write:
+        case IoOp::Kind::ReadFixed:
+            sqe.opcode = op->kind == IoOp::Kind::Read    ? IORING_OP_READ
+                         : op->kind == IoOp::Kind::Write ? IORING_OP_WRITE
+                                                         : IORING_OP_READ_FIXED;
+            sqe.addr = reinterpret_cast<uintptr_t>(op->buffer);
+            sqe.len = op->length;
+            sqe.off = static_cast<uint64_t>(op->offset); // -1: the file position
+            sqe.buf_index = static_cast<uint16_t>(op->bufferIndex);
+            break;
+        case IoOp::Kind::Connect:
+            sqe.opcode = IORING_OP_CONNECT;
+            sqe.addr = reinterpret_cast<uintptr_t>(op->address);
+            sqe.off = op->addressLength;
+            break;
+        case IoOp::Kind::Sleep:
+            break; // Timers never reach the ring
+    }
+    sqe.user_data = reinterpret_cast<uintptr_t>(op);
+    ring->sqArray[index] = index;
+    __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+    ++ring->unsubmitted;
+#else
+    (void)op;
+#endif
+}
+
+void EventLoop::queueStart(IoOp* op) {
+    std::lock_guard<std::mutex> guard(startLock);
+    op->nextOp = nullptr;
+    (startTail ? startTail->nextOp : startHead) = op;
+    startTail = op;
+}
+
+void EventLoop::flush() {
+    if (ring) {
+#ifdef __linux__
+        std::lock_guard<std::mutex> guard(ring->lock);
+        ring->submitLocked();
+#endif
+    }
+}
+
+bool EventLoop::perform(IoOp* op, bool mayBlock) {
+    ssize_t done = 0;
+    switch (op->kind) {
+        case IoOp::Kind::Read:
+        case IoOp::Kind::ReadFixed:
+            done = op->offset >= 0 ? pread(op->fd, op->buffer, op->length, op->offset)
+                                   : ::read(op->fd, op->buffer, op->length);
+            break;
+        case IoOp::Kind::Write:
+            done = op->offset >= 0 ? pwrite(op->fd, op->buffer, op->length, op->offset)
+                                   : ::write(op->fd, op->buffer, op->length);
+            break;
+        case IoOp::Kind::Connect: {
+            int error = 0;
+            socklen_t size = sizeof(error);
+            if (getsockopt(op->fd, SOL_SOCKET, SO_ERROR, &error, &size) != 0) {
+                error = errno;
+            }
+            done = error != 0 ? (errno = error, -1) : 0;
+            break;
+        }
+        case IoOp::Kind::Sleep:
+            break;
+    }
+    if (done < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) && !mayBlock) {
+        return false; // Spurious readiness; keep waiting
+    }
+    op->result = done < 0 ? -errno : done;
+    return true;
+}
+
+size_t EventLoop::startQueued() {
+    IoOp* op;
+    {
+        std::lock_guard<std::mutex> guard(startLock);
+        op = startHead;
+        startHead = startTail = nullptr;
+    }
+    size_t delivered = 0;
+    while (op) {
+        IoOp* next = op->nextOp;
+        if (begin(op)) {
+            deliver(op);
+            ++delivered;
+        }
+        op = next;
+    }
+    return delivered;
+}
+
+bool EventLoop::begin(IoOp* op) {
+    if (op->kind == IoOp::Kind::Connect) {
+        if (readiness) {
+            fcntl(op->fd, F_SETFL, fcntl(op->fd, F_GETFL) | O_NONBLOCK);
+        }
+        if (::connect(op->fd, op->address, op->addressLength) == 0) {
+            op->result = 0;
+            return true;
+        }
+        if (errno != EINPROGRESS || !readiness) {
+            op->result = -errno;
+            return true;
+        }
+    } else if (op->offset >= 0 || !readiness) {
+        perform(op, true);
+        return true;
+    }
+#ifdef __linux__
+    Readiness::Waiters& waiters = readiness->fds[op->fd];
+    (op->kind == IoOp::Kind::Write || op->kind == IoOp::Kind::Connect ? waiters.writers : waiters.readers).push(op);
+    if (readiness->watch(waitFd, op->fd, waiters)) {
+        return false;
+    }
+    // Only a new fd can fail to be added, so `op` is its only waiter.
+    // Regular files cannot be watched, and are always ready.
+    int error = errno;
+    readiness->fds.erase(op->fd);
+    if (error == EPERM) {
+        perform(op, true);
+    } else {
+        op->result = -error;
+    }
+#endif
+    return true;
+}
+
+size_t EventLoop::runReady(int fd, uint32_t events) {
+    size_t delivered = 0;
+#ifdef __linux__
+    auto it = readiness->fds.find(fd);
+    if (it == readiness->fds.end()) {
+        return 0;
+    }
+    Readiness::Waiters& waiters = it->second;
+    // One operation per direction; the level-triggered set reports the fd
+    // again while it stays ready
+    bool failed = (events & (EPOLLERR | EPOLLHUP)) != 0;
+    if (!waiters.readers.empty() && ((events & EPOLLIN) || failed) && perform(waiters.readers.head, false)) {
+        deliver(waiters.readers.pop());
+        ++delivered;
+    }
+    if (!waiters.writers.empty() && ((events & EPOLLOUT) || failed) && perform(waiters.writers.head, false)) {
+        deliver(waiters.writers.pop());
+        ++delivered;
+    }
+    readiness->watch(waitFd, fd, waiters);
+    if (waiters.registered == 0) {
+        readiness->fds.erase(it);
+    }
+#else
+    (void)fd;
+    (void)events;
+#endif
+    return delivered;
+}
+
+size_t EventLoop::reapRing() {
+    size_t delivered = 0;
+#ifdef __linux__
+    if (!ring) {
+        return 0;
+    }
+    unsigned head = *ring->cqHead;
+    while (head != __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE)) {
+        const io_uring_cqe& cqe = ring->cqes[head & ring->cqMask];
+        auto* op = reinterpret_cast<IoOp*>(static_cast<uintptr_t>(cqe.user_data));
+        op->result = cqe.res;
+        // Release the entry first: the operation's task may start more
+        __atomic_store_n(ring->cqHead, ++head, __ATOMIC_RELEASE);
+        deliver(op);
+        ++delivered;
+    }
+#endif
+    return delivered;
+}
+
+size_t EventLoop::expireTimers() {
+    IoOp* fired = nullptr;
+    IoOp** tail = &fired;
+    {
+        std::lock_guard<std::mutex> guard(timerLock);
+        timers.advance(nowTick(), [&](TimerNode* timer) {
+            auto* op = static_cast<IoOp*>(timer);
+            op->nextOp = nullptr;
+            *tail = op;
+            tail = &op->nextOp;
+        });
+    }
+    size_t delivered = 0;
+    while (fired) {
+        IoOp* next = fired->nextOp;
+        fired->result = 0;
+        deliver(fired);
+        ++delivered;
+        fired = next;
+    }
+    return delivered;
+}
+
+int EventLoop::waitTimeout(int timeoutMs) {
+    uint64_t next;
+    {
+        std::lock_guard<std::mutex> guard(timerLock);
+        next = timers.nextEvent();
+    }
+    if (next == TimingWheel::kNever) {
+        return timeoutMs;
+    }
+    uint64_t now = nowTick();
+    uint64_t untilTimer = next > now ? next - now : 0;
+    if (timeoutMs >= 0 && static_cast<uint64_t>(timeoutMs) < untilTimer) {
+        return timeoutMs;
+    }
+    return static_cast<int>(std::min<uint64_t>(untilTimer, INT32_MAX));
+}
+
+size_t EventLoop::waitForEvents(int timeoutMs) {
+    waiting.store(true, std::memory_order_seq_cst);
+    if (timeoutMs != 0) {
+        // Operations started since the poller last looked
+        bool started;
+        {
+            std::lock_guard<std::mutex> guard(startLock);
+            started = startHead != nullptr;
+        }
+        if (ring) {
+            std::lock_guard<std::mutex> guard(ring->lock);
+            started |= ring->unsubmitted != 0;
+        }
+        if (started) {
+            timeoutMs = 0;
+        }
+    }
+    size_t delivered = 0;
+#ifdef __linux__
+    epoll_event events[64];
+    int count = epoll_wait(waitFd, events, 64, timeoutMs);
+    waiting.store(false, std::memory_order_relaxed);
+    for (int i = 0; i < count; ++i) {
+        int fd = events[i].data.fd;
+        if (fd == wakeFds[0]) {
+            drainWake();
+        } else if (readiness) {
+            delivered += runReady(fd, events[i].events);
+        }
+        // The ring's completions are reaped by the caller
+    }
+#else
+    pollfd wakeFd{wakeFds[0], POLLIN, 0};
+    if (::poll(&wakeFd, 1, timeoutMs) > 0) {
+        drainWake();
+    }
+    waiting.store(false, std::memory_order_relaxed);
+#endif
+    return delivered;
+}
+
+void EventLoop::wake() {
+    // One byte per wait is enough, however many operations start meanwhile
+    if (!wakePending.exchange(true, std::memory_order_acq_rel)) {
+        char byte = 1;
+        ssize_t written = ::write(wakeFds[1], &byte, 1);
+        (void)written;
+    }
+}
+
+void EventLoop::drainWake() {
+    wakePending.store(false, std::memory_order_release);
+    char bytes[64];
+    while (::read(wakeFds[0], bytes, sizeof(bytes)) > 0) {
+    }
+}
+
+void EventLoop::deliver(IoOp* op) {
+    if (scheduler) {
+        // From a worker this lands on its own deque
+        scheduler->spawn(op);
+    } else {
+        op->invoke(op);
+    }
+    inFlight.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+size_t EventLoop::collect() {
+    size_t delivered = startQueued();
+    flush();
+    delivered += reapRing();
+    return delivered + expireTimers();
+}
+
+size_t EventLoop::poll(int timeoutMs) {
+    std::unique_lock<std::mutex> guard(pollLock, std::try_to_lock);
+    if (!guard.owns_lock()) {
+        return 0;
+    }
+    size_t delivered = collect();
+    // The epoll backend learns about readiness only from the wait
+    if (readiness || (delivered == 0 && timeoutMs != 0)) {
+        delivered += waitForEvents(delivered == 0 ? waitTimeout(timeoutMs) : 0);
+        delivered += collect();
+    }
+    return delivered;
+}
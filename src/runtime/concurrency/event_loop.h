@@ -0,0 +1,159 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include "runtime/concurrency/scheduler.h"
+#include "runtime/concurrency/timing_wheel.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct sockaddr;
+
+// An asynchronous operation: what `file.readAll()`, `Run.sleep` and
+// `db.connect()` suspend on. Callers embed it in (or derive from) the state
+// of the suspended task, start it through one of EventLoop's functions and
+// get it back through its Task once it completes. The operation's buffer
+// and address must stay valid until then.
+struct IoOp : Task, TimerNode {
+    enum class Kind : uint8_t { Read, Write, ReadFixed, Connect, Sleep };
+
+    Kind kind = Kind::Read;
+    int fd = -1;
+    void* buffer = nullptr;
+    uint32_t length = 0;
+    uint32_t bufferIndex = 0;         // ReadFixed: registered buffer to read into
+    int64_t offset = -1;              // File offset; -1 for the current position (pipes, sockets)
+    const sockaddr* address = nullptr; // Connect
+    uint32_t addressLength = 0;
+    int64_t result = 0;               // Bytes transferred (0 for Connect and Sleep), or -errno
+    IoOp* nextOp = nullptr;           // Queue link inside the loop
+
+    explicit IoOp(void (*fn)(Task*)) : Task(fn) {}
+};
+
+// The runtime's event loop.
+//
+// On Linux it drives io_uring: operations are written to the submission
+// ring as they are started, and the whole batch reaches the kernel in one
+// io_uring_enter when the loop next polls (or when the ring fills up), so
+// a busy loop pays a syscall per batch rather than per operation. Reads
+// into registered buffers (registerBuffers) skip the per-operation page
+// pinning. Where io_uring is unavailable or lacks an operation, an epoll
+// backend waits for readiness and then issues the plain syscall; regular
+// files, which are always ready, are read and written directly. Other
+// platforms get the same behavior without the readiness wait.
+//
+// Timers live on a hierarchical timing wheel with millisecond ticks, so
+// any number of pending sleeps costs nothing per poll.
+//
+// Operations may be started from any thread; one thread polls at a time.
+// A completed operation is spawned on the attached scheduler, from the
+// polling thread, so when a worker polls, the task it completes resumes
+// on that same worker's deque (Scheduler::Options::events does this).
+// Without a scheduler the operation's task runs inside poll().
+class EventLoop {
+public:
+    enum class Backend : uint8_t { IoUring, Epoll, Blocking };
+
+    struct Options {
+        uint32_t entries = 256;   // Submission ring size (io_uring)
+        bool allowIoUring = true; // False forces the fallback
+    };
+
+    EventLoop() : EventLoop(Options()) {}
+    explicit EventLoop(Options options);
+    // Operations still pending are abandoned
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    Backend backend() const { return kind; }
+
+    // Scheduler that completed operations are spawned on; null to run them
+    // inside poll()
+    void attach(Scheduler* target) { scheduler = target; }
+
+    // Starting operations. Offsets of -1 use the file position, which is
+    // what pipes and sockets need.
+    void read(IoOp* op, int fd, void* buffer, uint32_t length, int64_t offset = -1);
+    void write(IoOp* op, int fd, const void* buffer, uint32_t length, int64_t offset = -1);
+    void readFixed(IoOp* op, int fd, uint32_t bufferIndex, uint32_t length, int64_t offset = 0);
+    void connect(IoOp* op, int fd, const sockaddr* address, uint32_t addressLength);
+    void sleep(IoOp* op, uint64_t milliseconds);
+
+    // Registers buffers for readFixed, replacing any registered before
+    // (with none pending). Returns 0 or -errno.
+    int registerBuffers(std::vector<std::pair<void*, size_t>> buffers);
+    void* registeredBuffer(uint32_t index) const { return registered[index].first; }
+
+    // Hands the operations started so far to the kernel without waiting
+    void flush();
+
+    // Delivers completed operations and expired timers, waiting up to
+    // `timeoutMs` (-1: until there is one, or wake()) when there are none.
+    // Returns the number delivered; 0 as well when another thread is
+    // polling.
+    size_t poll(int timeoutMs);
+
+    // Interrupts a poll() that is waiting. Callable from any thread.
+    void wake();
+
+    // Operations started and not yet delivered
+    size_t pending() const { return inFlight.load(std::memory_order_acquire); }
+
+private:
+    struct Ring;
+    struct Readiness;
+
+    Backend kind;
+    Scheduler* scheduler = nullptr;
+    std::unique_ptr<Ring> ring;           // IoUring
+    std::unique_ptr<Readiness> readiness; // Epoll
+    int waitFd = -1;                      // epoll set the poller blocks on (Linux)
+    int wakeFds[2] = {-1, -1};            // Self-pipe poked by wake()
+    std::vector<std::pair<void*, size_t>> registered;
+
+    std::mutex pollLock;
+    std::atomic<size_t> inFlight{0};
+    std::atomic<bool> waiting{false};     // The poller is blocked
+    std::atomic<bool> wakePending{false}; // A wake byte is in the pipe
+
+    // Operations started for the fallback backends, taken by the poller
+    std::mutex startLock;
+    IoOp* startHead = nullptr;
+    IoOp* startTail = nullptr;
+
+    std::mutex timerLock;
+    TimingWheel timers;
+    uint64_t epochMs; // steady_clock time of tick 0
+
+    void start(IoOp* op);
+    void submitToRing(IoOp* op);
+    void queueStart(IoOp* op);
+    // Fallback backends: starts queued operations, running those that need
+    // not wait for readiness
+    size_t startQueued();
+    // Starts one; true when it completed right away rather than waiting
+    // for its fd
+    bool begin(IoOp* op);
+    // Epoll backend: runs operations whose fd became ready
+    size_t runReady(int fd, uint32_t events);
+    // Issues the system call of `op`; false when it would block
+    bool perform(IoOp* op, bool mayBlock);
+    size_t reapRing();
+    size_t expireTimers();
+    // Everything deliverable without waiting
+    size_t collect();
+    // Waits for the next event; the timeout covers the next timer too
+    int waitTimeout(int timeoutMs);
+    size_t waitForEvents(int timeoutMs);
+    void drainWake();
+    void deliver(IoOp* op);
+    uint64_t nowTick() const;
+};
+
+#endif // EVENT_LOOP_H
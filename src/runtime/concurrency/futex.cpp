@@ -0,0 +1,71 @@
+#include "runtime/concurrency/futex.h"
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex words must be plain 32-bit integers");
+
+void futexWait(const std::atomic<uint32_t>& word, uint32_t expected) {
+    // Private futexes: the word is never shared between processes
+    syscall(SYS_futex, reinterpret_cast<const uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+void futexWaitFor(const std::atomic<uint32_t>& word, uint32_t expected, uint32_t timeoutMicros) {
+    // Relative for FUTEX_WAIT
+    timespec timeout{static_cast<time_t>(timeoutMicros / 1000000), static_cast<long>(timeoutMicros % 1000000) * 1000};
+    syscall(SYS_futex, reinterpret_cast<const uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, &timeout, nullptr, 0);
+}
+
+void futexWake(const std::atomic<uint32_t>& word, int count) {
+    syscall(SYS_futex, reinterpret_cast<const uint32_t*>(&word), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+#else
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+
+namespace {
+
+struct Bucket {
+    std::mutex mutex;
+    std::condition_variable changed;
+};
+
+Bucket& bucketFor(const void* address) {
+    static Bucket buckets[64];
+    return buckets[std::hash<const void*>()(address) % 64];
+}
+
+} // namespace
+
+void futexWait(const std::atomic<uint32_t>& word, uint32_t expected) {
+    Bucket& bucket = bucketFor(&word);
+    std::unique_lock<std::mutex> lock(bucket.mutex);
+    // Wakers take the same lock, so a change after this check is not missed
+    if (word.load() == expected) {
+        bucket.changed.wait(lock);
+    }
+}
+
+void futexWaitFor(const std::atomic<uint32_t>& word, uint32_t expected, uint32_t timeoutMicros) {
+    Bucket& bucket = bucketFor(&word);
+    std::unique_lock<std::mutex> lock(bucket.mutex);
+    if (word.load() == expected) {
+        bucket.changed.wait_for(lock, std::chrono::microseconds(timeoutMicros));
+    }
+}
+
+void futexWake(const std::atomic<uint32_t>& word, int) {
+    Bucket& bucket = bucketFor(&word);
+    std::lock_guard<std::mutex> lock(bucket.mutex);
+    // Waiters of other words may share the bucket; they wake up spuriously
+    bucket.changed.notify_all();
+}
+
+#endif
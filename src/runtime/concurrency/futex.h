@@ -0,0 +1,23 @@
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include <atomic>
+#include <cstdint>
+
+// Address-based waiting on a 32-bit atomic, the building block of the
+// runtime's blocking primitives. On Linux these are the futex system
+// calls, so a waiter costs no kernel object and a wake with nobody waiting
+// is a single syscall that touches no lock; elsewhere a small table of
+// mutex/condition variable pairs hashed by address stands in.
+
+// Blocks while `word` holds `expected`. May return spuriously, so callers
+// re-check their condition in a loop.
+void futexWait(const std::atomic<uint32_t>& word, uint32_t expected);
+
+// futexWait that also returns after about `timeoutMicros`
+void futexWaitFor(const std::atomic<uint32_t>& word, uint32_t expected, uint32_t timeoutMicros);
+
+// Wakes up to `count` threads blocked on `word`
+void futexWake(const std::atomic<uint32_t>& word, int count);
+
+#endif // FUTEX_H
@@ -0,0 +1,266 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "runtime/concurrency/scheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Data-parallel loops on the Scheduler: the engine behind `mapParallel` and
+// its forEach/filter/reduce siblings.
+//
+// The input is cut into blocks of `grain` consecutive elements; a block is
+// the unit of scheduling and of cancellation, and the per-element work
+// inside it is a plain inlined loop. Blocks are spread in one of two ways:
+//
+// - CPU-bound (no concurrency limit): lazy binary splitting. A task owning
+//   a range of blocks gives away the upper half of what it has left
+//   whenever its worker's deque is empty, then works through its own blocks
+//   in order. Idle workers steal the halves and split them the same way, so
+//   the range fans out to every core in a logarithmic number of steps, and
+//   a worker that is the only one busy hardly splits at all.
+// - I/O-bound (`concurrency` set): that many lanes, each taking the next
+//   block index from a shared counter until none is left. The lanes act as
+//   the permits of a semaphore without anyone ever blocking on one.
+//
+// Results go straight to their final position (map) or to a per-block slot
+// combined in input order at the end (filter, reduce), so nothing is
+// serialized on a lock. When an element throws, the remaining blocks are
+// skipped and the first exception is rethrown to the caller once every
+// task has finished.
+//
+// Called from one of the scheduler's workers, the caller runs other tasks
+// while waiting; from any other thread it blocks.
+
+struct ParallelOptions {
+    size_t grain = 0;       // Elements per block; 0 picks one from the input size
+    size_t concurrency = 0; // Bodies running at once at most; 0 for no limit
+};
+
+namespace parallel_detail {
+
+// Blocks per worker for CPU-bound loops: enough to even out uneven
+// elements, few enough that per-block costs disappear
+constexpr size_t kBlocksPerWorker = 64;
+
+inline size_t chooseGrain(const Scheduler& scheduler, size_t count, const ParallelOptions& options) {
+    if (options.grain != 0) {
+        return options.grain;
+    }
+    if (options.concurrency != 0) {
+        return 1; // Each element is a request of its own
+    }
+    return std::max<size_t>(1, count / (scheduler.workerCount() * kBlocksPerWorker));
+}
+
+// Shared state of one parallel loop; lives on the caller's stack
+template <typename BlockFn>
+struct Loop {
+    Loop(Scheduler& s, BlockFn& fn, size_t blocks) : scheduler(s), blockFn(fn), blockCount(blocks) {}
+
+    Scheduler& scheduler;
+    BlockFn& blockFn;
+    size_t blockCount;
+    WaitGroup group;
+    std::atomic<size_t> nextBlock{0}; // Lanes only
+    std::atomic<bool> failed{false};
+    std::exception_ptr error; // Written by the first failure only
+
+    bool cancelled() const { return failed.load(std::memory_order_relaxed); }
+
+    void runBlock(size_t block) noexcept {
+        try {
+            blockFn(block);
+        } catch (...) {
+            if (!failed.exchange(true, std::memory_order_relaxed)) {
+                error = std::current_exception(); // Published by group.done()
+            }
+        }
+    }
+};
+
+template <typename BlockFn>
+struct RangeTask : Task {
+    RangeTask(Loop<BlockFn>& l, size_t b, size_t e) : Task(&run), loop(l), begin(b), end(e) {}
+
+    static void run(Task* task) noexcept {
+        auto* self = static_cast<RangeTask*>(task);
+        Loop<BlockFn>& loop = self->loop;
+        size_t begin = self->begin;
+        size_t end = self->end;
+        delete self;
+        while (begin < end && !loop.cancelled()) {
+            if (end - begin > 1 && loop.scheduler.localBacklog() == 0) {
+                size_t middle = begin + (end - begin) / 2;
+                loop.group.add();
+                loop.scheduler.spawn(static_cast<Task*>(new RangeTask(loop, middle, end)));
+                end = middle;
+                continue;
+            }
+            loop.runBlock(begin++);
+        }
+        loop.group.done();
+    }
+
+    Loop<BlockFn>& loop;
+    size_t begin;
+    size_t end;
+};
+
+template <typename BlockFn>
+struct LaneTask : Task {
+    explicit LaneTask(Loop<BlockFn>& l) : Task(&run), loop(l) {}
+
+    static void run(Task* task) noexcept {
+        auto* self = static_cast<LaneTask*>(task);
+        Loop<BlockFn>& loop = self->loop;
+        delete self;
+        while (!loop.cancelled()) {
+            size_t block = loop.nextBlock.fetch_add(1, std::memory_order_relaxed);
+            if (block >= loop.blockCount) {
+                break;
+            }
+            loop.runBlock(block);
+        }
+        loop.group.done();
+    }
+
+    Loop<BlockFn>& loop;
+};
+
+// Runs blockFn(b) for every b in [0, blockCount), at most `concurrency` at
+// a time when nonzero; rethrows the first exception
+template <typename BlockFn>
+void runBlocks(Scheduler& scheduler, size_t blockCount, size_t concurrency, BlockFn& blockFn) {
+    if (blockCount == 0) {
+        return;
+    }
+    Loop<BlockFn> loop(scheduler, blockFn, blockCount);
+    if (concurrency == 0) {
+        loop.group.add();
+        scheduler.spawn(static_cast<Task*>(new RangeTask<BlockFn>(loop, 0, blockCount)));
+    } else {
+        size_t lanes = std::min(concurrency, blockCount);
+        loop.group.add(static_cast<uint32_t>(lanes));
+        for (size_t i = 0; i < lanes; ++i) {
+            scheduler.spawn(static_cast<Task*>(new LaneTask<BlockFn>(loop)));
+        }
+    }
+    scheduler.wait(loop.group);
+    if (loop.error) {
+        std::rethrow_exception(loop.error);
+    }
+}
+
+} // namespace parallel_detail
+
+// body(i) for every i in [0, count)
+template <typename Fn>
+void parallelFor(Scheduler& scheduler, size_t count, Fn&& body, ParallelOptions options = ParallelOptions()) {
+    size_t grain = parallel_detail::chooseGrain(scheduler, count, options);
+    auto blockFn = [&](size_t block) {
+        size_t end = std::min(count, (block + 1) * grain);
+        for (size_t i = block * grain; i < end; ++i) {
+            body(i);
+        }
+    };
+    parallel_detail::runBlocks(scheduler, (count + grain - 1) / grain, options.concurrency, blockFn);
+}
+
+// fn(item) for every item
+template <typename T, typename Fn>
+void parallelForEach(Scheduler& scheduler, const std::vector<T>& items, Fn&& fn,
+                     ParallelOptions options = ParallelOptions()) {
+    parallelFor(scheduler, items.size(), [&](size_t i) { fn(items[i]); }, options);
+}
+
+// [fn(item) for every item], in input order. The result type must be
+// default constructible: each result is assigned into its final slot.
+template <typename T, typename Fn>
+auto parallelMap(Scheduler& scheduler, const std::vector<T>& items, Fn&& fn,
+                 ParallelOptions options = ParallelOptions()) {
+    using Result = std::decay_t<std::invoke_result_t<Fn&, const T&>>;
+    // Predicates collect into bytes rather than std::vector<bool>'s shared
+    // words, which blocks would write at once, and convert at the end
+    constexpr bool kPredicate = std::is_same<Result, bool>::value;
+    using Slot = std::conditional_t<kPredicate, unsigned char, Result>;
+    std::vector<Slot> results(items.size());
+    parallelFor(scheduler, items.size(), [&](size_t i) { results[i] = fn(items[i]); }, options);
+    if constexpr (kPredicate) {
+        return std::vector<bool>(results.begin(), results.end());
+    } else {
+        return results;
+    }
+}
+
+// The items for which pred(item) holds, in input order
+template <typename T, typename Pred>
+std::vector<T> parallelFilter(Scheduler& scheduler, const std::vector<T>& items, Pred&& pred,
+                              ParallelOptions options = ParallelOptions()) {
+    size_t count = items.size();
+    size_t grain = parallel_detail::chooseGrain(scheduler, count, options);
+    size_t blockCount = (count + grain - 1) / grain;
+
+    // Each block keeps its matches; their sizes give every block its place
+    // in the result, and a second pass copies the blocks there in parallel
+    std::vector<std::vector<T>> kept(blockCount);
+    auto select = [&](size_t block) {
+        size_t end = std::min(count, (block + 1) * grain);
+        for (size_t i = block * grain; i < end; ++i) {
+            if (pred(items[i])) {
+                kept[block].push_back(items[i]);
+            }
+        }
+    };
+    parallel_detail::runBlocks(scheduler, blockCount, options.concurrency, select);
+
+    std::vector<size_t> offsets(blockCount + 1, 0);
+    for (size_t block = 0; block < blockCount; ++block) {
+        offsets[block + 1] = offsets[block] + kept[block].size();
+    }
+    std::vector<T> results(offsets[blockCount]);
+    auto gather = [&](size_t block) {
+        std::move(kept[block].begin(), kept[block].end(), results.begin() + static_cast<std::ptrdiff_t>(offsets[block]));
+    };
+    parallel_detail::runBlocks(scheduler, blockCount, 0, gather);
+    return results;
+}
+
+// Folds the items in input order: each block computes
+// fold(...fold(identity, first), ...), and the block results are joined
+// left to right with combine. fold and combine must agree, and combine
+// must be associative with `identity` as its identity; neither needs to
+// be commutative.
+template <typename T, typename R, typename Fold, typename Combine>
+R parallelReduce(Scheduler& scheduler, const std::vector<T>& items, R identity, Fold&& fold, Combine&& combine,
+                 ParallelOptions options = ParallelOptions()) {
+    size_t count = items.size();
+    size_t grain = parallel_detail::chooseGrain(scheduler, count, options);
+    size_t blockCount = (count + grain - 1) / grain;
+    // Wrapped so that R = bool gets one object per block rather than
+    // std::vector<bool>'s shared words, which blocks would write at once
+    struct Partial {
+        R value;
+    };
+    std::vector<Partial> partial(blockCount, Partial{identity});
+    auto blockFn = [&](size_t block) {
+        size_t end = std::min(count, (block + 1) * grain);
+        R acc = identity;
+        for (size_t i = block * grain; i < end; ++i) {
+            acc = fold(std::move(acc), items[i]);
+        }
+        partial[block].value = std::move(acc);
+    };
+    parallel_detail::runBlocks(scheduler, blockCount, options.concurrency, blockFn);
+    R result = std::move(identity);
+    for (size_t block = 0; block < blockCount; ++block) {
+        result = combine(std::move(result), std::move(partial[block].value));
+    }
+    return result;
+}
+
+#endif // PARALLEL_H
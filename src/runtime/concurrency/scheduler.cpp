@@ -0,0 +1,293 @@
+#include "runtime/concurrency/scheduler.h"
+#include "runtime/concurrency/event_loop.h"
+#include <algorithm>
+
+namespace {
+
+constexpr int kStealRounds = 4;               // Passes over the victims before parking
+constexpr uint32_t kInjectionInterval = 61;   // Local tasks between injection-queue polls
+// Scheduler::wait on a worker with nothing to steal: failed search rounds
+// before sleeping on the group, and the range of the sleeps, which double.
+// The cap bounds how late a waiting worker notices new tasks, as spawns
+// only wake workers parked in the scheduler.
+constexpr uint32_t kWaitSearchRounds = 2;
+constexpr uint32_t kWaitMinSleepMicros = 50;
+constexpr uint32_t kWaitMaxSleepMicros = 1000;
+
+} // namespace
+
+struct Scheduler::Worker {
+    Worker(Scheduler& owner, unsigned i) : scheduler(owner), index(i), rng(0x9E3779B97F4A7C15ull * (i + 1)) {}
+
+    Scheduler& scheduler;
+    unsigned index;
+    WorkStealingDeque<Task*> deque;
+    std::thread thread;
+    uint64_t rng;      // xorshift state for picking victims
+    uint32_t tick = 0; // Tasks taken, for the injection-queue poll
+
+    // Written by the owner only; atomic so getStats can read them
+    std::atomic<uint64_t> tasksRun{0};
+    std::atomic<uint64_t> steals{0};
+    std::atomic<uint64_t> parks{0};
+
+    uint64_t nextRandom() {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        return rng;
+    }
+
+    static void bump(std::atomic<uint64_t>& counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void run(Task* task) {
+        bump(tasksRun);
+        task->invoke(task);
+    }
+};
+
+thread_local Scheduler::Worker* Scheduler::current = nullptr;
+
+Scheduler::Scheduler(Options options) : events(options.events) {
+    if (events) {
+        events->attach(this);
+    }
+    unsigned count = options.workers != 0 ? options.workers : std::max(1u, std::thread::hardware_concurrency());
+    workers.reserve(count);
+    for (unsigned i = 0; i < count; ++i) {
+        workers.push_back(std::make_unique<Worker>(*this, i));
+    }
+    // Only start once every deque exists: workers steal from each other
+    for (auto& worker : workers) {
+        Worker* w = worker.get();
+        w->thread = std::thread([this, w] { workerLoop(*w); });
+    }
+}
+
+Scheduler::~Scheduler() {
+    stopping.store(true, std::memory_order_seq_cst);
+    wakeEpoch.fetch_add(1, std::memory_order_seq_cst);
+    futexWake(wakeEpoch, INT32_MAX);
+    if (events) {
+        events->wake();
+    }
+    for (auto& worker : workers) {
+        worker->thread.join();
+    }
+    if (events) {
+        events->attach(nullptr);
+    }
+}
+
+void Scheduler::spawn(Task* task) {
+    Worker* worker = current;
+    if (worker && &worker->scheduler == this) {
+        worker->deque.push(task);
+    } else {
+        {
+            std::lock_guard<std::mutex> lock(injectionLock);
+            task->next = nullptr;
+            if (injectionTail) {
+                injectionTail->next = task;
+            } else {
+                injectionHead = task;
+            }
+            injectionTail = task;
+        }
+        injectionSize.fetch_add(1, std::memory_order_release);
+        injectedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    notify();
+}
+
+void Scheduler::notify() {
+    // Pairs with park(): either the parking worker sees the new task when
+    // it re-checks, or this sees it among the sleepers
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (searching.load(std::memory_order_relaxed) == 0 && sleepers.load(std::memory_order_relaxed) != 0) {
+        wakeOne();
+    }
+}
+
+void Scheduler::wakeOne() {
+    // A sleeper that has not reached futexWait yet sees the new epoch and
+    // does not block
+    wakeEpoch.fetch_add(1, std::memory_order_seq_cst);
+    futexWake(wakeEpoch, 1);
+    if (events && polling.load(std::memory_order_seq_cst)) {
+        events->wake();
+    }
+}
+
+void Scheduler::workerLoop(Worker& worker) {
+    current = &worker;
+    for (;;) {
+        Task* task = findLocalTask(worker);
+        if (!task) {
+            searching.fetch_add(1, std::memory_order_seq_cst);
+            task = stealTask(worker);
+            // The last searcher to find work passes the search on, since
+            // spawns skipped waking anyone while it was searching
+            if (searching.fetch_sub(1, std::memory_order_seq_cst) == 1 && task) {
+                notify();
+            }
+            if (!task) {
+                if (!park(worker)) {
+                    break;
+                }
+                continue;
+            }
+        }
+        worker.run(task);
+    }
+    current = nullptr;
+}
+
+Task* Scheduler::findLocalTask(Worker& worker) {
+    if (++worker.tick % kInjectionInterval == 0) {
+        pollEvents();
+        if (Task* task = popInjected()) {
+            return task;
+        }
+    }
+    if (Task* task = worker.deque.pop()) {
+        return task;
+    }
+    return popInjected();
+}
+
+Task* Scheduler::stealTask(Worker& worker) {
+    size_t count = workers.size();
+    for (int round = 0; round < kStealRounds; ++round) {
+        size_t start = static_cast<size_t>(worker.nextRandom() % count);
+        for (size_t i = 0; i < count; ++i) {
+            Worker& victim = *workers[(start + i) % count];
+            if (&victim == &worker) {
+                continue;
+            }
+            if (Task* task = victim.deque.steal()) {
+                Worker::bump(worker.steals);
+                return task;
+            }
+        }
+        if (Task* task = popInjected()) {
+            return task;
+        }
+        pollEvents();
+        if (Task* task = worker.deque.pop()) {
+            return task; // A completion reaped just now
+        }
+        std::this_thread::yield();
+    }
+    return nullptr;
+}
+
+Task* Scheduler::popInjected() {
+    if (injectionSize.load(std::memory_order_acquire) == 0) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(injectionLock);
+    Task* task = injectionHead;
+    if (!task) {
+        return nullptr;
+    }
+    injectionHead = task->next;
+    if (!injectionHead) {
+        injectionTail = nullptr;
+    }
+    injectionSize.fetch_sub(1, std::memory_order_relaxed);
+    return task;
+}
+
+bool Scheduler::hasVisibleWork() const {
+    if (injectionSize.load(std::memory_order_seq_cst) != 0) {
+        return true;
+    }
+    for (const auto& worker : workers) {
+        if (!worker->deque.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Scheduler::park(Worker& worker) {
+    uint32_t epoch = wakeEpoch.load(std::memory_order_seq_cst);
+    sleepers.fetch_add(1, std::memory_order_seq_cst);
+    bool keepRunning = true;
+    if (!hasVisibleWork()) {
+        if (stopping.load(std::memory_order_seq_cst) && (!events || events->pending() == 0)) {
+            keepRunning = false; // Drained: nothing is queued anywhere
+            // Others may be parked behind the last completion's poller
+            wakeEpoch.fetch_add(1, std::memory_order_seq_cst);
+            futexWake(wakeEpoch, INT32_MAX);
+        } else if (events && !polling.exchange(true, std::memory_order_seq_cst)) {
+            Worker::bump(worker.parks);
+            // Pairs with wakeOne(): either it sees this worker polling, or
+            // this sees the epoch it bumped and does not block
+            bool woken = wakeEpoch.load(std::memory_order_seq_cst) != epoch;
+            events->poll(woken ? 0 : -1);
+            polling.store(false, std::memory_order_seq_cst);
+        } else {
+            Worker::bump(worker.parks);
+            futexWait(wakeEpoch, epoch);
+        }
+    }
+    sleepers.fetch_sub(1, std::memory_order_seq_cst);
+    return keepRunning;
+}
+
+void Scheduler::pollEvents() {
+    if (events && events->pending() != 0 && !polling.load(std::memory_order_relaxed)) {
+        events->poll(0);
+    }
+}
+
+void Scheduler::wait(WaitGroup& group) {
+    Worker* worker = current;
+    if (!worker || &worker->scheduler != this) {
+        group.wait();
+        return;
+    }
+    uint32_t idleRounds = 0;
+    while (!group.finished()) {
+        Task* task = findLocalTask(*worker);
+        if (!task) {
+            task = stealTask(*worker);
+        }
+        if (task) {
+            worker->run(task);
+            idleRounds = 0;
+            continue;
+        }
+        // The group waits on tasks running elsewhere
+        if (++idleRounds > kWaitSearchRounds) {
+            uint32_t doublings = std::min<uint32_t>(idleRounds - kWaitSearchRounds - 1, 5);
+            Worker::bump(worker->parks);
+            group.waitFor(std::min(kWaitMinSleepMicros << doublings, kWaitMaxSleepMicros));
+        }
+    }
+}
+
+int Scheduler::currentWorker() const {
+    Worker* worker = current;
+    return worker && &worker->scheduler == this ? static_cast<int>(worker->index) : -1;
+}
+
+size_t Scheduler::localBacklog() const {
+    Worker* worker = current;
+    return worker && &worker->scheduler == this ? worker->deque.size() : 0;
+}
+
+SchedulerStats Scheduler::getStats() const {
+    SchedulerStats stats;
+    for (const auto& worker : workers) {
+        stats.tasksRun += worker->tasksRun.load(std::memory_order_relaxed);
+        stats.steals += worker->steals.load(std::memory_order_relaxed);
+        stats.parks += worker->parks.load(std::memory_order_relaxed);
+    }
+    stats.injected = injectedCount.load(std::memory_order_relaxed);
+    return stats;
+}
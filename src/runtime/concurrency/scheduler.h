@@ -0,0 +1,183 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "runtime/concurrency/futex.h"
+#include "runtime/concurrency/work_stealing_deque.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class EventLoop;
+
+// A unit of work for the Scheduler. `invoke` runs the task and disposes of
+// it; the scheduler never touches a task after calling it. Tasks are
+// intrusive so spawning needs a single allocation (none for callers that
+// embed Task in their own objects).
+struct Task {
+    void (*invoke)(Task*);
+    Task* next = nullptr; // Link in the injection queue
+
+    explicit Task(void (*fn)(Task*)) : invoke(fn) {}
+};
+
+// Counts outstanding tasks; wait() returns once as many done() calls as
+// add() increments have happened. Waiting blocks on a futex.
+class WaitGroup {
+public:
+    void add(uint32_t n = 1) { count.fetch_add(n, std::memory_order_relaxed); }
+    void done() {
+        if (count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            futexWake(count, INT32_MAX);
+        }
+    }
+    bool finished() const { return count.load(std::memory_order_acquire) == 0; }
+    void wait() const {
+        for (uint32_t n; (n = count.load(std::memory_order_acquire)) != 0;) {
+            futexWait(count, n);
+        }
+    }
+    // Blocks until finished or for about `timeoutMicros`, whichever comes
+    // first (or spuriously); returns finished()
+    bool waitFor(uint32_t timeoutMicros) const {
+        uint32_t n = count.load(std::memory_order_acquire);
+        if (n != 0) {
+            futexWaitFor(count, n, timeoutMicros);
+        }
+        return finished();
+    }
+
+private:
+    std::atomic<uint32_t> count{0};
+};
+
+// Counters summed over the workers
+struct SchedulerStats {
+    uint64_t tasksRun = 0;
+    uint64_t steals = 0;   // Tasks taken from another worker's deque
+    uint64_t injected = 0; // Tasks spawned from outside the workers
+    uint64_t parks = 0;    // Times a worker went to sleep
+};
+
+// M:N scheduler behind `run`: many short tasks multiplexed onto one worker
+// thread per core.
+//
+// Each worker owns a Chase-Lev deque. Tasks spawned by a task go to its
+// worker's deque without any shared write beyond the deque itself, and the
+// worker runs its own tasks newest first. Idle workers steal the oldest
+// task of a randomly chosen victim. Tasks spawned from other threads go to
+// a global injection queue, which workers also poll every so often so a
+// busy worker cannot starve it.
+//
+// A worker that finds nothing after a few rounds of stealing parks on a
+// futex. Spawning wakes a parked worker only when no worker is already
+// searching for work; a searcher that finds some wakes the next one, so
+// wakeups ripple out as fast as work appears without every spawn paying
+// for a syscall.
+//
+// With an event loop, one parking worker at a time waits in the loop's
+// poll() instead of on the futex, and busy workers reap completions
+// between tasks. Either way a completed operation is spawned by the worker
+// that reaped it, so the task resumes there. Spawns interrupt the polling
+// worker like a futex wake, and the destructor also waits for operations
+// still pending.
+class Scheduler {
+public:
+    struct Options {
+        unsigned workers = 0;        // 0: one per hardware thread
+        EventLoop* events = nullptr; // Loop whose completions the workers deliver
+    };
+
+    Scheduler() : Scheduler(Options()) {}
+    explicit Scheduler(Options options);
+    // Runs every task spawned so far, and those they spawn, to completion;
+    // then stops the workers. No spawn may race with the destructor.
+    ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    unsigned workerCount() const { return static_cast<unsigned>(workers.size()); }
+
+    // Queues a task to run on some worker. Callable from any thread,
+    // including from inside tasks.
+    void spawn(Task* task);
+
+    // Queues `fn()`. Tasks must not throw: an escaping exception terminates
+    // the program, as it would on a thread.
+    template <typename Fn, typename = std::enable_if_t<!std::is_convertible<Fn, Task*>::value>>
+    void spawn(Fn&& fn) {
+        spawn(static_cast<Task*>(new FunctionTask<std::decay_t<Fn>>(std::forward<Fn>(fn))));
+    }
+
+    // Waits for `group`. On a worker of this scheduler it runs other tasks
+    // meanwhile instead of blocking the worker; when there are none to
+    // take, it sleeps on the group in growing spells, stealing in between.
+    void wait(WaitGroup& group);
+
+    // Index of the calling thread among this scheduler's workers, or -1
+    int currentWorker() const;
+
+    // Tasks waiting in the calling worker's own deque (0 off the workers).
+    // Splitters hand out more work only while this is empty, i.e. once
+    // thieves have taken what was there.
+    size_t localBacklog() const;
+
+    SchedulerStats getStats() const;
+
+private:
+    template <typename Fn>
+    struct FunctionTask : Task {
+        template <typename F>
+        explicit FunctionTask(F&& f) : Task(&run), fn(std::forward<F>(f)) {}
+
+        static void run(Task* task) noexcept {
+            auto* self = static_cast<FunctionTask*>(task);
+            self->fn();
+            delete self;
+        }
+
+        Fn fn;
+    };
+
+    struct Worker;
+
+    static thread_local Worker* current; // Worker run by the calling thread, of any scheduler
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    // Injection queue: FIFO through Task::next
+    std::mutex injectionLock;
+    Task* injectionHead = nullptr;
+    Task* injectionTail = nullptr;
+    std::atomic<size_t> injectionSize{0}; // Lets workers skip the lock when empty
+
+    alignas(64) std::atomic<uint32_t> searching{0}; // Workers looking for work
+    std::atomic<uint32_t> sleepers{0};              // Workers parked or about to park
+    std::atomic<uint32_t> wakeEpoch{0};             // Futex word the sleepers wait on
+    std::atomic<bool> stopping{false};
+    EventLoop* events = nullptr;
+    std::atomic<bool> polling{false}; // A parked worker waits in events->poll()
+    std::atomic<uint64_t> injectedCount{0};
+
+    void workerLoop(Worker& worker);
+    Task* findLocalTask(Worker& worker);
+    Task* stealTask(Worker& worker);
+    Task* popInjected();
+    bool hasVisibleWork() const;
+    // Parks the worker unless work shows up; returns false when the
+    // scheduler is stopping and no work is left
+    bool park(Worker& worker);
+    // Delivers I/O completions without waiting, unless a worker is polling
+    void pollEvents();
+    // Wakes a parked worker if nobody is searching
+    void notify();
+    void wakeOne();
+};
+
+#endif // SCHEDULER_H
@@ -0,0 +1,99 @@
+#include "runtime/concurrency/timing_wheel.h"
+#include <algorithm>
+
+TimingWheel::TimingWheel(uint64_t start) : current(start) {}
+
+void TimingWheel::append(List& list, TimerNode* timer) {
+    timer->prev = list.head.prev;
+    timer->next = &list.head;
+    list.head.prev->next = timer;
+    list.head.prev = timer;
+}
+
+void TimingWheel::unlink(TimerNode* timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->prev = timer->next = nullptr;
+}
+
+TimerNode* TimingWheel::takeList(List& list) {
+    if (list.empty()) {
+        return nullptr;
+    }
+    TimerNode* first = list.head.next;
+    first->prev = nullptr;
+    list.head.prev->next = nullptr;
+    list.head.prev = list.head.next = &list.head;
+    return first;
+}
+
+void TimingWheel::schedule(TimerNode* timer, uint64_t deadline) {
+    timer->deadline = deadline;
+    ++count;
+    place(timer);
+}
+
+void TimingWheel::cancel(TimerNode* timer) {
+    if (timer->prev) {
+        unlink(timer);
+        --count;
+    }
+}
+
+void TimingWheel::place(TimerNode* timer) {
+    uint64_t deadline = timer->deadline;
+    if (deadline <= current) {
+        append(due, timer);
+        return;
+    }
+    // The lowest level whose slots above it agree with the current tick
+    for (int level = 0; level < kLevels; ++level) {
+        int above = kSlotBits * (level + 1);
+        if ((deadline >> above) == (current >> above)) {
+            append(slots[level][(deadline >> (kSlotBits * level)) & (kSlots - 1)], timer);
+            return;
+        }
+    }
+    append(overflow, timer);
+}
+
+void TimingWheel::cascade() {
+    // Levels whose slot the new tick just entered: level l when its low
+    // kSlotBits*l bits are zero, and the overflow list past the top level
+    int entered = 0;
+    while (entered < kLevels && (current & ((uint64_t(1) << (kSlotBits * (entered + 1))) - 1)) == 0) {
+        ++entered;
+    }
+    // Highest first, so timers can fall through several levels at once
+    for (int level = entered; level >= 1; --level) {
+        List& list = level == kLevels ? overflow : slots[level][(current >> (kSlotBits * level)) & (kSlots - 1)];
+        for (TimerNode* timer = takeList(list); timer;) {
+            TimerNode* next = timer->next;
+            place(timer);
+            timer = next;
+        }
+    }
+}
+
+uint64_t TimingWheel::nextEvent() const {
+    if (!due.empty()) {
+        return current;
+    }
+    uint64_t next = kNever;
+    for (int level = 0; level < kLevels; ++level) {
+        int shift = kSlotBits * level;
+        uint64_t base = current >> shift;
+        // Pending slots of a level lie after the current one in its block
+        for (uint64_t slot = (base & (kSlots - 1)) + 1; slot < kSlots; ++slot) {
+            if (!slots[level][slot].empty()) {
+                next = std::min(next, ((base & ~uint64_t(kSlots - 1)) + slot) << shift);
+                break;
+            }
+        }
+    }
+    if (!overflow.empty()) {
+        int top = kSlotBits * kLevels;
+        next = std::min(next, ((current >> top) + 1) << top);
+    }
+    return next;
+}
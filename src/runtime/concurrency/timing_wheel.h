@@ -0,0 +1,108 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+
+// A timer in a TimingWheel; embedded in the object that waits for it
+struct TimerNode {
+    uint64_t deadline = 0; // Tick at which the timer fires
+    TimerNode* prev = nullptr;
+    TimerNode* next = nullptr;
+};
+
+// Hierarchical timing wheel: kLevels wheels of kSlots slots each, where a
+// slot of level l spans kSlots^l ticks. A timer goes into the lowest level
+// whose slot range still tells it apart from the current tick, so starting,
+// cancelling and expiring a timer are O(1), however many are pending.
+// When the current tick enters a slot of a higher level, that slot's timers
+// cascade down to the levels below; a timer moves at most kLevels times.
+// Advancing jumps straight over ticks with nothing to do, so a loop that
+// slept for long does not walk every millisecond it missed.
+// Timers too far out for the top level wait in an overflow list that is
+// redistributed once per top-level revolution.
+//
+// The wheel does not lock; the event loop guards it.
+class TimingWheel {
+public:
+    static constexpr int kLevels = 4;
+    static constexpr int kSlotBits = 6;
+    static constexpr uint32_t kSlots = 1u << kSlotBits;
+    static constexpr uint64_t kNever = ~uint64_t(0);
+
+    explicit TimingWheel(uint64_t start = 0);
+
+    TimingWheel(const TimingWheel&) = delete;
+    TimingWheel& operator=(const TimingWheel&) = delete;
+
+    uint64_t now() const { return current; }
+    size_t size() const { return count; }
+
+    // Starts `timer` to fire at tick `deadline`. Deadlines that are not in
+    // the future fire on the next advance().
+    void schedule(TimerNode* timer, uint64_t deadline);
+
+    // Stops a pending timer
+    void cancel(TimerNode* timer);
+
+    // Moves the current tick forward to `to`, calling fire(TimerNode*) for
+    // each timer that expires, tick by tick. fire() may schedule timers,
+    // but not cancel them.
+    template <typename Fire>
+    void advance(uint64_t to, Fire&& fire) {
+        fireList(takeList(due), fire);
+        while (current < to) {
+            // Ticks with nothing to cascade or fire are skipped
+            uint64_t next = nextEvent();
+            if (next <= current) {
+                fireList(takeList(due), fire); // Scheduled by fire() meanwhile
+                continue;
+            }
+            if (next > to) {
+                current = to;
+                break;
+            }
+            current = next;
+            cascade();
+            fireList(takeList(slots[0][current & (kSlots - 1)]), fire);
+        }
+    }
+
+    // First tick at which advance() has work to do: a timer expiring or a
+    // slot cascading (never later than the earliest deadline), or kNever
+    uint64_t nextEvent() const;
+
+private:
+    // Circular doubly linked lists with a sentinel head
+    struct List {
+        TimerNode head;
+        List() { head.prev = head.next = &head; }
+        bool empty() const { return head.next == &head; }
+    };
+
+    uint64_t current;
+    size_t count = 0;
+    List slots[kLevels][kSlots];
+    List overflow; // Beyond the top level
+    List due;      // Deadline already reached when scheduled
+
+    static void append(List& list, TimerNode* timer);
+    static void unlink(TimerNode* timer);
+    // Moves the timers of `list` into a detached chain, returned by head
+    TimerNode* takeList(List& list);
+    void place(TimerNode* timer);
+    void cascade();
+
+    template <typename Fire>
+    void fireList(TimerNode* timer, Fire& fire) {
+        while (timer) {
+            TimerNode* next = timer->next;
+            timer->prev = timer->next = nullptr;
+            --count;
+            fire(timer);
+            timer = next;
+        }
+    }
+};
+
+#endif // TIMING_WHEEL_H
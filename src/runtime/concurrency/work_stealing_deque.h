@@ -0,0 +1,130 @@
+#ifndef WORK_STEALING_DEQUE_H
+#define WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Chase-Lev work-stealing deque of pointers (with the memory orderings of
+// Lê et al., "Correct and Efficient Work-Stealing for Weak Memory Models").
+//
+// One owner thread pushes and pops at the bottom, LIFO, which keeps its
+// cache warm; any other thread may steal from the top, FIFO, taking the
+// oldest (usually largest) piece of work. push and pop cost a few plain
+// loads and stores and only contend with thieves over the last element;
+// steal is one compare-and-swap.
+//
+// The ring buffer doubles when full. Thieves may still be reading the old
+// one, so replaced buffers are kept until the deque is destroyed; they
+// total less than the final buffer.
+template <typename T>
+class WorkStealingDeque {
+    static_assert(std::is_pointer<T>::value, "WorkStealingDeque holds pointers");
+
+public:
+    explicit WorkStealingDeque(size_t capacity = 256) : top(0), bottom(0) {
+        size_t rounded = 1;
+        while (rounded < capacity) {
+            rounded <<= 1;
+        }
+        buffers.push_back(std::make_unique<Buffer>(rounded));
+        buffer.store(buffers.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // Owner only
+    void push(T item) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        Buffer* a = buffer.load(std::memory_order_relaxed);
+        if (b - t > static_cast<int64_t>(a->mask)) {
+            a = grow(a, t, b);
+        }
+        a->put(b, item);
+        // A release store rather than the paper's release fence: the same
+        // code on x86, and visible to thread sanitizers
+        bottom.store(b + 1, std::memory_order_release);
+    }
+
+    // Owner only; returns the newest item, or nullptr when empty
+    T pop() {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Buffer* a = buffer.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        T item = a->get(b);
+        if (t == b) {
+            // Last item: race the thieves for it
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                item = nullptr;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // Any thread; returns the oldest item, or nullptr when the deque is
+    // empty or another thread took the item first
+    T steal() {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+        Buffer* a = buffer.load(std::memory_order_acquire);
+        T item = a->get(t);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
+
+    // Approximate when other threads are pushing or stealing
+    bool empty() const {
+        return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+    }
+    size_t size() const {
+        int64_t n = bottom.load(std::memory_order_relaxed) - top.load(std::memory_order_relaxed);
+        return n > 0 ? static_cast<size_t>(n) : 0;
+    }
+
+private:
+    struct Buffer {
+        explicit Buffer(size_t capacity) : mask(capacity - 1), slots(new std::atomic<T>[capacity]) {}
+
+        T get(int64_t index) const { return slots[static_cast<size_t>(index) & mask].load(std::memory_order_relaxed); }
+        void put(int64_t index, T item) { slots[static_cast<size_t>(index) & mask].store(item, std::memory_order_relaxed); }
+
+        size_t mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+    };
+
+    Buffer* grow(Buffer* old, int64_t t, int64_t b) {
+        buffers.push_back(std::make_unique<Buffer>(2 * (old->mask + 1)));
+        Buffer* grown = buffers.back().get();
+        for (int64_t i = t; i < b; ++i) {
+            grown->put(i, old->get(i));
+        }
+        buffer.store(grown, std::memory_order_release);
+        return grown;
+    }
+
+    // Thieves hammer `top`; keep it off the owner's line
+    alignas(64) std::atomic<int64_t> top;
+    alignas(64) std::atomic<int64_t> bottom;
+    std::atomic<Buffer*> buffer;
+    std::vector<std::unique_ptr<Buffer>> buffers; // Current last; owner only
+};
+
+#endif // WORK_STEALING_DEQUE_H
@@ -0,0 +1,24 @@
+#include "runtime/memory/array_buffer.h"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+ArrayBuffer::ArrayBuffer(size_t byteLength) : bytes(nullptr), length(byteLength) {
+    // aligned_alloc wants a multiple of the alignment (and a non-zero size)
+    size_t padded = (byteLength + kAlignment - 1) & ~(kAlignment - 1);
+    if (padded < byteLength) {
+        throw std::bad_alloc();
+    }
+    if (padded == 0) {
+        padded = kAlignment;
+    }
+    bytes = static_cast<uint8_t*>(std::aligned_alloc(kAlignment, padded));
+    if (!bytes) {
+        throw std::bad_alloc();
+    }
+    std::memset(bytes, 0, padded);
+}
+
+ArrayBuffer::~ArrayBuffer() {
+    std::free(bytes);
+}
@@ -0,0 +1,34 @@
+#ifndef ARRAY_BUFFER_H
+#define ARRAY_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Backing store of an ArrayBuffer and the typed arrays viewing it: a block
+// of zero-initialized bytes owned by the buffer.
+//
+// The block starts on a 64-byte boundary, so whole cache lines and vector
+// registers line up with the start of the data and the typed-array kernels
+// never split a load across two lines, and it is padded to a multiple of 64
+// bytes.
+class ArrayBuffer {
+public:
+    static constexpr size_t kAlignment = 64;
+
+    // Throws std::bad_alloc when the system is out of memory
+    explicit ArrayBuffer(size_t byteLength);
+    ~ArrayBuffer();
+
+    ArrayBuffer(const ArrayBuffer&) = delete;
+    ArrayBuffer& operator=(const ArrayBuffer&) = delete;
+
+    uint8_t* data() { return bytes; }
+    const uint8_t* data() const { return bytes; }
+    size_t byteLength() const { return length; }
+
+private:
+    uint8_t* bytes;
+    size_t length;
+};
+
+#endif // ARRAY_BUFFER_H
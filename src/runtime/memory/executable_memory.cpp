@@ -0,0 +1,39 @@
+#include "runtime/memory/executable_memory.h"
+#include <cstring>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+
+ExecutableMemory::~ExecutableMemory() {
+    if (base) {
+        munmap(base, length);
+    }
+}
+
+bool ExecutableMemory::install(const std::vector<uint8_t>& code) {
+    size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t bytes = (code.size() + pageSize - 1) / pageSize * pageSize;
+    void* mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    std::memcpy(mapping, code.data(), code.size());
+    if (mprotect(mapping, bytes, PROT_READ | PROT_EXEC) != 0) {
+        munmap(mapping, bytes);
+        return false;
+    }
+    base = mapping;
+    length = bytes;
+    return true;
+}
+
+#else
+
+ExecutableMemory::~ExecutableMemory() = default;
+
+bool ExecutableMemory::install(const std::vector<uint8_t>&) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef EXECUTABLE_MEMORY_H
+#define EXECUTABLE_MEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A block of mmap'd memory holding generated machine code.
+// Code is copied in while the mapping is writable, then the mapping is
+// flipped to read+execute, so memory is never writable and executable at
+// the same time (W^X).
+class ExecutableMemory {
+public:
+    ExecutableMemory() = default;
+    ~ExecutableMemory();
+
+    ExecutableMemory(const ExecutableMemory&) = delete;
+    ExecutableMemory& operator=(const ExecutableMemory&) = delete;
+
+    // Maps memory, copies `code` into it and makes it executable.
+    // Returns false when the platform refuses executable mappings.
+    bool install(const std::vector<uint8_t>& code);
+
+    const void* data() const { return base; }
+    size_t size() const { return length; }
+
+private:
+    void* base = nullptr;
+    size_t length = 0;
+};
+
+#endif // EXECUTABLE_MEMORY_H
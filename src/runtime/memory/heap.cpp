@@ -0,0 +1,873 @@
+#include "runtime/memory/heap.h"
+#include "runtime/concurrency/parallel.h"
+#include "runtime/concurrency/work_stealing_deque.h"
+#include "runtime/vm/class_layout.h"
+#include "runtime/vm/function_proto.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+
+Heap::Heap(size_t nurserySize)
+    : nursery(new char[nurserySize]),
+      nurseryStart(nursery.get()),
+      nurseryTop(nursery.get()),
+      nurseryLimit(nursery.get() + nurserySize),
+      nurseryEnd(nursery.get() + nurserySize),
+      currentChunk(nullptr),
+      roots(nullptr),
+      workers(nullptr),
+      rootedList(nullptr),
+      requested(0),
+      marking(0),
+      pending(false),
+      nurseryExhausted(false),
+      majorRequested(false),
+      suspendDepth(0),
+      phase(GcPhase::Idle),
+      allocated(0),
+      oldBytes(0),
+      majorThreshold(kMinMajorThreshold) {}
+
+Heap::~Heap() {
+    for (Chunk* chunk : chunks) {
+        std::free(chunk);
+    }
+    for (Chunk* chunk : unsweptChunks) {
+        std::free(chunk);
+    }
+}
+
+size_t Heap::objectSize(const HeapObject* obj) {
+    switch (obj->kind) {
+        case ObjectKind::String: {
+            auto* str = static_cast<const String*>(obj);
+            if (str->isRope()) {
+                return allocationSize(sizeof(RopeString));
+            }
+            return allocationSize(String::allocationSize(str->length, str->isTwoByte()));
+        }
+        case ObjectKind::Object: return allocationSize(sizeof(Object));
+        case ObjectKind::Function: return allocationSize(sizeof(FunctionObject));
+        case ObjectKind::ValueArray: return allocationSize(ValueArray::allocationSize(obj->length));
+        case ObjectKind::Instance: return allocationSize(Instance::allocationSize(obj->length));
+        case ObjectKind::Promise: return allocationSize(sizeof(Promise));
+        case ObjectKind::Coroutine: return allocationSize(Coroutine::allocationSize(obj->length));
+        case ObjectKind::Free: return obj->length;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Allocation
+// ---------------------------------------------------------------------------
+
+// Slow path of allocate(): the nursery is full, the object is too large to
+// be worth copying, or a major cycle is due its next slice
+void* Heap::allocateSlow(size_t bytes) {
+    allocated += bytes;
+    if (bytes > kLargeObjectSize) {
+        return allocateOld(bytes);
+    }
+    requestCollection();
+    if (static_cast<size_t>(nurseryEnd - nurseryTop) >= bytes) {
+        nurseryLimit = nurseryTop + std::min(static_cast<size_t>(nurseryEnd - nurseryTop), bytes + kSliceInterval);
+        void* result = nurseryTop;
+        nurseryTop += bytes;
+        return result;
+    }
+    nurseryExhausted = true;
+    return allocateOld(bytes);
+}
+
+void Heap::requestCollection() {
+    pending = true;
+    if (suspendDepth == 0) {
+        requested = 1;
+    }
+}
+
+void Heap::requestMajorCollection() {
+    if (phase == GcPhase::Idle) {
+        majorRequested = true;
+        requestCollection();
+    }
+}
+
+void* Heap::allocateTenured(size_t bytes) {
+    bytes = allocationSize(bytes);
+    allocated += bytes;
+    return allocateOld(bytes);
+}
+
+void* Heap::allocateOld(size_t bytes) {
+    void* result;
+    if (bytes > kLargeObjectSize) {
+        result = allocateLarge(bytes);
+    } else if (!(result = allocateFromFreeList(bytes))) {
+        if (!currentChunk || static_cast<size_t>(currentChunk->end() - currentChunk->top) < bytes) {
+            retireCurrentChunk();
+            currentChunk = newChunk(kChunkSize, false);
+        }
+        result = currentChunk->top;
+        currentChunk->top += bytes;
+    }
+    oldBytes += bytes;
+    if (oldBytes >= majorThreshold && !majorRequested) {
+        requestMajorCollection();
+    }
+    return result;
+}
+
+void* Heap::allocateFromFreeList(size_t bytes) {
+    size_t sizeClass = bytes / kAlignment;
+    if (sizeClass < kSizeClasses && !freeLists[sizeClass].empty()) {
+        HeapObject* block = freeLists[sizeClass].back();
+        freeLists[sizeClass].pop_back();
+        return block;
+    }
+    // Split a bigger block; the remainder must be big enough to stay a
+    // walkable free block
+    for (size_t larger = sizeClass + kMinObjectSize / kAlignment; larger < kSizeClasses; ++larger) {
+        if (!freeLists[larger].empty()) {
+            char* block = reinterpret_cast<char*>(freeLists[larger].back());
+            freeLists[larger].pop_back();
+            addFreeBlock(block + bytes, larger * kAlignment - bytes);
+            return block;
+        }
+    }
+    for (size_t i = 0; i < largeFreeList.size(); ++i) {
+        HeapObject* block = largeFreeList[i];
+        size_t size = block->length;
+        if (size == bytes || size >= bytes + kMinObjectSize) {
+            largeFreeList[i] = largeFreeList.back();
+            largeFreeList.pop_back();
+            if (size > bytes) {
+                addFreeBlock(reinterpret_cast<char*>(block) + bytes, size - bytes);
+            }
+            return block;
+        }
+    }
+    return nullptr;
+}
+
+void* Heap::allocateLarge(size_t bytes) {
+    Chunk* chunk = newChunk(Chunk::headerSize() + bytes, true);
+    chunk->top = chunk->begin() + bytes;
+    return chunk->begin();
+}
+
+Heap::Chunk* Heap::newChunk(size_t bytes, bool large) {
+    size_t reserved = (bytes + kChunkSize - 1) & ~(kChunkSize - 1);
+    void* memory = std::aligned_alloc(kChunkSize, reserved);
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    Chunk* chunk = new (memory) Chunk;
+    chunk->size = bytes;
+    chunk->top = chunk->begin();
+    chunk->large = large;
+    chunk->hasDirtyCards = false;
+    chunk->swept = true;
+    std::memset(chunk->cards, 0, sizeof(chunk->cards));
+    chunks.push_back(chunk);
+    return chunk;
+}
+
+// Hands the unused tail of the bump chunk to the free lists
+void Heap::retireCurrentChunk() {
+    if (currentChunk && static_cast<size_t>(currentChunk->end() - currentChunk->top) >= kMinObjectSize) {
+        addFreeBlock(currentChunk->top, static_cast<size_t>(currentChunk->end() - currentChunk->top));
+        currentChunk->top = currentChunk->end();
+    }
+    currentChunk = nullptr;
+}
+
+void Heap::addFreeBlock(char* start, size_t bytes) {
+    auto* block = reinterpret_cast<HeapObject*>(start);
+    block->kind = ObjectKind::Free;
+    block->gcBits = 0;
+    block->flags = 0;
+    block->length = static_cast<uint32_t>(bytes);
+    size_t sizeClass = bytes / kAlignment;
+    if (sizeClass < kSizeClasses) {
+        freeLists[sizeClass].push_back(block);
+    } else {
+        largeFreeList.push_back(block);
+    }
+}
+
+void Heap::initHeader(HeapObject* obj, ObjectKind kind, uint32_t length) const {
+    obj->kind = kind;
+    obj->gcBits = allocationColor(obj);
+    obj->flags = 0;
+    obj->length = length;
+}
+
+static String* initString(String* str) {
+    str->hash = 0;
+    str->padding = 0;
+    return str;
+}
+
+String* Heap::allocateString(uint32_t length, bool twoByte) {
+    auto* str = static_cast<String*>(allocate(String::allocationSize(length, twoByte)));
+    initHeader(str, ObjectKind::String, length);
+    str->flags = twoByte ? kStringTwoByte : 0;
+    return initString(str);
+}
+
+String* Heap::allocateString(std::string_view chars) {
+    String* str = allocateString(static_cast<uint32_t>(chars.size()));
+    std::memcpy(str->chars(), chars.data(), chars.size());
+    return str;
+}
+
+String* Heap::allocateTenuredString(uint32_t length, bool twoByte) {
+    auto* str = static_cast<String*>(allocateTenured(String::allocationSize(length, twoByte)));
+    initHeader(str, ObjectKind::String, length);
+    str->flags = twoByte ? kStringTwoByte : 0;
+    return initString(str);
+}
+
+String* Heap::allocateTenuredString(std::string_view chars) {
+    String* str = allocateTenuredString(static_cast<uint32_t>(chars.size()), false);
+    std::memcpy(str->chars(), chars.data(), chars.size());
+    return str;
+}
+
+RopeString* Heap::allocateRope(String* left, String* right) {
+    auto* rope = static_cast<RopeString*>(allocate(sizeof(RopeString)));
+    initHeader(rope, ObjectKind::String, left->length + right->length);
+    rope->flags = kStringRope | ((left->flags | right->flags) & kStringTwoByte);
+    initString(rope);
+    rope->left = Value::object(left);
+    rope->right = Value::object(right);
+    // A full nursery places the rope in the old generation
+    writeBarrier(rope, rope->left);
+    writeBarrier(rope, rope->right);
+    return rope;
+}
+
+ValueArray* Heap::allocateValueArray(uint32_t length) {
+    auto* array = static_cast<ValueArray*>(allocate(ValueArray::allocationSize(length)));
+    initHeader(array, ObjectKind::ValueArray, length);
+    Value* items = array->items();
+    for (uint32_t i = 0; i < length; ++i) {
+        new (&items[i]) Value();
+    }
+    return array;
+}
+
+Object* Heap::allocateObject(Shape* shape) {
+    auto* obj = static_cast<Object*>(allocate(sizeof(Object)));
+    initHeader(obj, ObjectKind::Object, 0);
+    obj->shape = shape;
+    obj->overflow = nullptr;
+    for (Value& slot : obj->inlineSlots) {
+        new (&slot) Value();
+    }
+    return obj;
+}
+
+FunctionObject* Heap::allocateFunction(FunctionProto* proto) {
+    auto* fn = static_cast<FunctionObject*>(allocateTenured(sizeof(FunctionObject)));
+    initHeader(fn, ObjectKind::Function, 0);
+    fn->proto = proto;
+    return fn;
+}
+
+Instance* Heap::allocateInstance(const ClassLayout* layout) {
+    auto* instance = static_cast<Instance*>(allocate(Instance::allocationSize(layout->fieldBytes())));
+    initHeader(instance, ObjectKind::Instance, layout->fieldBytes());
+    instance->layout = layout;
+    new (&instance->expando) Value();
+    // All-zero bits are 0, 0.0 and false for the typed fields
+    std::memset(instance->fieldAt<char>(sizeof(Instance)), 0, layout->fieldBytes());
+    Value* values = instance->fieldAt<Value>(sizeof(Instance));
+    for (uint32_t i = 0; i < layout->valueFieldCount(); ++i) {
+        new (&values[i]) Value();
+    }
+    return instance;
+}
+
+Promise* Heap::allocatePromise() {
+    auto* promise = static_cast<Promise*>(allocate(sizeof(Promise)));
+    initHeader(promise, ObjectKind::Promise, 0);
+    new (&promise->result) Value();
+    new (&promise->waiters) Value();
+    return promise;
+}
+
+Coroutine* Heap::allocateCoroutine(FunctionProto* proto) {
+    uint32_t registerCount = static_cast<uint32_t>(proto->numRegisters);
+    auto* coroutine = static_cast<Coroutine*>(allocate(Coroutine::allocationSize(registerCount)));
+    initHeader(coroutine, ObjectKind::Coroutine, registerCount);
+    new (&coroutine->result) Value();
+    new (&coroutine->waiters) Value();
+    coroutine->proto = proto;
+    new (&coroutine->nextWaiter) Value();
+    coroutine->pc = 0;
+    coroutine->padding = 0;
+    Value* registers = coroutine->registers();
+    for (uint32_t i = 0; i < registerCount; ++i) {
+        new (&registers[i]) Value();
+    }
+    return coroutine;
+}
+
+// ---------------------------------------------------------------------------
+// Tracing
+// ---------------------------------------------------------------------------
+
+void Heap::rememberObject(HeapObject* holder) {
+    Chunk* chunk = chunkOf(holder);
+    size_t card = static_cast<size_t>(reinterpret_cast<char*>(holder) - reinterpret_cast<char*>(chunk)) / kCardSize;
+    chunk->cards[card] = 1;
+    chunk->hasDirtyCards = true;
+}
+
+template <typename Visitor>
+void Heap::traceChildren(HeapObject* obj, Visitor& visitor) {
+    switch (obj->kind) {
+        case ObjectKind::Object: {
+            auto* o = static_cast<Object*>(obj);
+            for (Value& slot : o->inlineSlots) {
+                visitor.visit(slot);
+            }
+            if (o->overflow) {
+                // Stores into the overflow slots are barriered on the owning
+                // object, so its overflow values are traced along with it
+                HeapObject* overflow = o->overflow;
+                visitor.visitPointer(overflow);
+                o->overflow = static_cast<ValueArray*>(overflow);
+                Value* items = o->overflow->items();
+                for (uint32_t i = 0; i < o->overflow->length; ++i) {
+                    visitor.visit(items[i]);
+                }
+            }
+            break;
+        }
+        case ObjectKind::ValueArray: {
+            auto* array = static_cast<ValueArray*>(obj);
+            Value* items = array->items();
+            for (uint32_t i = 0; i < array->length; ++i) {
+                visitor.visit(items[i]);
+            }
+            break;
+        }
+        case ObjectKind::Instance: {
+            auto* instance = static_cast<Instance*>(obj);
+            visitor.visit(instance->expando);
+            Value* values = instance->fieldAt<Value>(sizeof(Instance));
+            for (uint32_t i = 0; i < instance->layout->valueFieldCount(); ++i) {
+                visitor.visit(values[i]);
+            }
+            break;
+        }
+        case ObjectKind::Promise: {
+            auto* promise = static_cast<Promise*>(obj);
+            visitor.visit(promise->result);
+            visitor.visit(promise->waiters);
+            break;
+        }
+        case ObjectKind::Coroutine: {
+            auto* coroutine = static_cast<Coroutine*>(obj);
+            visitor.visit(coroutine->result);
+            visitor.visit(coroutine->waiters);
+            visitor.visit(coroutine->nextWaiter);
+            // A running coroutine's registers are on the stack; the saved
+            // copies are stale
+            if (coroutine->isSuspended()) {
+                Value* registers = coroutine->registers();
+                for (uint32_t i = 0; i < coroutine->length; ++i) {
+                    visitor.visit(registers[i]);
+                }
+            }
+            break;
+        }
+        case ObjectKind::String:
+            if (static_cast<String*>(obj)->isRope()) {
+                auto* rope = static_cast<RopeString*>(obj);
+                visitor.visit(rope->left);
+                visitor.visit(rope->right);
+            }
+            break;
+        case ObjectKind::Function:
+        case ObjectKind::Free:
+            break;
+    }
+}
+
+// Minor collection visitor: copies reachable nursery objects out
+struct Heap::Evacuator : RootVisitor {
+    explicit Evacuator(Heap& h) : heap(h) {}
+    Heap& heap;
+
+    void visit(Value& slot) override { heap.evacuateSlot(slot); }
+    void visitPointer(HeapObject*& obj) {
+        if (heap.isYoung(obj)) {
+            obj = heap.evacuate(obj);
+        }
+    }
+};
+
+// Major collection visitor: marks reachable objects
+struct Heap::Marker : RootVisitor {
+    explicit Marker(Heap& h) : heap(h) {}
+    Heap& heap;
+
+    void visit(Value& slot) override { heap.markSlot(slot); }
+    void visitPointer(HeapObject*& obj) { heap.mark(obj); }
+};
+
+// ---------------------------------------------------------------------------
+// Minor collection: copy the nursery's survivors into the old generation
+// ---------------------------------------------------------------------------
+
+HeapObject* Heap::evacuate(HeapObject* obj) {
+    if (obj->gcBits & kGcForwarded) {
+        return *reinterpret_cast<HeapObject**>(obj + 1);
+    }
+    size_t size = objectSize(obj);
+    auto* copy = static_cast<HeapObject*>(allocateOld(size));
+    std::memcpy(copy, obj, size);
+    copy->gcBits = allocationColor(copy); // Survivors of a minor GC during marking are black
+    obj->gcBits |= kGcForwarded;
+    *reinterpret_cast<HeapObject**>(obj + 1) = copy;
+    worklist.push_back(copy);
+    stats.bytesPromoted += size;
+    return copy;
+}
+
+void Heap::evacuateSlot(Value& slot) {
+    if (slot.isObject() && isYoung(slot.asObject())) {
+        slot = Value::object(evacuate(slot.asObject()));
+    }
+}
+
+// Traces the old objects whose header lies on a dirty card. Unmarked
+// objects in chunks still waiting to be swept are dead and their fields may
+// reference freed nursery objects, so they are skipped.
+void Heap::scanDirtyCards(std::vector<Chunk*>& list) {
+    Evacuator evacuator(*this);
+    // Evacuation may append chunks to `list`; they have no dirty cards
+    for (size_t i = 0; i < list.size(); ++i) {
+        Chunk* chunk = list[i];
+        if (!chunk->hasDirtyCards) {
+            continue;
+        }
+        char* base = reinterpret_cast<char*>(chunk);
+        for (char* p = chunk->begin(); p < chunk->top;) {
+            auto* obj = reinterpret_cast<HeapObject*>(p);
+            size_t size = objectSize(obj);
+            if (chunk->cards[static_cast<size_t>(p - base) / kCardSize] &&
+                (chunk->swept || (obj->gcBits & kGcMarked))) {
+                traceChildren(obj, evacuator);
+            }
+            p += size;
+        }
+        std::memset(chunk->cards, 0, sizeof(chunk->cards));
+        chunk->hasDirtyCards = false;
+    }
+}
+
+void Heap::collectMinor() {
+    Evacuator evacuator(*this);
+    if (roots) {
+        roots->traceRoots(evacuator);
+    }
+    for (Rooted* rooted = rootedList; rooted; rooted = rooted->prev) {
+        evacuateSlot(rooted->value);
+    }
+    scanDirtyCards(chunks);
+    scanDirtyCards(unsweptChunks);
+    while (!worklist.empty()) {
+        HeapObject* obj = worklist.back();
+        worklist.pop_back();
+        traceChildren(obj, evacuator);
+    }
+    // Everything left in the nursery is garbage
+    nurseryTop = nurseryStart;
+    nurseryLimit = phase == GcPhase::Idle ? nurseryEnd : nurseryStart + std::min(kSliceInterval, static_cast<size_t>(nurseryEnd - nurseryStart));
+    nurseryExhausted = false;
+#ifndef NDEBUG
+    std::memset(nurseryStart, 0xCD, static_cast<size_t>(nurseryEnd - nurseryStart));
+#endif
+    ++stats.minorCollections;
+}
+
+// ---------------------------------------------------------------------------
+// Major collection: incremental mark-sweep of the old generation
+// ---------------------------------------------------------------------------
+
+// Greys an old object; nursery objects are left to the minor collector
+void Heap::mark(HeapObject* obj) {
+    if (!isYoung(obj) && !(obj->gcBits & kGcMarked)) {
+        obj->gcBits |= kGcMarked;
+        grayStack.push_back(obj);
+    }
+}
+
+void Heap::markSlot(Value& slot) {
+    if (slot.isObject()) {
+        mark(slot.asObject());
+    }
+}
+
+// Starts a cycle by greying the roots. The nursery must be empty.
+void Heap::startMarking() {
+    phase = GcPhase::Marking;
+    marking = 1;
+    majorRequested = false;
+    Marker marker(*this);
+    if (roots) {
+        roots->traceRoots(marker);
+    }
+    for (Rooted* rooted = rootedList; rooted; rooted = rooted->prev) {
+        markSlot(rooted->value);
+    }
+    nurseryLimit = nurseryTop + std::min(kSliceInterval, static_cast<size_t>(nurseryEnd - nurseryTop));
+}
+
+bool Heap::markSlice(size_t budget) {
+    if (workers && workers->workerCount() > 1 && !grayStack.empty()) {
+        markParallel(budget);
+        return grayStack.empty();
+    }
+    Marker marker(*this);
+    size_t traced = 0;
+    while (!grayStack.empty() && traced < budget) {
+        HeapObject* obj = grayStack.back();
+        grayStack.pop_back();
+        traceChildren(obj, marker);
+        traced += objectSize(obj);
+    }
+    return grayStack.empty();
+}
+
+// Shared state of a parallel marking slice
+struct Heap::ParallelMark {
+    static constexpr size_t kSeedBlock = 64;        // Grey objects a marker takes from the seed at once
+    static constexpr size_t kChargeBytes = 16 << 10; // Traced bytes a marker counts before charging the budget
+
+    ParallelMark(Heap& h, size_t markers, size_t budget)
+        : heap(h),
+          budget(static_cast<int64_t>(std::min<size_t>(budget, INT64_MAX))),
+          stacks(markers),
+          leftovers(markers) {
+        for (auto& stack : stacks) {
+            stack = std::make_unique<WorkStealingDeque<HeapObject*>>();
+        }
+    }
+
+    Heap& heap;
+    std::vector<HeapObject*> seed; // The grey stack at the start of the slice
+    std::atomic<size_t> nextSeed{0};
+    std::atomic<int64_t> budget;
+    std::atomic<bool> stopped{false}; // Out of budget, or no grey object left
+    std::atomic<uint32_t> active{0};  // Markers that have started
+    std::atomic<uint32_t> idle{0};    // Of those, markers that found no work
+    std::vector<std::unique_ptr<WorkStealingDeque<HeapObject*>>> stacks;
+    std::vector<std::vector<HeapObject*>> leftovers; // Grey objects a marker stopped with
+    WaitGroup group;
+
+    // Moves the next block of the seed onto `stack`; false once it is used up
+    bool takeSeed(WorkStealingDeque<HeapObject*>& stack) {
+        size_t begin = nextSeed.fetch_add(kSeedBlock, std::memory_order_relaxed);
+        if (begin >= seed.size()) {
+            return false;
+        }
+        size_t end = std::min(seed.size(), begin + kSeedBlock);
+        for (size_t i = begin; i < end; ++i) {
+            stack.push(seed[i]);
+        }
+        return true;
+    }
+
+    HeapObject* steal(size_t thief) {
+        for (size_t i = 1; i < stacks.size(); ++i) {
+            if (HeapObject* obj = stacks[(thief + i) % stacks.size()]->steal()) {
+                return obj;
+            }
+        }
+        return nullptr;
+    }
+
+    // Called by a marker that found no work: true when marking is over,
+    // false when grey objects showed up again. A marker only idles with its
+    // own stack empty and idle ones push nothing, so once every marker that
+    // started is idle, no grey object is left.
+    bool quiesce() {
+        idle.fetch_add(1, std::memory_order_acq_rel);
+        for (;;) {
+            uint32_t idleNow = idle.load(std::memory_order_acquire);
+            if (stopped.load(std::memory_order_acquire) || idleNow == active.load(std::memory_order_acquire)) {
+                stopped.store(true, std::memory_order_release);
+                return true;
+            }
+            for (auto& stack : stacks) {
+                if (!stack->empty()) {
+                    idle.fetch_sub(1, std::memory_order_acq_rel);
+                    return false;
+                }
+            }
+            std::this_thread::yield();
+        }
+    }
+};
+
+// One marker of a parallel slice, run as a scheduler task
+struct Heap::MarkWorker : Task {
+    MarkWorker(ParallelMark& m, size_t i) : Task(&run), mark(m), index(i), stack(*m.stacks[i]) {}
+
+    ParallelMark& mark;
+    size_t index;
+    WorkStealingDeque<HeapObject*>& stack;
+
+    // Claims an old object for this marker: several may reach it at once
+    void visitPointer(HeapObject*& obj) {
+        if (mark.heap.isYoung(obj) || (__atomic_load_n(&obj->gcBits, __ATOMIC_RELAXED) & kGcMarked)) {
+            return;
+        }
+        if (!(__atomic_fetch_or(&obj->gcBits, kGcMarked, __ATOMIC_RELAXED) & kGcMarked)) {
+            stack.push(obj);
+        }
+    }
+    void visit(Value& slot) {
+        if (slot.isObject()) {
+            HeapObject* obj = slot.asObject();
+            visitPointer(obj);
+        }
+    }
+
+    static void run(Task* task) {
+        auto* self = static_cast<MarkWorker*>(task);
+        ParallelMark& mark = self->mark;
+        mark.active.fetch_add(1, std::memory_order_acq_rel);
+        size_t traced = 0;
+        while (!mark.stopped.load(std::memory_order_relaxed)) {
+            HeapObject* obj = self->stack.pop();
+            if (!obj && !mark.takeSeed(self->stack) && !(obj = mark.steal(self->index))) {
+                if (mark.quiesce()) {
+                    break;
+                }
+                continue;
+            }
+            if (!obj) {
+                continue; // Took a block of the seed
+            }
+            traceChildren(obj, *self);
+            traced += objectSize(obj);
+            if (traced >= ParallelMark::kChargeBytes) {
+                int64_t charge = static_cast<int64_t>(traced);
+                if (mark.budget.fetch_sub(charge, std::memory_order_relaxed) <= charge) {
+                    mark.stopped.store(true, std::memory_order_release);
+                }
+                traced = 0;
+            }
+        }
+        // Out of budget: what this marker still holds stays grey
+        while (HeapObject* obj = self->stack.pop()) {
+            mark.leftovers[self->index].push_back(obj);
+        }
+        mark.group.done();
+    }
+};
+
+// A marking slice on every worker. The slice ends early, with grey objects
+// left for the next one, once the markers together traced `budget` bytes.
+void Heap::markParallel(size_t budget) {
+    size_t markers = workers->workerCount();
+    ParallelMark mark(*this, markers, budget);
+    mark.seed.swap(grayStack);
+    std::vector<std::unique_ptr<MarkWorker>> tasks;
+    mark.group.add(static_cast<uint32_t>(markers));
+    for (size_t i = 0; i < markers; ++i) {
+        tasks.push_back(std::make_unique<MarkWorker>(mark, i));
+        workers->spawn(tasks.back().get());
+    }
+    workers->wait(mark.group);
+
+    size_t seedLeft = std::min(mark.nextSeed.load(std::memory_order_relaxed), mark.seed.size());
+    grayStack.assign(mark.seed.begin() + static_cast<std::ptrdiff_t>(seedLeft), mark.seed.end());
+    for (auto& leftover : mark.leftovers) {
+        grayStack.insert(grayStack.end(), leftover.begin(), leftover.end());
+    }
+    ++stats.parallelSlices;
+}
+
+// Marking is complete: every chunk becomes unswept and allocation moves to
+// fresh chunks (and to the free lists the sweep rebuilds) until its turn
+void Heap::startSweeping() {
+    phase = GcPhase::Sweeping;
+    marking = 0;
+    retireCurrentChunk();
+    for (auto& list : freeLists) {
+        list.clear();
+    }
+    largeFreeList.clear();
+    for (Chunk* chunk : chunks) {
+        chunk->swept = false;
+    }
+    unsweptChunks.insert(unsweptChunks.end(), chunks.begin(), chunks.end());
+    chunks.clear();
+}
+
+// What sweeping a chunk found: scanned by any worker, applied serially
+struct Heap::SweepResult {
+    size_t live = 0;  // Bytes of marked objects
+    size_t freed = 0; // Bytes of dead objects (free blocks excluded)
+    std::vector<std::pair<char*, size_t>> freeRuns; // Coalesced dead space
+};
+
+bool Heap::sweepSlice(size_t budget) {
+    if (!workers || workers->workerCount() < 2) {
+        size_t swept = 0;
+        while (!unsweptChunks.empty() && swept < budget) {
+            Chunk* chunk = unsweptChunks.back();
+            unsweptChunks.pop_back();
+            swept += chunk->size;
+            sweepChunk(chunk);
+        }
+        return unsweptChunks.empty();
+    }
+
+    std::vector<Chunk*> slice;
+    size_t swept = 0;
+    while (!unsweptChunks.empty() && swept < budget) {
+        slice.push_back(unsweptChunks.back());
+        unsweptChunks.pop_back();
+        swept += slice.back()->size;
+    }
+    std::vector<SweepResult> results(slice.size());
+    parallelFor(*workers, slice.size(), [&](size_t i) { scanChunk(slice[i], results[i]); });
+    for (size_t i = 0; i < slice.size(); ++i) {
+        applySweep(slice[i], results[i]);
+    }
+    if (slice.size() > 1) {
+        ++stats.parallelSlices;
+    }
+    return unsweptChunks.empty();
+}
+
+void Heap::sweepChunk(Chunk* chunk) {
+    SweepResult result;
+    scanChunk(chunk, result);
+    applySweep(chunk, result);
+}
+
+// Clears the mark bits of the chunk's live objects and collects the runs
+// of dead ones. Touches nothing but the chunk.
+void Heap::scanChunk(Chunk* chunk, SweepResult& result) {
+    if (chunk->large) {
+        auto* obj = reinterpret_cast<HeapObject*>(chunk->begin());
+        size_t size = objectSize(obj);
+        if (obj->gcBits & kGcMarked) {
+            obj->gcBits &= static_cast<uint8_t>(~kGcMarked);
+            result.live = size;
+        } else {
+            result.freed = size;
+        }
+        return;
+    }
+
+    // Coalesce runs of dead objects into free blocks
+    char* runStart = nullptr;
+    for (char* p = chunk->begin(); p < chunk->top;) {
+        auto* obj = reinterpret_cast<HeapObject*>(p);
+        size_t size = objectSize(obj);
+        if (obj->gcBits & kGcMarked) {
+            obj->gcBits &= static_cast<uint8_t>(~kGcMarked);
+            result.live += size;
+            if (runStart) {
+                result.freeRuns.emplace_back(runStart, static_cast<size_t>(p - runStart));
+                runStart = nullptr;
+            }
+        } else {
+            if (obj->kind != ObjectKind::Free) {
+                result.freed += size;
+            }
+            if (!runStart) {
+                runStart = p;
+            }
+        }
+        p += size;
+    }
+    if (runStart) {
+        result.freeRuns.emplace_back(runStart, static_cast<size_t>(chunk->top - runStart));
+    }
+}
+
+void Heap::applySweep(Chunk* chunk, SweepResult& result) {
+    stats.bytesFreed += result.freed;
+    oldBytes -= result.freed;
+    if (result.live == 0) {
+        std::free(chunk);
+        return;
+    }
+    for (const auto& [start, bytes] : result.freeRuns) {
+        addFreeBlock(start, bytes);
+    }
+    chunk->swept = true;
+    chunks.push_back(chunk);
+}
+
+void Heap::finishCycle() {
+    phase = GcPhase::Idle;
+    nurseryLimit = nurseryEnd;
+    majorThreshold = std::max(kMinMajorThreshold, oldBytes * 2);
+    ++stats.majorCollections;
+}
+
+void Heap::collectMajor() {
+    // Complete the cycle in progress, whose snapshot may predate garbage
+    // the caller expects to be reclaimed, then run a fresh one
+    if (phase == GcPhase::Marking) {
+        markSlice(SIZE_MAX);
+        startSweeping();
+    }
+    if (phase == GcPhase::Sweeping) {
+        sweepSlice(SIZE_MAX);
+        finishCycle();
+    }
+    // Empty the nursery first so only the old generation needs marking
+    collectMinor();
+    startMarking();
+    markSlice(SIZE_MAX);
+    startSweeping();
+    sweepSlice(SIZE_MAX);
+    finishCycle();
+}
+
+void Heap::collect() {
+    if (suspendDepth > 0) {
+        return; // Stays pending until the suspension ends
+    }
+    auto start = std::chrono::steady_clock::now();
+    requested = 0;
+    pending = false;
+    bool majorWork = phase != GcPhase::Idle || majorRequested;
+    if (phase == GcPhase::Idle && majorRequested) {
+        collectMinor();
+        startMarking();
+    } else {
+        if (nurseryExhausted) {
+            collectMinor();
+        }
+        if (phase == GcPhase::Marking) {
+            if (markSlice(kMarkSliceBytes)) {
+                startSweeping();
+            }
+        } else if (phase == GcPhase::Sweeping) {
+            if (sweepSlice(kSweepSliceBytes)) {
+                finishCycle();
+            }
+        }
+    }
+    auto pause = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    (majorWork ? stats.majorPauses : stats.minorPauses).record(pause);
+}
@@ -0,0 +1,337 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include "runtime/memory/pause_histogram.h"
+#include "runtime/vm/heap_object.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Receives every root slot during a collection. The collector may rewrite
+// the slot when the object it references moves.
+class RootVisitor {
+public:
+    virtual ~RootVisitor() = default;
+    virtual void visit(Value& slot) = 0;
+};
+
+// Supplies the roots that live outside the heap (globals, registers, ...).
+// Implemented by the VM.
+class RootProvider {
+public:
+    virtual ~RootProvider() = default;
+    virtual void traceRoots(RootVisitor& visitor) = 0;
+};
+
+// Collection counters
+struct GcStats {
+    size_t minorCollections = 0;
+    size_t majorCollections = 0;
+    size_t bytesPromoted = 0;  // Nursery survivors copied to the old generation
+    size_t bytesFreed = 0;     // Old generation bytes reclaimed by sweeping
+    PauseHistogram minorPauses; // collect() calls that only ran a minor collection
+    PauseHistogram majorPauses; // collect() calls that did major marking or sweeping work
+    size_t parallelSlices = 0;  // Marking and sweeping slices spread over the GC workers
+};
+
+// Progress of the incremental major collection
+enum class GcPhase : uint8_t {
+    Idle,
+    Marking,  // Tracing the old generation in slices; SATB barrier active
+    Sweeping, // Reclaiming unmarked objects chunk by chunk
+};
+
+class Rooted;
+class Scheduler;
+
+// Generational garbage-collected heap for script objects.
+//
+// New objects are bump-allocated in the nursery, a single contiguous block
+// owned by the heap (and thus by the thread running its VM). A minor
+// collection copies the nursery's live objects into the old generation
+// (Cheney-style, everything that survives is promoted) and resets the bump
+// pointer, so short-lived objects cost nothing to free.
+//
+// The old generation is a set of chunks managed by mark-sweep: it never
+// moves objects, so tenured objects (interned strings, function objects)
+// can be referenced from C++ by plain pointer. Freed space goes to
+// size-class free lists. Large objects get a chunk of their own.
+//
+// Stores of a value into an old object must call writeBarrier(), which
+// dirties the card holding the object's header when the value is a nursery
+// object. Minor collections trace the objects of dirty cards in addition
+// to the roots.
+//
+// Collections only run at safepoints: allocation never collects, it merely
+// requests a collection (spilling into the old generation when the nursery
+// is full) and the interpreter calls collect() at its next safepoint, where
+// the precise stack maps describe every live register. C++ code can
+// therefore hold raw object pointers between safepoints; across them it
+// must use Rooted.
+//
+// Major collections are incremental so no single pause has to cover the
+// whole old generation. A cycle empties the nursery, greys the roots, then
+// each later safepoint traces at most kMarkSliceBytes of grey objects, and
+// once marking finishes sweeps at most kSweepSliceBytes of chunks. While
+// marking, the mutator keeps the snapshot-at-the-beginning invariant: every
+// store into an old object must first pass the overwritten value to
+// preWriteBarrier(), and objects allocated or promoted meanwhile are black.
+// During a cycle the nursery hands out kSliceInterval bytes at a time so
+// slices keep pace with allocation.
+//
+// suspendCollection() defers collection entirely (wild functions run with
+// the collector suspended); requests made meanwhile are served once the
+// outermost suspension ends.
+//
+// Given a Scheduler, major collections borrow its workers for the pause.
+// A marking slice then runs one marker per worker, each with its own
+// Chase-Lev mark stack: markers claim objects by setting the mark bit
+// atomically, push what they grey on their own stack and steal from the
+// others' once it runs dry, while the slice budget is shared. Sweeping
+// slices scan their chunks in parallel and rebuild the free lists from the
+// results in chunk order. The mutator stays stopped throughout, so the
+// barriers and the serial paths keep using plain mark bits.
+class Heap {
+public:
+    static constexpr size_t kDefaultNurserySize = 4 << 20; // 4 MiB
+    static constexpr size_t kChunkSize = 1 << 20;          // 1 MiB, also the chunk alignment
+    static constexpr size_t kCardSize = 512;
+    static constexpr size_t kAlignment = 8;
+    static constexpr size_t kMinObjectSize = 16;           // Room for a forwarding pointer
+    static constexpr size_t kLargeObjectSize = kChunkSize / 4;
+    static constexpr size_t kMinMajorThreshold = 8 << 20;  // Old generation bytes before the first major GC
+    static constexpr size_t kMarkSliceBytes = 256 << 10;   // Bytes traced per marking slice
+    static constexpr size_t kSweepSliceBytes = 4 << 20;    // Chunk bytes swept per sweeping slice
+    static constexpr size_t kSliceInterval = 512 << 10;    // Nursery bytes allocated between slices
+
+    explicit Heap(size_t nurserySize = kDefaultNurserySize);
+    ~Heap();
+
+    Heap(const Heap&) = delete;
+    Heap& operator=(const Heap&) = delete;
+
+    // Rounds a request up to the size actually occupied on the heap
+    static size_t allocationSize(size_t bytes) {
+        bytes = (bytes + kAlignment - 1) & ~(kAlignment - 1);
+        return bytes < kMinObjectSize ? kMinObjectSize : bytes;
+    }
+
+    // Returns `bytes` of uninitialized, 8-byte aligned nursery storage
+    void* allocate(size_t bytes) {
+        bytes = allocationSize(bytes);
+        if (bytes > kLargeObjectSize || static_cast<size_t>(nurseryLimit - nurseryTop) < bytes) {
+            return allocateSlow(bytes);
+        }
+        void* result = nurseryTop;
+        nurseryTop += bytes;
+        allocated += bytes;
+        return result;
+    }
+
+    // Returns uninitialized old-generation storage that never moves. The
+    // caller must write a valid header before the next collection.
+    void* allocateTenured(size_t bytes);
+
+    // Typed allocation helpers; each returns a fully initialized object
+    String* allocateString(std::string_view chars); // One byte per character (Latin-1)
+    String* allocateString(uint32_t length, bool twoByte = false); // Characters left uninitialized
+    String* allocateTenuredString(std::string_view chars);
+    String* allocateTenuredString(uint32_t length, bool twoByte); // Characters left uninitialized
+    RopeString* allocateRope(String* left, String* right);
+    ValueArray* allocateValueArray(uint32_t length); // Filled with undefined
+    Object* allocateObject(Shape* shape);
+    FunctionObject* allocateFunction(FunctionProto* proto); // Always tenured
+    Instance* allocateInstance(const ClassLayout* layout); // Fields zeroed, Any fields undefined
+    Promise* allocatePromise(); // Pending
+    Coroutine* allocateCoroutine(FunctionProto* proto); // Pending, not suspended
+
+    bool isYoung(const void* p) const {
+        return static_cast<const char*>(p) >= nurseryStart && static_cast<const char*>(p) < nurseryEnd;
+    }
+
+    // Must follow every store of `value` into a field of `holder`
+    void writeBarrier(HeapObject* holder, Value value) {
+        if (value.isObject() && isYoung(value.asObject()) && !isYoung(holder)) {
+            rememberObject(holder);
+        }
+    }
+
+    // Must precede every store that overwrites `oldValue` in an old object
+    // while marking, so the snapshot of the heap at the start of marking
+    // stays reachable
+    void preWriteBarrier(Value oldValue) {
+        if (marking && oldValue.isObject()) {
+            mark(oldValue.asObject());
+        }
+    }
+    bool isMarking() const { return marking != 0; }
+    const uint8_t* markingFlag() const { return &marking; }
+
+    // Collection scheduling. collect() runs the requested minor collection
+    // and the next slice of a major cycle; it may only be called at a
+    // safepoint. collectMinor() and collectMajor() run regardless of
+    // suspension; collectMajor() completes a whole cycle at once.
+    void setRootProvider(RootProvider* provider) { roots = provider; }
+    // Workers for parallel marking and sweeping; null collects on the
+    // calling thread alone. The scheduler must outlive the heap's use of it.
+    void setScheduler(Scheduler* scheduler) { workers = scheduler; }
+    bool collectionRequested() const { return requested != 0; }
+    const uint8_t* collectionRequestedFlag() const { return &requested; }
+    void requestMajorCollection();
+    void collect();
+    void collectMinor();
+    void collectMajor(); // Also runs a minor collection first
+    GcPhase getPhase() const { return phase; }
+
+    // Nestable; collect() does nothing while any suspension is active
+    void suspendCollection() {
+        ++suspendDepth;
+        requested = 0;
+    }
+    void resumeCollection() {
+        if (--suspendDepth == 0 && pending) {
+            requested = 1;
+        }
+    }
+    bool isCollectionSuspended() const { return suspendDepth != 0; }
+
+    const GcStats& getStats() const { return stats; }
+
+    // Total bytes handed out since the heap was created
+    size_t bytesAllocated() const { return allocated; }
+    // Bytes in use by the old generation (live at the last sweep plus
+    // everything tenured since)
+    size_t oldGenerationBytes() const { return oldBytes; }
+    size_t nurseryBytesUsed() const { return static_cast<size_t>(nurseryTop - nurseryStart); }
+
+    // Heap size of an existing object
+    static size_t objectSize(const HeapObject* obj);
+
+private:
+    friend class Rooted;
+
+    // Old-generation chunk. The header sits at the start of a
+    // kChunkSize-aligned block, so any object header address masked with
+    // ~(kChunkSize - 1) yields its chunk; large-object chunks hold one
+    // object right after the header.
+    struct Chunk {
+        size_t size;        // Bytes including this header
+        char* top;          // End of the objects; [top, end) is unused
+        bool large;
+        bool hasDirtyCards;
+        bool swept;         // False while waiting for the current cycle's sweep
+        uint8_t cards[kChunkSize / kCardSize];
+
+        static size_t headerSize() { return allocationSize(sizeof(Chunk)); }
+        char* begin() { return reinterpret_cast<char*>(this) + headerSize(); }
+        char* end() { return reinterpret_cast<char*>(this) + size; }
+    };
+
+    static constexpr size_t kSizeClasses = 64; // Exact free lists for sizes below 64 * 8 bytes
+
+    std::unique_ptr<char[]> nursery;
+    char* nurseryStart;
+    char* nurseryTop;
+    char* nurseryLimit; // Allocation limit; below nurseryEnd during a major cycle
+    char* nurseryEnd;
+
+    std::vector<Chunk*> chunks;
+    std::vector<Chunk*> unsweptChunks;
+    Chunk* currentChunk;
+    std::vector<HeapObject*> freeLists[kSizeClasses]; // Indexed by size / kAlignment
+    std::vector<HeapObject*> largeFreeList;           // Free blocks of kSizeClasses * 8 bytes and up
+
+    RootProvider* roots;
+    Scheduler* workers;
+    Rooted* rootedList;
+    uint8_t requested;  // pending && !suspendDepth, polled by safepoints
+    uint8_t marking;    // phase == Marking, polled by the JIT's store paths
+    bool pending;
+    bool nurseryExhausted;
+    bool majorRequested;
+    size_t suspendDepth;
+    GcPhase phase;
+    size_t allocated;
+    size_t oldBytes;
+    size_t majorThreshold;
+    std::vector<HeapObject*> worklist;  // Promoted objects left to scan
+    std::vector<HeapObject*> grayStack; // Marked objects left to trace
+    GcStats stats;
+
+    // Nursery exhausted (or the object is large): request a collection and
+    // serve the allocation from the old generation meanwhile
+    void* allocateSlow(size_t bytes);
+    void* allocateOld(size_t bytes);
+    void* allocateFromFreeList(size_t bytes);
+    void* allocateLarge(size_t bytes);
+    Chunk* newChunk(size_t bytes, bool large);
+    void retireCurrentChunk();
+    void addFreeBlock(char* start, size_t bytes);
+
+    static Chunk* chunkOf(const void* p) {
+        return reinterpret_cast<Chunk*>(reinterpret_cast<uintptr_t>(p) & ~(kChunkSize - 1));
+    }
+    void rememberObject(HeapObject* holder);
+    void requestCollection();
+    // Color of a newly allocated object: black while marking
+    uint8_t allocationColor(const void* p) const {
+        return marking && !isYoung(p) ? kGcMarked : 0;
+    }
+    void initHeader(HeapObject* obj, ObjectKind kind, uint32_t length) const;
+
+    struct Evacuator;
+    struct Marker;
+    struct ParallelMark;
+    struct MarkWorker;
+    struct SweepResult;
+
+    // Calls visit(Value&) for every value field of `obj` and
+    // visitPointer(HeapObject*&) for its raw object pointers
+    template <typename Visitor>
+    static void traceChildren(HeapObject* obj, Visitor& visitor);
+
+    // Minor collection helpers
+    HeapObject* evacuate(HeapObject* obj);
+    void evacuateSlot(Value& slot);
+    void scanDirtyCards(std::vector<Chunk*>& list);
+
+    // Major collection helpers
+    void markSlot(Value& slot);
+    void mark(HeapObject* obj);
+    void startMarking();
+    bool markSlice(size_t budget); // True once no grey objects remain
+    void markParallel(size_t budget);
+    void startSweeping();
+    bool sweepSlice(size_t budget); // True once every chunk is swept
+    void sweepChunk(Chunk* chunk);
+    static void scanChunk(Chunk* chunk, SweepResult& result); // Safe to run in parallel
+    void applySweep(Chunk* chunk, SweepResult& result);
+    void finishCycle();
+};
+
+// Keeps a value alive, and current if it moves, while C++ code holds it
+// across a safepoint. Rooted values form a stack-ordered list on the heap.
+class Rooted {
+public:
+    Rooted(Heap& heap, Value value) : heap(heap), prev(heap.rootedList), value(value) {
+        heap.rootedList = this;
+    }
+    ~Rooted() { heap.rootedList = prev; }
+
+    Rooted(const Rooted&) = delete;
+    Rooted& operator=(const Rooted&) = delete;
+
+    Value get() const { return value; }
+    void set(Value v) { value = v; }
+
+private:
+    friend class Heap;
+
+    Heap& heap;
+    Rooted* prev;
+    Value value;
+};
+
+#endif // HEAP_H
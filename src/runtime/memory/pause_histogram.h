@@ -0,0 +1,63 @@
+#ifndef PAUSE_HISTOGRAM_H
+#define PAUSE_HISTOGRAM_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Distribution of collector pause times. Bucket 0 counts pauses under 1 us;
+// bucket i counts pauses in [2^(i-1), 2^i) us, the last bucket everything
+// longer.
+class PauseHistogram {
+public:
+    static constexpr size_t kBuckets = 24; // Last bucket starts at ~4.2 s
+
+    void record(std::chrono::nanoseconds pause) {
+        uint64_t nanos = pause.count() > 0 ? static_cast<uint64_t>(pause.count()) : 0;
+        uint64_t micros = nanos / 1000;
+        size_t bucket = 0;
+        while (micros != 0 && bucket < kBuckets - 1) {
+            micros >>= 1;
+            ++bucket;
+        }
+        ++buckets[bucket];
+        ++pauses;
+        totalNanos += nanos;
+        if (nanos > maxNanos) {
+            maxNanos = nanos;
+        }
+    }
+
+    uint64_t count() const { return pauses; }
+    uint64_t bucketCount(size_t bucket) const { return buckets[bucket]; }
+    std::chrono::nanoseconds total() const { return std::chrono::nanoseconds(totalNanos); }
+    std::chrono::nanoseconds max() const { return std::chrono::nanoseconds(maxNanos); }
+
+    // Exclusive upper bound of a bucket, in microseconds
+    static uint64_t bucketLimitMicros(size_t bucket) { return uint64_t(1) << bucket; }
+
+    // Upper bound (in microseconds) of the bucket holding the given
+    // percentile, e.g. percentileMicros(0.99); 0 when nothing was recorded
+    uint64_t percentileMicros(double fraction) const {
+        if (pauses == 0) {
+            return 0;
+        }
+        auto target = static_cast<uint64_t>(fraction * static_cast<double>(pauses));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBuckets; ++i) {
+            seen += buckets[i];
+            if (seen > target || seen == pauses) {
+                return bucketLimitMicros(i);
+            }
+        }
+        return bucketLimitMicros(kBuckets - 1);
+    }
+
+private:
+    uint64_t buckets[kBuckets] = {};
+    uint64_t pauses = 0;
+    uint64_t totalNanos = 0;
+    uint64_t maxNanos = 0;
+};
+
+#endif // PAUSE_HISTOGRAM_H
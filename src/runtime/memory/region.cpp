@@ -0,0 +1,168 @@
+#include "runtime/memory/region.h"
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+
+namespace {
+
+// Spare chunks kept for reuse after the outermost scope exits; more than
+// this go back to the system
+constexpr size_t kMaxSpareChunks = 16;
+
+size_t roundUp(size_t bytes, size_t alignment) {
+    return (bytes + alignment - 1) & ~(alignment - 1);
+}
+
+} // namespace
+
+RegionArena::~RegionArena() {
+    unwindTo(0);
+    for (Chunk* chunk : chunks) {
+        release(chunk);
+    }
+}
+
+RegionArena::Chunk* RegionArena::newChunk(size_t bytes) {
+    size_t size = roundUp(bytes, kChunkSize);
+    void* memory = std::aligned_alloc(kChunkSize, size);
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    auto* chunk = new (memory) Chunk;
+    chunk->pins.store(1, std::memory_order_relaxed);
+    chunk->size = size;
+    return chunk;
+}
+
+RegionArena::Chunk* RegionArena::chunkOf(void* p) {
+    return reinterpret_cast<Chunk*>(reinterpret_cast<uintptr_t>(p) & ~(kChunkSize - 1));
+}
+
+void RegionArena::release(Chunk* chunk) {
+    if (chunk->pins.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        chunk->~Chunk();
+        std::free(chunk);
+    }
+}
+
+void RegionArena::pin(void* p) {
+    chunkOf(p)->pins.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RegionArena::unpin(void* p) {
+    release(chunkOf(p));
+}
+
+void RegionArena::enter() {
+    scopes.push_back(Scope{current, offset, large.size(), nullptr});
+}
+
+void* RegionArena::allocate(size_t bytes) {
+    if (scopes.empty()) {
+        throw std::logic_error("Region allocation outside of a scope");
+    }
+    size_t size = roundUp(bytes == 0 ? 1 : bytes, 16);
+    if (size > kChunkSize - kHeaderSize) {
+        // Large objects start right after the header, so chunkOf() still
+        // finds their chunk
+        Chunk* chunk = newChunk(kHeaderSize + size);
+        large.emplace_back(chunk, scopes.size());
+        return reinterpret_cast<char*>(chunk) + kHeaderSize;
+    }
+    if (current < chunks.size() && offset + size > kChunkSize) {
+        ++current;
+        offset = kHeaderSize;
+    }
+    if (current == chunks.size()) {
+        chunks.push_back(newChunk(kChunkSize));
+        offset = kHeaderSize;
+    }
+    char* p = reinterpret_cast<char*>(chunks[current]) + offset;
+    offset += size;
+    return p;
+}
+
+void RegionArena::addCleanup(void (*fn)(void*), void* arg) {
+    auto* cleanup = static_cast<Cleanup*>(allocate(sizeof(Cleanup)));
+    cleanup->fn = fn;
+    cleanup->arg = arg;
+    cleanup->next = scopes.back().cleanups;
+    scopes.back().cleanups = cleanup;
+}
+
+void RegionArena::exit() {
+    if (scopes.empty()) {
+        throw std::logic_error("Region scope exited more often than entered");
+    }
+    // Cleanups may register more cleanups (a defer block creating scoped
+    // objects); those run too, before the memory goes away
+    while (Cleanup* cleanup = scopes.back().cleanups) {
+        scopes.back().cleanups = cleanup->next;
+        cleanup->fn(cleanup->arg);
+    }
+    Scope scope = scopes.back();
+    scopes.pop_back();
+
+    while (large.size() > scope.largeCount) {
+        release(large.back().first);
+        large.pop_back();
+    }
+
+    // The chunk the scope started in is shared with the enclosing scope
+    // when that had already allocated from it
+    bool sharesFirst = !scopes.empty() && scope.offset > kHeaderSize && scope.chunkIndex < chunks.size();
+    size_t firstOwned = scopes.empty() ? 0 : scope.chunkIndex + (sharesFirst ? 1 : 0);
+    size_t lastUsed = current < chunks.size() ? current : chunks.size() - 1;
+
+    // Chunks pinned by objects that outlive the scope are handed over to
+    // those objects; the others become spare
+    size_t kept = firstOwned;
+    for (size_t i = firstOwned; i < chunks.size(); ++i) {
+        if (i <= lastUsed && chunks[i]->pins.load(std::memory_order_acquire) != 1) {
+            release(chunks[i]);
+        } else {
+            chunks[kept++] = chunks[i];
+        }
+    }
+    chunks.resize(kept);
+
+    if (sharesFirst && chunks[scope.chunkIndex]->pins.load(std::memory_order_acquire) != 1) {
+        // Keep the pinned objects: carry on in the next chunk instead
+        current = scope.chunkIndex + 1;
+        offset = kHeaderSize;
+    } else if (sharesFirst) {
+        current = scope.chunkIndex;
+        offset = scope.offset;
+    } else {
+        current = firstOwned;
+        offset = kHeaderSize;
+    }
+
+    if (scopes.empty()) {
+        while (chunks.size() > kMaxSpareChunks) {
+            release(chunks.back());
+            chunks.pop_back();
+        }
+    }
+}
+
+void RegionArena::unwindTo(size_t targetDepth) {
+    while (scopes.size() > targetDepth) {
+        exit();
+    }
+}
+
+size_t RegionArena::bytesInUse() const {
+    size_t bytes = 0;
+    if (!scopes.empty() && !chunks.empty()) {
+        size_t used = current < chunks.size() ? current : chunks.size();
+        bytes += used * (kChunkSize - kHeaderSize);
+        if (current < chunks.size()) {
+            bytes += offset - kHeaderSize;
+        }
+    }
+    for (const auto& entry : large) {
+        bytes += entry.first->size - kHeaderSize;
+    }
+    return bytes;
+}
@@ -0,0 +1,97 @@
+#ifndef REGION_H
+#define REGION_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Nested allocation scopes for `wild(scope)` objects and block-scoped wild
+// variables. Everything allocated inside a scope is bump-allocated from
+// 64 KiB chunks and given back all at once when the scope exits, by
+// resetting the bump position to where the scope began. Chunks stay with
+// the arena, so a scope entered on every loop iteration reuses the same
+// memory without touching the system allocator.
+//
+// Cleanups registered in a scope (destructors of its objects, `defer`
+// blocks) run in reverse registration order when it exits, before its
+// memory is reused.
+//
+// An object may outlive its scope when references to it are still counted
+// (see WildObject): it pins its chunk, which the arena then lets go of and
+// which is freed by the object's last release instead. Chunks are aligned
+// to their size so the chunk of an object is found from its address.
+//
+// Scopes are entered and exited by the VM's thread only; unpin() may be
+// called from any thread.
+class RegionArena {
+public:
+    static constexpr size_t kChunkSize = 64 << 10;
+
+    RegionArena() = default;
+    ~RegionArena();
+
+    RegionArena(const RegionArena&) = delete;
+    RegionArena& operator=(const RegionArena&) = delete;
+
+    // Opens a scope nested in the current one
+    void enter();
+    // Runs the innermost scope's cleanups and releases its memory
+    void exit();
+    // Number of open scopes
+    size_t depth() const { return scopes.size(); }
+    // Exits scopes until `targetDepth` remain (used when unwinding)
+    void unwindTo(size_t targetDepth);
+
+    // Returns 16-byte aligned storage owned by the innermost scope; throws
+    // std::logic_error when no scope is open and std::bad_alloc when the
+    // system is out of memory
+    void* allocate(size_t bytes);
+
+    // Runs `fn(arg)` when the innermost scope exits
+    void addCleanup(void (*fn)(void*), void* arg);
+
+    // Keeps the chunk holding `p` (from allocate) alive after its scope
+    // exits, until the matching unpin
+    static void pin(void* p);
+    static void unpin(void* p);
+
+    // Chunks owned by the arena, used or kept for reuse
+    size_t chunkCount() const { return chunks.size() + large.size(); }
+    // Bytes allocated in the open scopes
+    size_t bytesInUse() const;
+
+private:
+    struct Chunk {
+        std::atomic<uint32_t> pins; // 1 while owned by the arena, plus pins
+        size_t size;                // Including this header
+    };
+    static constexpr size_t kHeaderSize = 16;
+
+    struct Cleanup {
+        void (*fn)(void*);
+        void* arg;
+        Cleanup* next;
+    };
+
+    struct Scope {
+        size_t chunkIndex; // Bump position when the scope was entered
+        size_t offset;
+        size_t largeCount;
+        Cleanup* cleanups;
+    };
+
+    std::vector<Chunk*> chunks;                 // In bump order; those past `current` are spare
+    std::vector<std::pair<Chunk*, size_t>> large; // Oversized allocations and their scope depth
+    std::vector<Scope> scopes;
+    size_t current = 0; // Chunk being bumped through
+    size_t offset = 0;  // Bump position inside it
+
+    static Chunk* newChunk(size_t bytes);
+    static Chunk* chunkOf(void* p);
+    // Drops the arena's hold on a chunk; frees it unless it is pinned
+    static void release(Chunk* chunk);
+};
+
+#endif // REGION_H
@@ -0,0 +1,650 @@
+#include "runtime/memory/wild_heap.h"
+#include "runtime/vm/config.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define SE_WILD_MMAP 1
+#else
+#define SE_WILD_MMAP 0
+#endif
+
+// Slab header, at the start of every kSlabSize-aligned slab and of every
+// large-object mapping. Everything in the first cache line belongs to
+// the threads freeing into the slab as well; the rest, to the owning thread.
+struct WildHeap::Slab {
+    // Freed by other threads: a Treiber stack linked through the first word
+    // of each slot, pushed a batch at a time and drained by the owner
+    alignas(64) std::atomic<void*> remoteFree;
+    // Whether the owner waits to hear of remote frees (RemoteState)
+    std::atomic<uint8_t> remoteState;
+    Slab* nextReady; // In the owner's ready stack, while queued
+
+    alignas(64) ThreadCache* owner; // Null for large objects and pooled slabs
+    Slab* prev; // Within the owner's partial or full list (or the large list)
+    Slab* next;
+    void* localFree;
+    char* bump; // Never-used slots start here
+    char* end;
+    uint32_t sizeClass;
+    uint32_t objectSize;
+    uint32_t used;
+    uint8_t list;
+    bool large;
+    size_t mappingSize; // Large objects only
+
+    static constexpr size_t kHeaderSize = 192; // Keeps objects 16-byte aligned
+    char* begin() { return reinterpret_cast<char*>(this) + kHeaderSize; }
+};
+
+namespace {
+
+enum SlabList : uint8_t { NoList, ActiveList, PartialList, FullList };
+
+// Slab::remoteState. A full slab is watched; the first remote flush into a
+// watched slab queues it on its owner's ready stack for the class, so the
+// owner finds slabs with room without scanning its full ones. A queued
+// slab stays allocated until the owner has taken it off the stack.
+enum RemoteState : uint8_t { RemoteIdle, RemoteWatched, RemoteQueued };
+
+void* popSlot(void*& list) {
+    void* p = list;
+    list = *static_cast<void**>(p);
+    return p;
+}
+
+// Maps `bytes` (a multiple of the page size) aligned to `alignment`; sets
+// `huge` when the mapping uses explicit huge pages
+char* mapAligned(size_t bytes, size_t alignment, bool tryHuge, bool& huge) {
+    huge = false;
+#if SE_WILD_MMAP
+#ifdef MAP_HUGETLB
+    if (tryHuge && bytes % (2 << 20) == 0) {
+        // Huge page mappings come aligned to the huge page size
+        void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED && reinterpret_cast<uintptr_t>(p) % alignment == 0) {
+            huge = true;
+            return static_cast<char*>(p);
+        }
+        if (p != MAP_FAILED) {
+            munmap(p, bytes);
+        }
+    }
+#endif
+    // Over-map and trim to the alignment
+    void* p = mmap(nullptr, bytes + alignment, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    auto* raw = static_cast<char*>(p);
+    char* aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(raw) + alignment - 1) & ~(alignment - 1));
+    if (aligned > raw) {
+        munmap(raw, static_cast<size_t>(aligned - raw));
+    }
+    size_t tail = static_cast<size_t>(raw + bytes + alignment - (aligned + bytes));
+    if (tail > 0) {
+        munmap(aligned + bytes, tail);
+    }
+#ifdef MADV_HUGEPAGE
+    if (tryHuge) {
+        madvise(aligned, bytes, MADV_HUGEPAGE); // Transparent huge pages, best effort
+    }
+#endif
+    return aligned;
+#else
+    (void)tryHuge;
+    void* p = std::aligned_alloc(alignment, bytes);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return static_cast<char*>(p);
+#endif
+}
+
+void unmap(char* p, size_t bytes) {
+#if SE_WILD_MMAP
+    munmap(p, bytes);
+#else
+    (void)bytes;
+    std::free(p);
+#endif
+}
+
+size_t pageSize() {
+#if SE_WILD_MMAP
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+#else
+    return 4096;
+#endif
+}
+
+// Ids of the heaps still alive, so exiting threads know which caches they
+// may still touch. Deliberately leaked: threads can exit during static
+// destruction.
+struct HeapRegistry {
+    std::mutex mutex;
+    std::vector<uint64_t> live;
+    uint64_t nextId = 1;
+};
+
+HeapRegistry& registry() {
+    static HeapRegistry* instance = new HeapRegistry;
+    return *instance;
+}
+
+} // namespace
+
+struct WildHeap::ThreadCache {
+    struct ClassState {
+        Slab* active = nullptr;
+        Slab* partial = nullptr; // Owner freed into them after they filled up
+        Slab* full = nullptr;
+        // Full slabs other threads have since freed into, pushed by them
+        std::atomic<Slab*> ready{nullptr};
+    };
+    // Frees into slabs owned by other threads, collected per slab
+    struct RemoteBatch {
+        Slab* slab = nullptr;
+        void* head = nullptr;
+        void* tail = nullptr;
+        size_t count = 0;
+    };
+    static constexpr size_t kRemoteBatches = 8;
+
+    ClassState classes[kSizeClasses];
+    RemoteBatch remote[kRemoteBatches];
+    // Written only by the thread using the cache; read by getStats()
+    std::atomic<int64_t> liveBytes{0};
+    std::atomic<int64_t> liveObjects{0};
+
+    void count(int64_t bytes, int64_t objects) {
+        liveBytes.store(liveBytes.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+        liveObjects.store(liveObjects.load(std::memory_order_relaxed) + objects, std::memory_order_relaxed);
+    }
+
+    void unlink(Slab* slab) {
+        ClassState& state = classes[slab->sizeClass];
+        Slab*& head = slab->list == PartialList ? state.partial : state.full;
+        if (slab->prev) {
+            slab->prev->next = slab->next;
+        } else {
+            head = slab->next;
+        }
+        if (slab->next) {
+            slab->next->prev = slab->prev;
+        }
+        slab->prev = slab->next = nullptr;
+        slab->list = NoList;
+    }
+
+    void push(Slab* slab, SlabList list) {
+        ClassState& state = classes[slab->sizeClass];
+        Slab*& head = list == PartialList ? state.partial : state.full;
+        slab->prev = nullptr;
+        slab->next = head;
+        if (head) {
+            head->prev = slab;
+        }
+        head = slab;
+        slab->list = list;
+    }
+};
+
+// The calling thread's caches, one per heap it has used. On thread exit the
+// caches of heaps still alive are handed back for adoption.
+struct WildThreadExit {
+    struct Entry {
+        uint64_t heapId = 0;
+        WildHeap* heap = nullptr;
+        WildHeap::ThreadCache* cache = nullptr;
+    };
+    Entry last; // Most recently used, checked first
+    std::vector<Entry> entries;
+
+    ~WildThreadExit() {
+        HeapRegistry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (const Entry& entry : entries) {
+            if (std::find(reg.live.begin(), reg.live.end(), entry.heapId) != reg.live.end()) {
+                entry.heap->retireThread(entry.cache);
+            }
+        }
+    }
+};
+
+static thread_local WildThreadExit threadCaches;
+
+WildHeap::WildHeap(Options options)
+    : options(options),
+      largeList(nullptr),
+      mappedBytes(0),
+      slabBytes(0),
+      largeBytes(0),
+      largeObjects(0),
+      hugePageSegments(0) {
+    HeapRegistry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    id = reg.nextId++;
+    reg.live.push_back(id);
+}
+
+WildHeap::~WildHeap() {
+    {
+        HeapRegistry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.live.erase(std::find(reg.live.begin(), reg.live.end(), id));
+    }
+    auto& entries = threadCaches.entries;
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [this](const WildThreadExit::Entry& e) { return e.heapId == id; }),
+                  entries.end());
+    if (threadCaches.last.heapId == id) {
+        threadCaches.last = WildThreadExit::Entry();
+    }
+    for (Slab* slab = largeList; slab;) {
+        Slab* next = slab->next;
+        unmap(reinterpret_cast<char*>(slab), slab->mappingSize);
+        slab = next;
+    }
+    for (const auto& [base, bytes] : segments) {
+        unmap(base, bytes);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Size classes
+// ---------------------------------------------------------------------------
+
+// 16, 32, 48, 64, then four classes per power of two: 80, 96, 112, 128,
+// 160, ... 8192. Rounding wastes at most 20% of a request above 64 bytes.
+size_t WildHeap::sizeClassOf(size_t bytes) {
+    if (bytes <= 64) {
+        return bytes == 0 ? 0 : (bytes + 15) / 16 - 1;
+    }
+    // bytes lies in (2^k, 2^(k+1)]
+    size_t k = 63 - static_cast<size_t>(__builtin_clzll(bytes - 1));
+    size_t step = size_t(1) << (k - 2);
+    return 4 + (k - 6) * 4 + (bytes - (size_t(1) << k) + step - 1) / step - 1;
+}
+
+size_t WildHeap::classSize(size_t sizeClass) {
+    if (sizeClass < 4) {
+        return 16 * (sizeClass + 1);
+    }
+    size_t k = 6 + (sizeClass - 4) / 4;
+    return (size_t(1) << k) + ((sizeClass - 4) % 4 + 1) * (size_t(1) << (k - 2));
+}
+
+size_t WildHeap::usableSize(const void* p) {
+    Slab* slab = slabOf(p);
+    return slab->large ? slab->mappingSize - Slab::kHeaderSize : slab->objectSize;
+}
+
+// ---------------------------------------------------------------------------
+// Thread caches
+// ---------------------------------------------------------------------------
+
+WildHeap::ThreadCache* WildHeap::threadCache() {
+    if (SE_LIKELY(threadCaches.last.heapId == id)) {
+        return threadCaches.last.cache;
+    }
+    for (const auto& entry : threadCaches.entries) {
+        if (entry.heapId == id) {
+            threadCaches.last = entry;
+            return entry.cache;
+        }
+    }
+    ThreadCache* cache = registerThread();
+    threadCaches.entries.push_back(WildThreadExit::Entry{id, this, cache});
+    threadCaches.last = threadCaches.entries.back();
+    return cache;
+}
+
+// Adopts the cache (and slabs) of a thread that exited, or makes a new one
+WildHeap::ThreadCache* WildHeap::registerThread() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!orphanedCaches.empty()) {
+        ThreadCache* cache = orphanedCaches.back();
+        orphanedCaches.pop_back();
+        return cache;
+    }
+    caches.push_back(std::make_unique<ThreadCache>());
+    return caches.back().get();
+}
+
+void WildHeap::retireThread(ThreadCache* cache) {
+    for (size_t i = 0; i < ThreadCache::kRemoteBatches; ++i) {
+        flushRemote(cache, i);
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    orphanedCaches.push_back(cache);
+}
+
+void WildHeap::flushThreadCache() {
+    ThreadCache* cache = threadCache();
+    for (size_t i = 0; i < ThreadCache::kRemoteBatches; ++i) {
+        flushRemote(cache, i);
+    }
+    for (size_t sizeClass = 0; sizeClass < kSizeClasses; ++sizeClass) {
+        reclaimRemote(cache, sizeClass);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Allocation
+// ---------------------------------------------------------------------------
+
+void* WildHeap::allocate(size_t bytes) {
+    if (SE_UNLIKELY(bytes > kMaxSmallSize)) {
+        return allocateLarge(bytes);
+    }
+    ThreadCache* cache = threadCache();
+    size_t sizeClass = sizeClassOf(bytes);
+    Slab* slab = cache->classes[sizeClass].active;
+    if (SE_LIKELY(slab != nullptr)) {
+        void* p = nullptr;
+        if (slab->localFree) {
+            p = popSlot(slab->localFree);
+        } else if (slab->bump + slab->objectSize <= slab->end) {
+            p = slab->bump;
+            slab->bump += slab->objectSize;
+        }
+        if (SE_LIKELY(p != nullptr)) {
+            ++slab->used;
+            cache->count(slab->objectSize, 1);
+            return p;
+        }
+    }
+    return refill(cache, sizeClass);
+}
+
+// The active slab is exhausted: reclaim remote frees, or switch to a slab
+// with room
+void* WildHeap::refill(ThreadCache* cache, size_t sizeClass) {
+    ThreadCache::ClassState& state = cache->classes[sizeClass];
+    // First, so no slab of the class is still queued when one is watched
+    reclaimRemote(cache, sizeClass);
+    Slab* slab = state.active;
+    if (slab && !drainRemote(slab)) {
+        state.active = nullptr;
+        watchFull(cache, slab);
+        slab = nullptr;
+    }
+    if (!slab && state.partial) {
+        slab = state.partial;
+        cache->unlink(slab);
+        drainRemote(slab);
+    }
+    if (!slab) {
+        slab = acquireSlab(cache, sizeClass);
+    }
+    slab->list = ActiveList;
+    state.active = slab;
+
+    void* p;
+    if (slab->localFree) {
+        p = popSlot(slab->localFree);
+    } else {
+        p = slab->bump;
+        slab->bump += slab->objectSize;
+    }
+    ++slab->used;
+    cache->count(slab->objectSize, 1);
+    return p;
+}
+
+// Moves the slab's remote frees to its local free list
+bool WildHeap::drainRemote(Slab* slab) {
+    void* head = slab->remoteFree.exchange(nullptr, std::memory_order_acquire);
+    if (!head) {
+        return false;
+    }
+    void* tail = head;
+    uint32_t count = 1;
+    while (*static_cast<void**>(tail)) {
+        tail = *static_cast<void**>(tail);
+        ++count;
+    }
+    *static_cast<void**>(tail) = slab->localFree;
+    slab->localFree = head;
+    slab->used -= count;
+    return true;
+}
+
+// Parks an exhausted slab on the full list until frees give it room
+void WildHeap::watchFull(ThreadCache* cache, Slab* slab) {
+    cache->push(slab, FullList);
+    slab->remoteState.store(RemoteWatched, std::memory_order_seq_cst);
+    // A flush that landed before the store queued nothing: either it sees
+    // the slab watched or this load sees its frees (both seq_cst)
+    uint8_t watched = RemoteWatched;
+    if (slab->remoteFree.load(std::memory_order_seq_cst) &&
+        slab->remoteState.compare_exchange_strong(watched, RemoteIdle, std::memory_order_relaxed)) {
+        cache->unlink(slab);
+        cache->push(slab, PartialList);
+    }
+}
+
+// Takes the full slabs that other threads freed into off the ready stack:
+// those left empty go back to the pool, the others to the partial list
+void WildHeap::reclaimRemote(ThreadCache* cache, size_t sizeClass) {
+    ThreadCache::ClassState& state = cache->classes[sizeClass];
+    if (!state.ready.load(std::memory_order_relaxed)) {
+        return;
+    }
+    Slab* slab = state.ready.exchange(nullptr, std::memory_order_acquire);
+    while (slab) {
+        Slab* next = slab->nextReady;
+        slab->remoteState.store(RemoteIdle, std::memory_order_relaxed);
+        drainRemote(slab);
+        if (slab->list == FullList) {
+            cache->unlink(slab);
+            cache->push(slab, PartialList);
+        }
+        // An active slab stays, even empty
+        if (slab->used == 0 && slab->list == PartialList) {
+            cache->unlink(slab);
+            releaseSlab(slab);
+        }
+        slab = next;
+    }
+}
+
+WildHeap::Slab* WildHeap::acquireSlab(ThreadCache* owner, size_t sizeClass) {
+    static_assert(sizeof(Slab) <= Slab::kHeaderSize, "slab header overlaps the first object");
+    Slab* slab;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (freeSlabs.empty()) {
+            mapSegment();
+        }
+        slab = new (freeSlabs.back()) Slab;
+        freeSlabs.pop_back();
+        slabBytes += kSlabSize;
+    }
+    slab->remoteFree.store(nullptr, std::memory_order_relaxed);
+    slab->remoteState.store(RemoteIdle, std::memory_order_relaxed);
+    slab->nextReady = nullptr;
+    slab->owner = owner;
+    slab->prev = slab->next = nullptr;
+    slab->localFree = nullptr;
+    slab->bump = slab->begin();
+    slab->end = reinterpret_cast<char*>(slab) + kSlabSize;
+    slab->sizeClass = static_cast<uint32_t>(sizeClass);
+    slab->objectSize = static_cast<uint32_t>(classSize(sizeClass));
+    slab->used = 0;
+    slab->list = NoList;
+    slab->large = false;
+    slab->mappingSize = 0;
+    return slab;
+}
+
+void WildHeap::releaseSlab(Slab* slab) {
+    std::lock_guard<std::mutex> lock(mutex);
+    slab->owner = nullptr;
+    slabBytes -= kSlabSize;
+    freeSlabs.push_back(slab);
+}
+
+// Called with the mutex held
+void WildHeap::mapSegment() {
+    bool huge;
+    char* base = mapAligned(kSegmentSize, kSegmentSize, options.hugePages, huge);
+    segments.emplace_back(base, kSegmentSize);
+    mappedBytes += kSegmentSize;
+    if (huge) {
+        ++hugePageSegments;
+    }
+    // Hand out the lowest addresses first
+    for (size_t offset = kSegmentSize; offset > 0; offset -= kSlabSize) {
+        freeSlabs.push_back(reinterpret_cast<Slab*>(base + offset - kSlabSize));
+    }
+}
+
+void* WildHeap::allocateLarge(size_t bytes) {
+    size_t page = pageSize();
+    size_t size = (Slab::kHeaderSize + bytes + page - 1) / page * page;
+    bool huge;
+    char* base = mapAligned(size, kSlabSize, false, huge);
+    auto* slab = new (base) Slab;
+    slab->remoteFree.store(nullptr, std::memory_order_relaxed);
+    slab->owner = nullptr;
+    slab->large = true;
+    slab->mappingSize = size;
+    slab->prev = nullptr;
+    std::lock_guard<std::mutex> lock(mutex);
+    slab->next = largeList;
+    if (largeList) {
+        largeList->prev = slab;
+    }
+    largeList = slab;
+    mappedBytes += size;
+    largeBytes += size;
+    ++largeObjects;
+    return slab->begin();
+}
+
+// ---------------------------------------------------------------------------
+// Freeing
+// ---------------------------------------------------------------------------
+
+void WildHeap::free(void* p) {
+    if (!p) {
+        return;
+    }
+    Slab* slab = slabOf(p);
+    if (SE_UNLIKELY(slab->large)) {
+        freeLarge(slab);
+        return;
+    }
+    ThreadCache* cache = threadCache();
+    if (SE_UNLIKELY(slab->owner != cache)) {
+        freeRemote(cache, slab, p);
+        return;
+    }
+    *static_cast<void**>(p) = slab->localFree;
+    slab->localFree = p;
+    --slab->used;
+    cache->count(-static_cast<int64_t>(slab->objectSize), -1);
+    if (slab->list == FullList) {
+        uint8_t watched = RemoteWatched;
+        slab->remoteState.compare_exchange_strong(watched, RemoteIdle, std::memory_order_relaxed);
+        cache->unlink(slab);
+        cache->push(slab, PartialList);
+    }
+    // A queued slab is released once it leaves the ready stack
+    if (slab->used == 0 && slab->list == PartialList &&
+        slab->remoteState.load(std::memory_order_relaxed) != RemoteQueued) {
+        // Emptied: let other size classes and threads have it
+        cache->unlink(slab);
+        releaseSlab(slab);
+    }
+}
+
+void WildHeap::freeLarge(Slab* slab) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (slab->prev) {
+            slab->prev->next = slab->next;
+        } else {
+            largeList = slab->next;
+        }
+        if (slab->next) {
+            slab->next->prev = slab->prev;
+        }
+        mappedBytes -= slab->mappingSize;
+        largeBytes -= slab->mappingSize;
+        --largeObjects;
+    }
+    unmap(reinterpret_cast<char*>(slab), slab->mappingSize);
+}
+
+void WildHeap::freeRemote(ThreadCache* cache, Slab* slab, void* p) {
+    cache->count(-static_cast<int64_t>(slab->objectSize), -1);
+    size_t index = (reinterpret_cast<uintptr_t>(slab) / kSlabSize) % ThreadCache::kRemoteBatches;
+    ThreadCache::RemoteBatch& batch = cache->remote[index];
+    if (batch.slab != slab) {
+        flushRemote(cache, index);
+        batch.slab = slab;
+    }
+    *static_cast<void**>(p) = batch.head;
+    batch.head = p;
+    if (!batch.tail) {
+        batch.tail = p;
+    }
+    if (++batch.count >= kRemoteBatch) {
+        flushRemote(cache, index);
+    }
+}
+
+// Pushes a whole batch onto its slab's remote free list with one CAS
+void WildHeap::flushRemote(ThreadCache* cache, size_t index) {
+    ThreadCache::RemoteBatch& batch = cache->remote[index];
+    if (batch.count == 0) {
+        return;
+    }
+    std::atomic<void*>& list = batch.slab->remoteFree;
+    void* old = list.load(std::memory_order_relaxed);
+    do {
+        *static_cast<void**>(batch.tail) = old;
+    } while (!list.compare_exchange_weak(old, batch.head, std::memory_order_seq_cst, std::memory_order_relaxed));
+    Slab* slab = batch.slab;
+    batch = ThreadCache::RemoteBatch();
+
+    // Tell an owner waiting for room in this slab. Once queued, the slab
+    // is not released, so its owner and class stay valid to read here.
+    uint8_t watched = RemoteWatched;
+    if (slab->remoteState.load(std::memory_order_seq_cst) == RemoteWatched &&
+        slab->remoteState.compare_exchange_strong(watched, RemoteQueued, std::memory_order_acquire)) {
+        std::atomic<Slab*>& ready = slab->owner->classes[slab->sizeClass].ready;
+        Slab* head = ready.load(std::memory_order_relaxed);
+        do {
+            slab->nextReady = head;
+        } while (!ready.compare_exchange_weak(head, slab, std::memory_order_release, std::memory_order_relaxed));
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Statistics
+// ---------------------------------------------------------------------------
+
+WildHeapStats WildHeap::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    WildHeapStats stats;
+    stats.mappedBytes = mappedBytes;
+    stats.slabBytes = slabBytes;
+    stats.largeBytes = largeBytes;
+    stats.hugePageSegments = hugePageSegments;
+    int64_t liveBytes = 0;
+    int64_t liveObjects = 0;
+    for (const auto& cache : caches) {
+        liveBytes += cache->liveBytes.load(std::memory_order_relaxed);
+        liveObjects += cache->liveObjects.load(std::memory_order_relaxed);
+    }
+    stats.liveBytes = static_cast<size_t>(std::max<int64_t>(liveBytes, 0));
+    stats.liveObjects = static_cast<size_t>(std::max<int64_t>(liveObjects, 0)) + largeObjects;
+    return stats;
+}
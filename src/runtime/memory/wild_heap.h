@@ -0,0 +1,127 @@
+#ifndef WILD_HEAP_H
+#define WILD_HEAP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Footprint and fragmentation counters of a WildHeap. Per-thread counters
+// are summed without stopping their threads, so the figures are a snapshot
+// that may lag concurrent allocation slightly.
+struct WildHeapStats {
+    size_t mappedBytes = 0;      // Memory obtained from the OS (the footprint)
+    size_t slabBytes = 0;        // Slabs currently handed to thread caches
+    size_t largeBytes = 0;       // Mapped for objects above kMaxSmallSize
+    size_t liveBytes = 0;        // Size-class bytes of live small objects
+    size_t liveObjects = 0;      // Live small and large objects
+    size_t hugePageSegments = 0; // Segments backed by explicit huge pages
+
+    // Share of the slab memory not occupied by live objects, counting
+    // size-class rounding and free slots in partially used slabs
+    double fragmentation() const {
+        return slabBytes == 0 ? 0.0 : 1.0 - static_cast<double>(liveBytes) / static_cast<double>(slabBytes);
+    }
+};
+
+// Manually managed heap for `wild` objects, which `destroy` frees
+// explicitly and the garbage collector never sees.
+//
+// Small requests (up to kMaxSmallSize) are rounded to one of kSizeClasses
+// classes, four per power of two, and carved from 64 KiB slabs holding a
+// single class. Each thread allocates from slabs it owns through a private
+// cache, so the common allocate/free pair touches no shared state and takes
+// no lock. Memory freed by a thread that does not own the slab is buffered
+// per slab and handed back in batches with one compare-and-swap onto the
+// slab's remote free list, which the owner drains when it runs out of
+// space. The first such batch into a full slab also queues the slab for
+// its owner, so finding room never means scanning the full slabs, and a
+// slab that remote frees emptied goes back to the pool. Slabs are cut from 2 MiB segments, optionally backed by huge
+// pages; larger requests get a mapping of their own.
+//
+// A thread's cache lives as long as the heap. When the thread exits, its
+// slabs are kept together and adopted by the next thread to arrive.
+class WildHeap {
+public:
+    static constexpr size_t kSlabSize = 64 << 10;
+    static constexpr size_t kSegmentSize = 2 << 20;
+    static constexpr size_t kMaxSmallSize = 8 << 10;
+    static constexpr size_t kSizeClasses = 32;
+    static constexpr size_t kRemoteBatch = 32; // Remote frees buffered per slab before a flush
+
+    struct Options {
+        bool hugePages = false; // Back segments with huge pages where available
+    };
+
+    WildHeap() : WildHeap(Options()) {}
+    explicit WildHeap(Options options);
+    ~WildHeap();
+
+    WildHeap(const WildHeap&) = delete;
+    WildHeap& operator=(const WildHeap&) = delete;
+
+    // Returns 16-byte aligned storage; throws std::bad_alloc when the
+    // system is out of memory
+    void* allocate(size_t bytes);
+    // Frees storage from allocate() on any thread; null is ignored
+    void free(void* p);
+    // Bytes actually usable at `p`
+    static size_t usableSize(const void* p);
+
+    // Hands the calling thread's buffered remote frees to their slabs, and
+    // returns its own slabs that other threads emptied to the pool
+    void flushThreadCache();
+
+    WildHeapStats getStats() const;
+
+    // Size-class mapping for small requests
+    static size_t sizeClassOf(size_t bytes);
+    static size_t classSize(size_t sizeClass);
+
+private:
+    struct Slab;
+    struct ThreadCache;
+
+    Options options;
+    uint64_t id; // Distinguishes heaps in the per-thread cache lookup
+
+    mutable std::mutex mutex; // Guards everything below
+    std::vector<std::pair<char*, size_t>> segments;
+    std::vector<Slab*> freeSlabs;
+    Slab* largeList; // Doubly linked through Slab::prev/next
+    std::vector<std::unique_ptr<ThreadCache>> caches;
+    std::vector<ThreadCache*> orphanedCaches;
+    size_t mappedBytes;
+    size_t slabBytes;
+    size_t largeBytes;
+    size_t largeObjects;
+    size_t hugePageSegments;
+
+    ThreadCache* threadCache();
+    ThreadCache* registerThread();
+    void retireThread(ThreadCache* cache);
+
+    void* refill(ThreadCache* cache, size_t sizeClass);
+    static void watchFull(ThreadCache* cache, Slab* slab);
+    void reclaimRemote(ThreadCache* cache, size_t sizeClass);
+    void* allocateLarge(size_t bytes);
+    void freeLarge(Slab* slab);
+    void freeRemote(ThreadCache* cache, Slab* slab, void* p);
+    static void flushRemote(ThreadCache* cache, size_t batch);
+    static bool drainRemote(Slab* slab);
+
+    Slab* acquireSlab(ThreadCache* owner, size_t sizeClass);
+    void releaseSlab(Slab* slab);
+    void mapSegment();
+
+    static Slab* slabOf(const void* p) {
+        return reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(p) & ~(kSlabSize - 1));
+    }
+
+    friend struct WildThreadExit;
+};
+
+#endif // WILD_HEAP_H
@@ -0,0 +1,114 @@
+#include "runtime/vm/class_layout.h"
+#include "runtime/vm/object.h"
+#include "runtime/vm/shape.h"
+#include "runtime/vm/string_ops.h"
+#include "runtime/vm/vm.h"
+#include <stdexcept>
+
+namespace {
+
+uint32_t fieldSize(FieldType type) {
+    switch (type) {
+        case FieldType::Any:
+        case FieldType::Float64: return 8;
+        case FieldType::Int32: return 4;
+        case FieldType::Boolean: return 1;
+    }
+    return 8;
+}
+
+const char* fieldTypeName(FieldType type) {
+    switch (type) {
+        case FieldType::Any: return "any";
+        case FieldType::Int32: return "int32";
+        case FieldType::Float64: return "float64";
+        case FieldType::Boolean: return "boolean";
+    }
+    return "any";
+}
+
+const char* valueTypeName(Value value) {
+    if (value.isNumber()) {
+        return "number";
+    }
+    if (value.isBoolean()) {
+        return "boolean";
+    }
+    if (value.isNullish()) {
+        return value.isNull() ? "null" : "undefined";
+    }
+    if (isString(value)) {
+        return "string";
+    }
+    return "object";
+}
+
+} // namespace
+
+ClassLayout::ClassLayout(std::string name, const std::vector<FieldDecl>& fields)
+    : className(std::move(name)), bytes(0), valueFields(0) {
+    fieldList.reserve(fields.size());
+    for (const FieldDecl& decl : fields) {
+        if (fieldIndex(decl.name) >= 0) {
+            throw std::logic_error("Duplicate field '" + toUtf8(decl.name) + "' in class " + className);
+        }
+        fieldList.push_back(FieldInfo{decl.name, decl.type, 0});
+    }
+    // Largest fields first: every offset stays naturally aligned without
+    // padding between fields, and the Any fields (placed before Float64
+    // ones of the same size) form one run
+    uint32_t offset = sizeof(Instance);
+    static constexpr FieldType kPlacementOrder[] = {FieldType::Any, FieldType::Float64, FieldType::Int32,
+                                                     FieldType::Boolean};
+    for (FieldType type : kPlacementOrder) {
+        for (FieldInfo& info : fieldList) {
+            if (info.type == type) {
+                info.offset = offset;
+                offset += fieldSize(type);
+            }
+        }
+        if (type == FieldType::Any) {
+            valueFields = (offset - static_cast<uint32_t>(sizeof(Instance))) / sizeof(Value);
+        }
+    }
+    bytes = (offset - static_cast<uint32_t>(sizeof(Instance)) + 7) & ~7u;
+}
+
+int ClassLayout::fieldIndex(const String* key) const {
+    for (size_t i = 0; i < fieldList.size(); ++i) {
+        if (fieldList[i].name == key) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void throwFieldTypeError(const FieldInfo& field, Value value) {
+    throw RuntimeError(std::string("Cannot store a ") + valueTypeName(value) + " in " + fieldTypeName(field.type) +
+                       " field '" + toUtf8(field.name) + "'");
+}
+
+Value getInstanceProperty(const Instance* instance, const String* key) {
+    int index = instance->layout->fieldIndex(key);
+    if (index >= 0) {
+        return loadField(instance, instance->layout->field(static_cast<uint32_t>(index)));
+    }
+    if (!isPlainObject(instance->expando)) {
+        return Value::undefined();
+    }
+    return getProperty(asPlainObject(instance->expando), key);
+}
+
+void setInstanceProperty(Heap& heap, ShapeTree& shapes, Instance* instance, const String* key, Value value) {
+    int index = instance->layout->fieldIndex(key);
+    if (index >= 0) {
+        storeField(heap, instance, instance->layout->field(static_cast<uint32_t>(index)), value);
+        return;
+    }
+    if (!isPlainObject(instance->expando)) {
+        // Allocation never collects, so `instance` stays where it is
+        instance->expando = Value::object(heap.allocateObject(shapes.root()));
+        heap.writeBarrier(instance, instance->expando);
+    }
+    setProperty(heap, shapes, asPlainObject(instance->expando), key, value);
+}
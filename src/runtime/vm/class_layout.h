@@ -0,0 +1,115 @@
+#ifndef CLASS_LAYOUT_H
+#define CLASS_LAYOUT_H
+
+#include "runtime/memory/heap.h"
+#include "runtime/vm/config.h"
+#include "runtime/vm/heap_object.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ShapeTree;
+
+// Declared type of a class field. Typed fields are stored unboxed in the
+// instance and checked on every store; Any holds a full Value.
+enum class FieldType : uint8_t {
+    Any,     // Any value (8 bytes, traced by the collector)
+    Int32,   // Integers in int32 range (4 bytes)
+    Float64, // Any number (8 bytes)
+    Boolean  // true or false (1 byte)
+};
+
+// A field as written in the class declaration
+struct FieldDecl {
+    const String* name; // Interned
+    FieldType type;
+};
+
+// A field placed in the layout
+struct FieldInfo {
+    const String* name;
+    FieldType type;
+    uint32_t offset; // Bytes from the start of the Instance
+};
+
+// Fixed memory layout of the instances of a class that declares its fields
+// up front. Every field gets a byte offset when the class is defined, so
+// compiled code reaches a field with one layout comparison and a load at a
+// constant offset instead of a shape lookup. Fields are packed by size to
+// avoid padding, Any fields first so the collector traces one contiguous
+// run of Values; declaration order only fixes the field indexes.
+class ClassLayout {
+public:
+    // Throws std::logic_error when two fields share a name
+    ClassLayout(std::string name, const std::vector<FieldDecl>& fields);
+
+    const std::string& name() const { return className; }
+    uint32_t fieldCount() const { return static_cast<uint32_t>(fieldList.size()); }
+    const FieldInfo& field(uint32_t index) const { return fieldList[index]; }
+    // Index of the field called `key` (interned), or -1
+    int fieldIndex(const String* key) const;
+
+    // Size of the field area after the Instance header, a multiple of 8
+    uint32_t fieldBytes() const { return bytes; }
+    // The Any fields, which start right after the Instance header
+    uint32_t valueFieldCount() const { return valueFields; }
+
+private:
+    std::string className;
+    std::vector<FieldInfo> fieldList;
+    uint32_t bytes;
+    uint32_t valueFields;
+};
+
+// Field reads and writes on an instance of the field's class
+inline Value loadField(const Instance* instance, const FieldInfo& field) {
+    switch (field.type) {
+        case FieldType::Any: return *instance->fieldAt<Value>(field.offset);
+        case FieldType::Int32: return Value::integer(*instance->fieldAt<int32_t>(field.offset));
+        case FieldType::Float64: return Value::fromDouble(*instance->fieldAt<double>(field.offset));
+        case FieldType::Boolean: return Value::boolean(*instance->fieldAt<uint8_t>(field.offset) != 0);
+    }
+    return Value::undefined();
+}
+
+// Throws the RuntimeError for storing `value` into a typed field
+[[noreturn]] SE_NOINLINE void throwFieldTypeError(const FieldInfo& field, Value value);
+
+// Stores `value`, which must match the field's type: integers in int32
+// range for Int32, any number for Float64, a boolean for Boolean
+inline void storeField(Heap& heap, Instance* instance, const FieldInfo& field, Value value) {
+    switch (field.type) {
+        case FieldType::Any: {
+            Value* slot = instance->fieldAt<Value>(field.offset);
+            heap.preWriteBarrier(*slot);
+            *slot = value;
+            heap.writeBarrier(instance, value);
+            return;
+        }
+        case FieldType::Int32:
+            if (!value.isInt() || value.asInt() != static_cast<int32_t>(value.asInt())) {
+                throwFieldTypeError(field, value);
+            }
+            *instance->fieldAt<int32_t>(field.offset) = static_cast<int32_t>(value.asInt());
+            return;
+        case FieldType::Float64:
+            if (!value.isNumber()) {
+                throwFieldTypeError(field, value);
+            }
+            *instance->fieldAt<double>(field.offset) = value.toNumber();
+            return;
+        case FieldType::Boolean:
+            if (!value.isBoolean()) {
+                throwFieldTypeError(field, value);
+            }
+            *instance->fieldAt<uint8_t>(field.offset) = value.asBoolean() ? 1 : 0;
+            return;
+    }
+}
+
+// Generic property access on an instance: declared fields by name,
+// anything else through the expando object
+Value getInstanceProperty(const Instance* instance, const String* key);
+void setInstanceProperty(Heap& heap, ShapeTree& shapes, Instance* instance, const String* key, Value value);
+
+#endif // CLASS_LAYOUT_H
@@ -0,0 +1,50 @@
+#ifndef VM_CONFIG_H
+#define VM_CONFIG_H
+
+// Compiler hints shared by the runtime's hot paths
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SE_LIKELY(x) __builtin_expect(!!(x), 1)
+#define SE_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#define SE_NOINLINE __attribute__((noinline))
+#define SE_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define SE_LIKELY(x) (x)
+#define SE_UNLIKELY(x) (x)
+#define SE_NOINLINE
+#define SE_ALWAYS_INLINE inline
+#endif
+
+// Interpreter dispatch strategy. Computed goto ("labels as values") lets
+// every handler jump straight to the next one; the portable fallback is a
+// switch inside a loop. Build with -DSE_COMPUTED_GOTO=0 to force the switch.
+#ifndef SE_COMPUTED_GOTO
+#if defined(__GNUC__) || defined(__clang__)
+#define SE_COMPUTED_GOTO 1
+#else
+#define SE_COMPUTED_GOTO 0
+#endif
+#endif
+
+// Baseline JIT: generates x86-64 machine code for hot functions. Only
+// available on x86-64 Linux; build with -DSE_ENABLE_JIT=0 to leave it out.
+#ifndef SE_ENABLE_JIT
+#if defined(__x86_64__) && defined(__linux__)
+#define SE_ENABLE_JIT 1
+#else
+#define SE_ENABLE_JIT 0
+#endif
+#endif
+
+// Vector kernels behind the typed-array builtins (runtime/vm/simd_kernels.h):
+// SSE2 on any x86-64 CPU, AVX2 when the CPU has it. Build with
+// -DSE_ENABLE_SIMD=0 to use the portable loops only.
+#ifndef SE_ENABLE_SIMD
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define SE_ENABLE_SIMD 1
+#else
+#define SE_ENABLE_SIMD 0
+#endif
+#endif
+
+#endif // VM_CONFIG_H
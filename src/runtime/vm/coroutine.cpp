@@ -0,0 +1,213 @@
+#include "runtime/concurrency/futex.h"
+#include "runtime/vm/slow_paths.h"
+#include "runtime/vm/vm.h"
+#include <algorithm>
+
+// Async functions as stackless coroutines.
+//
+// A coroutine frame runs on the VM stack exactly like an ordinary call, so
+// the interpreter, the JIT and the stack maps need nothing special until an
+// Await finds a pending promise. Only then are the registers copied into the
+// Coroutine object, which the compiler sized to the function's register
+// window, and the frame popped. Await may only appear in the async function
+// itself, never in a function it calls, so a suspension always pops exactly
+// one frame: the entry frame of the execute() that runCoroutine() started.
+//
+// While a coroutine runs its saved registers are stale and untraced. Moving
+// the values between the stack and the object is therefore barriered like
+// an ordinary store or overwrite of a heap field.
+
+Value VM::newPromise() {
+    return Value::object(heap.allocatePromise());
+}
+
+void VM::resolvePromise(Value promise, Value value) {
+    if (!isPromise(promise)) {
+        throw RuntimeError("Value is not a promise");
+    }
+    settlePromise(asPromise(promise), value, false);
+}
+
+void VM::rejectPromise(Value promise, Value reason) {
+    if (!isPromise(promise)) {
+        throw RuntimeError("Value is not a promise");
+    }
+    settlePromise(asPromise(promise), reason, true);
+}
+
+size_t VM::runPendingJobs() {
+    size_t count = 0;
+    // A resumed coroutine leaving a `using` block may hand its lock to
+    // another one
+    for (settleGrantedLocks(); !jobs.empty(); settleGrantedLocks()) {
+        Value job = jobs.front();
+        jobs.pop_front();
+        resumeCoroutine(asCoroutine(job));
+        ++count;
+    }
+    return count;
+}
+
+void VM::waitForLocks() {
+    for (uint32_t grants; !pendingLocks.empty() && (grants = lockGrants.load(std::memory_order_acquire)) == lockGrantsSettled;) {
+        futexWait(lockGrants, grants);
+    }
+}
+
+VM::PendingLock::PendingLock(VM* owner, WildObject* target) : LockWaiter(&resume), vm(owner), object(target) {}
+
+void VM::PendingLock::resume(Task* task) {
+    auto* self = static_cast<PendingLock*>(static_cast<LockWaiter*>(task));
+    // Woken to compete for the lock again; that only touches the lock, so
+    // the releasing thread may as well do it
+    if (!self->acquired && !self->object->lock.lockAsync(self, self->site)) {
+        return;
+    }
+    VM* vm = self->vm;
+    vm->lockGrants.fetch_add(1, std::memory_order_release);
+    futexWake(vm->lockGrants, 1);
+    self->granted.store(true, std::memory_order_release); // Last touch: the VM may free us now
+}
+
+Value VM::lockContended(WildObject* object, LockSite& site) {
+    // The reference keeps the object's memory, lock word included, while
+    // the waiter is parked on it
+    object->retain();
+    auto pending = std::make_unique<PendingLock>(this, object);
+    if (object->lock.lockAsync(pending.get(), &site)) {
+        object->release();
+        return Value::wild(object);
+    }
+    // Parked; the release that hands the lock over never reads the promise
+    pending->promise = newPromise();
+    Value promise = pending->promise;
+    pendingLocks.push_back(std::move(pending));
+    return promise;
+}
+
+void VM::settleGrantedLocks() {
+    if (lockGrants.load(std::memory_order_acquire) == lockGrantsSettled) {
+        return;
+    }
+    // In the order the coroutines started waiting
+    for (size_t i = 0; i < pendingLocks.size();) {
+        if (!pendingLocks[i]->granted.load(std::memory_order_acquire)) {
+            ++i;
+            continue;
+        }
+        Value promise = pendingLocks[i]->promise;
+        WildObject* object = pendingLocks[i]->object;
+        pendingLocks.erase(pendingLocks.begin() + static_cast<std::ptrdiff_t>(i));
+        ++lockGrantsSettled;
+        resolvePromise(promise, Value::wild(object));
+        object->release();
+    }
+}
+
+void VM::settlePromise(Promise* promise, Value result, bool rejected) {
+    if (promise->isSettled()) {
+        return;
+    }
+    heap.preWriteBarrier(promise->result);
+    promise->result = result;
+    heap.writeBarrier(promise, result);
+    promise->flags |= rejected ? kPromiseRejected : kPromiseFulfilled;
+
+    // Queue the waiters in the order they started waiting. The chain leaves
+    // the heap for the job queue, a root, so each link is an overwrite.
+    size_t first = jobs.size();
+    Value waiter = promise->waiters;
+    heap.preWriteBarrier(waiter);
+    promise->waiters = Value::undefined();
+    while (waiter.isObject()) {
+        Coroutine* coroutine = asCoroutine(waiter);
+        jobs.push_back(waiter);
+        waiter = coroutine->nextWaiter;
+        heap.preWriteBarrier(waiter);
+        coroutine->nextWaiter = Value::undefined();
+    }
+    std::reverse(jobs.begin() + static_cast<std::ptrdiff_t>(first), jobs.end());
+}
+
+Value VM::callAsync(Value callee, Value* base, int argc) {
+    // Allocation never collects, so the arguments at `base` stay valid
+    Coroutine* coroutine = heap.allocateCoroutine(asFunction(callee)->proto);
+    pushFrame(callee, base, argc, -1);
+    frames[frameCount - 1].coroutine = Value::object(coroutine);
+    return runCoroutine(0);
+}
+
+void VM::resumeCoroutine(Coroutine* coroutine) {
+    FunctionProto* proto = coroutine->proto;
+    Value* base = stackTop();
+    if (frameCount == kMaxFrames || base + proto->numRegisters > stackEnd) {
+        throw RuntimeError("Maximum call stack size exceeded");
+    }
+    const Value* saved = coroutine->registers();
+    for (int reg = 0; reg < proto->numRegisters; ++reg) {
+        heap.preWriteBarrier(saved[reg]);
+        base[reg] = saved[reg];
+    }
+    coroutine->flags &= static_cast<uint16_t>(~kCoroutineSuspended);
+    frames[frameCount++] = CallFrame{proto, nullptr, base, -1, Value::object(coroutine)};
+    if (SE_UNLIKELY(proto->isWild)) {
+        heap.suspendCollection(); // Lifted again at the next Await or on return
+    }
+    // Re-runs the Await, which now finds its promise settled
+    runCoroutine(coroutine->pc);
+}
+
+Value VM::runCoroutine(size_t startPc) {
+    size_t entryDepth = frameCount - 1;
+    size_t regionDepth = regions.depth();
+    Value result;
+    bool rejected = false;
+    try {
+        result = execute(entryDepth, startPc);
+    } catch (const RuntimeError& e) {
+        unwindFrames(entryDepth, regionDepth);
+        result = Value::object(heap.allocateString(e.what()));
+        rejected = true;
+    } catch (...) {
+        unwindFrames(entryDepth, regionDepth);
+        throw;
+    }
+    // The popped entry frame still holds the coroutine, kept up to date by
+    // any collection that ran meanwhile
+    Coroutine* coroutine = asCoroutine(frames[entryDepth].coroutine);
+    if (!coroutine->isSuspended()) {
+        settlePromise(coroutine, result, rejected);
+    }
+    return Value::object(coroutine);
+}
+
+void VM::suspendCoroutine(Promise* awaited) {
+    const CallFrame& frame = frames[frameCount - 1];
+    Coroutine* coroutine = asCoroutine(frame.coroutine);
+    FunctionProto* proto = frame.proto;
+    size_t pc = framePc(frame);
+
+    // Only the registers live at the Await survive; the others may hold
+    // values the collector no longer knows about
+    const StackMap& map = proto->stackMap;
+    Value* saved = coroutine->registers();
+    for (int reg = 0; reg < proto->numRegisters; ++reg) {
+        Value value = map.empty() || map.isLive(pc, reg) ? frame.base[reg] : Value::undefined();
+        saved[reg] = value;
+        heap.writeBarrier(coroutine, value);
+    }
+    coroutine->pc = static_cast<uint32_t>(pc);
+    coroutine->flags |= kCoroutineSuspended;
+
+    heap.preWriteBarrier(coroutine->nextWaiter);
+    coroutine->nextWaiter = awaited->waiters;
+    heap.writeBarrier(coroutine, coroutine->nextWaiter);
+    heap.preWriteBarrier(awaited->waiters);
+    awaited->waiters = Value::object(coroutine);
+    heap.writeBarrier(awaited, awaited->waiters);
+
+    // The collector may run while a wild async function waits
+    if (SE_UNLIKELY(proto->isWild)) {
+        heap.resumeCollection();
+    }
+}
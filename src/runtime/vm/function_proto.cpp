@@ -0,0 +1,62 @@
+#include "runtime/vm/function_proto.h"
+#include <sstream>
+
+std::string disassemble(const FunctionProto& proto) {
+    std::ostringstream out;
+    out << "function " << proto.name << " (params: " << proto.numParams
+        << ", registers: " << proto.numRegisters << ")\n";
+    for (size_t i = 0; i < proto.code.size(); ++i) {
+        const Instruction& insn = proto.code[i];
+        const OpcodeInfo& info = opcodeInfo(insn.op);
+        out << "  " << i << ": " << info.name;
+        const int32_t operands[3] = {insn.a, insn.b, insn.c};
+        for (int j = 0; j < 3; ++j) {
+            switch (info.operands[j]) {
+                case OperandKind::None: continue;
+                case OperandKind::RegRead:
+                case OperandKind::RegWrite:
+                case OperandKind::RegPair: out << " r" << operands[j]; break;
+                case OperandKind::Const: out << " k" << operands[j]; break;
+                case OperandKind::Imm: out << " #" << operands[j]; break;
+                case OperandKind::Target: out << " @" << operands[j]; break;
+                case OperandKind::Global: out << " g" << operands[j]; break;
+                case OperandKind::Cache: out << " ic" << operands[j]; break;
+                case OperandKind::Class: out << " class" << operands[j]; break;
+                case OperandKind::Field: out << " field" << operands[j]; break;
+                case OperandKind::Count: out << " argc=" << operands[j]; break;
+                case OperandKind::Lock: out << " lock" << operands[j]; break;
+            }
+        }
+        out << "\n";
+    }
+    return out.str();
+}
+
+void eraseInstructions(FunctionProto& proto, const std::vector<bool>& removed) {
+    std::vector<Instruction>& code = proto.code;
+    size_t count = code.size();
+    std::vector<int32_t> newIndex(count + 1);
+    int32_t next = 0;
+    for (size_t i = 0; i < count; ++i) {
+        newIndex[i] = next;
+        if (!removed[i]) {
+            ++next;
+        }
+    }
+    newIndex[count] = next;
+    std::vector<Instruction> compacted;
+    compacted.reserve(static_cast<size_t>(next));
+    for (size_t i = 0; i < count; ++i) {
+        if (removed[i]) {
+            continue;
+        }
+        Instruction insn = code[i];
+        if (insn.op == Opcode::Jump) {
+            insn.a = newIndex[static_cast<size_t>(insn.a)];
+        } else if (insn.op == Opcode::JumpIfTrue || insn.op == Opcode::JumpIfFalse) {
+            insn.b = newIndex[static_cast<size_t>(insn.b)];
+        }
+        compacted.push_back(insn);
+    }
+    code = std::move(compacted);
+}
@@ -0,0 +1,81 @@
+#ifndef FUNCTION_PROTO_H
+#define FUNCTION_PROTO_H
+
+#include "runtime/concurrency/adaptive_lock.h"
+#include "runtime/vm/opcodes.h"
+#include "runtime/vm/value.h"
+#include "runtime/vm/inline_cache.h"
+#include "runtime/vm/stack_map.h"
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One bytecode instruction: an opcode and three 32-bit operands whose
+// meaning is described by opcodeInfo()
+struct Instruction {
+    Opcode op;
+    int32_t a;
+    int32_t b;
+    int32_t c;
+};
+
+// Instruction rewritten for direct threading: the opcode is replaced by the
+// address of its handler inside the interpreter loop. Operands are unchanged,
+// so instruction indices (and therefore jump targets) are identical.
+struct ThreadedInstruction {
+    const void* handler;
+    int32_t a;
+    int32_t b;
+    int32_t c;
+};
+
+struct JitCode;
+class ClassLayout;
+
+// Field operand of GetField/SetField: a declared field of a class
+struct FieldRef {
+    const ClassLayout* layout;
+    uint32_t index; // Into the layout's fields
+};
+
+// Compiled function: bytecode plus everything needed to run it.
+// Owned by the VM; script-visible FunctionObjects point at it.
+struct FunctionProto {
+    std::string name;
+    int numParams = 0;     // Parameters arrive in registers 0 .. numParams-1
+    int numRegisters = 0;  // Size of the register window for one activation
+    std::vector<Instruction> code;
+    std::vector<Value> constants;
+    std::vector<PropertyCache> propertyCaches; // One per GetProp/SetProp site
+    std::vector<const ClassLayout*> classes;   // NewInstance operands (owned by the VM)
+    std::vector<FieldRef> fieldRefs;           // GetField/SetField operands
+    std::deque<LockSite> lockSites;            // One per Lock site, with its contention counters
+    StackMap stackMap; // Live registers per instruction, for the collector
+    bool isWild = false; // `wild function`: no collection while an activation is live
+    bool isAsync = false; // `async function`: calls return a promise, may `await`
+    // Part of a program proven GC-free, running with the collector off: no
+    // stack map, and compiled code skips safepoint polls and write barriers
+    bool gcFree = false;
+
+    // Direct-threaded copy of `code`, built lazily by the interpreter the
+    // first time the function runs (only used with computed-goto dispatch)
+    std::vector<ThreadedInstruction> threadedCode;
+
+    // Tier-up state (see BaselineJit)
+    uint32_t hotness = 0;        // Invocations plus loop back-edges so far
+    uint32_t deoptCount = 0;
+    bool jitDisabled = false;    // Compilation failed or deopts kept happening
+    std::shared_ptr<JitCode> jitCode;
+};
+
+// Returns a human readable listing of the function's bytecode
+std::string disassemble(const FunctionProto& proto);
+
+// Deletes the instructions flagged in `removed` (one flag per instruction)
+// and remaps jump targets; a jump to a deleted instruction lands on the
+// next one kept. For optimization passes, before the stack map is built.
+void eraseInstructions(FunctionProto& proto, const std::vector<bool>& removed);
+
+#endif // FUNCTION_PROTO_H
@@ -0,0 +1,204 @@
+#ifndef HEAP_OBJECT_H
+#define HEAP_OBJECT_H
+
+#include "runtime/vm/value.h"
+#include <cstdint>
+#include <string_view>
+
+class ClassLayout;
+struct FunctionProto;
+class Shape;
+
+// Kinds of objects that live on the managed heap
+enum class ObjectKind : uint8_t {
+    String,
+    Object,
+    Function,
+    ValueArray,
+    Instance,
+    Promise,
+    Coroutine,
+    Free        // Unused old-generation space; `length` is its size in bytes
+};
+
+// HeapObject::gcBits flags
+constexpr uint8_t kGcMarked = 1;    // Reached by the current major collection
+constexpr uint8_t kGcForwarded = 2; // Nursery object already copied; the new
+                                    // address is stored right after the header
+
+// Common header for every heap object.
+// Heap objects are plain data: they hold no C++ resources and store any
+// variable-sized payload inline after the header, so the collector can move
+// them with memcpy and free them without running destructors.
+struct HeapObject {
+    ObjectKind kind;
+    uint8_t gcBits;    // Reserved for the garbage collector
+    uint16_t flags;    // Per-kind flags
+    uint32_t length;   // Per-kind length (characters, elements, ...)
+
+    bool is(ObjectKind k) const { return kind == k; }
+};
+
+static_assert(sizeof(HeapObject) == 8, "HeapObject header must stay one word");
+
+// String::flags
+constexpr uint16_t kStringTwoByte = 1;   // UTF-16 code units rather than Latin-1
+constexpr uint16_t kStringRope = 2;      // Concatenation node (RopeString)
+constexpr uint16_t kStringFlattened = 4; // Rope whose `left` now holds the flat result
+constexpr uint16_t kStringInterned = 8;  // The unique atom for its contents (VM::intern)
+
+// Immutable string; `length` counts UTF-16 code units. A flat string stores
+// its characters directly after the struct, one byte each (Latin-1) or two
+// (kStringTwoByte). Concatenations that are not short make a RopeString
+// instead; see runtime/vm/string_ops.h for operations on either.
+struct String : HeapObject {
+    uint32_t hash;     // Cached hash, 0 when not yet computed
+    uint32_t padding;
+
+    bool isTwoByte() const { return (flags & kStringTwoByte) != 0; }
+    bool isRope() const { return (flags & kStringRope) != 0; }
+    bool isInterned() const { return (flags & kStringInterned) != 0; }
+
+    // Flat strings only
+    char* chars() { return reinterpret_cast<char*>(this + 1); }
+    const char* chars() const { return reinterpret_cast<const char*>(this + 1); }
+    char16_t* twoByteChars() { return reinterpret_cast<char16_t*>(this + 1); }
+    const char16_t* twoByteChars() const { return reinterpret_cast<const char16_t*>(this + 1); }
+    char16_t charAt(uint32_t index) const {
+        return isTwoByte() ? twoByteChars()[index] : static_cast<unsigned char>(chars()[index]);
+    }
+    // Flat one-byte strings only
+    std::string_view view() const { return std::string_view(chars(), length); }
+
+    static size_t allocationSize(uint32_t length, bool twoByte = false) {
+        return sizeof(String) + (twoByte ? 2 * static_cast<size_t>(length) : length);
+    }
+};
+
+// Lazy concatenation of two strings, flattened into a flat copy the first
+// time its characters are needed. The copy is kept in `left` (and `right`
+// cleared) so later reads go straight to it.
+struct RopeString : String {
+    Value left;
+    Value right;
+};
+
+// Fixed-size array of values, stored directly after the struct; used as
+// out-of-line storage by other objects
+struct ValueArray : HeapObject {
+    Value* items() { return reinterpret_cast<Value*>(this + 1); }
+    const Value* items() const { return reinterpret_cast<const Value*>(this + 1); }
+
+    static size_t allocationSize(uint32_t length) { return sizeof(ValueArray) + sizeof(Value) * length; }
+};
+
+// Ordinary script object. The shape maps property keys to slot numbers;
+// the first kInlineSlots slots are stored in the object itself and the rest
+// in the `overflow` array.
+struct Object : HeapObject {
+    static constexpr uint32_t kInlineSlots = 4;
+
+    Shape* shape;
+    ValueArray* overflow;  // Slots kInlineSlots and up, or nullptr
+    Value inlineSlots[kInlineSlots];
+
+    // Number of slots the object can hold without growing `overflow`
+    uint32_t slotCapacity() const {
+        return kInlineSlots + (overflow ? overflow->length : 0);
+    }
+
+    Value* slotAddress(uint32_t slot) {
+        return slot < kInlineSlots ? &inlineSlots[slot] : &overflow->items()[slot - kInlineSlots];
+    }
+    const Value* slotAddress(uint32_t slot) const {
+        return slot < kInlineSlots ? &inlineSlots[slot] : &overflow->items()[slot - kInlineSlots];
+    }
+};
+
+// Script function: a thin heap wrapper around a compiled FunctionProto,
+// which is owned by the VM and never moves.
+struct FunctionObject : HeapObject {
+    FunctionProto* proto;
+};
+
+// Instance of a class with declared fields. The fields sit directly after
+// the struct at offsets fixed by the class's ClassLayout, typed ones
+// unboxed; `length` is the size of that field area in bytes. Properties the
+// class does not declare go to the plain object in `expando`, created on
+// the first such store.
+struct Instance : HeapObject {
+    const ClassLayout* layout; // Owned by the VM, never moves
+    Value expando;             // Plain object, or undefined
+
+    // Field storage at a byte offset from the start of the instance
+    template <typename T>
+    T* fieldAt(uint32_t offset) { return reinterpret_cast<T*>(reinterpret_cast<char*>(this) + offset); }
+    template <typename T>
+    const T* fieldAt(uint32_t offset) const {
+        return reinterpret_cast<const T*>(reinterpret_cast<const char*>(this) + offset);
+    }
+
+    static size_t allocationSize(uint32_t fieldBytes) { return sizeof(Instance) + fieldBytes; }
+};
+
+// Promise::flags
+constexpr uint16_t kPromiseFulfilled = 1;
+constexpr uint16_t kPromiseRejected = 2;
+// Coroutine::flags, next to the state of its promise
+constexpr uint16_t kCoroutineSuspended = 4; // Registers saved, waiting on a promise
+
+// Eventual result of an asynchronous computation. Pending until settled
+// once, as fulfilled with a value or rejected with a reason. Coroutines
+// waiting on a pending promise are chained from `waiters` through
+// Coroutine::nextWaiter, most recent first.
+struct Promise : HeapObject {
+    Value result;  // Value or rejection reason, once settled
+    Value waiters; // Coroutine, or undefined
+
+    bool isSettled() const { return (flags & (kPromiseFulfilled | kPromiseRejected)) != 0; }
+    bool isRejected() const { return (flags & kPromiseRejected) != 0; }
+};
+
+// Activation of an async function, doubling as the promise of its result
+// so an async call allocates exactly one object. The frame is stackless:
+// while the function runs its registers live on the VM stack like any
+// other frame's, and an `await` of a pending promise copies them here and
+// pops the frame. The register area after the struct is sized by the
+// compiler (`length` is the function's numRegisters) and only holds values
+// while kCoroutineSuspended is set; the registers the stack map declares
+// dead at the await are stored as undefined.
+struct Coroutine : Promise {
+    FunctionProto* proto;
+    Value nextWaiter; // Next coroutine waiting on the same promise
+    uint32_t pc;      // Await instruction the frame is suspended at
+    uint32_t padding;
+
+    Value* registers() { return reinterpret_cast<Value*>(this + 1); }
+    const Value* registers() const { return reinterpret_cast<const Value*>(this + 1); }
+    bool isSuspended() const { return (flags & kCoroutineSuspended) != 0; }
+
+    static size_t allocationSize(uint32_t registerCount) {
+        return sizeof(Coroutine) + sizeof(Value) * registerCount;
+    }
+};
+
+// Casting helpers
+inline bool isString(Value v) { return v.isObject() && v.asObject()->is(ObjectKind::String); }
+inline bool isPlainObject(Value v) { return v.isObject() && v.asObject()->is(ObjectKind::Object); }
+inline bool isFunction(Value v) { return v.isObject() && v.asObject()->is(ObjectKind::Function); }
+inline bool isInstance(Value v) { return v.isObject() && v.asObject()->is(ObjectKind::Instance); }
+inline bool isCoroutine(Value v) { return v.isObject() && v.asObject()->is(ObjectKind::Coroutine); }
+inline bool isPromise(Value v) {
+    return v.isObject() && (v.asObject()->is(ObjectKind::Promise) || v.asObject()->is(ObjectKind::Coroutine));
+}
+
+inline String* asString(Value v) { return static_cast<String*>(v.asObject()); }
+inline RopeString* asRope(String* str) { return static_cast<RopeString*>(str); }
+inline const RopeString* asRope(const String* str) { return static_cast<const RopeString*>(str); }
+inline Object* asPlainObject(Value v) { return static_cast<Object*>(v.asObject()); }
+inline FunctionObject* asFunction(Value v) { return static_cast<FunctionObject*>(v.asObject()); }
+inline Instance* asInstance(Value v) { return static_cast<Instance*>(v.asObject()); }
+inline Promise* asPromise(Value v) { return static_cast<Promise*>(v.asObject()); }
+inline Coroutine* asCoroutine(Value v) { return static_cast<Coroutine*>(v.asObject()); }
+
+#endif // HEAP_OBJECT_H
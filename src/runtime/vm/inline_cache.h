@@ -0,0 +1,61 @@
+#ifndef INLINE_CACHE_H
+#define INLINE_CACHE_H
+
+#include <cstdint>
+
+class Shape;
+struct String;
+
+// Inline cache for one property access site (a GetProp or SetProp
+// instruction). It remembers the shapes seen at the site and where the
+// property lives for each of them, so a hit costs one pointer comparison
+// per entry instead of a lookup.
+//
+//   uninitialized -> monomorphic (1 entry) -> polymorphic (up to
+//   kMaxEntries) -> megamorphic (stops caching, uses the shape's lookup)
+//
+// For stores, an entry may also describe an add-property transition:
+// objects with `shape` move to `newShape` and store into `slot`.
+struct PropertyCache {
+    static constexpr int kMaxEntries = 4;
+
+    struct Entry {
+        Shape* shape;
+        Shape* newShape; // Non-null for add-property store entries
+        uint32_t slot;
+    };
+
+    const String* key = nullptr;
+    uint8_t count = 0;
+    bool megamorphic = false;
+    Entry entries[kMaxEntries] = {};
+
+    explicit PropertyCache(const String* k = nullptr) : key(k) {}
+
+    // Records a new entry, going megamorphic when the cache is full. Hits
+    // can still miss (stores to overflow slots in compiled code, cached
+    // transitions racing with another task), so entries already present
+    // are not added again.
+    void add(Shape* shape, Shape* newShape, uint32_t slot) {
+        if (megamorphic) {
+            return;
+        }
+        for (int i = 0; i < count; ++i) {
+            if (entries[i].shape == shape && entries[i].newShape == newShape) {
+                return;
+            }
+        }
+        if (count == kMaxEntries) {
+            // Clear the entries too: compiled code probes all of them
+            megamorphic = true;
+            count = 0;
+            for (Entry& entry : entries) {
+                entry = Entry{};
+            }
+            return;
+        }
+        entries[count++] = Entry{shape, newShape, slot};
+    }
+};
+
+#endif // INLINE_CACHE_H
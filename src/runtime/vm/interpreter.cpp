@@ -0,0 +1,648 @@
+#include "compiler/codegen/baseline_jit.h"
+#include "runtime/vm/config.h"
+#include "runtime/vm/object.h"
+#include "runtime/vm/slow_paths.h"
+#include "runtime/vm/vm.h"
+#include "runtime/vm/wild_object.h"
+
+// The interpreter loop.
+//
+// With SE_COMPUTED_GOTO the loop is direct threaded: the first time a
+// function runs its bytecode is rewritten into ThreadedInstructions whose
+// first word is the address of the handler label, and every handler ends
+// with `goto *ip->handler`. Each handler thus gets its own indirect branch,
+// which predicts far better than the single shared branch of a switch.
+// Without computed goto the same handlers are compiled as switch cases.
+//
+// Small-int and double arithmetic and comparisons are handled inline; any
+// other operand types go to the out-of-line functions in slow_paths.h.
+//
+// Tier-up: calls and loop back-edges bump a function's hotness. Once it
+// reaches BaselineJit::kHotnessThreshold the function is compiled, and from
+// then on the interpreter enters the machine code at function entry, at
+// loop headers and after calls return. Compiled code runs on the same
+// register window and comes back here for calls, returns and deopts.
+//
+// Safepoints: the garbage collector only runs at function entry and at
+// loop back-edges, when the heap has requested a collection. The current
+// frame's ip is stored first so the stack maps can find its live registers.
+
+static SE_ALWAYS_INLINE bool fitsInt32(int64_t i) {
+    return i >= INT32_MIN && i <= INT32_MAX;
+}
+
+#if SE_COMPUTED_GOTO
+using Insn = ThreadedInstruction;
+
+// Rewrites a function's bytecode into direct-threaded form
+static void threadCode(FunctionProto* proto, const void* const* labels) {
+    proto->threadedCode.clear();
+    proto->threadedCode.reserve(proto->code.size());
+    for (const Instruction& insn : proto->code) {
+        proto->threadedCode.push_back(
+            ThreadedInstruction{labels[static_cast<int>(insn.op)], insn.a, insn.b, insn.c});
+    }
+}
+
+static SE_ALWAYS_INLINE const Insn* codeFor(FunctionProto* proto, const void* const* labels) {
+    if (SE_UNLIKELY(proto->threadedCode.size() != proto->code.size())) {
+        threadCode(proto, labels);
+    }
+    return proto->threadedCode.data();
+}
+#else
+using Insn = Instruction;
+
+static SE_ALWAYS_INLINE const Insn* codeFor(FunctionProto* proto, const void* const*) {
+    return proto->code.data();
+}
+#endif
+
+SE_NOINLINE void VM::tierUp(FunctionProto* proto) {
+    proto->hotness = 0;
+    if (!jitEnabled || proto->jitDisabled) {
+        return;
+    }
+    proto->jitCode = BaselineJit::compile(*proto);
+    if (!proto->jitCode) {
+        proto->jitDisabled = true;
+    }
+}
+
+size_t VM::framePc(const CallFrame& frame) const {
+#if SE_COMPUTED_GOTO
+    return static_cast<size_t>(static_cast<const Insn*>(frame.ip) - frame.proto->threadedCode.data());
+#else
+    return static_cast<size_t>(static_cast<const Insn*>(frame.ip) - frame.proto->code.data());
+#endif
+}
+
+Value VM::execute(size_t entryDepth, size_t startPc) {
+#if SE_COMPUTED_GOTO
+    static const void* const labels[kOpcodeCount] = {
+#define SE_OPCODE_LABEL(name, a, b, c) &&op_##name,
+        SE_OPCODES(SE_OPCODE_LABEL)
+#undef SE_OPCODE_LABEL
+    };
+#else
+    const void* const* labels = nullptr;
+#endif
+
+    CallFrame* frame = &frames[frameCount - 1];
+    FunctionProto* proto = frame->proto;
+    Value* regs = frame->base;
+    const Value* constants = proto->constants.data();
+    PropertyCache* caches = proto->propertyCaches.data();
+    const Insn* code = codeFor(proto, labels);
+    const Insn* ip = code + startPc;
+    Value result;
+#if SE_ENABLE_JIT
+    JitContext jit{this, nullptr, heap.collectionRequestedFlag(), heap.markingFlag(), 0, 0};
+    uint64_t jitPc = 0;
+#endif
+
+#define R(n) regs[n]
+#define OP_A (ip->a)
+#define OP_B (ip->b)
+#define OP_C (ip->c)
+
+#if SE_COMPUTED_GOTO
+#define DISPATCH() goto *ip->handler
+#define CASE(name) op_##name:
+#else
+#define DISPATCH() goto dispatch
+#define CASE(name) case Opcode::name:
+#endif
+#define NEXT() do { ++ip; DISPATCH(); } while (0)
+#define JUMP_TO(target) do { ip = code + (target); DISPATCH(); } while (0)
+
+    // Reloads the cached frame state after a call or return
+#define LOAD_FRAME() do { \
+        frame = &frames[frameCount - 1]; \
+        proto = frame->proto; \
+        regs = frame->base; \
+        constants = proto->constants.data(); \
+        caches = proto->propertyCaches.data(); \
+        code = codeFor(proto, labels); \
+    } while (0)
+
+    // Integer fast path shared by Add/Sub: compute in 64 bits, keep the
+    // result unboxed when it still fits
+#define INT_ARITH(expr) do { \
+        int64_t res = (expr); \
+        if (SE_LIKELY(Value::fitsInt(res))) { \
+            R(OP_A) = Value::integer(res); \
+            NEXT(); \
+        } \
+    } while (0)
+
+#if SE_ENABLE_JIT
+    // Counts one unit of hotness for the current function, then runs its
+    // machine code from bytecode index `pc` if it has any
+#define TIER_UP_AT(pc) do { \
+        if (!proto->jitCode && SE_UNLIKELY(++proto->hotness >= BaselineJit::kHotnessThreshold)) { \
+            tierUp(proto); \
+        } \
+        if (proto->jitCode) { \
+            jitPc = (pc); \
+            goto runJit; \
+        } \
+    } while (0)
+#else
+#define TIER_UP_AT(pc) do { } while (0)
+#endif
+
+    // Runs a pending garbage collection with the frame stopped before `pc`
+#define SAFEPOINT(pc) do { \
+        if (SE_UNLIKELY(heap.collectionRequested())) { \
+            frame->ip = code + (pc); \
+            heap.collect(); \
+        } \
+    } while (0)
+
+    // Backward branches are loop back-edges
+#define BRANCH_TO(target) do { \
+        if ((target) <= ip - code) { \
+            SAFEPOINT(target); \
+            TIER_UP_AT(target); \
+        } \
+        JUMP_TO(target); \
+    } while (0)
+
+#define COMPARE(name, op) \
+    CASE(name) { \
+        Value l = R(OP_B), r = R(OP_C); \
+        if (SE_LIKELY(Value::bothInt(l, r))) { \
+            R(OP_A) = Value::boolean(l.asInt() op r.asInt()); \
+        } else if (l.isNumber() && r.isNumber()) { \
+            R(OP_A) = Value::boolean(l.toNumber() op r.toNumber()); \
+        } else { \
+            R(OP_A) = Value::boolean(slowCompare(Opcode::name, l, r)); \
+        } \
+        NEXT(); \
+    }
+
+    // Int updates that stay in range try one compare-and-swap inline; a lost
+    // race, overflow or other operands go through the retrying slow path
+#define ATOMIC_ARITH(name, op, binop) \
+    CASE(name) { \
+        Value* slot = &globals[OP_B]; \
+        Value old = Value::loadAtomic(slot); \
+        Value operand = R(OP_C); \
+        if (SE_LIKELY(Value::bothInt(old, operand))) { \
+            int64_t res = old.asInt() binop operand.asInt(); \
+            if (SE_LIKELY(Value::fitsInt(res)) && Value::compareExchange(slot, old, Value::integer(res))) { \
+                R(OP_A) = old; \
+                NEXT(); \
+            } \
+        } \
+        R(OP_A) = atomicArithmetic(*this, Opcode::op, slot, operand); \
+        NEXT(); \
+    }
+
+    SAFEPOINT(startPc);
+    if (startPc == 0) {
+        TIER_UP_AT(0);
+    }
+#if SE_COMPUTED_GOTO
+    DISPATCH();
+#else
+dispatch:
+    switch (ip->op) {
+#endif
+
+    CASE(LoadConst) {
+        R(OP_A) = constants[OP_B];
+        NEXT();
+    }
+    CASE(LoadInt) {
+        R(OP_A) = Value::integer(OP_B);
+        NEXT();
+    }
+    CASE(LoadUndefined) {
+        R(OP_A) = Value::undefined();
+        NEXT();
+    }
+    CASE(LoadNull) {
+        R(OP_A) = Value::null();
+        NEXT();
+    }
+    CASE(LoadTrue) {
+        R(OP_A) = Value::boolean(true);
+        NEXT();
+    }
+    CASE(LoadFalse) {
+        R(OP_A) = Value::boolean(false);
+        NEXT();
+    }
+    CASE(Move) {
+        R(OP_A) = R(OP_B);
+        NEXT();
+    }
+
+    CASE(Add) {
+        Value l = R(OP_B), r = R(OP_C);
+        if (SE_LIKELY(Value::bothInt(l, r))) {
+            INT_ARITH(l.asInt() + r.asInt());
+        } else if (l.isNumber() && r.isNumber()) {
+            R(OP_A) = Value::number(l.toNumber() + r.toNumber());
+            NEXT();
+        }
+        R(OP_A) = slowAdd(*this, l, r);
+        NEXT();
+    }
+    CASE(Sub) {
+        Value l = R(OP_B), r = R(OP_C);
+        if (SE_LIKELY(Value::bothInt(l, r))) {
+            INT_ARITH(l.asInt() - r.asInt());
+        } else if (l.isNumber() && r.isNumber()) {
+            R(OP_A) = Value::number(l.toNumber() - r.toNumber());
+            NEXT();
+        }
+        R(OP_A) = slowArithmetic(Opcode::Sub, l, r);
+        NEXT();
+    }
+    CASE(Mul) {
+        Value l = R(OP_B), r = R(OP_C);
+        if (SE_LIKELY(Value::bothInt(l, r))) {
+            int64_t x = l.asInt(), y = r.asInt();
+            // Operands within 32 bits cannot overflow the 64-bit product.
+            // A zero product with a negative operand is -0, which needs a double.
+            if (SE_LIKELY(fitsInt32(x) && fitsInt32(y))) {
+                int64_t res = x * y;
+                if (SE_LIKELY(Value::fitsInt(res) && (res != 0 || (x >= 0 && y >= 0)))) {
+                    R(OP_A) = Value::integer(res);
+                    NEXT();
+                }
+            }
+        } else if (l.isNumber() && r.isNumber()) {
+            R(OP_A) = Value::number(l.toNumber() * r.toNumber());
+            NEXT();
+        }
+        R(OP_A) = slowArithmetic(Opcode::Mul, l, r);
+        NEXT();
+    }
+    CASE(Div) {
+        Value l = R(OP_B), r = R(OP_C);
+        if (SE_LIKELY(Value::bothInt(l, r))) {
+            int64_t x = l.asInt(), y = r.asInt();
+            // Stay in ints only for exact quotients that are not -0
+            if (y != 0 && x % y == 0 && (x != 0 || y > 0)) {
+                INT_ARITH(x / y);
+            }
+        }
+        if (l.isNumber() && r.isNumber()) {
+            R(OP_A) = Value::number(l.toNumber() / r.toNumber());
+            NEXT();
+        }
+        R(OP_A) = slowArithmetic(Opcode::Div, l, r);
+        NEXT();
+    }
+    CASE(Mod) {
+        Value l = R(OP_B), r = R(OP_C);
+        if (SE_LIKELY(Value::bothInt(l, r))) {
+            int64_t x = l.asInt(), y = r.asInt();
+            // A zero remainder of a negative dividend is -0
+            if (y != 0 && (x >= 0 || x % y != 0)) {
+                R(OP_A) = Value::integer(x % y);
+                NEXT();
+            }
+        }
+        R(OP_A) = slowArithmetic(Opcode::Mod, l, r);
+        NEXT();
+    }
+    CASE(Neg) {
+        Value v = R(OP_B);
+        if (SE_LIKELY(v.isInt() && v.asInt() != 0)) {
+            INT_ARITH(-v.asInt());
+        } else if (v.isDouble()) {
+            R(OP_A) = Value::number(-v.asDouble());
+            NEXT();
+        }
+        R(OP_A) = slowNegate(v);
+        NEXT();
+    }
+    CASE(Not) {
+        Value v = R(OP_B);
+        R(OP_A) = Value::boolean(!(v.isBoolean() ? v.asBoolean() : toBoolean(v)));
+        NEXT();
+    }
+
+    CASE(Eq) {
+        Value l = R(OP_B), r = R(OP_C);
+        R(OP_A) = Value::boolean(SE_LIKELY(Value::bothInt(l, r)) ? l.asInt() == r.asInt() : strictEquals(l, r));
+        NEXT();
+    }
+    CASE(Ne) {
+        Value l = R(OP_B), r = R(OP_C);
+        R(OP_A) = Value::boolean(SE_LIKELY(Value::bothInt(l, r)) ? l.asInt() != r.asInt() : !strictEquals(l, r));
+        NEXT();
+    }
+    COMPARE(Lt, <)
+    COMPARE(Le, <=)
+    COMPARE(Gt, >)
+    COMPARE(Ge, >=)
+
+    CASE(Jump) {
+        BRANCH_TO(OP_A);
+    }
+    CASE(JumpIfTrue) {
+        Value v = R(OP_A);
+        if (v.isBoolean() ? v.asBoolean() : toBoolean(v)) {
+            BRANCH_TO(OP_B);
+        }
+        NEXT();
+    }
+    CASE(JumpIfFalse) {
+        Value v = R(OP_A);
+        if (!(v.isBoolean() ? v.asBoolean() : toBoolean(v))) {
+            BRANCH_TO(OP_B);
+        }
+        NEXT();
+    }
+
+    CASE(GetGlobal) {
+        R(OP_A) = globals[OP_B];
+        NEXT();
+    }
+    CASE(SetGlobal) {
+        globals[OP_A] = R(OP_B);
+        NEXT();
+    }
+    ATOMIC_ARITH(AtomicAddGlobal, Add, +)
+    ATOMIC_ARITH(AtomicSubGlobal, Sub, -)
+    CASE(CompareAndSetGlobal) {
+        Value* slot = &globals[OP_B];
+        Value expected = R(OP_C);
+        if (SE_LIKELY(expected.isInt())) {
+            // Equal to an int means the same bits, unless the slot holds a double
+            Value seen = expected;
+            if (Value::compareExchange(slot, seen, R(OP_C + 1)) || seen.isInt()) {
+                R(OP_A) = Value::boolean(seen == expected);
+                NEXT();
+            }
+        }
+        R(OP_A) = Value::boolean(atomicCompareAndSet(slot, expected, R(OP_C + 1)));
+        NEXT();
+    }
+
+    CASE(NewObject) {
+        R(OP_A) = Value::object(heap.allocateObject(shapes.root()));
+        NEXT();
+    }
+    CASE(NewWild) {
+        R(OP_A) = Value::wild(WildObject::create(wildHeap, static_cast<uint32_t>(OP_B)));
+        NEXT();
+    }
+    // `ref` of a GC value is the value itself, so these ignore non-wild values
+    CASE(WildRetain) {
+        if (R(OP_A).isWild()) {
+            R(OP_A).asWild()->retain();
+        }
+        NEXT();
+    }
+    CASE(WildCheck) {
+        if (R(OP_A).isWild() && SE_UNLIKELY(R(OP_A).asWild()->isDestroyed())) {
+            R(OP_A).asWild()->throwInvalid();
+        }
+        NEXT();
+    }
+    CASE(WildRelease) {
+        if (R(OP_A).isWild()) {
+            R(OP_A).asWild()->release();
+        }
+        NEXT();
+    }
+    CASE(Destroy) {
+        if (!R(OP_A).isWild()) {
+            throw RuntimeError("Only wild objects can be destroyed");
+        }
+        R(OP_A).asWild()->destroy();
+        NEXT();
+    }
+    CASE(EnterRegion) {
+        regions.enter();
+        NEXT();
+    }
+    CASE(ExitRegion) {
+        regions.exit();
+        NEXT();
+    }
+    CASE(NewScopedWild) {
+        R(OP_A) = Value::wild(WildObject::createScoped(regions, static_cast<uint32_t>(OP_B)));
+        NEXT();
+    }
+    CASE(Lock) {
+        Value target = R(OP_B);
+        if (SE_UNLIKELY(!target.isWild())) {
+            throw RuntimeError("Run.lock needs a wild object");
+        }
+        WildObject* obj = target.asWild();
+        if (SE_UNLIKELY(obj->isDestroyed())) {
+            obj->throwInvalid();
+        }
+        R(OP_A) = SE_LIKELY(obj->lock.tryLock()) ? target : lockContended(obj, proto->lockSites[OP_C]);
+        NEXT();
+    }
+    CASE(Unlock) {
+        Value target = R(OP_A);
+        if (SE_UNLIKELY(!target.isWild() || !target.asWild()->lock.isLocked())) {
+            throw RuntimeError("Wild object is not locked");
+        }
+        target.asWild()->lock.unlock();
+        NEXT();
+    }
+    CASE(Transfer) {
+        Value source = R(OP_B);
+        if (!source.isWild()) {
+            throw RuntimeError("Only wild objects can be transferred");
+        }
+        if (SE_UNLIKELY(source.asWild()->isDestroyed())) {
+            source.asWild()->throwInvalid();
+        }
+        // Invalidate the source first so `transfer x` into x keeps the object
+        R(OP_B) = Value::wild(WildObject::transferred());
+        R(OP_A) = source;
+        NEXT();
+    }
+    CASE(GetProp) {
+        // Inline cache probe: one shape comparison per cached entry
+        Value target = R(OP_B);
+        const PropertyCache& cache = caches[OP_C];
+        if (SE_LIKELY(isPlainObject(target))) {
+            const Object* obj = asPlainObject(target);
+            const Shape* shape = loadShape(obj);
+            for (int i = 0; i < cache.count; ++i) {
+                if (cache.entries[i].shape == shape) {
+                    R(OP_A) = loadSlot(obj, cache.entries[i].slot);
+                    NEXT();
+                }
+            }
+        }
+        R(OP_A) = getPropertyMiss(*this, target, caches[OP_C]);
+        NEXT();
+    }
+    CASE(SetProp) {
+        Value target = R(OP_A);
+        const PropertyCache& cache = caches[OP_B];
+        if (SE_LIKELY(isPlainObject(target))) {
+            Object* obj = asPlainObject(target);
+            const Shape* shape = loadShape(obj);
+            for (int i = 0; i < cache.count; ++i) {
+                const PropertyCache::Entry& entry = cache.entries[i];
+                if (entry.shape != shape) {
+                    continue;
+                }
+                if (!entry.newShape) {
+                    storeSlot(heap, obj, entry.slot, R(OP_C));
+                    NEXT();
+                }
+                // Cached add-property transition; needs room for the slot
+                if (tryCachedTransition(heap, obj, shape, entry.newShape, entry.slot, R(OP_C))) {
+                    NEXT();
+                }
+                break;
+            }
+        }
+        setPropertyMiss(*this, target, caches[OP_B], R(OP_C));
+        NEXT();
+    }
+    CASE(NewInstance) {
+        R(OP_A) = Value::object(heap.allocateInstance(proto->classes[OP_B]));
+        NEXT();
+    }
+    CASE(GetField) {
+        // Fixed layout: one layout comparison, then a load at a constant
+        // offset. Other values (instances of other classes included) take
+        // the generic path by name.
+        Value target = R(OP_B);
+        const FieldRef& ref = proto->fieldRefs[OP_C];
+        if (SE_LIKELY(isInstance(target) && asInstance(target)->layout == ref.layout)) {
+            R(OP_A) = loadField(asInstance(target), ref.layout->field(ref.index));
+            NEXT();
+        }
+        R(OP_A) = slowGetProperty(*this, target, ref.layout->field(ref.index).name);
+        NEXT();
+    }
+    CASE(SetField) {
+        Value target = R(OP_A);
+        const FieldRef& ref = proto->fieldRefs[OP_B];
+        if (SE_LIKELY(isInstance(target) && asInstance(target)->layout == ref.layout)) {
+            storeField(heap, asInstance(target), ref.layout->field(ref.index), R(OP_C));
+            NEXT();
+        }
+        slowSetProperty(*this, target, ref.layout->field(ref.index).name, R(OP_C));
+        NEXT();
+    }
+
+    CASE(Await) {
+        Value awaited = R(OP_B);
+        if (!isPromise(awaited)) {
+            R(OP_A) = awaited;
+            NEXT();
+        }
+        Promise* promise = asPromise(awaited);
+        if (promise->isSettled()) {
+            if (SE_UNLIKELY(promise->isRejected())) {
+                throwRejection(promise->result);
+            }
+            R(OP_A) = promise->result;
+            NEXT();
+        }
+        // Pending: save the frame into its coroutine and pop it. It is the
+        // entry frame of this loop (see coroutine.cpp).
+        frame->ip = ip;
+        suspendCoroutine(promise);
+        --frameCount;
+        return Value::undefined();
+    }
+
+    CASE(Call) {
+        frame->ip = ip;
+        if (SE_UNLIKELY(isFunction(R(OP_B)) && asFunction(R(OP_B))->proto->isAsync)) {
+            // Runs in a nested loop until the callee first suspends
+            R(OP_A) = callAsync(R(OP_B), regs + OP_B + 1, OP_C);
+            NEXT();
+        }
+        pushFrame(R(OP_B), regs + OP_B + 1, OP_C, OP_A);
+        LOAD_FRAME();
+        ip = code;
+        SAFEPOINT(0);
+        TIER_UP_AT(0);
+        DISPATCH();
+    }
+    CASE(Return) {
+        result = R(OP_A);
+        goto doReturn;
+    }
+    CASE(ReturnUndefined) {
+        result = Value::undefined();
+        goto doReturn;
+    }
+
+#if !SE_COMPUTED_GOTO
+    }
+    throw RuntimeError("Invalid opcode");
+#endif
+
+doReturn:
+    {
+        int returnRegister = frame->returnRegister;
+        if (SE_UNLIKELY(proto->isWild)) {
+            heap.resumeCollection();
+        }
+        --frameCount;
+        if (frameCount == entryDepth) {
+            return result;
+        }
+        LOAD_FRAME();
+        ip = static_cast<const Insn*>(frame->ip);
+        R(returnRegister) = result;
+#if SE_ENABLE_JIT
+        if (proto->jitCode) {
+            jitPc = static_cast<uint64_t>(ip - code) + 1;
+            goto runJit;
+        }
+#endif
+        NEXT();
+    }
+
+#if SE_ENABLE_JIT
+runJit:
+    {
+        jit.globals = globals.data();
+        JitExit exit = static_cast<JitExit>(proto->jitCode->entry(&jit, regs, jitPc));
+        if (exit == JitExit::Return) {
+            result = Value::fromBits(jit.result);
+            goto doReturn;
+        }
+        // Other exits resume in the interpreter at jit.pc
+        ip = code + jit.pc;
+        if (exit == JitExit::Safepoint) {
+            SAFEPOINT(jit.pc);
+        }
+        if (exit == JitExit::Deopt && SE_UNLIKELY(++proto->deoptCount >= BaselineJit::kMaxDeopts)) {
+            // Keeps failing its type guards: stay interpreted
+            proto->jitCode.reset();
+            proto->jitDisabled = true;
+        }
+        DISPATCH();
+    }
+#endif
+
+#undef R
+#undef OP_A
+#undef OP_B
+#undef OP_C
+#undef DISPATCH
+#undef CASE
+#undef NEXT
+#undef JUMP_TO
+#undef LOAD_FRAME
+#undef TIER_UP_AT
+#undef SAFEPOINT
+#undef BRANCH_TO
+#undef INT_ARITH
+#undef COMPARE
+#undef ATOMIC_ARITH
+}
@@ -0,0 +1,161 @@
+#include "runtime/vm/object.h"
+#include "runtime/memory/heap.h"
+#include "runtime/vm/shape.h"
+#include <algorithm>
+#include <thread>
+
+namespace {
+
+// The shape sequence lock in Object::length (see object.h)
+uint32_t loadSequence(const Object* obj) {
+    return __atomic_load_n(&obj->length, __ATOMIC_SEQ_CST);
+}
+
+void lockShape(Object* obj) {
+    for (;;) {
+        uint32_t seq = __atomic_load_n(&obj->length, __ATOMIC_RELAXED);
+        if ((seq & 1) == 0 &&
+            __atomic_compare_exchange_n(&obj->length, &seq, seq + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            return;
+        }
+        std::this_thread::yield();
+    }
+}
+
+bool tryLockShape(Object* obj) {
+    uint32_t seq = __atomic_load_n(&obj->length, __ATOMIC_RELAXED);
+    return (seq & 1) == 0 &&
+           __atomic_compare_exchange_n(&obj->length, &seq, seq + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+void unlockShape(Object* obj) {
+    __atomic_store_n(&obj->length, __atomic_load_n(&obj->length, __ATOMIC_RELAXED) + 1, __ATOMIC_RELEASE);
+}
+
+// Waits until no writer holds the lock and returns the sequence
+uint32_t stableSequence(const Object* obj) {
+    uint32_t seq;
+    while ((seq = loadSequence(obj)) & 1) {
+        std::this_thread::yield();
+    }
+    return seq;
+}
+
+// Grows the overflow storage so that `slots` slots fit. The shape lock must
+// be held.
+void ensureCapacity(Heap& heap, Object* obj, uint32_t slots) {
+    if (slots <= obj->slotCapacity()) {
+        return;
+    }
+    ValueArray* old = obj->overflow;
+    uint32_t oldLength = old ? old->length : 0;
+    uint32_t newLength = std::max(std::max<uint32_t>(4, oldLength * 2), slots - Object::kInlineSlots);
+    ValueArray* grown = heap.allocateValueArray(newLength);
+    for (uint32_t i = 0; i < oldLength; ++i) {
+        // Stores racing with the copy notice the lock and redo themselves
+        Value value = Value::loadAtomic(&old->items()[i]);
+        grown->items()[i] = value;
+        // The barrier for overflow slots is recorded on the owning object
+        heap.writeBarrier(obj, value);
+    }
+    if (old) {
+        heap.preWriteBarrier(Value::object(old));
+    }
+    __atomic_store_n(&obj->overflow, grown, __ATOMIC_RELEASE);
+    heap.writeBarrier(obj, Value::object(grown));
+}
+
+// Stores the value of a property being added, then publishes the shape
+// that has it. The shape lock must be held and the capacity ensured.
+void addSlot(Heap& heap, Object* obj, Shape* shape, uint32_t slot, Value value) {
+    heap.preWriteBarrier(Value::exchange(obj->slotAddress(slot), value));
+    heap.writeBarrier(obj, value);
+    __atomic_store_n(&obj->shape, shape, __ATOMIC_RELEASE);
+}
+
+} // namespace
+
+void storeSlot(Heap& heap, Object* obj, uint32_t slot, Value value) {
+    if (slot < Object::kInlineSlots) {
+        // Inline slots never move
+        heap.preWriteBarrier(Value::exchange(&obj->inlineSlots[slot], value));
+        heap.writeBarrier(obj, value);
+        return;
+    }
+    for (;;) {
+        uint32_t seq = stableSequence(obj);
+        ValueArray* overflow = __atomic_load_n(&obj->overflow, __ATOMIC_ACQUIRE);
+        Value old = Value::exchange(&overflow->items()[slot - Object::kInlineSlots], value);
+        // The exchange is ordered before this load, so either the storage
+        // was copied after it, or the sequence has moved on
+        if (loadSequence(obj) == seq) {
+            heap.preWriteBarrier(old);
+            heap.writeBarrier(obj, value);
+            return;
+        }
+    }
+}
+
+bool tryCachedTransition(Heap& heap, Object* obj, const Shape* from, Shape* to, uint32_t slot, Value value) {
+    if (!tryLockShape(obj)) {
+        return false;
+    }
+    bool fits = obj->shape == from && slot < obj->slotCapacity();
+    if (fits) {
+        addSlot(heap, obj, to, slot, value);
+    }
+    unlockShape(obj);
+    return fits;
+}
+
+Value getProperty(const Object* obj, const String* key) {
+    const Shape* shape = loadShape(obj);
+    if (shape->isDictionary()) {
+        auto* locked = const_cast<Object*>(obj);
+        lockShape(locked);
+        int slot = obj->shape->lookup(key);
+        Value value = slot < 0 ? Value::undefined() : *obj->slotAddress(static_cast<uint32_t>(slot));
+        unlockShape(locked);
+        return value;
+    }
+    int slot = shape->lookup(key);
+    if (slot < 0) {
+        return Value::undefined();
+    }
+    return loadSlot(obj, static_cast<uint32_t>(slot));
+}
+
+PropertyStore setProperty(Heap& heap, ShapeTree& shapes, Object* obj, const String* key, Value value) {
+    Shape* oldShape = loadShape(obj);
+    if (!oldShape->isDictionary()) {
+        int existing = oldShape->lookup(key);
+        if (existing >= 0) {
+            storeSlot(heap, obj, static_cast<uint32_t>(existing), value);
+            return PropertyStore{oldShape, nullptr, static_cast<uint32_t>(existing)};
+        }
+    }
+
+    // Adding a property, or a dictionary-mode object: under the lock, where
+    // the shape may have changed since it was loaded
+    lockShape(obj);
+    oldShape = obj->shape;
+    int existing = oldShape->lookup(key);
+    if (existing >= 0) {
+        Value* slot = obj->slotAddress(static_cast<uint32_t>(existing));
+        heap.preWriteBarrier(Value::exchange(slot, value));
+        heap.writeBarrier(obj, value);
+        unlockShape(obj);
+        return PropertyStore{oldShape, nullptr, static_cast<uint32_t>(existing)};
+    }
+
+    Shape* base = oldShape;
+    if (!base->isDictionary() && base->getSlotCount() >= ShapeTree::kMaxFastProperties) {
+        base = shapes.toDictionary(base);
+    }
+    Shape* newShape = shapes.addProperty(base, key);
+    uint32_t slot = newShape->getSlotCount() - 1;
+    ensureCapacity(heap, obj, slot + 1);
+    addSlot(heap, obj, newShape, slot, value);
+    unlockShape(obj);
+    return PropertyStore{oldShape, newShape, slot};
+}
@@ -0,0 +1,75 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include "runtime/vm/heap_object.h"
+
+class Heap;
+class Shape;
+class ShapeTree;
+
+// Property access on plain script objects. Keys are interned strings, so
+// they are compared by pointer. These are the generic (uncached) paths;
+// the interpreter's inline caches avoid them on hits.
+
+// Where a store ended up; used to fill inline caches
+struct PropertyStore {
+    Shape* oldShape;  // Shape before the store
+    Shape* newShape;  // Shape after an add-property transition, else nullptr
+    uint32_t slot;
+};
+
+// Returns the property value, or undefined when the object lacks it
+Value getProperty(const Object* obj, const String* key);
+
+// Adds or overwrites a property. Objects that grow past
+// ShapeTree::kMaxFastProperties switch to a private dictionary shape.
+PropertyStore setProperty(Heap& heap, ShapeTree& shapes, Object* obj, const String* key, Value value);
+
+// Concurrent access. `run` tasks may read and write properties of the same
+// object at once, with no global lock:
+//
+// - Storing to an existing property is one atomic word store, so stores to
+//   different properties never interfere and no reader sees a torn value.
+//   Overflow slots are stored with an exchange, after which the store
+//   checks that the overflow storage was not replaced meanwhile, and redoes
+//   itself into the new storage when it was.
+// - Adding a property is serialized per object by a sequence lock kept in
+//   the object's `length`, which is odd while a writer holds it. The writer
+//   grows the overflow storage if needed, stores the value, and only then
+//   publishes the new shape.
+// - Growing copies the slots into a new array and publishes it before the
+//   shape that needs it. The old array stays intact for readers still
+//   using it until the collector frees it.
+// - Readers take no lock: they load the shape first, which guarantees that
+//   the overflow storage loaded after it has the slot. Dictionary shapes
+//   change in place, so objects in dictionary mode are read and written
+//   under the sequence lock.
+//
+// Racing stores to one property leave one of the values. The shape tree
+// locks internally while it grows. Allocation and the collector still
+// assume one mutator per heap.
+
+// Shape of an object other tasks may be changing
+inline Shape* loadShape(const Object* obj) {
+    return __atomic_load_n(&obj->shape, __ATOMIC_ACQUIRE);
+}
+
+// Value in `slot`; the shape loaded before must have the slot
+inline Value loadSlot(const Object* obj, uint32_t slot) {
+    if (slot < Object::kInlineSlots) {
+        return Value::loadAtomic(&obj->inlineSlots[slot]);
+    }
+    const ValueArray* overflow = __atomic_load_n(&obj->overflow, __ATOMIC_ACQUIRE);
+    return Value::loadAtomic(&overflow->items()[slot - Object::kInlineSlots]);
+}
+
+// Overwrites the existing property in `slot` (barriers included)
+void storeSlot(Heap& heap, Object* obj, uint32_t slot, Value value);
+
+// Adds a property along a transition recorded by an inline cache: moves
+// the object from shape `from` to `to`, storing `value` in `slot`. False,
+// with nothing changed, when the object no longer has shape `from`, has no
+// room for the slot, or another task is changing its shape.
+bool tryCachedTransition(Heap& heap, Object* obj, const Shape* from, Shape* to, uint32_t slot, Value value);
+
+#endif // OBJECT_H
@@ -0,0 +1,121 @@
+#ifndef OPCODES_H
+#define OPCODES_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Role of each instruction operand. The interpreter does not look at these,
+// but the bytecode builder, the disassembler and later analysis passes
+// (liveness, stack maps, the JIT) all need to know what an operand means.
+enum class OperandKind : uint8_t {
+    None,     // Operand is unused
+    RegRead,  // Register read by the instruction
+    RegWrite, // Register written by the instruction
+    Const,    // Index into the function's constant pool
+    Imm,      // Immediate integer value
+    Target,   // Absolute instruction index (jump target)
+    Global,   // Index into the VM's global slot table
+    Cache,    // Index into the function's property inline caches
+    Class,    // Index into the function's class layouts
+    Field,    // Index into the function's field references
+    Count,    // Argument count (Call)
+    RegPair,  // Register read together with the one after it
+    Lock      // Index into the function's lock sites
+};
+
+// Master opcode list: X(Name, aKind, bKind, cKind).
+// Every instruction has three 32-bit operands a, b and c; the kinds document
+// how each one is used. Keeping the list in one macro guarantees that the
+// enum, the name table and the interpreter's dispatch table stay in sync.
+#define SE_OPCODES(X) \
+    X(LoadConst,     RegWrite, Const,   None)    /* a = K[b]                      */ \
+    X(LoadInt,       RegWrite, Imm,     None)    /* a = b (small int)             */ \
+    X(LoadUndefined, RegWrite, None,    None)    /* a = undefined                 */ \
+    X(LoadNull,      RegWrite, None,    None)    /* a = null                      */ \
+    X(LoadTrue,      RegWrite, None,    None)    /* a = true                      */ \
+    X(LoadFalse,     RegWrite, None,    None)    /* a = false                     */ \
+    X(Move,          RegWrite, RegRead, None)    /* a = b                         */ \
+    X(Add,           RegWrite, RegRead, RegRead) /* a = b + c                     */ \
+    X(Sub,           RegWrite, RegRead, RegRead) /* a = b - c                     */ \
+    X(Mul,           RegWrite, RegRead, RegRead) /* a = b * c                     */ \
+    X(Div,           RegWrite, RegRead, RegRead) /* a = b / c                     */ \
+    X(Mod,           RegWrite, RegRead, RegRead) /* a = b % c                     */ \
+    X(Neg,           RegWrite, RegRead, None)    /* a = -b                        */ \
+    X(Not,           RegWrite, RegRead, None)    /* a = !b                        */ \
+    X(Eq,            RegWrite, RegRead, RegRead) /* a = b == c                    */ \
+    X(Ne,            RegWrite, RegRead, RegRead) /* a = b != c                    */ \
+    X(Lt,            RegWrite, RegRead, RegRead) /* a = b < c                     */ \
+    X(Le,            RegWrite, RegRead, RegRead) /* a = b <= c                    */ \
+    X(Gt,            RegWrite, RegRead, RegRead) /* a = b > c                     */ \
+    X(Ge,            RegWrite, RegRead, RegRead) /* a = b >= c                    */ \
+    X(Jump,          Target,   None,    None)    /* goto a                        */ \
+    X(JumpIfTrue,    RegRead,  Target,  None)    /* if (a) goto b                 */ \
+    X(JumpIfFalse,   RegRead,  Target,  None)    /* if (!a) goto b                */ \
+    X(GetGlobal,     RegWrite, Global,  None)    /* a = globals[b]                */ \
+    X(SetGlobal,     Global,   RegRead, None)    /* globals[a] = b                */ \
+    X(AtomicAddGlobal, RegWrite, Global, RegRead) /* a = globals[b]; += c, atomic */ \
+    X(AtomicSubGlobal, RegWrite, Global, RegRead) /* a = globals[b]; -= c, atomic */ \
+    X(CompareAndSetGlobal, RegWrite, Global, RegPair) /* a = globals[b] === c, and then globals[b] = c+1; atomic */ \
+    X(NewObject,     RegWrite, None,    None)    /* a = {}                        */ \
+    X(GetProp,       RegWrite, RegRead, Cache)   /* a = b.(IC[c].key)             */ \
+    X(SetProp,       RegRead,  Cache,   RegRead) /* a.(IC[b].key) = c             */ \
+    X(NewInstance,   RegWrite, Class,   None)    /* a = new classes[b]            */ \
+    X(GetField,      RegWrite, RegRead, Field)   /* a = b.(fields[c])             */ \
+    X(SetField,      RegRead,  Field,   RegRead) /* a.(fields[b]) = c             */ \
+    X(NewWild,       RegWrite, Imm,     None)    /* a = wild object, b bytes      */ \
+    X(WildRetain,    RegRead,  None,    None)    /* ref a (count a reference)     */ \
+    X(WildCheck,     RegRead,  None,    None)    /* fail if a was destroyed       */ \
+    X(WildRelease,   RegRead,  None,    None)    /* drop a reference to a         */ \
+    X(Destroy,       RegRead,  None,    None)    /* destroy a                     */ \
+    X(Transfer,      RegWrite, RegRead, None)    /* a = transfer b (b invalid)    */ \
+    X(EnterRegion,   None,     None,    None)    /* open a wild(scope) region     */ \
+    X(ExitRegion,    None,     None,    None)    /* destroy and free its objects  */ \
+    X(NewScopedWild, RegWrite, Imm,     None)    /* a = wild(scope), b bytes      */ \
+    X(Lock,          RegWrite, RegRead, Lock)    /* a = Run.lock(b) at site c     */ \
+    X(Unlock,        RegRead,  None,    None)    /* release a's lock (`using` exit) */ \
+    X(Await,         RegWrite, RegRead, None)    /* a = await b                   */ \
+    X(Call,          RegWrite, RegRead, Count)   /* a = b(b+1 .. b+c)             */ \
+    X(Return,        RegRead,  None,    None)    /* return a                      */ \
+    X(ReturnUndefined, None,   None,    None)    /* return undefined              */
+
+enum class Opcode : uint8_t {
+#define SE_OPCODE_ENUM(name, a, b, c) name,
+    SE_OPCODES(SE_OPCODE_ENUM)
+#undef SE_OPCODE_ENUM
+};
+
+// Number of opcodes; sizes the dispatch and metadata tables.
+constexpr int kOpcodeCount = 0
+#define SE_OPCODE_COUNT(name, a, b, c) + 1
+    SE_OPCODES(SE_OPCODE_COUNT)
+#undef SE_OPCODE_COUNT
+    ;
+
+// Operand kinds for an opcode, indexed by operand position (0 = a, 1 = b, 2 = c)
+struct OpcodeInfo {
+    const char* name;
+    OperandKind operands[3];
+};
+
+inline const OpcodeInfo& opcodeInfo(Opcode op) {
+    static const OpcodeInfo table[] = {
+#define SE_OPCODE_INFO(name, a, b, c) \
+        {#name, {OperandKind::a, OperandKind::b, OperandKind::c}},
+        SE_OPCODES(SE_OPCODE_INFO)
+#undef SE_OPCODE_INFO
+    };
+    return table[static_cast<int>(op)];
+}
+
+inline std::string opcodeToString(Opcode op) {
+    return opcodeInfo(op).name;
+}
+
+// Overload the << operator so opcodes print by name (used by test assertions)
+inline std::ostream& operator<<(std::ostream& os, Opcode op) {
+    os << opcodeInfo(op).name;
+    return os;
+}
+
+#endif // OPCODES_H
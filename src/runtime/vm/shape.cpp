@@ -0,0 +1,91 @@
+#include "runtime/vm/shape.h"
+#include <algorithm>
+
+const Shape::Table* Shape::buildTable() const {
+    auto built = std::make_unique<Table>();
+    built->reserve(slotCount);
+    uint32_t slot = slotCount;
+    for (const Shape* shape = this; shape && shape->key; shape = shape->parent) {
+        built->emplace(shape->key, --slot);
+    }
+    Table* published = nullptr;
+    if (table.compare_exchange_strong(published, built.get(), std::memory_order_acq_rel)) {
+        return built.release();
+    }
+    return published; // Another thread got there first
+}
+
+int Shape::lookup(const String* wanted) const {
+    const Table* lookupTable = table.load(std::memory_order_acquire);
+    if (lookupTable || slotCount > kTableThreshold) {
+        if (!lookupTable) {
+            lookupTable = buildTable();
+        }
+        auto it = lookupTable->find(wanted);
+        return it != lookupTable->end() ? static_cast<int>(it->second) : -1;
+    }
+    // Small shapes: walk the chain; the key of each shape is its last slot
+    for (const Shape* shape = this; shape && shape->key; shape = shape->parent) {
+        if (shape->key == wanted) {
+            return static_cast<int>(shape->slotCount - 1);
+        }
+    }
+    return -1;
+}
+
+std::vector<const String*> Shape::keys() const {
+    std::vector<const String*> result(slotCount);
+    if (dictionary) {
+        for (const auto& [k, slot] : *table.load(std::memory_order_acquire)) {
+            result[slot] = k;
+        }
+        return result;
+    }
+    for (const Shape* shape = this; shape && shape->key; shape = shape->parent) {
+        result[shape->slotCount - 1] = shape->key;
+    }
+    return result;
+}
+
+ShapeTree::ShapeTree() {
+    shapes.push_back(std::make_unique<Shape>());
+    rootShape = shapes.back().get();
+}
+
+Shape* ShapeTree::addProperty(Shape* from, const String* key) {
+    if (from->dictionary) {
+        // Private to one object, whose shape lock the caller holds
+        from->table.load(std::memory_order_relaxed)->emplace(key, from->slotCount++);
+        return from;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    for (const auto& [transitionKey, child] : from->transitions) {
+        if (transitionKey == key) {
+            return child;
+        }
+    }
+
+    shapes.push_back(std::make_unique<Shape>());
+    Shape* child = shapes.back().get();
+    child->parent = from;
+    child->key = key;
+    child->slotCount = from->slotCount + 1;
+    from->transitions.emplace_back(key, child);
+    return child;
+}
+
+Shape* ShapeTree::toDictionary(const Shape* from) {
+    auto dict = std::make_unique<Shape>();
+    dict->dictionary = true;
+    dict->slotCount = from->slotCount;
+    auto* dictTable = new Shape::Table();
+    dict->table.store(dictTable, std::memory_order_relaxed);
+    std::vector<const String*> layout = from->keys();
+    for (uint32_t slot = 0; slot < layout.size(); ++slot) {
+        dictTable->emplace(layout[slot], slot);
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    shapes.push_back(std::move(dict));
+    return shapes.back().get();
+}
@@ -0,0 +1,99 @@
+#ifndef SHAPE_H
+#define SHAPE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct String;
+
+// A Shape (hidden class) describes the property layout of an object: which
+// keys it has and in which slot each value is stored. Objects that receive
+// the same properties in the same order share a shape, which is what makes
+// inline caches work: one pointer comparison proves the layout.
+//
+// Shapes form a transition tree rooted at the empty shape. Adding property
+// `k` to an object with shape S moves it to S's child for `k`, creating the
+// child on first use. Each shape stores only its own key; lookups walk the
+// parent chain, or use a lazily built hash table for larger shapes.
+//
+// Dictionary shapes are the exception: they belong to a single object that
+// outgrew the fast layout, are mutated in place and are never cached.
+//
+// Other shapes never change once created, so any thread may look them up;
+// threads racing to build the same lookup table keep the first one
+// published.
+class Shape {
+public:
+    Shape() = default;
+    Shape(const Shape&) = delete;
+    Shape& operator=(const Shape&) = delete;
+    ~Shape() { delete table.load(std::memory_order_relaxed); }
+
+    // Shapes with more properties than this get a lookup table
+    static constexpr uint32_t kTableThreshold = 8;
+
+    Shape* getParent() const { return parent; }
+    const String* getKey() const { return key; }
+    uint32_t getSlotCount() const { return slotCount; }
+    bool isDictionary() const { return dictionary; }
+
+    // Returns the slot of `key`, or -1 when the shape lacks it
+    int lookup(const String* key) const;
+
+    // Keys in slot order
+    std::vector<const String*> keys() const;
+
+private:
+    friend class ShapeTree;
+
+    Shape* parent = nullptr;
+    const String* key = nullptr;   // Key added by the transition into this shape
+    uint32_t slotCount = 0;        // Number of properties (the new key has slot slotCount-1)
+    bool dictionary = false;
+
+    using Table = std::unordered_map<const String*, uint32_t>;
+
+    std::vector<std::pair<const String*, Shape*>> transitions; // Guarded by ShapeTree::lock
+    mutable std::atomic<Table*> table{nullptr};                // Owned
+
+    const Table* buildTable() const;
+};
+
+// Owns every shape created by a VM. Shapes are never freed before the VM.
+// Tasks running in parallel may add properties at the same time, so adding
+// a transition takes a lock; following an existing one does too, since the
+// transition list may be growing.
+class ShapeTree {
+public:
+    // Objects with more properties than this switch to dictionary mode
+    static constexpr uint32_t kMaxFastProperties = 64;
+
+    ShapeTree();
+
+    // The empty shape every new object starts with
+    Shape* root() const { return rootShape; }
+
+    // Returns the shape reached by adding `key` to `from`. For dictionary
+    // shapes the shape itself is extended and returned.
+    Shape* addProperty(Shape* from, const String* key);
+
+    // Returns a fresh dictionary shape with the same layout as `from`
+    Shape* toDictionary(const Shape* from);
+
+    size_t shapeCount() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return shapes.size();
+    }
+
+private:
+    mutable std::mutex lock;
+    std::vector<std::unique_ptr<Shape>> shapes;
+    Shape* rootShape;
+};
+
+#endif // SHAPE_H
@@ -0,0 +1,490 @@
+#include "runtime/vm/simd_kernels.h"
+#include "runtime/vm/config.h"
+#include <atomic>
+#include <cstring>
+
+#if SE_ENABLE_SIMD
+#include <immintrin.h>
+#define SE_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+
+SimdLevel detectSimdLevel() {
+#if SE_ENABLE_SIMD
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? SimdLevel::Avx2 : SimdLevel::Sse2;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+std::atomic<SimdLevel>& currentLevel() {
+    static std::atomic<SimdLevel> level(maxSimdLevel());
+    return level;
+}
+
+SimdLevel level() {
+    return currentLevel().load(std::memory_order_relaxed);
+}
+
+// Portable loops; also finish the tails the vector loops leave
+template <typename T>
+ptrdiff_t findFrom(const T* data, size_t count, T value, size_t i) {
+    for (; i < count; ++i) {
+        if (data[i] == value) {
+            return static_cast<ptrdiff_t>(i);
+        }
+    }
+    return -1;
+}
+
+double apply(NumericOp op, double x, double y) {
+    switch (op) {
+        case NumericOp::Add: return x + y;
+        case NumericOp::Sub: return x - y;
+        case NumericOp::Mul: return x * y;
+        case NumericOp::Div: return x / y;
+    }
+    return x;
+}
+
+int compareFrom(const uint8_t* a, const uint8_t* b, size_t count, size_t i) {
+    for (; i < count; ++i) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+#if SE_ENABLE_SIMD
+
+// Lane operations of the search kernels, one struct per instruction set and
+// element type. match() returns a bit mask with kMaskBits bits per lane,
+// set for the lanes equal to the needle.
+struct Sse2U8 {
+    using Element = uint8_t;
+    using Vector = __m128i;
+    static constexpr size_t kLanes = 16;
+    static constexpr unsigned kMaskBits = 1;
+    static Vector splat(Element v) { return _mm_set1_epi8(static_cast<char>(v)); }
+    static unsigned match(const Element* p, Vector needle) {
+        return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), needle)));
+    }
+};
+
+struct Sse2U16 {
+    using Element = uint16_t;
+    using Vector = __m128i;
+    static constexpr size_t kLanes = 8;
+    static constexpr unsigned kMaskBits = 2;
+    static Vector splat(Element v) { return _mm_set1_epi16(static_cast<short>(v)); }
+    static unsigned match(const Element* p, Vector needle) {
+        return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), needle)));
+    }
+};
+
+struct Sse2U32 {
+    using Element = uint32_t;
+    using Vector = __m128i;
+    static constexpr size_t kLanes = 4;
+    static constexpr unsigned kMaskBits = 4;
+    static Vector splat(Element v) { return _mm_set1_epi32(static_cast<int>(v)); }
+    static unsigned match(const Element* p, Vector needle) {
+        return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), needle)));
+    }
+};
+
+struct Sse2F32 {
+    using Element = float;
+    using Vector = __m128;
+    static constexpr size_t kLanes = 4;
+    static constexpr unsigned kMaskBits = 1;
+    static Vector splat(Element v) { return _mm_set1_ps(v); }
+    static unsigned match(const Element* p, Vector needle) {
+        return static_cast<unsigned>(_mm_movemask_ps(_mm_cmpeq_ps(_mm_loadu_ps(p), needle)));
+    }
+};
+
+struct Sse2F64 {
+    using Element = double;
+    using Vector = __m128d;
+    static constexpr size_t kLanes = 2;
+    static constexpr unsigned kMaskBits = 1;
+    static Vector splat(Element v) { return _mm_set1_pd(v); }
+    static unsigned match(const Element* p, Vector needle) {
+        return static_cast<unsigned>(_mm_movemask_pd(_mm_cmpeq_pd(_mm_loadu_pd(p), needle)));
+    }
+};
+
+struct Avx2U8 {
+    using Element = uint8_t;
+    using Vector = __m256i;
+    static constexpr size_t kLanes = 32;
+    static constexpr unsigned kMaskBits = 1;
+    SE_AVX2 static Vector splat(Element v) { return _mm256_set1_epi8(static_cast<char>(v)); }
+    SE_AVX2 static unsigned match(const Element* p, Vector needle) {
+        return static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), needle)));
+    }
+};
+
+struct Avx2U16 {
+    using Element = uint16_t;
+    using Vector = __m256i;
+    static constexpr size_t kLanes = 16;
+    static constexpr unsigned kMaskBits = 2;
+    SE_AVX2 static Vector splat(Element v) { return _mm256_set1_epi16(static_cast<short>(v)); }
+    SE_AVX2 static unsigned match(const Element* p, Vector needle) {
+        return static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), needle)));
+    }
+};
+
+struct Avx2U32 {
+    using Element = uint32_t;
+    using Vector = __m256i;
+    static constexpr size_t kLanes = 8;
+    static constexpr unsigned kMaskBits = 4;
+    SE_AVX2 static Vector splat(Element v) { return _mm256_set1_epi32(static_cast<int>(v)); }
+    SE_AVX2 static unsigned match(const Element* p, Vector needle) {
+        return static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), needle)));
+    }
+};
+
+struct Avx2F32 {
+    using Element = float;
+    using Vector = __m256;
+    static constexpr size_t kLanes = 8;
+    static constexpr unsigned kMaskBits = 1;
+    SE_AVX2 static Vector splat(Element v) { return _mm256_set1_ps(v); }
+    SE_AVX2 static unsigned match(const Element* p, Vector needle) {
+        return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(p), needle, _CMP_EQ_OQ)));
+    }
+};
+
+struct Avx2F64 {
+    using Element = double;
+    using Vector = __m256d;
+    static constexpr size_t kLanes = 4;
+    static constexpr unsigned kMaskBits = 1;
+    SE_AVX2 static Vector splat(Element v) { return _mm256_set1_pd(v); }
+    SE_AVX2 static unsigned match(const Element* p, Vector needle) {
+        return static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(p), needle, _CMP_EQ_OQ)));
+    }
+};
+
+// The search loop, once per instruction set: the AVX2 lane operations can
+// only be inlined into a function compiled for AVX2
+template <typename Lanes>
+ptrdiff_t findSse2(const typename Lanes::Element* data, size_t count, typename Lanes::Element value) {
+    typename Lanes::Vector needle = Lanes::splat(value);
+    size_t i = 0;
+    for (; i + Lanes::kLanes <= count; i += Lanes::kLanes) {
+        if (unsigned mask = Lanes::match(data + i, needle)) {
+            return static_cast<ptrdiff_t>(i + __builtin_ctz(mask) / Lanes::kMaskBits);
+        }
+    }
+    return findFrom(data, count, value, i);
+}
+
+template <typename Lanes>
+SE_AVX2 ptrdiff_t findAvx2(const typename Lanes::Element* data, size_t count, typename Lanes::Element value) {
+    typename Lanes::Vector needle = Lanes::splat(value);
+    size_t i = 0;
+    for (; i + Lanes::kLanes <= count; i += Lanes::kLanes) {
+        if (unsigned mask = Lanes::match(data + i, needle)) {
+            return static_cast<ptrdiff_t>(i + __builtin_ctz(mask) / Lanes::kMaskBits);
+        }
+    }
+    return findFrom(data, count, value, i);
+}
+
+// Fills with a 32-byte block holding whole copies of the element; returns
+// the bytes done
+size_t fillSse2(uint8_t* dst, const uint8_t* block, size_t bytes) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+    size_t i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+    }
+    return i;
+}
+
+SE_AVX2 size_t fillAvx2(uint8_t* dst, const uint8_t* block, size_t bytes) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    size_t i = 0;
+    for (; i + 128 <= bytes; i += 128) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), v);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 32), v);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 64), v);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 96), v);
+    }
+    for (; i + 32 <= bytes; i += 32) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), v);
+    }
+    return i;
+}
+
+SE_AVX2 int64_t sumI32Avx2(const int32_t* data, size_t count, size_t& i) {
+    __m256i a = _mm256_setzero_si256();
+    __m256i b = _mm256_setzero_si256();
+    for (; i + 8 <= count; i += 8) {
+        a = _mm256_add_epi64(a, _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i))));
+        b = _mm256_add_epi64(b, _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 4))));
+    }
+    alignas(32) int64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), _mm256_add_epi64(a, b));
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+SE_AVX2 uint64_t sumU32Avx2(const uint32_t* data, size_t count, size_t& i) {
+    __m256i a = _mm256_setzero_si256();
+    __m256i b = _mm256_setzero_si256();
+    for (; i + 8 <= count; i += 8) {
+        a = _mm256_add_epi64(a, _mm256_cvtepu32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i))));
+        b = _mm256_add_epi64(b, _mm256_cvtepu32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 4))));
+    }
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), _mm256_add_epi64(a, b));
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+SE_AVX2 __m256d applyAvx2(NumericOp op, __m256d x, __m256d y) {
+    switch (op) {
+        case NumericOp::Add: return _mm256_add_pd(x, y);
+        case NumericOp::Sub: return _mm256_sub_pd(x, y);
+        case NumericOp::Mul: return _mm256_mul_pd(x, y);
+        case NumericOp::Div: return _mm256_div_pd(x, y);
+    }
+    return x;
+}
+
+// The op is switched on per vector; the branch always goes the same way
+SE_AVX2 size_t mapF64Avx2(double* dst, const double* src, size_t count, NumericOp op, double operand) {
+    __m256d y = _mm256_set1_pd(operand);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm256_storeu_pd(dst + i, applyAvx2(op, _mm256_loadu_pd(src + i), y));
+    }
+    return i;
+}
+
+SE_AVX2 size_t mapF32Avx2(float* dst, const float* src, size_t count, NumericOp op, double operand) {
+    __m256d y = _mm256_set1_pd(operand);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d x = _mm256_cvtps_pd(_mm_loadu_ps(src + i));
+        _mm_storeu_ps(dst + i, _mm256_cvtpd_ps(applyAvx2(op, x, y)));
+    }
+    return i;
+}
+
+__m128d applySse2(NumericOp op, __m128d x, __m128d y) {
+    switch (op) {
+        case NumericOp::Add: return _mm_add_pd(x, y);
+        case NumericOp::Sub: return _mm_sub_pd(x, y);
+        case NumericOp::Mul: return _mm_mul_pd(x, y);
+        case NumericOp::Div: return _mm_div_pd(x, y);
+    }
+    return x;
+}
+
+size_t mapF64Sse2(double* dst, const double* src, size_t count, NumericOp op, double operand) {
+    __m128d y = _mm_set1_pd(operand);
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        _mm_storeu_pd(dst + i, applySse2(op, _mm_loadu_pd(src + i), y));
+    }
+    return i;
+}
+
+// Returns the index of the first differing byte, or `count`
+size_t mismatchSse2(const uint8_t* a, const uint8_t* b, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        unsigned equal = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)));
+        if (equal != 0xFFFF) {
+            return i + __builtin_ctz(~equal);
+        }
+    }
+    return i;
+}
+
+SE_AVX2 size_t mismatchAvx2(const uint8_t* a, const uint8_t* b, size_t count) {
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        unsigned equal = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)));
+        if (equal != 0xFFFFFFFFu) {
+            return i + __builtin_ctz(~equal);
+        }
+    }
+    return i;
+}
+
+#endif // SE_ENABLE_SIMD
+
+template <typename T, typename Sse2, typename Avx2>
+ptrdiff_t find(const T* data, size_t count, T value) {
+#if SE_ENABLE_SIMD
+    switch (level()) {
+        case SimdLevel::Avx2: return findAvx2<Avx2>(data, count, value);
+        case SimdLevel::Sse2: return findSse2<Sse2>(data, count, value);
+        case SimdLevel::Scalar: break;
+    }
+#endif
+    return findFrom(data, count, value, 0);
+}
+
+} // namespace
+
+SimdLevel maxSimdLevel() {
+    static const SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+SimdLevel simdLevel() {
+    return level();
+}
+
+void setSimdLevel(SimdLevel requested) {
+    currentLevel().store(requested < maxSimdLevel() ? requested : maxSimdLevel(), std::memory_order_relaxed);
+}
+
+void fillElements(void* dst, const void* pattern, size_t size, size_t count) {
+    auto* out = static_cast<uint8_t*>(dst);
+    size_t bytes = size * count;
+    alignas(32) uint8_t block[32];
+    for (size_t i = 0; i < sizeof(block); i += size) {
+        std::memcpy(block + i, pattern, size);
+    }
+    size_t done = 0;
+#if SE_ENABLE_SIMD
+    switch (level()) {
+        case SimdLevel::Avx2: done = fillAvx2(out, block, bytes); break;
+        case SimdLevel::Sse2: done = fillSse2(out, block, bytes); break;
+        case SimdLevel::Scalar: break;
+    }
+#endif
+    // Every block starts on an element boundary, so whole and partial
+    // blocks alike hold whole elements
+    for (; done + sizeof(block) <= bytes; done += sizeof(block)) {
+        std::memcpy(out + done, block, sizeof(block));
+    }
+    std::memcpy(out + done, block, bytes - done);
+}
+
+ptrdiff_t indexOfU8(const uint8_t* data, size_t count, uint8_t value) {
+#if SE_ENABLE_SIMD
+    return find<uint8_t, Sse2U8, Avx2U8>(data, count, value);
+#else
+    const void* found = std::memchr(data, value, count);
+    return found ? static_cast<const uint8_t*>(found) - data : -1;
+#endif
+}
+
+ptrdiff_t indexOfU16(const uint16_t* data, size_t count, uint16_t value) {
+#if SE_ENABLE_SIMD
+    return find<uint16_t, Sse2U16, Avx2U16>(data, count, value);
+#else
+    return findFrom(data, count, value, 0);
+#endif
+}
+
+ptrdiff_t indexOfU32(const uint32_t* data, size_t count, uint32_t value) {
+#if SE_ENABLE_SIMD
+    return find<uint32_t, Sse2U32, Avx2U32>(data, count, value);
+#else
+    return findFrom(data, count, value, 0);
+#endif
+}
+
+ptrdiff_t indexOfF32(const float* data, size_t count, float value) {
+#if SE_ENABLE_SIMD
+    return find<float, Sse2F32, Avx2F32>(data, count, value);
+#else
+    return findFrom(data, count, value, 0);
+#endif
+}
+
+ptrdiff_t indexOfF64(const double* data, size_t count, double value) {
+#if SE_ENABLE_SIMD
+    return find<double, Sse2F64, Avx2F64>(data, count, value);
+#else
+    return findFrom(data, count, value, 0);
+#endif
+}
+
+// Below AVX2 the plain loops are left to the compiler, which vectorizes
+// them with SSE2 itself
+
+int64_t sumI32(const int32_t* data, size_t count) {
+    int64_t sum = 0;
+    size_t i = 0;
+#if SE_ENABLE_SIMD
+    if (level() == SimdLevel::Avx2) {
+        sum = sumI32Avx2(data, count, i);
+    }
+#endif
+    for (; i < count; ++i) {
+        sum += data[i];
+    }
+    return sum;
+}
+
+uint64_t sumU32(const uint32_t* data, size_t count) {
+    uint64_t sum = 0;
+    size_t i = 0;
+#if SE_ENABLE_SIMD
+    if (level() == SimdLevel::Avx2) {
+        sum = sumU32Avx2(data, count, i);
+    }
+#endif
+    for (; i < count; ++i) {
+        sum += data[i];
+    }
+    return sum;
+}
+
+void mapF64(double* dst, const double* src, size_t count, NumericOp op, double operand) {
+    size_t i = 0;
+#if SE_ENABLE_SIMD
+    switch (level()) {
+        case SimdLevel::Avx2: i = mapF64Avx2(dst, src, count, op, operand); break;
+        case SimdLevel::Sse2: i = mapF64Sse2(dst, src, count, op, operand); break;
+        case SimdLevel::Scalar: break;
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = apply(op, src[i], operand);
+    }
+}
+
+void mapF32(float* dst, const float* src, size_t count, NumericOp op, double operand) {
+    size_t i = 0;
+#if SE_ENABLE_SIMD
+    if (level() == SimdLevel::Avx2) {
+        i = mapF32Avx2(dst, src, count, op, operand);
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = static_cast<float>(apply(op, src[i], operand));
+    }
+}
+
+int compareBytes(const void* a, const void* b, size_t count) {
+    const auto* x = static_cast<const uint8_t*>(a);
+    const auto* y = static_cast<const uint8_t*>(b);
+    size_t i = 0;
+#if SE_ENABLE_SIMD
+    switch (level()) {
+        case SimdLevel::Avx2: i = mismatchAvx2(x, y, count); break;
+        case SimdLevel::Sse2: i = mismatchSse2(x, y, count); break;
+        case SimdLevel::Scalar: break;
+    }
+#endif
+    return compareFrom(x, y, count, i);
+}
@@ -0,0 +1,60 @@
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Vector kernels behind the typed-array builtins (see TypedArray). Each
+// kernel has an AVX2 version, picked at run time when the CPU supports it,
+// and a portable loop. fillElements, the indexOf kernels, mapF64 and
+// compareBytes also have an SSE2 version (the x86-64 baseline); below AVX2,
+// sumI32, sumU32 and mapF32 run the portable loop, which the compiler
+// vectorizes with SSE2 itself. All versions give identical results. Inputs
+// need no particular alignment: the kernels use unaligned loads, which
+// cost nothing extra on the 64-byte aligned storage of an ArrayBuffer.
+//
+// Floating-point kernels compare and compute lane by lane exactly as the
+// scalar loop would, so results never depend on the vector width. Sums of
+// floating-point elements are deliberately left out: reassociating them
+// would change the rounding of a left-to-right reduce.
+
+// Instruction sets the kernels may use, from least to most capable
+enum class SimdLevel : uint8_t { Scalar, Sse2, Avx2 };
+
+// Best level this build and CPU support
+SimdLevel maxSimdLevel();
+// Level currently in use; starts at maxSimdLevel()
+SimdLevel simdLevel();
+// Restricts the kernels to `level` (clamped to maxSimdLevel()), to compare
+// the versions in tests and benchmarks
+void setSimdLevel(SimdLevel level);
+
+// Element-wise arithmetic of map kernels
+enum class NumericOp : uint8_t { Add, Sub, Mul, Div };
+
+// Stores `count` copies of the `size`-byte element at `pattern` (size 1,
+// 2, 4 or 8) at `dst`
+void fillElements(void* dst, const void* pattern, size_t size, size_t count);
+
+// Index of the first element equal to `value`, or -1. Integers compare
+// bitwise; floats numerically, so NaN matches nothing and -0 matches 0.
+ptrdiff_t indexOfU8(const uint8_t* data, size_t count, uint8_t value);
+ptrdiff_t indexOfU16(const uint16_t* data, size_t count, uint16_t value);
+ptrdiff_t indexOfU32(const uint32_t* data, size_t count, uint32_t value);
+ptrdiff_t indexOfF32(const float* data, size_t count, float value);
+ptrdiff_t indexOfF64(const double* data, size_t count, double value);
+
+// Exact sums of 32-bit integers
+int64_t sumI32(const int32_t* data, size_t count);
+uint64_t sumU32(const uint32_t* data, size_t count);
+
+// dst[i] = src[i] op operand, computed in double precision (for floats,
+// then rounded to float as a store into a Float32Array does). dst may be
+// src.
+void mapF64(double* dst, const double* src, size_t count, NumericOp op, double operand);
+void mapF32(float* dst, const float* src, size_t count, NumericOp op, double operand);
+
+// Compares two byte ranges like memcmp, returning -1, 0 or 1
+int compareBytes(const void* a, const void* b, size_t count);
+
+#endif // SIMD_KERNELS_H
@@ -0,0 +1,250 @@
+#include "runtime/vm/slow_paths.h"
+#include "runtime/vm/class_layout.h"
+#include "runtime/vm/object.h"
+#include "runtime/vm/shape.h"
+#include "runtime/vm/string_ops.h"
+#include "runtime/vm/vm.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+std::string numberToString(double d) {
+    if (std::isnan(d)) {
+        return "NaN";
+    }
+    if (std::isinf(d)) {
+        return d > 0 ? "Infinity" : "-Infinity";
+    }
+    if (d == 0) {
+        return "0"; // Also covers -0
+    }
+    // Integral values within the exactly representable range print without
+    // a fraction
+    if (std::fabs(d) < 9007199254740992.0 && d == std::floor(d)) {
+        return std::to_string(static_cast<int64_t>(d));
+    }
+    // Otherwise use the shortest representation that round-trips
+    char buffer[32];
+    for (int precision = 1; precision <= 17; ++precision) {
+        std::snprintf(buffer, sizeof(buffer), "%.*g", precision, d);
+        if (std::strtod(buffer, nullptr) == d) {
+            break;
+        }
+    }
+    return buffer;
+}
+
+double toNumber(Value a) {
+    switch (a.getTag()) {
+        case Value::Tag::Int: return a.asInt();
+        case Value::Tag::Double: return a.asDouble();
+        case Value::Tag::Boolean: return a.asBoolean() ? 1 : 0;
+        case Value::Tag::Null: return 0;
+        case Value::Tag::Undefined:
+        case Value::Tag::WildObject: return NAN;
+        case Value::Tag::Object:
+            if (isString(a)) {
+                std::string text = toUtf8(asString(a));
+                if (text.empty()) {
+                    return 0;
+                }
+                char* end = nullptr;
+                double result = std::strtod(text.c_str(), &end);
+                return *end == '\0' ? result : NAN;
+            }
+            return NAN;
+    }
+    return NAN;
+}
+
+bool toBoolean(Value a) {
+    switch (a.getTag()) {
+        case Value::Tag::Boolean: return a.asBoolean();
+        case Value::Tag::Int: return a.asInt() != 0;
+        case Value::Tag::Double: return a.asDouble() != 0 && !std::isnan(a.asDouble());
+        case Value::Tag::Null:
+        case Value::Tag::Undefined: return false;
+        case Value::Tag::WildObject: return true;
+        case Value::Tag::Object:
+            return !isString(a) || asString(a)->length != 0;
+    }
+    return false;
+}
+
+String* toString(VM& vm, Value a) {
+    switch (a.getTag()) {
+        case Value::Tag::Undefined: return vm.intern("undefined");
+        case Value::Tag::Null: return vm.intern("null");
+        case Value::Tag::Boolean: return vm.intern(a.asBoolean() ? "true" : "false");
+        case Value::Tag::Int:
+        case Value::Tag::Double:
+            return vm.getHeap().allocateString(numberToString(a.toNumber()));
+        case Value::Tag::WildObject: return vm.intern("[wild object]");
+        case Value::Tag::Object:
+            switch (a.asObject()->kind) {
+                case ObjectKind::String: return asString(a);
+                case ObjectKind::Function: return vm.intern("[function]");
+                case ObjectKind::Promise:
+                case ObjectKind::Coroutine: return vm.intern("[object Promise]");
+                default: return vm.intern("[object Object]");
+            }
+    }
+    return vm.intern("");
+}
+
+Value slowAdd(VM& vm, Value a, Value b) {
+    if (isString(a) || isString(b)) {
+        String* left = toString(vm, a);
+        String* right = toString(vm, b);
+        return Value::object(concatStrings(vm.getHeap(), left, right));
+    }
+    if (Value::bothInt(a, b)) {
+        // Only reached when the sum leaves the 48-bit int range
+        return Value::fromInt64(a.asInt() + b.asInt());
+    }
+    return Value::number(toNumber(a) + toNumber(b));
+}
+
+Value slowArithmetic(Opcode op, Value a, Value b) {
+    double x = toNumber(a);
+    double y = toNumber(b);
+    // Int operands that miss the interpreter's fast path (large products,
+    // -0 results, inexact quotients) keep an int result when it is exact
+    bool ints = Value::bothInt(a, b);
+    switch (op) {
+        case Opcode::Sub: return ints ? Value::fromDouble(x - y) : Value::number(x - y);
+        case Opcode::Mul: return ints ? Value::fromDouble(x * y) : Value::number(x * y);
+        case Opcode::Div: return ints ? Value::fromDouble(x / y) : Value::number(x / y);
+        case Opcode::Mod: return ints ? Value::fromDouble(std::fmod(x, y)) : Value::number(std::fmod(x, y));
+        default: break;
+    }
+    throw RuntimeError("Invalid arithmetic opcode " + opcodeToString(op));
+}
+
+Value atomicArithmetic(VM& vm, Opcode op, Value* slot, Value operand) {
+    Value old = Value::loadAtomic(slot);
+    while (true) {
+        Value updated = op == Opcode::Add ? slowAdd(vm, old, operand) : slowArithmetic(op, old, operand);
+        if (Value::compareExchange(slot, old, updated)) {
+            return old;
+        }
+    }
+}
+
+bool atomicCompareAndSet(Value* slot, Value expected, Value desired) {
+    // Strictly equal values need not have the same bits (strings, 1 and
+    // 1.0), so compare first and exchange the exact bits seen
+    Value seen = Value::loadAtomic(slot);
+    while (strictEquals(seen, expected)) {
+        if (Value::compareExchange(slot, seen, desired)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Value slowNegate(Value a) {
+    return Value::number(-toNumber(a));
+}
+
+bool slowCompare(Opcode op, Value a, Value b) {
+    if (isString(a) && isString(b)) {
+        int cmp = compareStrings(asString(a), asString(b));
+        switch (op) {
+            case Opcode::Lt: return cmp < 0;
+            case Opcode::Le: return cmp <= 0;
+            case Opcode::Gt: return cmp > 0;
+            case Opcode::Ge: return cmp >= 0;
+            default: break;
+        }
+    } else {
+        // Comparisons involving NaN are false, which the IEEE operators give us
+        double x = toNumber(a);
+        double y = toNumber(b);
+        switch (op) {
+            case Opcode::Lt: return x < y;
+            case Opcode::Le: return x <= y;
+            case Opcode::Gt: return x > y;
+            case Opcode::Ge: return x >= y;
+            default: break;
+        }
+    }
+    throw RuntimeError("Invalid comparison opcode " + opcodeToString(op));
+}
+
+bool strictEquals(Value a, Value b) {
+    if (a.isNumber() && b.isNumber()) {
+        return a.toNumber() == b.toNumber();
+    }
+    if (isString(a) && isString(b)) {
+        return equalStrings(asString(a), asString(b));
+    }
+    return a == b;
+}
+
+Value slowGetProperty(VM& vm, Value target, const String* key) {
+    if (isPlainObject(target)) {
+        return getProperty(asPlainObject(target), key);
+    }
+    if (isInstance(target)) {
+        return getInstanceProperty(asInstance(target), key);
+    }
+    if (isString(target) && key == vm.intern("length")) {
+        return Value::integer(static_cast<int32_t>(asString(target)->length));
+    }
+    if (target.isNullish()) {
+        throw RuntimeError("Cannot read property '" + toUtf8(key) + "' of " +
+                           (target.isNull() ? "null" : "undefined"));
+    }
+    return Value::undefined();
+}
+
+void slowSetProperty(VM& vm, Value target, const String* key, Value value) {
+    if (isPlainObject(target)) {
+        setProperty(vm.getHeap(), vm.getShapes(), asPlainObject(target), key, value);
+        return;
+    }
+    if (isInstance(target)) {
+        setInstanceProperty(vm.getHeap(), vm.getShapes(), asInstance(target), key, value);
+        return;
+    }
+    throw RuntimeError("Cannot set property '" + toUtf8(key) + "' on a non-object value");
+}
+
+Value getPropertyMiss(VM& vm, Value target, PropertyCache& cache) {
+    if (!isPlainObject(target)) {
+        return slowGetProperty(vm, target, cache.key);
+    }
+    Object* obj = asPlainObject(target);
+    Shape* shape = loadShape(obj);
+    // Dictionary shapes change in place, so they can never be cached
+    if (shape->isDictionary()) {
+        return getProperty(obj, cache.key);
+    }
+    int slot = shape->lookup(cache.key);
+    if (slot < 0) {
+        return Value::undefined();
+    }
+    cache.add(shape, nullptr, static_cast<uint32_t>(slot));
+    return loadSlot(obj, static_cast<uint32_t>(slot));
+}
+
+void setPropertyMiss(VM& vm, Value target, PropertyCache& cache, Value value) {
+    if (!isPlainObject(target)) {
+        slowSetProperty(vm, target, cache.key, value);
+        return;
+    }
+    PropertyStore store = setProperty(vm.getHeap(), vm.getShapes(), asPlainObject(target), cache.key, value);
+    if (store.oldShape->isDictionary() || (store.newShape && store.newShape->isDictionary())) {
+        return;
+    }
+    cache.add(store.oldShape, store.newShape, store.slot);
+}
+
+void throwRejection(Value reason) {
+    if (isString(reason)) {
+        throw RuntimeError(toUtf8(asString(reason)));
+    }
+    throw RuntimeError("Promise rejected with a non-string reason");
+}
@@ -0,0 +1,65 @@
+#ifndef SLOW_PATHS_H
+#define SLOW_PATHS_H
+
+#include "runtime/vm/config.h"
+#include "runtime/vm/heap_object.h"
+#include "runtime/vm/inline_cache.h"
+#include "runtime/vm/opcodes.h"
+#include <string>
+
+class VM;
+
+// Out-of-line generic implementations of the interpreter's operations.
+// The interpreter handles small ints and doubles inline and calls these only
+// for everything else (strings, objects, overflow, conversions). They are
+// kept out of line so the dispatch loop stays small and register friendly.
+
+// a + b for arbitrary operands (numeric addition or string concatenation)
+SE_NOINLINE Value slowAdd(VM& vm, Value a, Value b);
+
+// Sub, Mul, Div and Mod for arbitrary operands
+SE_NOINLINE Value slowArithmetic(Opcode op, Value a, Value b);
+
+// AtomicAddGlobal (op Add) and AtomicSubGlobal (op Sub) for arbitrary
+// operands: updates `slot` by `operand`, recomputing when another thread
+// changed it in between, and returns its previous value
+SE_NOINLINE Value atomicArithmetic(VM& vm, Opcode op, Value* slot, Value operand);
+
+// CompareAndSetGlobal for arbitrary operands: stores `desired` when the slot
+// is strictly equal to `expected`, as one atomic step
+SE_NOINLINE bool atomicCompareAndSet(Value* slot, Value expected, Value desired);
+
+// Unary minus for arbitrary operands
+SE_NOINLINE Value slowNegate(Value a);
+
+// Lt, Le, Gt and Ge for arbitrary operands
+SE_NOINLINE bool slowCompare(Opcode op, Value a, Value b);
+
+// Strict equality: numbers by value, strings by content, others by identity
+SE_NOINLINE bool strictEquals(Value a, Value b);
+
+// Truthiness of a value that is not a boolean
+SE_NOINLINE bool toBoolean(Value a);
+
+// Numeric conversion (undefined -> NaN, null -> 0, strings are parsed)
+double toNumber(Value a);
+
+// String conversion, allocating a new String when needed
+String* toString(VM& vm, Value a);
+
+// Formats a number the way script code prints it ("3", "0.5", "NaN")
+std::string numberToString(double d);
+
+// Generic property access on any value
+SE_NOINLINE Value slowGetProperty(VM& vm, Value target, const String* key);
+SE_NOINLINE void slowSetProperty(VM& vm, Value target, const String* key, Value value);
+
+// Inline cache misses: perform the access generically and record the
+// object's shape in the cache for next time
+SE_NOINLINE Value getPropertyMiss(VM& vm, Value target, PropertyCache& cache);
+SE_NOINLINE void setPropertyMiss(VM& vm, Value target, PropertyCache& cache, Value value);
+
+// Throws the RuntimeError for awaiting a promise rejected with `reason`
+[[noreturn]] SE_NOINLINE void throwRejection(Value reason);
+
+#endif // SLOW_PATHS_H
@@ -0,0 +1,758 @@
+#include "runtime/vm/snapshot.h"
+#include "compiler/codegen/liveness.h"
+#include "runtime/vm/class_layout.h"
+#include "runtime/vm/function_proto.h"
+#include "runtime/vm/object.h"
+#include "runtime/vm/shape.h"
+#include "runtime/vm/vm.h"
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+constexpr char kMagic[8] = {'S', 'E', 'I', 'M', 'A', 'G', 'E', '\n'};
+constexpr uint32_t kVersion = 2;
+constexpr uint64_t kRunBytes = Heap::kLargeObjectSize;
+constexpr uint64_t kNoKey = UINT64_MAX;
+
+// What an image depends on besides its format: a build where any of these
+// differ lays objects or bytecode out differently
+uint32_t buildFingerprint() {
+    uint32_t hash = 2166136261u;
+    auto mix = [&hash](size_t value) { hash = (hash ^ static_cast<uint32_t>(value)) * 16777619u; };
+    mix(sizeof(void*));
+    mix(sizeof(RopeString));
+    mix(sizeof(Object));
+    mix(Object::kInlineSlots);
+    mix(sizeof(FunctionObject));
+    mix(sizeof(Instance));
+    mix(sizeof(Promise));
+    mix(sizeof(Coroutine));
+    mix(static_cast<size_t>(kOpcodeCount));
+    return hash;
+}
+
+// What the field at a relocation entry's offset holds in the image
+enum RelocationKind : uint64_t {
+    kRelocValue = 0,  // Value whose payload is the image offset of an object
+    kRelocObject = 1, // Object pointer, as an image offset
+    kRelocShape = 2,  // Shape pointer, as an index into the image's shapes
+    kRelocProto = 3,  // FunctionProto pointer, as an index into the VM's functions
+    kRelocLayout = 4, // ClassLayout pointer, as an index into the VM's classes
+};
+constexpr uint64_t kRelocKindBits = 3;
+
+uint64_t roundUp(uint64_t value, uint64_t to) { return (value + to - 1) / to * to; }
+
+// Of everything after the header. Each step is a bijection of the running
+// hash, so any single changed word changes the result.
+uint64_t payloadChecksum(const char* data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ull;
+        hash ^= hash >> 29;
+    }
+    for (; i < size; ++i) {
+        hash = (hash ^ static_cast<uint8_t>(data[i])) * 1099511628211ull;
+    }
+    return hash;
+}
+
+class ByteWriter {
+public:
+    template <typename T>
+    void put(T value) {
+        const char* raw = reinterpret_cast<const char*>(&value);
+        bytes.insert(bytes.end(), raw, raw + sizeof(T));
+    }
+    void putBytes(const char* data, size_t size) { bytes.insert(bytes.end(), data, data + size); }
+    void putString(const std::string& text) {
+        put<uint32_t>(static_cast<uint32_t>(text.size()));
+        putBytes(text.data(), text.size());
+    }
+    void align() { bytes.resize(roundUp(bytes.size(), 8), 0); }
+    // Overwrites what an earlier put() left at `at`
+    template <typename T>
+    void patch(size_t at, T value) {
+        std::memcpy(&bytes[at], &value, sizeof(T));
+    }
+
+    size_t size() const { return bytes.size(); }
+    const std::vector<char>& data() const { return bytes; }
+
+private:
+    std::vector<char> bytes;
+};
+
+class ByteReader {
+public:
+    ByteReader(const char* data, size_t size) : data(data), size(size) {}
+
+    template <typename T>
+    T get() {
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+    const char* take(size_t bytes) {
+        if (bytes > size - pos) {
+            throw SnapshotError("Snapshot image is truncated");
+        }
+        const char* at = data + pos;
+        pos += bytes;
+        return at;
+    }
+    std::string getString() {
+        uint32_t length = get<uint32_t>();
+        return std::string(take(length), length);
+    }
+    void align() { take(roundUp(pos, 8) - pos); }
+
+    // What is left to read
+    const char* rest() const { return data + pos; }
+    size_t remaining() const { return size - pos; }
+
+private:
+    const char* data;
+    size_t size;
+    size_t pos = 0;
+};
+
+// Read-only private mapping of a whole file
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw SnapshotError("Cannot open snapshot " + path);
+        }
+        struct stat info;
+        if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+            size = static_cast<size_t>(info.st_size);
+            void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            data = mapped == MAP_FAILED ? nullptr : static_cast<const char*>(mapped);
+        }
+        ::close(fd);
+        if (!data) {
+            throw SnapshotError("Cannot map snapshot " + path);
+        }
+    }
+    ~MappedFile() { ::munmap(const_cast<char*>(data), size); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data = nullptr;
+    size_t size = 0;
+};
+
+// Lays the reachable objects out in image space and records their
+// references as relocations
+class ObjectImage {
+public:
+    struct Run {
+        uint64_t offset;
+        uint64_t bytes;
+    };
+    struct ShapeRecord {
+        bool dictionary;
+        uint32_t parent;           // Tree shapes
+        std::vector<uint64_t> keys; // One for tree shapes, every slot's for dictionaries
+    };
+
+    ObjectImage(Shape* root, const std::vector<std::unique_ptr<FunctionProto>>& protos,
+                const std::vector<std::unique_ptr<ClassLayout>>& classes) {
+        shapeIndexes.emplace(root, 0);
+        shapes.push_back(ShapeRecord{false, 0, {kNoKey}});
+        for (size_t i = 0; i < protos.size(); ++i) {
+            protoIndexes.emplace(protos[i].get(), static_cast<uint64_t>(i));
+        }
+        for (size_t i = 0; i < classes.size(); ++i) {
+            layoutIndexes.emplace(classes[i].get(), static_cast<uint64_t>(i));
+        }
+    }
+
+    // Image offset of `obj`, which is copied along with what it references
+    uint64_t add(const HeapObject* obj) {
+        auto it = offsets.find(obj);
+        if (it != offsets.end()) {
+            return it->second;
+        }
+        uint64_t size = Heap::objectSize(obj);
+        uint64_t offset;
+        if (size > kRunBytes) {
+            // A run of its own, spanning as many run slots as it needs
+            offset = roundUp(cursor, kRunBytes);
+            runs.push_back(Run{offset, size});
+            cursor = offset + roundUp(size, kRunBytes);
+            runOpen = false;
+        } else {
+            if (!runOpen || cursor + size > runs.back().offset + kRunBytes) {
+                runs.push_back(Run{roundUp(cursor, kRunBytes), 0});
+                cursor = runs.back().offset;
+                runOpen = true;
+            }
+            offset = cursor;
+            cursor += size;
+            runs.back().bytes += size;
+        }
+        offsets.emplace(obj, offset);
+        pending.push_back(obj);
+        return offset;
+    }
+
+    // `value` as stored in the image outside objects
+    uint64_t encode(Value value) {
+        if (value.isWild()) {
+            throw SnapshotError("Wild objects cannot be saved in a snapshot");
+        }
+        if (value.isObject()) {
+            return Value::object(reinterpret_cast<HeapObject*>(add(value.asObject()))).rawBits();
+        }
+        return value.rawBits();
+    }
+
+    uint64_t shapeIndex(Shape* shape) {
+        auto it = shapeIndexes.find(shape);
+        if (it != shapeIndexes.end()) {
+            return it->second;
+        }
+        ShapeRecord record;
+        record.dictionary = shape->isDictionary();
+        record.parent = 0;
+        if (record.dictionary) {
+            for (const String* key : shape->keys()) {
+                record.keys.push_back(key ? add(key) : kNoKey);
+            }
+        } else {
+            record.parent = static_cast<uint32_t>(shapeIndex(shape->getParent()));
+            record.keys.push_back(add(shape->getKey()));
+        }
+        uint64_t index = shapes.size();
+        shapes.push_back(std::move(record));
+        shapeIndexes.emplace(shape, index);
+        return index;
+    }
+
+    uint64_t layoutIndex(const ClassLayout* layout) {
+        auto it = layoutIndexes.find(layout);
+        if (it == layoutIndexes.end()) {
+            throw SnapshotError("Instance of a class the VM does not own");
+        }
+        return it->second;
+    }
+
+    // Copies every object added so far, and those they reach
+    void copyObjects() {
+        while (!pending.empty()) {
+            const HeapObject* obj = pending.back();
+            pending.pop_back();
+            copy(obj, offsets[obj]);
+        }
+    }
+
+    uint64_t imageBytes() const { return cursor; }
+
+    std::vector<Run> runs;
+    std::vector<char> bytes; // Image space, from offset 0
+    std::vector<uint64_t> relocations;
+    std::vector<ShapeRecord> shapes;
+
+private:
+    std::unordered_map<const HeapObject*, uint64_t> offsets;
+    std::vector<const HeapObject*> pending;
+    std::unordered_map<const Shape*, uint64_t> shapeIndexes;
+    std::unordered_map<const FunctionProto*, uint64_t> protoIndexes;
+    std::unordered_map<const ClassLayout*, uint64_t> layoutIndexes;
+    uint64_t cursor = 0;
+    bool runOpen = false;
+
+    void store(uint64_t at, uint64_t word) { std::memcpy(&bytes[at], &word, sizeof(word)); }
+
+    void relocate(uint64_t at, uint64_t word, RelocationKind kind) {
+        store(at, word);
+        relocations.push_back(at << kRelocKindBits | kind);
+    }
+
+    // The field at `field` of `obj` (a Value) goes to image offset `at`
+    void copyValue(const HeapObject* obj, const Value* field, uint64_t at) {
+        uint64_t fieldAt = at + static_cast<uint64_t>(reinterpret_cast<const char*>(field) -
+                                                      reinterpret_cast<const char*>(obj));
+        Value value = *field;
+        uint64_t encoded = encode(value); // May grow `bytes`
+        if (value.isObject()) {
+            relocate(fieldAt, encoded, kRelocValue);
+        } else {
+            store(fieldAt, encoded);
+        }
+    }
+
+    void copyPointer(const HeapObject* obj, const void* field, uint64_t at, uint64_t word, RelocationKind kind) {
+        uint64_t fieldAt = at + static_cast<uint64_t>(reinterpret_cast<const char*>(field) -
+                                                      reinterpret_cast<const char*>(obj));
+        relocate(fieldAt, word, kind);
+    }
+
+    uint64_t protoIndex(const FunctionProto* proto) {
+        auto it = protoIndexes.find(proto);
+        if (it == protoIndexes.end()) {
+            throw SnapshotError("Function that the VM did not adopt");
+        }
+        return it->second;
+    }
+
+    void copy(const HeapObject* obj, uint64_t at) {
+        size_t size = Heap::objectSize(obj);
+        if (bytes.size() < cursor) {
+            bytes.resize(cursor);
+        }
+        std::memcpy(&bytes[at], obj, size);
+        HeapObject header;
+        std::memcpy(&header, &bytes[at], sizeof(header));
+        header.gcBits = 0;
+        std::memcpy(&bytes[at], &header, sizeof(header));
+
+        switch (obj->kind) {
+            case ObjectKind::String:
+                if (static_cast<const String*>(obj)->isRope()) {
+                    auto* rope = static_cast<const RopeString*>(obj);
+                    copyValue(obj, &rope->left, at);
+                    copyValue(obj, &rope->right, at);
+                }
+                break;
+            case ObjectKind::Object: {
+                auto* o = static_cast<const Object*>(obj);
+                copyPointer(obj, &o->shape, at, shapeIndex(loadShape(o)), kRelocShape);
+                if (o->overflow) {
+                    copyPointer(obj, &o->overflow, at, add(o->overflow), kRelocObject);
+                }
+                for (const Value& slot : o->inlineSlots) {
+                    copyValue(obj, &slot, at);
+                }
+                break;
+            }
+            case ObjectKind::Function: {
+                auto* fn = static_cast<const FunctionObject*>(obj);
+                copyPointer(obj, &fn->proto, at, protoIndex(fn->proto), kRelocProto);
+                break;
+            }
+            case ObjectKind::ValueArray: {
+                auto* array = static_cast<const ValueArray*>(obj);
+                for (uint32_t i = 0; i < array->length; ++i) {
+                    copyValue(obj, &array->items()[i], at);
+                }
+                break;
+            }
+            case ObjectKind::Instance: {
+                auto* instance = static_cast<const Instance*>(obj);
+                copyPointer(obj, &instance->layout, at, layoutIndex(instance->layout), kRelocLayout);
+                copyValue(obj, &instance->expando, at);
+                const Value* values = instance->fieldAt<Value>(sizeof(Instance));
+                for (uint32_t i = 0; i < instance->layout->valueFieldCount(); ++i) {
+                    copyValue(obj, &values[i], at);
+                }
+                break;
+            }
+            case ObjectKind::Promise: {
+                auto* promise = static_cast<const Promise*>(obj);
+                copyValue(obj, &promise->result, at);
+                copyValue(obj, &promise->waiters, at);
+                break;
+            }
+            case ObjectKind::Coroutine: {
+                auto* coroutine = static_cast<const Coroutine*>(obj);
+                copyValue(obj, &coroutine->result, at);
+                copyValue(obj, &coroutine->waiters, at);
+                copyValue(obj, &coroutine->nextWaiter, at);
+                copyPointer(obj, &coroutine->proto, at, protoIndex(coroutine->proto), kRelocProto);
+                // Saved registers only mean something while suspended
+                for (uint32_t i = 0; i < coroutine->length; ++i) {
+                    if (coroutine->isSuspended()) {
+                        copyValue(obj, &coroutine->registers()[i], at);
+                    } else {
+                        store(at + sizeof(Coroutine) + i * sizeof(Value), Value::undefined().rawBits());
+                    }
+                }
+                break;
+            }
+            case ObjectKind::Free:
+                break;
+        }
+    }
+};
+
+} // namespace
+
+void Snapshot::write(VM& vm, const std::string& path) {
+    if (vm.frameCount != 0 || vm.hasPendingJobs() || !vm.pendingLocks.empty()) {
+        throw SnapshotError("Cannot snapshot a VM while code runs or jobs are pending");
+    }
+    ObjectImage image(vm.shapes.root(), vm.protos, vm.classes);
+
+    // Roots first, each encoded as the image will hold it
+    std::vector<std::pair<std::string, uint64_t>> atoms;
+    for (const auto& [chars, atom] : vm.atoms) {
+        atoms.emplace_back(chars, image.add(atom));
+    }
+    std::vector<uint64_t> functions;
+    for (FunctionObject* fn : vm.functions) {
+        functions.push_back(image.add(fn));
+    }
+    std::vector<uint64_t> globals;
+    for (Value global : vm.globals) {
+        globals.push_back(image.encode(global));
+    }
+    std::vector<std::vector<uint64_t>> constants;
+    std::vector<std::vector<uint64_t>> cacheKeys;
+    for (const auto& proto : vm.protos) {
+        constants.emplace_back();
+        for (Value constant : proto->constants) {
+            constants.back().push_back(image.encode(constant));
+        }
+        cacheKeys.emplace_back();
+        for (const PropertyCache& cache : proto->propertyCaches) {
+            cacheKeys.back().push_back(cache.key ? image.add(cache.key) : kNoKey);
+        }
+    }
+    image.copyObjects();
+
+    ByteWriter out;
+    out.putBytes(kMagic, sizeof(kMagic));
+    out.put<uint32_t>(kVersion);
+    out.put<uint32_t>(buildFingerprint());
+    size_t checksumAt = out.size();
+    out.put<uint64_t>(0); // Patched once the payload is complete
+    size_t payloadAt = out.size();
+
+    // Objects, run by run
+    out.put<uint64_t>(image.runs.size());
+    for (const ObjectImage::Run& run : image.runs) {
+        out.put<uint64_t>(run.offset);
+        out.put<uint64_t>(run.bytes);
+        out.align();
+        out.putBytes(&image.bytes[run.offset], run.bytes);
+    }
+
+    out.put<uint32_t>(static_cast<uint32_t>(atoms.size()));
+    for (const auto& [chars, offset] : atoms) {
+        out.putString(chars);
+        out.put<uint64_t>(offset);
+    }
+
+    // Shapes after their parents; the root is implied
+    out.put<uint32_t>(static_cast<uint32_t>(image.shapes.size() - 1));
+    for (size_t i = 1; i < image.shapes.size(); ++i) {
+        const ObjectImage::ShapeRecord& shape = image.shapes[i];
+        out.put<uint8_t>(shape.dictionary ? 1 : 0);
+        out.put<uint32_t>(shape.parent);
+        out.put<uint32_t>(static_cast<uint32_t>(shape.keys.size()));
+        for (uint64_t key : shape.keys) {
+            out.put<uint64_t>(key);
+        }
+    }
+
+    out.put<uint32_t>(static_cast<uint32_t>(vm.classes.size()));
+    std::unordered_map<const ClassLayout*, uint32_t> classIndexes;
+    for (const auto& layout : vm.classes) {
+        classIndexes.emplace(layout.get(), static_cast<uint32_t>(classIndexes.size()));
+        out.putString(layout->name());
+        out.put<uint32_t>(layout->fieldCount());
+        for (uint32_t i = 0; i < layout->fieldCount(); ++i) {
+            out.putString(std::string(layout->field(i).name->view()));
+            out.put<uint8_t>(static_cast<uint8_t>(layout->field(i).type));
+        }
+    }
+
+    out.put<uint32_t>(static_cast<uint32_t>(vm.protos.size()));
+    for (size_t p = 0; p < vm.protos.size(); ++p) {
+        const FunctionProto& proto = *vm.protos[p];
+        out.putString(proto.name);
+        out.put<int32_t>(proto.numParams);
+        out.put<int32_t>(proto.numRegisters);
+        out.put<uint8_t>(static_cast<uint8_t>((proto.isWild ? 1 : 0) | (proto.isAsync ? 2 : 0)));
+        out.put<uint32_t>(static_cast<uint32_t>(proto.code.size()));
+        for (const Instruction& instruction : proto.code) {
+            out.put<uint8_t>(static_cast<uint8_t>(instruction.op));
+            out.put<int32_t>(instruction.a);
+            out.put<int32_t>(instruction.b);
+            out.put<int32_t>(instruction.c);
+        }
+        out.put<uint32_t>(static_cast<uint32_t>(constants[p].size()));
+        for (uint64_t constant : constants[p]) {
+            out.put<uint64_t>(constant);
+        }
+        out.put<uint32_t>(static_cast<uint32_t>(cacheKeys[p].size()));
+        for (uint64_t key : cacheKeys[p]) {
+            out.put<uint64_t>(key);
+        }
+        out.put<uint32_t>(static_cast<uint32_t>(proto.classes.size()));
+        for (const ClassLayout* layout : proto.classes) {
+            out.put<uint32_t>(classIndexes.at(layout));
+        }
+        out.put<uint32_t>(static_cast<uint32_t>(proto.fieldRefs.size()));
+        for (const FieldRef& ref : proto.fieldRefs) {
+            out.put<uint32_t>(classIndexes.at(ref.layout));
+            out.put<uint32_t>(ref.index);
+        }
+        out.put<uint32_t>(static_cast<uint32_t>(proto.lockSites.size()));
+        // GC-free functions have dropped theirs; the loaded VM collects
+        const StackMap& map = proto.stackMap;
+        out.put<uint64_t>(map.instructionCount());
+        out.put<uint64_t>(map.wordsPerInstruction());
+        if (!map.empty()) {
+            out.putBytes(reinterpret_cast<const char*>(map.row(0)),
+                         map.instructionCount() * map.wordsPerInstruction() * sizeof(uint64_t));
+        }
+    }
+
+    out.put<uint64_t>(image.relocations.size());
+    for (uint64_t relocation : image.relocations) {
+        out.put<uint64_t>(relocation);
+    }
+
+    out.put<uint32_t>(static_cast<uint32_t>(functions.size()));
+    for (uint64_t fn : functions) {
+        out.put<uint64_t>(fn);
+    }
+    out.put<uint32_t>(static_cast<uint32_t>(vm.globalSlots.size()));
+    for (const auto& [name, slot] : vm.globalSlots) {
+        out.putString(name);
+        out.put<int32_t>(slot);
+    }
+    out.put<uint32_t>(static_cast<uint32_t>(globals.size()));
+    for (uint64_t global : globals) {
+        out.put<uint64_t>(global);
+    }
+    out.patch<uint64_t>(checksumAt, payloadChecksum(out.data().data() + payloadAt, out.size() - payloadAt));
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(out.data().data(), static_cast<std::streamsize>(out.data().size()));
+    if (!file) {
+        throw SnapshotError("Cannot write snapshot " + path);
+    }
+}
+
+std::unique_ptr<VM> Snapshot::load(const std::string& path, size_t nurserySize) {
+    MappedFile file(path);
+    ByteReader in(file.data, file.size);
+    if (std::memcmp(in.take(sizeof(kMagic)), kMagic, sizeof(kMagic)) != 0) {
+        throw SnapshotError(path + " is not a snapshot image");
+    }
+    if (in.get<uint32_t>() != kVersion || in.get<uint32_t>() != buildFingerprint()) {
+        throw SnapshotError(path + " was written by a different build");
+    }
+    // Checked before anything in the payload is trusted
+    uint64_t checksum = in.get<uint64_t>();
+    if (payloadChecksum(in.rest(), in.remaining()) != checksum) {
+        throw SnapshotError("Snapshot image is corrupt");
+    }
+
+    auto vm = std::make_unique<VM>(nurserySize);
+    Heap& heap = vm->heap;
+
+    // One tenured block per run; runBase maps every run slot of image
+    // space to where its bytes now live, and runLimit to how many of the
+    // block's bytes follow that slot's start
+    std::vector<char*> runBase;
+    std::vector<uint64_t> runLimit;
+    uint64_t runCount = in.get<uint64_t>();
+    for (uint64_t i = 0; i < runCount; ++i) {
+        uint64_t offset = in.get<uint64_t>();
+        uint64_t bytes = in.get<uint64_t>();
+        in.align();
+        const char* source = in.take(bytes);
+        if (offset % kRunBytes != 0 || bytes == 0) {
+            throw SnapshotError("Snapshot image is corrupt");
+        }
+        auto* block = static_cast<char*>(heap.allocateTenured(bytes));
+        std::memcpy(block, source, bytes);
+        size_t first = offset / kRunBytes;
+        size_t slots = roundUp(bytes, kRunBytes) / kRunBytes;
+        if (runBase.size() < first + slots) {
+            runBase.resize(first + slots, nullptr);
+            runLimit.resize(first + slots, 0);
+        }
+        for (size_t k = 0; k < slots; ++k) {
+            runBase[first + k] = block + k * kRunBytes;
+            runLimit[first + k] = bytes - k * kRunBytes;
+        }
+    }
+    // The `size` bytes at image offset `offset`, which must lie in one run
+    auto address = [&runBase, &runLimit](uint64_t offset, uint64_t size) -> char* {
+        size_t run = offset / kRunBytes;
+        if (run >= runBase.size() || !runBase[run] || size > runLimit[run] ||
+            offset % kRunBytes > runLimit[run] - size) {
+            throw SnapshotError("Snapshot image is corrupt");
+        }
+        return runBase[run] + offset % kRunBytes;
+    };
+    auto object = [&address](uint64_t offset) {
+        auto* obj = reinterpret_cast<HeapObject*>(address(offset, sizeof(HeapObject)));
+        address(offset, Heap::objectSize(obj)); // The whole object, not only its header
+        return obj;
+    };
+    auto value = [&object](uint64_t raw) {
+        Value decoded = Value::fromBits(raw);
+        return decoded.isObject() ? Value::object(object(reinterpret_cast<uintptr_t>(decoded.asObject()))) : decoded;
+    };
+
+    uint32_t atomCount = in.get<uint32_t>();
+    for (uint32_t i = 0; i < atomCount; ++i) {
+        std::string chars = in.getString();
+        vm->atoms.emplace(std::move(chars), static_cast<String*>(object(in.get<uint64_t>())));
+    }
+
+    std::vector<Shape*> shapes{vm->shapes.root()};
+    uint32_t shapeCount = in.get<uint32_t>();
+    for (uint32_t i = 0; i < shapeCount; ++i) {
+        bool dictionary = in.get<uint8_t>() != 0;
+        uint32_t parent = in.get<uint32_t>();
+        uint32_t keyCount = in.get<uint32_t>();
+        if (parent >= shapes.size()) {
+            throw SnapshotError("Snapshot image is corrupt");
+        }
+        Shape* shape = dictionary ? vm->shapes.toDictionary(vm->shapes.root()) : shapes[parent];
+        for (uint32_t k = 0; k < keyCount; ++k) {
+            uint64_t key = in.get<uint64_t>();
+            shape = vm->shapes.addProperty(shape, key == kNoKey ? nullptr : static_cast<String*>(object(key)));
+        }
+        shapes.push_back(shape);
+    }
+
+    uint32_t classCount = in.get<uint32_t>();
+    for (uint32_t i = 0; i < classCount; ++i) {
+        std::string name = in.getString();
+        std::vector<std::pair<std::string, FieldType>> fields(in.get<uint32_t>());
+        for (auto& [fieldName, type] : fields) {
+            fieldName = in.getString();
+            type = static_cast<FieldType>(in.get<uint8_t>());
+        }
+        vm->defineClass(name, fields);
+    }
+    auto layout = [&vm](uint32_t index) -> const ClassLayout* {
+        if (index >= vm->classes.size()) {
+            throw SnapshotError("Snapshot image is corrupt");
+        }
+        return vm->classes[index].get();
+    };
+
+    uint32_t protoCount = in.get<uint32_t>();
+    for (uint32_t p = 0; p < protoCount; ++p) {
+        auto proto = std::make_unique<FunctionProto>();
+        proto->name = in.getString();
+        proto->numParams = in.get<int32_t>();
+        proto->numRegisters = in.get<int32_t>();
+        uint8_t flags = in.get<uint8_t>();
+        proto->isWild = (flags & 1) != 0;
+        proto->isAsync = (flags & 2) != 0;
+        proto->code.resize(in.get<uint32_t>());
+        for (Instruction& instruction : proto->code) {
+            instruction.op = static_cast<Opcode>(in.get<uint8_t>());
+            instruction.a = in.get<int32_t>();
+            instruction.b = in.get<int32_t>();
+            instruction.c = in.get<int32_t>();
+        }
+        proto->constants.resize(in.get<uint32_t>());
+        for (Value& constant : proto->constants) {
+            constant = value(in.get<uint64_t>());
+        }
+        uint32_t cacheCount = in.get<uint32_t>();
+        for (uint32_t i = 0; i < cacheCount; ++i) {
+            uint64_t key = in.get<uint64_t>();
+            proto->propertyCaches.emplace_back(key == kNoKey ? nullptr : static_cast<String*>(object(key)));
+        }
+        proto->classes.resize(in.get<uint32_t>());
+        for (const ClassLayout*& classLayout : proto->classes) {
+            classLayout = layout(in.get<uint32_t>());
+        }
+        proto->fieldRefs.resize(in.get<uint32_t>());
+        for (FieldRef& ref : proto->fieldRefs) {
+            ref.layout = layout(in.get<uint32_t>());
+            ref.index = in.get<uint32_t>();
+        }
+        proto->lockSites.resize(in.get<uint32_t>());
+        uint64_t instructions = in.get<uint64_t>();
+        uint64_t words = in.get<uint64_t>();
+        if (instructions != 0) {
+            proto->stackMap = StackMap(instructions, proto->numRegisters);
+            if (proto->stackMap.wordsPerInstruction() != words) {
+                throw SnapshotError("Snapshot image is corrupt");
+            }
+            size_t mapBytes = instructions * words * sizeof(uint64_t);
+            std::memcpy(proto->stackMap.row(0), in.take(mapBytes), mapBytes);
+        } else if (!proto->code.empty()) {
+            proto->stackMap = computeStackMap(*proto);
+        }
+        vm->protos.push_back(std::move(proto));
+    }
+
+    // Every reference in the copied objects, in one pass
+    uint64_t relocationCount = in.get<uint64_t>();
+    for (uint64_t i = 0; i < relocationCount; ++i) {
+        uint64_t entry = in.get<uint64_t>();
+        char* field = address(entry >> kRelocKindBits, sizeof(uint64_t));
+        uint64_t word;
+        std::memcpy(&word, field, sizeof(word));
+        void* resolved;
+        switch (entry & ((1u << kRelocKindBits) - 1)) {
+            case kRelocValue: {
+                uint64_t bits = value(word).rawBits();
+                std::memcpy(field, &bits, sizeof(bits));
+                continue;
+            }
+            case kRelocObject: resolved = object(word); break;
+            case kRelocShape:
+                if (word >= shapes.size()) {
+                    throw SnapshotError("Snapshot image is corrupt");
+                }
+                resolved = shapes[word];
+                break;
+            case kRelocProto:
+                if (word >= vm->protos.size()) {
+                    throw SnapshotError("Snapshot image is corrupt");
+                }
+                resolved = vm->protos[word].get();
+                break;
+            case kRelocLayout: resolved = const_cast<ClassLayout*>(layout(static_cast<uint32_t>(word))); break;
+            default: throw SnapshotError("Snapshot image is corrupt");
+        }
+        std::memcpy(field, &resolved, sizeof(resolved));
+    }
+
+    uint32_t functionCount = in.get<uint32_t>();
+    for (uint32_t i = 0; i < functionCount; ++i) {
+        vm->functions.push_back(static_cast<FunctionObject*>(object(in.get<uint64_t>())));
+    }
+    std::vector<std::pair<std::string, int32_t>> slots(in.get<uint32_t>());
+    for (auto& [name, slot] : slots) {
+        name = in.getString();
+        slot = in.get<int32_t>();
+    }
+    vm->globals.resize(in.get<uint32_t>());
+    for (Value& global : vm->globals) {
+        global = value(in.get<uint64_t>());
+    }
+    // getGlobal() does not check its slot
+    for (auto& [name, slot] : slots) {
+        if (slot < 0 || static_cast<size_t>(slot) >= vm->globals.size()) {
+            throw SnapshotError("Snapshot image is corrupt");
+        }
+        vm->globalSlots.emplace(std::move(name), slot);
+    }
+    return vm;
+}
+
+bool Snapshot::isImage(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    char magic[sizeof(kMagic)];
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
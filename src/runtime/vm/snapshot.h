@@ -0,0 +1,54 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "runtime/memory/heap.h"
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+class VM;
+
+// Raised when an image cannot be written (the VM holds state that has no
+// place in one) or read (missing, truncated, or from another build)
+class SnapshotError : public std::runtime_error {
+public:
+    explicit SnapshotError(const std::string& message) : std::runtime_error(message) {}
+};
+
+// Heap images: the state of a VM after its initialization (top-level code,
+// builtin setup) saved to a file with write(), so a fresh process can start
+// from it instead of running that initialization again (`superecma <image>`
+// then calls its global `main`).
+//
+// An image holds every heap object reachable from the VM's roots, the
+// shapes those objects use, the class layouts, the compiled functions
+// (bytecode, constants, stack maps) and the globals and atom table. It is
+// tied to the build that wrote it and carries a checksum of its contents,
+// checked before anything is copied; every reference and global slot is
+// also checked to land inside the image.
+//
+// Objects are stored as they sit in memory, packed into runs of at most
+// Heap::kLargeObjectSize bytes that each start at a multiple of that size
+// in the image's address space, so a reference is an image offset and its
+// run is offset / kLargeObjectSize. Loading maps the file read-only but
+// does not run the heap out of the mapping: it copies every run into one
+// tenured allocation and then relocates eagerly, walking a flat relocation
+// table listing every field that holds a reference. Heap objects hold raw
+// pointers and nothing traps a read of an unrelocated one, so relocating
+// pages lazily as they are touched is not possible. The walk needs no
+// parsing of objects and no graph traversal. Inline caches, tier-up state
+// and compiled code are not saved; they warm up again.
+//
+// Only a VM at rest can be saved: no frame running, no jobs or lock waits
+// pending, and no wild objects, which live outside the collected heap.
+class Snapshot {
+public:
+    // Throws SnapshotError
+    static void write(VM& vm, const std::string& path);
+    static std::unique_ptr<VM> load(const std::string& path, size_t nurserySize = Heap::kDefaultNurserySize);
+
+    // Whether the file starts like an image
+    static bool isImage(const std::string& path);
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,41 @@
+#ifndef STACK_MAP_H
+#define STACK_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Precise stack map for one function: for every instruction, the set of
+// registers that are live on entry to it (read later without being
+// overwritten first). The collector traces only live registers, so dead
+// registers neither keep garbage alive nor need updating when objects move.
+//
+// A frame suspended at a Call instruction needs the registers live across
+// the call instead: liveIn(pc + 1) minus the call's result register.
+class StackMap {
+public:
+    StackMap() = default;
+    StackMap(size_t instructionCount, int registerCount)
+        : instructions(instructionCount),
+          words((static_cast<size_t>(registerCount) + 63) / 64),
+          bits(instructionCount * words, 0) {}
+
+    bool empty() const { return instructions == 0; }
+    size_t instructionCount() const { return instructions; }
+    size_t wordsPerInstruction() const { return words; }
+
+    bool isLive(size_t pc, int reg) const {
+        return (bits[pc * words + static_cast<size_t>(reg) / 64] >> (reg % 64)) & 1;
+    }
+
+    // Live-in bit set of instruction `pc`, wordsPerInstruction() words long
+    uint64_t* row(size_t pc) { return bits.data() + pc * words; }
+    const uint64_t* row(size_t pc) const { return bits.data() + pc * words; }
+
+private:
+    size_t instructions = 0;
+    size_t words = 0;
+    std::vector<uint64_t> bits;
+};
+
+#endif // STACK_MAP_H
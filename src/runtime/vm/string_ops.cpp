@@ -0,0 +1,330 @@
+#include "runtime/vm/string_ops.h"
+#include "runtime/memory/heap.h"
+#include "runtime/vm/vm.h"
+#include <cstring>
+#include <vector>
+
+namespace {
+
+constexpr char16_t kReplacementCharacter = 0xFFFD;
+
+// Visits the flat pieces of a string in order, without recursion: a loop
+// appending to a string makes ropes as deep as the loop ran
+class LeafWalker {
+public:
+    explicit LeafWalker(const String* str) : pending{str} {}
+
+    // Next non-empty flat piece, or nullptr at the end
+    const String* next() {
+        while (!pending.empty()) {
+            const String* str = pending.back();
+            pending.pop_back();
+            if (const String* flat = flatContents(str)) {
+                if (flat->length != 0) {
+                    return flat;
+                }
+                continue;
+            }
+            const RopeString* rope = asRope(str);
+            pending.push_back(asString(rope->right));
+            pending.push_back(asString(rope->left));
+        }
+        return nullptr;
+    }
+
+private:
+    std::vector<const String*> pending;
+};
+
+// Reads the code units of a string one at a time
+class CodeUnitReader {
+public:
+    explicit CodeUnitReader(const String* str) : walker(str), leaf(walker.next()), index(0) {}
+
+    bool done() const { return leaf == nullptr; }
+
+    char16_t next() {
+        char16_t unit = leaf->charAt(index++);
+        if (index == leaf->length) {
+            leaf = walker.next();
+            index = 0;
+        }
+        return unit;
+    }
+
+private:
+    LeafWalker walker;
+    const String* leaf;
+    uint32_t index;
+};
+
+template <typename Fn>
+void forEachLeaf(const String* str, Fn fn) {
+    if (const String* flat = flatContents(str)) {
+        fn(flat);
+        return;
+    }
+    LeafWalker walker(str);
+    while (const String* leaf = walker.next()) {
+        fn(leaf);
+    }
+}
+
+// Copies the characters of `source` into the flat string `target` at `offset`
+void copyChars(const String* source, String* target, uint32_t offset) {
+    forEachLeaf(source, [&](const String* leaf) {
+        if (!target->isTwoByte()) {
+            std::memcpy(target->chars() + offset, leaf->chars(), leaf->length);
+        } else if (leaf->isTwoByte()) {
+            std::memcpy(target->twoByteChars() + offset, leaf->twoByteChars(), 2 * static_cast<size_t>(leaf->length));
+        } else {
+            char16_t* out = target->twoByteChars() + offset;
+            for (uint32_t i = 0; i < leaf->length; ++i) {
+                out[i] = static_cast<unsigned char>(leaf->chars()[i]);
+            }
+        }
+        offset += leaf->length;
+    });
+}
+
+std::u16string decodeUtf8(std::string_view utf8) {
+    std::u16string units;
+    units.reserve(utf8.size());
+    size_t i = 0;
+    while (i < utf8.size()) {
+        auto lead = static_cast<unsigned char>(utf8[i]);
+        if (lead < 0x80) {
+            units.push_back(lead);
+            ++i;
+            continue;
+        }
+        size_t extra = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : 0;
+        uint32_t codePoint = lead & (0x3F >> extra);
+        size_t end = i + 1 + extra;
+        bool valid = extra != 0 && lead < 0xF5 && end <= utf8.size();
+        for (size_t j = i + 1; valid && j < end; ++j) {
+            auto next = static_cast<unsigned char>(utf8[j]);
+            valid = (next & 0xC0) == 0x80;
+            codePoint = (codePoint << 6) | (next & 0x3F);
+        }
+        // Reject overlong forms, surrogates and values past U+10FFFF
+        static constexpr uint32_t kMinimum[] = {0, 0x80, 0x800, 0x10000};
+        valid = valid && codePoint >= kMinimum[extra] && codePoint <= 0x10FFFF &&
+                (codePoint < 0xD800 || codePoint > 0xDFFF);
+        if (!valid) {
+            units.push_back(kReplacementCharacter);
+            ++i;
+            continue;
+        }
+        if (codePoint >= 0x10000) {
+            codePoint -= 0x10000;
+            units.push_back(static_cast<char16_t>(0xD800 + (codePoint >> 10)));
+            units.push_back(static_cast<char16_t>(0xDC00 + (codePoint & 0x3FF)));
+        } else {
+            units.push_back(static_cast<char16_t>(codePoint));
+        }
+        i = end;
+    }
+    return units;
+}
+
+void appendUtf8(std::string& out, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        out.push_back(static_cast<char>(codePoint));
+    } else if (codePoint < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+        out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    } else if (codePoint < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+}
+
+} // namespace
+
+String* newString(Heap& heap, std::string_view utf8, bool tenured) {
+    bool ascii = true;
+    for (char c : utf8) {
+        ascii &= static_cast<unsigned char>(c) < 0x80;
+    }
+    if (ascii) {
+        return tenured ? heap.allocateTenuredString(utf8) : heap.allocateString(utf8);
+    }
+    std::u16string units = decodeUtf8(utf8);
+    bool twoByte = false;
+    for (char16_t unit : units) {
+        twoByte |= unit > 0xFF;
+    }
+    auto length = static_cast<uint32_t>(units.size());
+    String* str = tenured ? heap.allocateTenuredString(length, twoByte) : heap.allocateString(length, twoByte);
+    for (uint32_t i = 0; i < length; ++i) {
+        if (twoByte) {
+            str->twoByteChars()[i] = units[i];
+        } else {
+            str->chars()[i] = static_cast<char>(units[i]);
+        }
+    }
+    return str;
+}
+
+String* concatStrings(Heap& heap, String* left, String* right) {
+    if (left->length == 0) {
+        return right;
+    }
+    if (right->length == 0) {
+        return left;
+    }
+    uint64_t length = static_cast<uint64_t>(left->length) + right->length;
+    if (length > kMaxStringLength) {
+        throw RuntimeError("Invalid string length");
+    }
+    if (length >= kMinRopeLength) {
+        return heap.allocateRope(left, right);
+    }
+    String* result = heap.allocateString(static_cast<uint32_t>(length), left->isTwoByte() || right->isTwoByte());
+    copyChars(left, result, 0);
+    copyChars(right, result, left->length);
+    return result;
+}
+
+const String* flatContents(const String* str) {
+    if (!str->isRope()) {
+        return str;
+    }
+    if (str->flags & kStringFlattened) {
+        return asString(asRope(str)->left);
+    }
+    return nullptr;
+}
+
+String* flattenString(Heap& heap, String* str) {
+    if (!str->isRope()) {
+        return str;
+    }
+    RopeString* rope = asRope(str);
+    if (rope->flags & kStringFlattened) {
+        return asString(rope->left);
+    }
+    String* flat = heap.allocateString(rope->length, rope->isTwoByte());
+    copyChars(rope, flat, 0);
+    flat->hash = rope->hash;
+
+    // The children are no longer needed; only the copy is kept
+    heap.preWriteBarrier(rope->left);
+    heap.preWriteBarrier(rope->right);
+    rope->left = Value::object(flat);
+    rope->right = Value::undefined();
+    rope->flags |= kStringFlattened;
+    heap.writeBarrier(rope, rope->left);
+    return flat;
+}
+
+uint32_t stringHash(String* str) {
+    if (str->hash != 0) {
+        return str->hash;
+    }
+    // FNV-1a over code units, so both encodings of a string agree
+    uint32_t hash = 2166136261u;
+    forEachLeaf(str, [&](const String* leaf) {
+        if (leaf->isTwoByte()) {
+            for (uint32_t i = 0; i < leaf->length; ++i) {
+                hash = (hash ^ leaf->twoByteChars()[i]) * 16777619u;
+            }
+        } else {
+            for (uint32_t i = 0; i < leaf->length; ++i) {
+                hash = (hash ^ static_cast<unsigned char>(leaf->chars()[i])) * 16777619u;
+            }
+        }
+    });
+    str->hash = hash != 0 ? hash : 1; // 0 means "not computed"
+    return str->hash;
+}
+
+bool equalStrings(const String* a, const String* b) {
+    if (a == b) {
+        return true;
+    }
+    if (a->length != b->length) {
+        return false;
+    }
+    // Atoms are unique, and equal contents have equal hashes
+    if (a->isInterned() && b->isInterned()) {
+        return false;
+    }
+    if (a->hash != 0 && b->hash != 0 && a->hash != b->hash) {
+        return false;
+    }
+    const String* flatA = flatContents(a);
+    const String* flatB = flatContents(b);
+    if (flatA && flatB && flatA->isTwoByte() == flatB->isTwoByte()) {
+        size_t bytes = flatA->isTwoByte() ? 2 * static_cast<size_t>(flatA->length) : flatA->length;
+        return std::memcmp(flatA->chars(), flatB->chars(), bytes) == 0;
+    }
+    return compareStrings(a, b) == 0;
+}
+
+int compareStrings(const String* a, const String* b) {
+    const String* flatA = flatContents(a);
+    const String* flatB = flatContents(b);
+    if (flatA && flatB && !flatA->isTwoByte() && !flatB->isTwoByte()) {
+        return flatA->view().compare(flatB->view());
+    }
+    CodeUnitReader left(a);
+    CodeUnitReader right(b);
+    while (!left.done() && !right.done()) {
+        char16_t x = left.next();
+        char16_t y = right.next();
+        if (x != y) {
+            return x < y ? -1 : 1;
+        }
+    }
+    if (left.done() && right.done()) {
+        return 0;
+    }
+    return left.done() ? -1 : 1;
+}
+
+std::string toUtf8(const String* str) {
+    std::string out;
+    out.reserve(str->length);
+    char16_t high = 0; // Pending lead surrogate; pairs may span pieces
+    forEachLeaf(str, [&](const String* leaf) {
+        if (!leaf->isTwoByte()) {
+            if (high != 0) {
+                appendUtf8(out, high);
+                high = 0;
+            }
+            for (uint32_t i = 0; i < leaf->length; ++i) {
+                appendUtf8(out, static_cast<unsigned char>(leaf->chars()[i]));
+            }
+            return;
+        }
+        for (uint32_t i = 0; i < leaf->length; ++i) {
+            char16_t unit = leaf->twoByteChars()[i];
+            if (high != 0 && unit >= 0xDC00 && unit <= 0xDFFF) {
+                appendUtf8(out, 0x10000 + ((static_cast<uint32_t>(high - 0xD800) << 10) | (unit - 0xDC00)));
+                high = 0;
+                continue;
+            }
+            if (high != 0) {
+                appendUtf8(out, high);
+                high = 0;
+            }
+            if (unit >= 0xD800 && unit <= 0xDBFF) {
+                high = unit;
+            } else {
+                appendUtf8(out, unit);
+            }
+        }
+    });
+    if (high != 0) {
+        appendUtf8(out, high);
+    }
+    return out;
+}
@@ -0,0 +1,50 @@
+#ifndef STRING_OPS_H
+#define STRING_OPS_H
+
+#include "runtime/vm/heap_object.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+class Heap;
+
+// Operations on script strings, flat or rope (see String). Strings hold
+// UTF-16 code units; those made of code units up to 0xFF only are stored
+// one byte per character.
+//
+// Concatenation is O(1): it makes a rope node unless the result is shorter
+// than kMinRopeLength, where copying the characters is cheaper than the
+// node and keeps short strings flat. A loop appending to a string builds a
+// chain of nodes that is copied once, by flattenString(), when the
+// characters are first needed. Reading functions (equality, comparison,
+// hashing, conversion) walk ropes in place and never allocate, so they may
+// be called anywhere, not only at safepoints.
+
+constexpr uint32_t kMinRopeLength = 13;
+constexpr uint32_t kMaxStringLength = (1u << 30) - 1;
+
+// Builds a flat string from UTF-8 text; invalid sequences become U+FFFD
+String* newString(Heap& heap, std::string_view utf8, bool tenured = false);
+
+// left + right; throws RuntimeError past kMaxStringLength
+String* concatStrings(Heap& heap, String* left, String* right);
+
+// Returns a flat string with the same characters, flattening a rope (the
+// rope then forwards to the copy). Flat strings are returned as they are.
+String* flattenString(Heap& heap, String* str);
+
+// Flat string holding the characters of `str`, when one exists already
+// (a flat string, or a rope that has been flattened); otherwise nullptr
+const String* flatContents(const String* str);
+
+// Content hash, the same for both encodings; cached in the string
+uint32_t stringHash(String* str);
+
+bool equalStrings(const String* a, const String* b);
+// Lexicographic order of code units: negative, zero or positive
+int compareStrings(const String* a, const String* b);
+
+// UTF-8 encoding of the characters (unpaired surrogates are encoded as is)
+std::string toUtf8(const String* str);
+
+#endif // STRING_OPS_H
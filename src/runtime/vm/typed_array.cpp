@@ -0,0 +1,270 @@
+#include "runtime/vm/typed_array.h"
+#include "runtime/vm/vm.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+// ToUint32: the value modulo 2^32; NaN and infinities become 0
+uint32_t wrapToUint32(double value) {
+    if (!std::isfinite(value)) {
+        return 0;
+    }
+    double wrapped = std::fmod(std::trunc(value), 4294967296.0);
+    if (wrapped < 0) {
+        wrapped += 4294967296.0;
+    }
+    return static_cast<uint32_t>(wrapped);
+}
+
+uint8_t clampToUint8(double value) {
+    if (!(value > 0)) {
+        return 0; // Also NaN
+    }
+    if (value >= 255) {
+        return 255;
+    }
+    return static_cast<uint8_t>(std::nearbyint(value)); // Ties to even
+}
+
+// Writes `value` converted to an element of `kind` at `out`
+void encode(TypedArrayKind kind, double value, uint8_t* out) {
+    switch (kind) {
+        case TypedArrayKind::Int8Array:
+            *reinterpret_cast<int8_t*>(out) = static_cast<int8_t>(wrapToUint32(value));
+            break;
+        case TypedArrayKind::Uint8Array:
+            *out = static_cast<uint8_t>(wrapToUint32(value));
+            break;
+        case TypedArrayKind::Uint8ClampedArray:
+            *out = clampToUint8(value);
+            break;
+        case TypedArrayKind::Int16Array:
+            *reinterpret_cast<int16_t*>(out) = static_cast<int16_t>(wrapToUint32(value));
+            break;
+        case TypedArrayKind::Uint16Array:
+            *reinterpret_cast<uint16_t*>(out) = static_cast<uint16_t>(wrapToUint32(value));
+            break;
+        case TypedArrayKind::Int32Array:
+            *reinterpret_cast<int32_t*>(out) = static_cast<int32_t>(wrapToUint32(value));
+            break;
+        case TypedArrayKind::Uint32Array:
+            *reinterpret_cast<uint32_t*>(out) = wrapToUint32(value);
+            break;
+        case TypedArrayKind::Float32Array:
+            *reinterpret_cast<float*>(out) = static_cast<float>(value);
+            break;
+        case TypedArrayKind::Float64Array:
+            *reinterpret_cast<double*>(out) = value;
+            break;
+    }
+}
+
+double decode(TypedArrayKind kind, const uint8_t* in) {
+    switch (kind) {
+#define SE_TYPED_ARRAY_DECODE(name, type) \
+        case TypedArrayKind::name: return static_cast<double>(*reinterpret_cast<const type*>(in));
+        SE_TYPED_ARRAY_LIST(SE_TYPED_ARRAY_DECODE)
+#undef SE_TYPED_ARRAY_DECODE
+    }
+    return 0;
+}
+
+double apply(NumericOp op, double x, double y) {
+    switch (op) {
+        case NumericOp::Add: return x + y;
+        case NumericOp::Sub: return x - y;
+        case NumericOp::Mul: return x * y;
+        case NumericOp::Div: return x / y;
+    }
+    return x;
+}
+
+template <typename T>
+int64_t sumIntegers(const uint8_t* data, size_t count) {
+    const T* elements = reinterpret_cast<const T*>(data);
+    int64_t sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+        sum += elements[i];
+    }
+    return sum;
+}
+
+} // namespace
+
+size_t elementSize(TypedArrayKind kind) {
+    switch (kind) {
+#define SE_TYPED_ARRAY_SIZE(name, type) \
+        case TypedArrayKind::name: return sizeof(type);
+        SE_TYPED_ARRAY_LIST(SE_TYPED_ARRAY_SIZE)
+#undef SE_TYPED_ARRAY_SIZE
+    }
+    return 1;
+}
+
+const char* typedArrayName(TypedArrayKind kind) {
+    switch (kind) {
+#define SE_TYPED_ARRAY_NAME(name, type) \
+        case TypedArrayKind::name: return #name;
+        SE_TYPED_ARRAY_LIST(SE_TYPED_ARRAY_NAME)
+#undef SE_TYPED_ARRAY_NAME
+    }
+    return "TypedArray";
+}
+
+TypedArray::TypedArray(ArrayBuffer& buffer, TypedArrayKind kind, size_t byteOffset, size_t length)
+    : store(&buffer), offset(byteOffset), count(length), type(kind) {
+    size_t size = elementSize(kind);
+    if (byteOffset % size != 0) {
+        throw RuntimeError(std::string("Start offset of ") + typedArrayName(kind) + " should be a multiple of " +
+                           std::to_string(size));
+    }
+    if (byteOffset > buffer.byteLength() || length > (buffer.byteLength() - byteOffset) / size) {
+        throw RuntimeError("Invalid typed array length: " + std::to_string(length));
+    }
+}
+
+TypedArray::TypedArray(ArrayBuffer& buffer, TypedArrayKind kind)
+    : store(&buffer), offset(0), count(buffer.byteLength() / elementSize(kind)), type(kind) {
+    size_t size = elementSize(kind);
+    if (buffer.byteLength() % size != 0) {
+        throw RuntimeError(std::string("Byte length of ") + typedArrayName(kind) + " should be a multiple of " +
+                           std::to_string(size));
+    }
+}
+
+double TypedArray::get(size_t index) const {
+    return decode(type, data() + index * elementSize(type));
+}
+
+void TypedArray::set(size_t index, double value) {
+    encode(type, value, data() + index * elementSize(type));
+}
+
+void TypedArray::fill(double value, size_t start, size_t end) {
+    end = std::min(end, count);
+    if (start >= end) {
+        return;
+    }
+    size_t size = elementSize(type);
+    uint8_t pattern[8];
+    encode(type, value, pattern);
+    fillElements(data() + start * size, pattern, size, end - start);
+}
+
+void TypedArray::copyWithin(size_t target, size_t start, size_t end) {
+    end = std::min(end, count);
+    if (start >= end || target >= count) {
+        return;
+    }
+    size_t size = elementSize(type);
+    size_t elements = std::min(end - start, count - target);
+    std::memmove(data() + target * size, data() + start * size, elements * size);
+}
+
+void TypedArray::set(const TypedArray& source, size_t targetOffset) {
+    if (targetOffset > count || source.count > count - targetOffset) {
+        throw RuntimeError("Offset is out of bounds");
+    }
+    size_t size = elementSize(type);
+    uint8_t* to = data() + targetOffset * size;
+    if (source.type == type) {
+        std::memmove(to, source.data(), source.byteLength());
+        return;
+    }
+    // Converting copies read and write at different strides, so an
+    // overlapping source is copied out first
+    const uint8_t* from = source.data();
+    std::vector<uint8_t> copy;
+    if (from < to + source.count * size && to < from + source.byteLength()) {
+        copy.assign(from, from + source.byteLength());
+        from = copy.data();
+    }
+    size_t sourceSize = elementSize(source.type);
+    for (size_t i = 0; i < source.count; ++i) {
+        encode(type, decode(source.type, from + i * sourceSize), to + i * size);
+    }
+}
+
+ptrdiff_t TypedArray::indexOf(double value, size_t fromIndex) const {
+    if (fromIndex >= count) {
+        return -1;
+    }
+    // A value that does not survive conversion to the element type (NaN,
+    // fractions, out of range) equals no element
+    uint8_t needle[8];
+    encode(type, value, needle);
+    if (decode(type, needle) != value) {
+        return -1;
+    }
+    size_t size = elementSize(type);
+    const uint8_t* start = data() + fromIndex * size;
+    size_t remaining = count - fromIndex;
+    ptrdiff_t found = -1;
+    if (type == TypedArrayKind::Float64Array) {
+        found = indexOfF64(reinterpret_cast<const double*>(start), remaining, value);
+    } else if (type == TypedArrayKind::Float32Array) {
+        found = indexOfF32(reinterpret_cast<const float*>(start), remaining, static_cast<float>(value));
+    } else if (size == 1) {
+        found = indexOfU8(start, remaining, needle[0]);
+    } else if (size == 2) {
+        uint16_t bits;
+        std::memcpy(&bits, needle, sizeof(bits));
+        found = indexOfU16(reinterpret_cast<const uint16_t*>(start), remaining, bits);
+    } else {
+        uint32_t bits;
+        std::memcpy(&bits, needle, sizeof(bits));
+        found = indexOfU32(reinterpret_cast<const uint32_t*>(start), remaining, bits);
+    }
+    return found < 0 ? -1 : found + static_cast<ptrdiff_t>(fromIndex);
+}
+
+double TypedArray::sum() const {
+    switch (type) {
+        case TypedArrayKind::Int8Array: return static_cast<double>(sumIntegers<int8_t>(data(), count));
+        case TypedArrayKind::Uint8Array:
+        case TypedArrayKind::Uint8ClampedArray: return static_cast<double>(sumIntegers<uint8_t>(data(), count));
+        case TypedArrayKind::Int16Array: return static_cast<double>(sumIntegers<int16_t>(data(), count));
+        case TypedArrayKind::Uint16Array: return static_cast<double>(sumIntegers<uint16_t>(data(), count));
+        case TypedArrayKind::Int32Array:
+            return static_cast<double>(sumI32(reinterpret_cast<const int32_t*>(data()), count));
+        case TypedArrayKind::Uint32Array:
+            return static_cast<double>(sumU32(reinterpret_cast<const uint32_t*>(data()), count));
+        case TypedArrayKind::Float32Array:
+        case TypedArrayKind::Float64Array:
+            break;
+    }
+    double sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+        sum += get(i);
+    }
+    return sum;
+}
+
+void TypedArray::map(TypedArray& target, NumericOp op, double operand) const {
+    if (target.count != count) {
+        throw RuntimeError("Typed array lengths differ");
+    }
+    if (type == TypedArrayKind::Float64Array && target.type == type) {
+        mapF64(reinterpret_cast<double*>(target.data()), reinterpret_cast<const double*>(data()), count, op, operand);
+        return;
+    }
+    if (type == TypedArrayKind::Float32Array && target.type == type) {
+        mapF32(reinterpret_cast<float*>(target.data()), reinterpret_cast<const float*>(data()), count, op, operand);
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        target.set(i, apply(op, get(i), operand));
+    }
+}
+
+int TypedArray::compare(const TypedArray& other) const {
+    size_t common = std::min(byteLength(), other.byteLength());
+    if (int order = compareBytes(data(), other.data(), common)) {
+        return order;
+    }
+    return byteLength() < other.byteLength() ? -1 : byteLength() > other.byteLength() ? 1 : 0;
+}
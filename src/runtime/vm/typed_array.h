@@ -0,0 +1,87 @@
+#ifndef TYPED_ARRAY_H
+#define TYPED_ARRAY_H
+
+#include "runtime/memory/array_buffer.h"
+#include "runtime/vm/simd_kernels.h"
+#include <cstddef>
+#include <cstdint>
+
+// Typed-array types: X(Name, element type)
+#define SE_TYPED_ARRAY_LIST(X)      \
+    X(Int8Array,         int8_t)    \
+    X(Uint8Array,        uint8_t)   \
+    X(Uint8ClampedArray, uint8_t)   \
+    X(Int16Array,        int16_t)   \
+    X(Uint16Array,       uint16_t)  \
+    X(Int32Array,        int32_t)   \
+    X(Uint32Array,       uint32_t)  \
+    X(Float32Array,      float)     \
+    X(Float64Array,      double)
+
+enum class TypedArrayKind : uint8_t {
+#define SE_TYPED_ARRAY_ENUM(name, type) name,
+    SE_TYPED_ARRAY_LIST(SE_TYPED_ARRAY_ENUM)
+#undef SE_TYPED_ARRAY_ENUM
+};
+
+// Bytes per element
+size_t elementSize(TypedArrayKind kind);
+// Constructor name ("Int32Array")
+const char* typedArrayName(TypedArrayKind kind);
+
+// A typed-array view of `length` elements starting `byteOffset` bytes into
+// an ArrayBuffer, which must outlive the view. Elements read as numbers
+// and are converted on store the way script code converts them: integers
+// wrap around (Uint8ClampedArray clamps and rounds), Float32Array rounds to
+// float.
+//
+// The builtins take indexes already resolved against the length (negative
+// ones counted from the end) and clamp them to the view. fill, indexOf,
+// map, reduce-by-sum and byte comparison run on the vector kernels;
+// copyWithin and same-type set are memmove, which the C library already
+// vectorizes. Range errors throw RuntimeError.
+class TypedArray {
+public:
+    TypedArray(ArrayBuffer& buffer, TypedArrayKind kind, size_t byteOffset, size_t length);
+    // Views the whole buffer, whose length must be a multiple of the
+    // element size
+    TypedArray(ArrayBuffer& buffer, TypedArrayKind kind);
+
+    TypedArrayKind kind() const { return type; }
+    ArrayBuffer& buffer() const { return *store; }
+    size_t length() const { return count; }
+    size_t byteOffset() const { return offset; }
+    size_t byteLength() const { return count * elementSize(type); }
+    uint8_t* data() const { return store->data() + offset; }
+
+    double get(size_t index) const;
+    void set(size_t index, double value);
+
+    // Stores `value` into elements [start, end)
+    void fill(double value, size_t start, size_t end);
+    // Copies elements [start, end) to `target`, as far as they fit
+    void copyWithin(size_t target, size_t start, size_t end);
+    // Copies all of `source` (of any kind, possibly the same buffer) to
+    // elements starting at `targetOffset`
+    void set(const TypedArray& source, size_t targetOffset);
+    // First index from `fromIndex` holding an element strictly equal to
+    // `value`, or -1
+    ptrdiff_t indexOf(double value, size_t fromIndex = 0) const;
+    // reduce((a, b) => a + b, 0): exact for integer kinds, left to right
+    // for float kinds
+    double sum() const;
+    // target[i] = this[i] op operand for every element. `target` must have
+    // the same length and must not partially overlap this view.
+    void map(TypedArray& target, NumericOp op, double operand) const;
+    // Lexicographic comparison of the bytes of the two views, then of
+    // their lengths: negative, zero or positive
+    int compare(const TypedArray& other) const;
+
+private:
+    ArrayBuffer* store;
+    size_t offset;
+    size_t count;
+    TypedArrayKind type;
+};
+
+#endif // TYPED_ARRAY_H
@@ -0,0 +1,207 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+#include "runtime/vm/config.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+struct HeapObject;
+struct WildObject;
+
+// A runtime value, NaN-boxed into a single 64-bit word.
+//
+// Doubles are stored as their raw IEEE-754 bits. Every other type lives in
+// the space of negative quiet NaNs, which real arithmetic never produces
+// because all NaNs are canonicalized to kCanonicalNaN when boxed:
+//
+//   1111 1111 1111 1ttt  pppp ... pppp
+//   \___ box marker ___/ \_ 48-bit payload _/
+//
+// where ttt is a 3-bit tag:
+//   0 undefined, 1 null, 2 boolean (payload 0/1),
+//   3 int (48-bit two's complement), 4 GC object pointer,
+//   5 wild object pointer, 6-7 reserved.
+//
+// Pointers fit in the payload because user-space addresses on x86-64 and
+// AArch64 use at most 48 bits. A Value therefore always fits in one
+// register, arrays of values are 8 bytes per element, and numbers are never
+// heap allocated.
+class Value {
+public:
+    enum class Tag : uint8_t {
+        Undefined,
+        Null,
+        Boolean,
+        Int,        // 48-bit integer (see kMinInt/kMaxInt)
+        Double,
+        Object,     // Pointer to a GC-managed HeapObject
+        WildObject  // Pointer to a manually managed wild object
+    };
+
+    // Range of integers that are stored unboxed. Arithmetic that leaves this
+    // range falls back to doubles.
+    static constexpr int64_t kMinInt = -(int64_t(1) << 47);
+    static constexpr int64_t kMaxInt = (int64_t(1) << 47) - 1;
+
+    // Encoding constants
+    static constexpr uint64_t kBoxMask = 0xFFF8000000000000ull;
+    static constexpr uint64_t kPayloadMask = 0x0000FFFFFFFFFFFFull;
+    static constexpr uint64_t kCanonicalNaN = 0x7FF8000000000000ull;
+    static constexpr int kTagShift = 48;
+    static constexpr uint64_t kTagUndefined = 0;
+    static constexpr uint64_t kTagNull = 1;
+    static constexpr uint64_t kTagBoolean = 2;
+    static constexpr uint64_t kTagInt = 3;
+    static constexpr uint64_t kTagObject = 4;
+    static constexpr uint64_t kTagWild = 5;
+
+    // Upper 16 bits of a boxed value with the given tag
+    static constexpr uint64_t boxHigh(uint64_t tag) { return (kBoxMask >> kTagShift) | tag; }
+
+    Value() : bits(box(kTagUndefined, 0)) {}
+
+    // Factory functions
+    static Value undefined() { return Value(); }
+    static Value null() { return fromBits(box(kTagNull, 0)); }
+    static Value boolean(bool b) { return fromBits(box(kTagBoolean, b ? 1 : 0)); }
+    static Value integer(int64_t i) { return fromBits(box(kTagInt, static_cast<uint64_t>(i) & kPayloadMask)); }
+    static Value number(double d) {
+        if (SE_UNLIKELY(d != d)) {
+            return fromBits(kCanonicalNaN);
+        }
+        uint64_t raw;
+        std::memcpy(&raw, &d, sizeof(raw));
+        return fromBits(raw);
+    }
+    static Value object(HeapObject* o) { return fromBits(box(kTagObject, reinterpret_cast<uintptr_t>(o))); }
+    static Value wild(WildObject* o) { return fromBits(box(kTagWild, reinterpret_cast<uintptr_t>(o))); }
+
+    // Stores an int64 as an int when it fits, otherwise as a double.
+    // IntegerLiteral values map onto Values through this.
+    static Value fromInt64(int64_t i) {
+        return fitsInt(i) ? integer(i) : number(static_cast<double>(i));
+    }
+    // Stores a double as an int when it is integral and in range, so that
+    // results like 4.0 keep taking the integer fast paths
+    static Value fromDouble(double d) {
+        if (d >= static_cast<double>(kMinInt) && d <= static_cast<double>(kMaxInt)) {
+            int64_t i = static_cast<int64_t>(d);
+            if (static_cast<double>(i) == d && !(i == 0 && std::signbit(d))) {
+                return integer(i);
+            }
+        }
+        return number(d);
+    }
+
+    static bool fitsInt(int64_t i) { return i >= kMinInt && i <= kMaxInt; }
+
+    // Reinterprets raw bits as a value (used by snapshots and the JIT)
+    static Value fromBits(uint64_t raw) {
+        Value v;
+        v.bits = raw;
+        return v;
+    }
+    uint64_t rawBits() const { return bits; }
+
+    // Atomic access to a slot other threads may update at the same time
+    // (the Atomic*Global instructions, object slots). compareExchange
+    // compares raw bits and on failure loads the slot's current value into
+    // `expected`.
+    static Value loadAtomic(const Value* slot) {
+#if defined(__GNUC__) || defined(__clang__)
+        return fromBits(__atomic_load_n(&slot->bits, __ATOMIC_ACQUIRE));
+#else
+        return *slot;
+#endif
+    }
+    static void storeAtomic(Value* slot, Value value) {
+#if defined(__GNUC__) || defined(__clang__)
+        __atomic_store_n(&slot->bits, value.bits, __ATOMIC_RELEASE);
+#else
+        *slot = value;
+#endif
+    }
+    // Stores `value` and returns the value it replaced; a full barrier
+    static Value exchange(Value* slot, Value value) {
+#if defined(__GNUC__) || defined(__clang__)
+        return fromBits(__atomic_exchange_n(&slot->bits, value.bits, __ATOMIC_SEQ_CST));
+#else
+        Value old = *slot;
+        *slot = value;
+        return old;
+#endif
+    }
+    static bool compareExchange(Value* slot, Value& expected, Value desired) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __atomic_compare_exchange_n(&slot->bits, &expected.bits, desired.bits, false, __ATOMIC_ACQ_REL,
+                                           __ATOMIC_ACQUIRE);
+#else
+        if (slot->bits != expected.bits) {
+            expected = *slot;
+            return false;
+        }
+        *slot = desired;
+        return true;
+#endif
+    }
+
+    Tag getTag() const {
+        if (isDouble()) {
+            return Tag::Double;
+        }
+        switch (tagBits()) {
+            case kTagNull: return Tag::Null;
+            case kTagBoolean: return Tag::Boolean;
+            case kTagInt: return Tag::Int;
+            case kTagObject: return Tag::Object;
+            case kTagWild: return Tag::WildObject;
+            default: return Tag::Undefined;
+        }
+    }
+
+    // Type checks
+    bool isUndefined() const { return bits == box(kTagUndefined, 0); }
+    bool isNull() const { return bits == box(kTagNull, 0); }
+    bool isNullish() const { return isUndefined() || isNull(); }
+    bool isBoolean() const { return high() == boxHigh(kTagBoolean); }
+    bool isInt() const { return high() == boxHigh(kTagInt); }
+    bool isDouble() const { return (bits & kBoxMask) != kBoxMask; }
+    bool isNumber() const { return isDouble() || isInt(); }
+    bool isObject() const { return high() == boxHigh(kTagObject); }
+    bool isWild() const { return high() == boxHigh(kTagWild); }
+
+    // True when both values are ints; used by the interpreter fast paths
+    static bool bothInt(Value a, Value b) { return a.isInt() & b.isInt(); }
+
+    // Accessors (caller must check the type first)
+    bool asBoolean() const { return (bits & 1) != 0; }
+    int64_t asInt() const { return static_cast<int64_t>(bits << 16) >> 16; } // Sign-extend 48 bits
+    double asDouble() const {
+        double d;
+        std::memcpy(&d, &bits, sizeof(d));
+        return d;
+    }
+    HeapObject* asObject() const { return reinterpret_cast<HeapObject*>(bits & kPayloadMask); }
+    WildObject* asWild() const { return reinterpret_cast<WildObject*>(bits & kPayloadMask); }
+
+    // Numeric value of an Int or Double
+    double toNumber() const { return isInt() ? static_cast<double>(asInt()) : asDouble(); }
+
+    // Identity comparison (same bits)
+    bool operator==(const Value& other) const { return bits == other.bits; }
+    bool operator!=(const Value& other) const { return bits != other.bits; }
+
+private:
+    uint64_t bits;
+
+    static constexpr uint64_t box(uint64_t tag, uint64_t payload) {
+        return kBoxMask | (tag << kTagShift) | payload;
+    }
+    uint64_t high() const { return bits >> kTagShift; }
+    uint64_t tagBits() const { return (bits >> kTagShift) & 7; }
+};
+
+static_assert(sizeof(Value) == 8, "Value must be a single 64-bit word");
+
+#endif // VALUE_H
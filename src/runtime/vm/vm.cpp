@@ -0,0 +1,227 @@
+#include "runtime/vm/vm.h"
+#include "compiler/codegen/gc_free.h"
+#include "compiler/codegen/liveness.h"
+#include "runtime/vm/string_ops.h"
+#include <algorithm>
+#include <thread>
+
+VM::VM(size_t nurserySize)
+    : heap(nurserySize),
+      stack(new Value[kStackSize]),
+      stackEnd(stack.get() + kStackSize),
+      frames(new CallFrame[kMaxFrames]),
+      frameCount(0),
+      jitEnabled(BaselineJit::isSupported()),
+      collectorless(false) {
+    heap.setRootProvider(this);
+}
+
+VM::~VM() {
+    // Lock waits must leave the parking lot before their waiters are freed.
+    // One that a release is handing the lock to right now is waited for;
+    // the lock it ends up holding goes unused, so it is released again.
+    for (auto& pending : pendingLocks) {
+        bool cancelled = false;
+        while (!cancelled && !pending->granted.load(std::memory_order_acquire)) {
+            cancelled = pending->object->lock.cancel(pending.get());
+            if (!cancelled) {
+                std::this_thread::yield();
+            }
+        }
+        if (!cancelled) {
+            pending->object->lock.unlock();
+        }
+        pending->object->release();
+    }
+}
+
+String* VM::intern(std::string_view chars) {
+    std::string key(chars);
+    auto it = atoms.find(key);
+    if (it != atoms.end()) {
+        return it->second;
+    }
+    // Atoms are tenured: shapes, caches and this table hold them by pointer
+    String* atom = newString(heap, chars, true);
+    atom->flags |= kStringInterned;
+    stringHash(atom);
+    atoms.emplace(std::move(key), atom);
+    return atom;
+}
+
+int VM::defineGlobal(const std::string& name) {
+    auto it = globalSlots.find(name);
+    if (it != globalSlots.end()) {
+        return it->second;
+    }
+    int slot = static_cast<int>(globals.size());
+    globals.push_back(Value::undefined());
+    globalSlots.emplace(name, slot);
+    return slot;
+}
+
+int VM::lookupGlobal(const std::string& name) const {
+    auto it = globalSlots.find(name);
+    return it != globalSlots.end() ? it->second : -1;
+}
+
+const ClassLayout* VM::defineClass(const std::string& name,
+                                   const std::vector<std::pair<std::string, FieldType>>& fields) {
+    std::vector<FieldDecl> decls;
+    decls.reserve(fields.size());
+    for (const auto& [fieldName, type] : fields) {
+        decls.push_back(FieldDecl{intern(fieldName), type});
+    }
+    classes.push_back(std::make_unique<ClassLayout>(name, decls));
+    return classes.back().get();
+}
+
+FunctionObject* VM::adopt(std::unique_ptr<FunctionProto> proto) {
+    FunctionProto* raw = proto.get();
+    if (raw->stackMap.empty() && !raw->code.empty()) {
+        raw->stackMap = computeStackMap(*raw);
+    }
+    protos.push_back(std::move(proto));
+    FunctionObject* fn = heap.allocateFunction(raw);
+    functions.push_back(fn);
+    if (collectorless) {
+        // The new function joins the program the proof was about
+        if (analyzeProgram().gcFree) {
+            setGcFree(true);
+        } else {
+            collectorless = false;
+            setGcFree(false);
+            heap.resumeCollection();
+        }
+    }
+    return fn;
+}
+
+GcFreeReport VM::analyzeProgram() const {
+    std::vector<const FunctionProto*> program;
+    program.reserve(protos.size());
+    for (const auto& proto : protos) {
+        program.push_back(proto.get());
+    }
+    return analyzeGcFree(program, globals);
+}
+
+bool VM::enableCollectorless(std::string* reason) {
+    if (collectorless) {
+        return true;
+    }
+    GcFreeReport report = analyzeProgram();
+    if (!report.gcFree) {
+        if (reason) {
+            *reason = report.reason;
+        }
+        return false;
+    }
+    heap.suspendCollection(); // For good; wild functions nest inside this
+    setGcFree(true);
+    collectorless = true;
+    return true;
+}
+
+void VM::setGcFree(bool gcFree) {
+    for (auto& proto : protos) {
+        if (proto->gcFree == gcFree) {
+            continue;
+        }
+        proto->gcFree = gcFree;
+        if (gcFree) {
+            proto->stackMap = StackMap();
+        } else if (!proto->code.empty()) {
+            proto->stackMap = computeStackMap(*proto);
+        }
+        // Compiled for the other mode; recompiled once hot again
+        proto->jitCode.reset();
+        proto->hotness = 0;
+    }
+}
+
+Value* VM::stackTop() const {
+    if (frameCount == 0) {
+        return stack.get();
+    }
+    const CallFrame& top = frames[frameCount - 1];
+    return top.base + top.proto->numRegisters;
+}
+
+void VM::unwindFrames(size_t entryDepth, size_t regionDepth) {
+    while (frameCount > entryDepth) {
+        if (frames[--frameCount].proto->isWild) {
+            heap.resumeCollection();
+        }
+    }
+    regions.unwindTo(regionDepth);
+}
+
+Value VM::call(Value callee, const std::vector<Value>& args) {
+    // Place the new window above the registers of the innermost active frame
+    Value* base = stackTop();
+    if (base + args.size() > stackEnd) {
+        throw RuntimeError("Maximum call stack size exceeded");
+    }
+    std::copy(args.begin(), args.end(), base);
+    if (isFunction(callee) && asFunction(callee)->proto->isAsync) {
+        return callAsync(callee, base, static_cast<int>(args.size()));
+    }
+
+    size_t entryDepth = frameCount;
+    size_t regionDepth = regions.depth();
+    pushFrame(callee, base, static_cast<int>(args.size()), -1);
+    try {
+        return execute(entryDepth);
+    } catch (...) {
+        // Unwind the frames belonging to this call and the scopes they opened
+        unwindFrames(entryDepth, regionDepth);
+        throw;
+    }
+}
+
+void VM::traceRoots(RootVisitor& visitor) {
+    for (Value& global : globals) {
+        visitor.visit(global);
+    }
+    for (auto& proto : protos) {
+        for (Value& constant : proto->constants) {
+            visitor.visit(constant);
+        }
+    }
+    // Atoms and adopted functions are tenured, so visiting only keeps them
+    // alive; they never move
+    for (auto& [chars, atom] : atoms) {
+        Value value = Value::object(atom);
+        visitor.visit(value);
+    }
+    for (FunctionObject* fn : functions) {
+        Value value = Value::object(fn);
+        visitor.visit(value);
+    }
+    for (Value& job : jobs) {
+        visitor.visit(job);
+    }
+    for (auto& pending : pendingLocks) {
+        visitor.visit(pending->promise);
+    }
+
+    // Registers: the innermost frame is stopped at a safepoint before the
+    // instruction at its pc; every other frame is suspended in a Call
+    for (size_t i = 0; i < frameCount; ++i) {
+        CallFrame& frame = frames[i];
+        visitor.visit(frame.coroutine);
+        const StackMap& map = frame.proto->stackMap;
+        size_t pc = framePc(frame);
+        int skip = -1;
+        if (i + 1 < frameCount) {
+            skip = frame.proto->code[pc].a;
+            ++pc;
+        }
+        for (int reg = 0; reg < frame.proto->numRegisters; ++reg) {
+            if (reg != skip && map.isLive(pc, reg)) {
+                visitor.visit(frame.base[reg]);
+            }
+        }
+    }
+}
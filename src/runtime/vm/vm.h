@@ -0,0 +1,243 @@
+#ifndef VM_H
+#define VM_H
+
+#include "compiler/codegen/baseline_jit.h"
+#include "compiler/codegen/gc_free.h"
+#include "runtime/memory/heap.h"
+#include "runtime/memory/region.h"
+#include "runtime/memory/wild_heap.h"
+#include "runtime/vm/class_layout.h"
+#include "runtime/vm/function_proto.h"
+#include "runtime/vm/shape.h"
+#include "runtime/vm/value.h"
+#include "runtime/vm/wild_object.h"
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Error raised by the runtime for script-level failures (type errors,
+// stack overflow, ...)
+class RuntimeError : public std::runtime_error {
+public:
+    explicit RuntimeError(const std::string& message) : std::runtime_error(message) {}
+};
+
+// One activation record on the VM's frame stack
+struct CallFrame {
+    FunctionProto* proto;
+    const void* ip;        // Resume point in this frame's code while a callee runs
+    Value* base;           // Register window (register 0) of this activation
+    int returnRegister;    // Caller register receiving the result
+    Value coroutine;       // Coroutine of an async function's frame, or undefined
+};
+
+// The virtual machine: owns the heap, the global slots, the interned
+// strings, the compiled functions and the register stack. It supplies the
+// collector's roots: globals, constants, interned strings, adopted
+// functions and the live registers of every frame (from the stack maps).
+//
+// Registers live in one contiguous stack. A call `a = b(b+1 .. b+c)` makes
+// the callee's register window start at caller register b+1, so arguments
+// are passed in place without copying. Caller registers above b are
+// clobbered by the call.
+//
+// Async functions run as stackless coroutines (see Coroutine): calling one
+// allocates its coroutine, runs it on the stack like any call until it
+// returns or awaits a pending promise, and yields the coroutine as the
+// call's promise. A suspended coroutine costs only its heap object, so
+// there can be as many as memory holds. Settling a promise queues its
+// waiters as jobs; runPendingJobs() resumes them on the stack where they
+// left off. Awaiting a settled promise, or any other value, continues
+// synchronously. A wild async function holds off the collector only while
+// it is on the stack: suspending lifts its suspension of the collector and
+// resuming takes it again.
+//
+// `await Run.lock(x)` takes the AdaptiveLock in the header of wild object
+// x, and `using` releases it at block exit. A lock that is free costs one
+// CAS and yields x itself; a held one yields a promise, so the coroutine
+// suspends instead of blocking the thread, and the lock is handed to the
+// VM when its holder (a coroutine of this VM or code on another thread)
+// releases it. The promise then resolves with x.
+class VM : private RootProvider {
+public:
+    static constexpr size_t kStackSize = 1 << 18; // Values
+    static constexpr size_t kMaxFrames = 1 << 14;
+
+    explicit VM(size_t nurserySize = Heap::kDefaultNurserySize);
+    ~VM() override;
+
+    VM(const VM&) = delete;
+    VM& operator=(const VM&) = delete;
+
+    Heap& getHeap() { return heap; }
+    WildHeap& getWildHeap() { return wildHeap; } // Storage of `wild` objects
+    RegionArena& getRegions() { return regions; } // Storage of `wild(scope)` objects
+    ShapeTree& getShapes() { return shapes; }
+
+    // Returns the unique String for `chars`; property keys must be interned
+    String* intern(std::string_view chars);
+
+    // Global slots. Names are resolved to slot indices at compile time.
+    int defineGlobal(const std::string& name);
+    int lookupGlobal(const std::string& name) const; // -1 when undefined
+    Value getGlobal(int slot) const { return globals[slot]; }
+    void setGlobal(int slot, Value value) { globals[slot] = value; }
+
+    // Defines a class whose instances have the given fields, as (name,
+    // type) pairs in declaration order. The layout lives as long as the VM.
+    const ClassLayout* defineClass(const std::string& name,
+                                   const std::vector<std::pair<std::string, FieldType>>& fields);
+
+    // Takes ownership of a compiled function and returns a callable object.
+    // The object is tenured and stays alive as long as the VM.
+    FunctionObject* adopt(std::unique_ptr<FunctionProto> proto);
+
+    // Calls a script function with the given arguments. For an async
+    // function the result is its promise.
+    Value call(Value callee, const std::vector<Value>& args);
+
+    // Promises for the host. Settling a promise that is already settled
+    // does nothing; resolving with another promise does not adopt its state.
+    // A RuntimeError escaping an async function rejects its promise with
+    // the message, and awaiting a rejected promise throws its reason.
+    Value newPromise();
+    void resolvePromise(Value promise, Value value);
+    void rejectPromise(Value promise, Value reason);
+
+    // Resumes the coroutines whose promises were settled, and those their
+    // resumption wakes in turn, until none is left. Returns how many ran.
+    size_t runPendingJobs();
+    bool hasPendingJobs() const {
+        return !jobs.empty() || lockGrants.load(std::memory_order_acquire) != lockGrantsSettled;
+    }
+
+    // Blocks until a lock that a coroutine waits for has been handed to
+    // the VM, so runPendingJobs() has something to resume. Returns at once
+    // when there is such a lock already, or none is awaited.
+    void waitForLocks();
+
+    // The Lock instruction when the object's lock is held: spins, then
+    // parks a waiter and returns the promise to await
+    Value lockContended(WildObject* object, LockSite& site);
+
+    // Baseline JIT tier-up for hot functions. Enabled by default when the
+    // build supports it; disabling it keeps already compiled code.
+    bool isJitEnabled() const { return jitEnabled; }
+    void setJitEnabled(bool enabled) { jitEnabled = enabled && BaselineJit::isSupported(); }
+
+    // Runs the program without a garbage collector when analyzeGcFree()
+    // proves that none of the adopted functions allocates on the collected
+    // heap: collection stays off, stack maps are dropped and functions are
+    // recompiled without safepoint polls and write barriers. Returns false,
+    // with the offending site in `reason`, when the proof fails. Adopting a
+    // function that breaks the proof turns the collector back on. Values
+    // the host stores in globals later are not checked; should they make
+    // the program allocate, that memory is simply never reclaimed.
+    bool enableCollectorless(std::string* reason = nullptr);
+    bool isCollectorless() const { return collectorless; }
+
+private:
+    friend class Snapshot; // Reads and rebuilds everything below
+
+    Heap heap;
+    WildHeap wildHeap;
+    RegionArena regions;
+    ShapeTree shapes;
+    std::vector<Value> globals;
+    std::unordered_map<std::string, int> globalSlots;
+    std::unordered_map<std::string, String*> atoms; // By UTF-8 contents
+    std::vector<std::unique_ptr<FunctionProto>> protos;
+    std::vector<std::unique_ptr<ClassLayout>> classes;
+    std::vector<FunctionObject*> functions; // Adopted functions, kept alive
+
+    std::unique_ptr<Value[]> stack;
+    Value* stackEnd;
+    std::unique_ptr<CallFrame[]> frames;
+    size_t frameCount;
+    std::deque<Value> jobs; // Coroutines to resume, oldest first
+
+    // `Run.lock` that found the lock held (coroutine.cpp). The release that
+    // hands the lock over may run on any thread, so it only touches the
+    // waiter and lockGrants; the VM settles the promise itself.
+    struct PendingLock : LockWaiter {
+        VM* vm;
+        WildObject* object;
+        Value promise; // Resolved with the object once it is held
+        std::atomic<bool> granted{false}; // Held for the VM, and the releasing thread is done with us
+
+        PendingLock(VM* owner, WildObject* target);
+        static void resume(Task* task);
+    };
+    std::vector<std::unique_ptr<PendingLock>> pendingLocks;
+    std::atomic<uint32_t> lockGrants{0}; // Futex word; counts locks handed over
+    uint32_t lockGrantsSettled = 0;
+    bool jitEnabled;
+    bool collectorless;
+
+    // Runs the interpreter loop until the frame at `entryDepth` returns,
+    // starting that frame at instruction `startPc`
+    Value execute(size_t entryDepth, size_t startPc = 0);
+
+    // Start of the free stack above the innermost active frame
+    Value* stackTop() const;
+
+    // Pops the frames above `entryDepth` after an exception and closes the
+    // region scopes they opened
+    void unwindFrames(size_t entryDepth, size_t regionDepth);
+
+    // Coroutines (coroutine.cpp). callAsync() starts an async function with
+    // its arguments already in place at `base`; runCoroutine() runs the
+    // coroutine frame on top of the frame stack from `startPc` until it
+    // suspends or finishes; suspendCoroutine() saves the top frame into its
+    // coroutine to wait on `awaited`.
+    Value callAsync(Value callee, Value* base, int argc);
+    Value runCoroutine(size_t startPc);
+    void resumeCoroutine(Coroutine* coroutine);
+    void suspendCoroutine(Promise* awaited);
+    void settlePromise(Promise* promise, Value result, bool rejected);
+    // Resolves the promises of locks that were handed over
+    void settleGrantedLocks();
+
+    void traceRoots(RootVisitor& visitor) override;
+
+    // Instruction index a frame is executing or suspended at
+    size_t framePc(const CallFrame& frame) const;
+
+    // Runs analyzeGcFree() over the adopted functions and the globals
+    GcFreeReport analyzeProgram() const;
+
+    // Marks every function as GC-free or not and keeps the stack maps and
+    // compiled code in line with that
+    void setGcFree(bool gcFree);
+
+    // Compiles a function whose hotness reached the JIT threshold
+    void tierUp(FunctionProto* proto);
+
+    // Pushes a frame for calling `callee` with the window starting at `base`
+    void pushFrame(Value callee, Value* base, int argc, int returnRegister);
+};
+
+inline void VM::pushFrame(Value callee, Value* base, int argc, int returnRegister) {
+    if (!isFunction(callee)) {
+        throw RuntimeError("Value is not a function");
+    }
+    FunctionProto* proto = asFunction(callee)->proto;
+    if (frameCount == kMaxFrames || base + proto->numRegisters > stackEnd) {
+        throw RuntimeError("Maximum call stack size exceeded");
+    }
+    // Missing arguments read as undefined
+    for (int i = argc; i < proto->numParams; ++i) {
+        base[i] = Value::undefined();
+    }
+    frames[frameCount++] = CallFrame{proto, nullptr, base, returnRegister, Value::undefined()};
+    if (SE_UNLIKELY(proto->isWild)) {
+        heap.suspendCollection(); // Resumed when the frame is popped
+    }
+}
+
+#endif // VM_H
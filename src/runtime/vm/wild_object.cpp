@@ -0,0 +1,124 @@
+#include "runtime/vm/wild_object.h"
+#include "runtime/memory/region.h"
+#include "runtime/memory/wild_heap.h"
+#include "runtime/vm/vm.h"
+#include <cstring>
+#include <new>
+
+WildObject* WildObject::create(WildHeap& heap, uint32_t size) {
+    void* memory = heap.allocate(sizeof(WildObject) + size);
+    auto* obj = new (memory) WildObject;
+    obj->owner = currentThreadToken();
+    obj->heap = &heap;
+    obj->biasedRefs = 0;
+    obj->size = size;
+    obj->destroyedByOwner = false;
+    obj->sharedRefs.store(0, std::memory_order_relaxed);
+    std::memset(obj->data(), 0, size);
+    return obj;
+}
+
+WildObject* WildObject::createScoped(RegionArena& arena, uint32_t size) {
+    void* memory = arena.allocate(sizeof(WildObject) + size);
+    auto* obj = new (memory) WildObject;
+    obj->owner = currentThreadToken();
+    obj->heap = nullptr;
+    obj->biasedRefs = 0;
+    obj->size = size;
+    obj->destroyedByOwner = false;
+    obj->sharedRefs.store(0, std::memory_order_relaxed);
+    std::memset(obj->data(), 0, size);
+    arena.addCleanup([](void* p) {
+        auto* scoped = static_cast<WildObject*>(p);
+        if (!scoped->destroyedByOwner) {
+            scoped->destroy();
+        }
+    }, obj);
+    return obj;
+}
+
+WildObject* WildObject::transferred() {
+    static WildObject marker;
+    static const bool initialized = [] {
+        marker.owner = nullptr; // Never matches a thread, so every use goes the slow way
+        marker.heap = nullptr;
+        marker.biasedRefs = 0;
+        marker.size = 0;
+        marker.destroyedByOwner = true;
+        marker.sharedRefs.store(kDestroyed, std::memory_order_relaxed);
+        return true;
+    }();
+    (void)initialized;
+    return &marker;
+}
+
+void WildObject::throwInvalid() const {
+    if (this == transferred()) {
+        throw RuntimeError("Accessed transferred wild object");
+    }
+    throw RuntimeError("Reference to destroyed wild object");
+}
+
+void WildObject::retainShared() {
+    if (this == transferred()) {
+        throwInvalid();
+    }
+    int64_t previous = sharedRefs.fetch_add(1, std::memory_order_relaxed);
+    if (hasDestroyed(previous)) {
+        releaseShared(); // Undo; may be the last reference
+        throwInvalid();
+    }
+}
+
+void WildObject::releaseShared() {
+    if (this == transferred()) {
+        return; // Its reference was never counted
+    }
+    if (sharedRefs.fetch_sub(1, std::memory_order_acq_rel) - 1 == kDestroyed) {
+        free();
+    }
+}
+
+void WildObject::destroy() {
+    if (this == transferred()) {
+        throwInvalid();
+    }
+    if (owner != currentThreadToken()) {
+        throw RuntimeError("Wild object can only be destroyed by the thread that created it");
+    }
+    if (destroyedByOwner) {
+        throw RuntimeError("Wild object already destroyed");
+    }
+    destroyedByOwner = true;
+    if (!heap) {
+        // Keeps the region chunk alive should references outlast the
+        // scope; dropped by free()
+        RegionArena::pin(this);
+    }
+    // Merge the biased count into the shared one and publish the destroy
+    // with a single update, so exactly one thread sees the total reach zero
+    int64_t biased = biasedRefs;
+    biasedRefs = 0;
+    int64_t previous = sharedRefs.fetch_add(biased + kDestroyed, std::memory_order_acq_rel);
+    if (previous + biased == 0) {
+        free();
+    }
+}
+
+int64_t WildObject::refCount() const {
+    int64_t shared = sharedRefs.load(std::memory_order_acquire);
+    if (hasDestroyed(shared)) {
+        return shared - kDestroyed;
+    }
+    return shared + static_cast<int64_t>(biasedRefs);
+}
+
+void WildObject::free() {
+    WildHeap* owningHeap = heap;
+    this->~WildObject();
+    if (owningHeap) {
+        owningHeap->free(this);
+    } else {
+        RegionArena::unpin(this); // The scope reclaims the memory
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef WILD_OBJECT_H
+#define WILD_OBJECT_H
+
+#include "runtime/concurrency/adaptive_lock.h"
+#include "runtime/vm/config.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+class RegionArena;
+class WildHeap;
+
+// Identifies the calling thread; stable for the thread's lifetime
+inline const void* currentThreadToken() {
+    static thread_local char token;
+    return &token;
+}
+
+// Manually managed object allocated on the WildHeap. `wild var` owns it and
+// `destroy` frees it; `ref` creates non-owning references, which are
+// counted so a destroy with references still alive defers the free until
+// the last one is released, and so those references can report "Reference
+// to destroyed wild object" instead of reading freed memory.
+//
+// Counting is biased towards the thread that created the object, which
+// owns it and is the only one allowed to destroy it: its retains and
+// releases touch a plain field, while other threads use an atomic count.
+// The two are merged lazily, once, by destroy. From then on every count
+// change is atomic and whoever drops the merged total to zero frees the
+// object.
+//
+// Objects bound to a scope (`wild(scope)`, block-scoped wild variables)
+// live in a RegionArena instead of the WildHeap and are destroyed when the
+// scope exits; if references remain, they pin their region chunk until the
+// last one is released.
+struct WildObject {
+    const void* owner;   // currentThreadToken() of the creating thread
+    WildHeap* heap;      // Null for objects in a RegionArena
+    uint32_t biasedRefs; // Owner thread's references, until destroyed
+    uint32_t size;       // Payload bytes following the header
+    bool destroyedByOwner; // Owner's private copy of the destroyed bit
+    AdaptiveLock lock;     // `Run.lock`; fits in what was padding
+    // References held by other threads (may go negative when they release
+    // references the owner took), plus kDestroyed once destroyed and merged
+    std::atomic<int64_t> sharedRefs;
+
+    // Added to sharedRefs by destroy. Counts stay far below half of it, so
+    // a (possibly negative) count with kDestroyed added is still told apart.
+    static constexpr int64_t kDestroyed = int64_t(1) << 40;
+    static bool hasDestroyed(int64_t shared) { return shared > kDestroyed / 2; }
+
+    static WildObject* create(WildHeap& heap, uint32_t size);
+    // Allocates in the innermost scope of `arena`, which destroys the
+    // object when it exits
+    static WildObject* createScoped(RegionArena& arena, uint32_t size);
+
+    // Stands in for the object in a variable it was transferred out of, so
+    // later uses report "Accessed transferred wild object". Counts as
+    // destroyed; retain, release and destroy never touch its counts.
+    static WildObject* transferred();
+
+    char* data() { return reinterpret_cast<char*>(this + 1); }
+
+    // `ref`: throws RuntimeError when the object was destroyed
+    void retain() {
+        if (SE_LIKELY(owner == currentThreadToken() && !destroyedByOwner)) {
+            ++biasedRefs;
+            return;
+        }
+        retainShared();
+    }
+
+    // A reference went out of scope
+    void release() {
+        if (SE_LIKELY(owner == currentThreadToken() && !destroyedByOwner)) {
+            --biasedRefs;
+            return;
+        }
+        releaseShared();
+    }
+
+    // `destroy`: frees the object now, or when its last reference is
+    // released. Throws RuntimeError on a second destroy or from a thread
+    // other than the owner.
+    void destroy();
+
+    bool isDestroyed() const { return hasDestroyed(sharedRefs.load(std::memory_order_acquire)); }
+    // Throws the RuntimeError for using a destroyed or transferred object
+    [[noreturn]] SE_NOINLINE void throwInvalid() const;
+    // Live references; only exact on the owner thread or once destroyed
+    int64_t refCount() const;
+
+private:
+    SE_NOINLINE void retainShared();
+    SE_NOINLINE void releaseShared();
+    void free();
+};
+
+#endif // WILD_OBJECT_H
@@ -0,0 +1,162 @@
+// Interpreter microbenchmarks: fib, loops, property access, calls and
+// string concatenation. Run with an optional list of benchmark names:
+//
+//   run_benchmarks [fib] [loop] [property] [call] [concat]
+
+#include "compiler/codegen/bytecode_builder.h"
+#include "runtime/vm/vm.h"
+#include "test_programs.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A benchmark builds its program in a fresh VM and returns a callable that
+// runs it once; `operations` is the number of "ops" one run performs
+struct Benchmark {
+    const char* name;
+    long operations;
+    std::function<Value(VM&)> setup;
+    std::vector<Value> args;
+};
+
+// fib(n), recursive
+static Value buildFib(VM& vm) {
+    return vm.getGlobal(defineFib(vm));
+}
+
+// for (i = 0; i < n; i++) sum = sum + i * 2
+static Value buildLoop(VM& vm) {
+    BytecodeBuilder b("loop", 1);
+    auto loop = b.newLabel();
+    auto done = b.newLabel();
+    b.emit(Opcode::LoadInt, 1, 0);
+    b.emit(Opcode::LoadInt, 2, 0);
+    b.emit(Opcode::LoadInt, 3, 1);
+    b.emit(Opcode::LoadInt, 4, 2);
+    b.bind(loop);
+    b.emit(Opcode::Lt, 5, 2, 0);
+    b.emitJumpIfFalse(5, done);
+    b.emit(Opcode::Mul, 6, 2, 4);
+    b.emit(Opcode::Add, 1, 1, 6);
+    b.emit(Opcode::Add, 2, 2, 3);
+    b.emitJump(loop);
+    b.bind(done);
+    b.emit(Opcode::Return, 1);
+    return Value::object(vm.adopt(b.finish()));
+}
+
+// obj = {x: 0, y: 1, z: 2}; for (i = 0; i < n; i++) obj.z = obj.x + obj.z
+static Value buildProperty(VM& vm) {
+    BytecodeBuilder b("property", 1);
+    String* x = vm.intern("x");
+    String* y = vm.intern("y");
+    String* z = vm.intern("z");
+    auto loop = b.newLabel();
+    auto done = b.newLabel();
+    b.emit(Opcode::NewObject, 1);
+    b.emit(Opcode::LoadInt, 2, 0);
+    b.emit(Opcode::SetProp, 1, b.addPropertyCache(x), 2);
+    b.emit(Opcode::LoadInt, 3, 1);
+    b.emit(Opcode::SetProp, 1, b.addPropertyCache(y), 3);
+    b.emit(Opcode::SetProp, 1, b.addPropertyCache(z), 2);
+    b.bind(loop);
+    b.emit(Opcode::Lt, 4, 2, 0);
+    b.emitJumpIfFalse(4, done);
+    b.emit(Opcode::GetProp, 5, 1, b.addPropertyCache(x));
+    b.emit(Opcode::GetProp, 6, 1, b.addPropertyCache(z));
+    b.emit(Opcode::Add, 6, 5, 6);
+    b.emit(Opcode::SetProp, 1, b.addPropertyCache(z), 6);
+    b.emit(Opcode::Add, 2, 2, 3);
+    b.emitJump(loop);
+    b.bind(done);
+    b.emit(Opcode::GetProp, 5, 1, b.addPropertyCache(z));
+    b.emit(Opcode::Return, 5);
+    return Value::object(vm.adopt(b.finish()));
+}
+
+// add(a, b) { return a + b }; for (i = 0; i < n; i++) acc = add(acc, i)
+static Value buildCall(VM& vm) {
+    int addSlot = vm.defineGlobal("add");
+    BytecodeBuilder add("add", 2);
+    add.emit(Opcode::Add, 2, 0, 1);
+    add.emit(Opcode::Return, 2);
+    vm.setGlobal(addSlot, Value::object(vm.adopt(add.finish())));
+
+    BytecodeBuilder b("call", 1);
+    auto loop = b.newLabel();
+    auto done = b.newLabel();
+    b.emit(Opcode::LoadInt, 1, 0); // acc
+    b.emit(Opcode::LoadInt, 2, 0); // i
+    b.emit(Opcode::LoadInt, 3, 1);
+    b.bind(loop);
+    b.emit(Opcode::Lt, 4, 2, 0);
+    b.emitJumpIfFalse(4, done);
+    b.emit(Opcode::GetGlobal, 5, addSlot);
+    b.emit(Opcode::Move, 6, 1);
+    b.emit(Opcode::Move, 7, 2);
+    b.emit(Opcode::Call, 1, 5, 2);
+    b.emit(Opcode::Add, 2, 2, 3);
+    b.emitJump(loop);
+    b.bind(done);
+    b.emit(Opcode::Return, 1);
+    return Value::object(vm.adopt(b.finish()));
+}
+
+// s = ""; for (i = 0; i < n; i++) s = s + "item " + i
+static Value buildConcat(VM& vm) {
+    BytecodeBuilder b("concat", 1);
+    int empty = b.addConstant(Value::object(vm.intern("")));
+    int item = b.addConstant(Value::object(vm.intern("item ")));
+    auto loop = b.newLabel();
+    auto done = b.newLabel();
+    b.emit(Opcode::LoadConst, 1, empty);
+    b.emit(Opcode::LoadConst, 2, item);
+    b.emit(Opcode::LoadInt, 3, 0);
+    b.emit(Opcode::LoadInt, 4, 1);
+    b.bind(loop);
+    b.emit(Opcode::Lt, 5, 3, 0);
+    b.emitJumpIfFalse(5, done);
+    b.emit(Opcode::Add, 1, 1, 2);
+    b.emit(Opcode::Add, 1, 1, 3);
+    b.emit(Opcode::Add, 3, 3, 4);
+    b.emitJump(loop);
+    b.bind(done);
+    b.emit(Opcode::Return, 1);
+    return Value::object(vm.adopt(b.finish()));
+}
+
+int main(int argc, char* argv[]) {
+    const std::vector<Benchmark> benchmarks = {
+        {"fib", 832039 * 3L, buildFib, {Value::integer(30)}},   // ~calls of fib(30)
+        {"loop", 20000000L, buildLoop, {Value::integer(20000000)}},
+        {"property", 5000000L, buildProperty, {Value::integer(5000000)}},
+        {"call", 5000000L, buildCall, {Value::integer(5000000)}},
+        {"concat", 20000L, buildConcat, {Value::integer(20000)}},
+    };
+
+    std::printf("%-10s %12s %12s %10s\n", "benchmark", "ops", "time (ms)", "ns/op");
+    for (const Benchmark& bench : benchmarks) {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; ++i) {
+            selected = selected || std::strcmp(argv[i], bench.name) == 0;
+        }
+        if (!selected) {
+            continue;
+        }
+
+        VM vm;
+        Value fn = bench.setup(vm);
+        auto start = std::chrono::steady_clock::now();
+        vm.call(fn, bench.args);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+
+        double ms = std::chrono::duration<double, std::milli>(elapsed).count();
+        std::printf("%-10s %12ld %12.2f %10.2f\n", bench.name, bench.operations, ms,
+                    ms * 1e6 / static_cast<double>(bench.operations));
+    }
+    return 0;
+}
@@ -0,0 +1,220 @@
+#include "compiler/codegen/atomic_updates.h"
+#include "compiler/codegen/baseline_jit.h"
+#include "compiler/codegen/bytecode_builder.h"
+#include "runtime/vm/slow_paths.h"
+#include "runtime/vm/string_ops.h"
+#include "runtime/vm/vm.h"
+#include "test_runner.h"
+
+#include <limits>
+#include <thread>
+#include <vector>
+
+// old = g; g = old `op` r0; return old
+static std::unique_ptr<FunctionProto> buildFetchAndUpdate(int slot, Opcode op,
+                                                          std::vector<AtomicSite>* sites = nullptr) {
+    BytecodeBuilder b("fetchAndUpdate", 1);
+    b.emit(Opcode::GetGlobal, 1, slot);
+    b.emit(op, 2, 1, 0);
+    b.emit(Opcode::SetGlobal, slot, 2);
+    b.emit(Opcode::Return, 1);
+    auto proto = b.finish();
+    if (sites) {
+        *sites = b.loweredAtomicSites();
+    }
+    return proto;
+}
+
+// return g === r0 ? (g = r1, true) : false
+static std::unique_ptr<FunctionProto> buildCompareAndSet(int slot, std::vector<AtomicSite>* sites = nullptr) {
+    BytecodeBuilder b("compareAndSet", 2);
+    auto done = b.newLabel();
+    b.emit(Opcode::GetGlobal, 2, slot);
+    b.emit(Opcode::Eq, 3, 2, 0);
+    b.emitJumpIfFalse(3, done);
+    b.emit(Opcode::SetGlobal, slot, 1);
+    b.bind(done);
+    b.emit(Opcode::Return, 3);
+    auto proto = b.finish();
+    if (sites) {
+        *sites = b.loweredAtomicSites();
+    }
+    return proto;
+}
+
+TEST_CASE(TestAtomicUpdatesLowerFetchAndAdd) {
+    VM vm;
+    int counter = vm.defineGlobal("counter");
+    std::vector<AtomicSite> sites;
+    auto proto = buildFetchAndUpdate(counter, Opcode::Add, &sites);
+    ASSERT_EQ(sites.size(), 1u);
+    ASSERT_EQ(sites[0].pc, 0);
+    ASSERT_EQ(sites[0].global, counter);
+    ASSERT_EQ(sites[0].op, Opcode::AtomicAddGlobal);
+    ASSERT_EQ(proto->code.size(), 3u);
+    ASSERT_EQ(proto->code[0].op, Opcode::AtomicAddGlobal);
+    ASSERT_EQ(proto->code[1].op, Opcode::Add);
+    ASSERT_EQ(proto->code[2].op, Opcode::Return);
+
+    Value add = Value::object(vm.adopt(std::move(proto)));
+    Value sub = Value::object(vm.adopt(buildFetchAndUpdate(counter, Opcode::Sub)));
+    vm.setGlobal(counter, Value::integer(10));
+    ASSERT_EQ(vm.call(add, {Value::integer(5)}).asInt(), 10);
+    ASSERT_EQ(vm.call(sub, {Value::integer(3)}).asInt(), 15);
+    ASSERT_EQ(vm.getGlobal(counter).asInt(), 12);
+
+    // Leaving the int range, doubles and strings take the generic path
+    vm.setGlobal(counter, Value::integer(Value::kMaxInt));
+    vm.call(add, {Value::integer(1)});
+    ASSERT_EQ(vm.getGlobal(counter).toNumber(), static_cast<double>(Value::kMaxInt) + 1);
+    vm.setGlobal(counter, Value::number(0.5));
+    vm.call(add, {Value::integer(2)});
+    ASSERT_EQ(vm.getGlobal(counter).toNumber(), 2.5);
+    vm.setGlobal(counter, Value::object(vm.intern("ab")));
+    ASSERT_TRUE(isString(vm.call(add, {Value::object(vm.intern("cd"))})));
+    ASSERT_TRUE(toUtf8(asString(vm.getGlobal(counter))) == "abcd");
+}
+
+TEST_CASE(TestAtomicUpdatesLowerCompareAndSet) {
+    VM vm;
+    int status = vm.defineGlobal("status");
+    std::vector<AtomicSite> sites;
+    auto proto = buildCompareAndSet(status, &sites);
+    ASSERT_EQ(sites.size(), 1u);
+    ASSERT_EQ(sites[0].pc, 2);
+    ASSERT_EQ(sites[0].op, Opcode::CompareAndSetGlobal);
+    ASSERT_EQ(proto->code.size(), 4u);
+    ASSERT_EQ(proto->code[2].op, Opcode::CompareAndSetGlobal);
+    ASSERT_EQ(proto->code[2].a, 3);
+    ASSERT_EQ(proto->numRegisters, 6); // The operand pair comes after r3
+
+    Value cas = Value::object(vm.adopt(std::move(proto)));
+    vm.setGlobal(status, Value::integer(1));
+    ASSERT_FALSE(vm.call(cas, {Value::integer(2), Value::integer(3)}).asBoolean());
+    ASSERT_EQ(vm.getGlobal(status).asInt(), 1);
+    ASSERT_TRUE(vm.call(cas, {Value::integer(1), Value::integer(3)}).asBoolean());
+    ASSERT_EQ(vm.getGlobal(status).asInt(), 3);
+
+    // Strict equality, not identity: equal strings and 3 === 3.0
+    ASSERT_TRUE(vm.call(cas, {Value::number(3.0), Value::object(vm.intern("pending"))}).asBoolean());
+    String* pending = concatStrings(vm.getHeap(), vm.intern("pend"), vm.intern("ing"));
+    ASSERT_TRUE(vm.call(cas, {Value::object(pending), Value::object(vm.intern("completed"))}).asBoolean());
+    ASSERT_FALSE(vm.call(cas, {Value::object(vm.intern("pending")), Value::integer(0)}).asBoolean());
+    ASSERT_TRUE(toUtf8(asString(vm.getGlobal(status))) == "completed");
+    Value nan = Value::number(std::numeric_limits<double>::quiet_NaN());
+    vm.setGlobal(status, nan);
+    ASSERT_FALSE(vm.call(cas, {nan, Value::integer(0)}).asBoolean()); // Same bits, but NaN !== NaN
+}
+
+TEST_CASE(TestAtomicUpdatesLeaveOtherSequences) {
+    // g = r0 + g could prepend a string, which the atomic add cannot
+    BytecodeBuilder prepend("prepend", 1);
+    prepend.emit(Opcode::GetGlobal, 1, 0);
+    prepend.emit(Opcode::Add, 2, 0, 1);
+    prepend.emit(Opcode::SetGlobal, 0, 2);
+    prepend.emit(Opcode::ReturnUndefined);
+    prepend.finish();
+    ASSERT_TRUE(prepend.loweredAtomicSites().empty());
+
+    // Another path joins between the load and the store
+    BytecodeBuilder joined("joined", 1);
+    auto middle = joined.newLabel();
+    joined.emitJumpIfFalse(0, middle);
+    joined.emit(Opcode::GetGlobal, 1, 0);
+    joined.bind(middle);
+    joined.emit(Opcode::Add, 2, 1, 0);
+    joined.emit(Opcode::SetGlobal, 0, 2);
+    joined.emit(Opcode::ReturnUndefined);
+    joined.finish();
+    ASSERT_TRUE(joined.loweredAtomicSites().empty());
+
+    // The compared value is returned afterwards, so it must stay loaded
+    BytecodeBuilder used("used", 2);
+    auto done = used.newLabel();
+    used.emit(Opcode::GetGlobal, 2, 0);
+    used.emit(Opcode::Eq, 3, 2, 0);
+    used.emitJumpIfFalse(3, done);
+    used.emit(Opcode::SetGlobal, 0, 1);
+    used.bind(done);
+    used.emit(Opcode::Return, 2);
+    used.finish();
+    ASSERT_TRUE(used.loweredAtomicSites().empty());
+}
+
+TEST_CASE(TestAtomicUpdatesInCompiledCode) {
+    // counter = counter + 1, n times, hot enough to be compiled
+    VM vm;
+    int counter = vm.defineGlobal("counter");
+    BytecodeBuilder b("count", 1);
+    auto loop = b.newLabel();
+    auto done = b.newLabel();
+    b.emit(Opcode::LoadInt, 1, 0);
+    b.emit(Opcode::LoadInt, 2, 1);
+    b.bind(loop);
+    b.emit(Opcode::Lt, 3, 1, 0);
+    b.emitJumpIfFalse(3, done);
+    b.emit(Opcode::GetGlobal, 4, counter);
+    b.emit(Opcode::Add, 4, 4, 2);
+    b.emit(Opcode::SetGlobal, counter, 4);
+    b.emit(Opcode::Add, 1, 1, 2);
+    b.emitJump(loop);
+    b.bind(done);
+    b.emit(Opcode::ReturnUndefined);
+    auto proto = b.finish();
+    ASSERT_EQ(b.loweredAtomicSites().size(), 1u);
+    Value count = Value::object(vm.adopt(std::move(proto)));
+    Value cas = Value::object(vm.adopt(buildCompareAndSet(counter)));
+
+    vm.setGlobal(counter, Value::integer(0));
+    vm.call(count, {Value::integer(5000)});
+    ASSERT_EQ(vm.getGlobal(counter).asInt(), 5000);
+    ASSERT_EQ(asFunction(count)->proto->jitCode != nullptr, BaselineJit::isSupported());
+    // Compiled code hands doubles to the generic path
+    vm.setGlobal(counter, Value::number(0.5));
+    vm.call(count, {Value::integer(10)});
+    ASSERT_EQ(vm.getGlobal(counter).toNumber(), 10.5);
+
+    vm.setGlobal(counter, Value::integer(0));
+    int swapped = 0;
+    for (int i = 0; i < static_cast<int>(2 * BaselineJit::kHotnessThreshold); ++i) {
+        swapped += vm.call(cas, {Value::integer(i % 2), Value::integer(1 - i % 2)}).asBoolean() ? 1 : 0;
+    }
+    ASSERT_EQ(swapped, static_cast<int>(2 * BaselineJit::kHotnessThreshold));
+    ASSERT_FALSE(vm.call(cas, {Value::integer(7), Value::integer(0)}).asBoolean());
+    ASSERT_TRUE(vm.call(cas, {Value::number(0.0), Value::integer(5)}).asBoolean());
+    ASSERT_EQ(vm.getGlobal(counter).asInt(), 5);
+}
+
+TEST_CASE(TestAtomicUpdatesAreNotLostBetweenThreads) {
+    // The slow paths behind the instructions, hammered from several threads
+    VM vm;
+    Value counter = Value::integer(0);
+    Value flag = Value::integer(0);
+    constexpr int kThreads = 4;
+    constexpr int kIterations = 50000;
+    std::vector<std::thread> threads;
+    std::vector<int> wins(kThreads);
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < kIterations; ++i) {
+                atomicArithmetic(vm, Opcode::Add, &counter, Value::integer(3));
+                atomicArithmetic(vm, Opcode::Sub, &counter, Value::integer(1));
+                // Flip the flag from i to i + 1 (as a double) if nobody did
+                Value expected = Value::integer(i);
+                if (atomicCompareAndSet(&flag, expected, Value::number(i + 1.0))) {
+                    ++wins[t];
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQ(Value::loadAtomic(&counter).asInt(), int64_t(2) * kThreads * kIterations);
+    int total = 0;
+    for (int w : wins) {
+        total += w;
+    }
+    ASSERT_TRUE(total <= kIterations);
+    ASSERT_EQ(Value::loadAtomic(&flag).toNumber(), static_cast<double>(total));
+}
@@ -0,0 +1,168 @@
+#include "compiler/codegen/baseline_jit.h"
+#include "compiler/codegen/bytecode_builder.h"
+#include "compiler/codegen/x64_assembler.h"
+#include "runtime/vm/object.h"
+#include "runtime/vm/vm.h"
+#include "test_programs.h"
+#include "test_runner.h"
+
+#include <vector>
+
+// The machine code tests only run where the JIT is built in; elsewhere the
+// VM must simply keep interpreting.
+
+TEST_CASE(TestX64AssemblerEncodings) {
+    x64::Assembler masm;
+    masm.mov(x64::RAX, x64::RDI);                // 48 89 f8
+    masm.add(x64::RAX, x64::RSI);                // 48 01 f0
+    masm.mov(x64::R8, x64::Mem(x64::R12, 8));    // 4d 8b 84 24 08 00 00 00
+    masm.ret();                                  // c3
+    std::vector<uint8_t> expected = {0x48, 0x89, 0xF8, 0x48, 0x01, 0xF0, 0x4D, 0x8B,
+                                     0x84, 0x24, 0x08, 0x00, 0x00, 0x00, 0xC3};
+    ASSERT_TRUE(masm.code() == expected);
+
+    x64::Assembler atomics;
+    atomics.lockCmpxchg(x64::Mem(x64::R8, 16), x64::RSI); // f0 49 0f b1 b0 10 00 00 00
+    std::vector<uint8_t> lockCmpxchg = {0xF0, 0x49, 0x0F, 0xB1, 0xB0, 0x10, 0x00, 0x00, 0x00};
+    ASSERT_TRUE(atomics.code() == lockCmpxchg);
+
+    // Forward jumps are patched when their label is bound
+    x64::Assembler jumps;
+    x64::Assembler::Label target;
+    jumps.jmp(target);
+    jumps.ret();
+    jumps.bind(target);
+    ASSERT_EQ(jumps.size(), 6u);
+    ASSERT_EQ(static_cast<int>(jumps.code()[1]), 1);
+}
+
+TEST_CASE(TestX64AssemblerRunsGeneratedCode) {
+    if (!BaselineJit::isSupported()) {
+        return;
+    }
+    // long f(long a, long b) { return a > b ? a - b : b - a; }
+    x64::Assembler masm;
+    x64::Assembler::Label swap;
+    masm.cmp(x64::RDI, x64::RSI);
+    masm.jcc(x64::LessOrEqual, swap);
+    masm.mov(x64::RAX, x64::RDI);
+    masm.sub(x64::RAX, x64::RSI);
+    masm.ret();
+    masm.bind(swap);
+    masm.mov(x64::RAX, x64::RSI);
+    masm.sub(x64::RAX, x64::RDI);
+    masm.ret();
+
+    ExecutableMemory memory;
+    ASSERT_TRUE(memory.install(masm.code()));
+    auto fn = reinterpret_cast<long (*)(long, long)>(const_cast<void*>(memory.data()));
+    ASSERT_EQ(fn(10, 3), 7L);
+    ASSERT_EQ(fn(3, 10), 7L);
+}
+
+// sum = 0; for (i = 0; i < n; i = i + step) sum = sum + i; return sum
+static Value defineLoopSum(VM& vm) {
+    BytecodeBuilder b("sum", 2);
+    auto loop = b.newLabel();
+    auto done = b.newLabel();
+    b.emit(Opcode::LoadInt, 2, 0); // sum
+    b.emit(Opcode::LoadInt, 3, 0); // i
+    b.bind(loop);
+    b.emit(Opcode::Lt, 4, 3, 0);
+    b.emitJumpIfFalse(4, done);
+    b.emit(Opcode::Add, 2, 2, 3);
+    b.emit(Opcode::Add, 3, 3, 1);
+    b.emitJump(loop);
+    b.bind(done);
+    b.emit(Opcode::Return, 2);
+    return Value::object(vm.adopt(b.finish()));
+}
+
+static FunctionProto* protoOf(Value fn) {
+    return asFunction(fn)->proto;
+}
+
+TEST_CASE(TestBaselineJitTiersUpRecursiveCalls) {
+    VM vm;
+    int fibSlot = defineFib(vm);
+    Value result = vm.call(vm.getGlobal(fibSlot), {Value::integer(22)});
+    ASSERT_EQ(result.asInt(), 17711);
+    ASSERT_EQ(protoOf(vm.getGlobal(fibSlot))->jitCode != nullptr, BaselineJit::isSupported());
+    // Fully compiled from entry on the next call
+    ASSERT_EQ(vm.call(vm.getGlobal(fibSlot), {Value::integer(15)}).asInt(), 610);
+}
+
+TEST_CASE(TestBaselineJitLoopEntersCompiledCode) {
+    VM vm;
+    Value sum = defineLoopSum(vm);
+    // Back-edges alone reach the threshold inside one call
+    ASSERT_EQ(vm.call(sum, {Value::integer(5000), Value::integer(1)}).asInt(), 12497500);
+    ASSERT_EQ(protoOf(sum)->jitCode != nullptr, BaselineJit::isSupported());
+    ASSERT_EQ(protoOf(sum)->deoptCount, 0u);
+}
+
+TEST_CASE(TestBaselineJitDeoptimizesOnDoubles) {
+    VM vm;
+    Value sum = defineLoopSum(vm);
+    ASSERT_EQ(vm.call(sum, {Value::integer(5000), Value::integer(1)}).asInt(), 12497500);
+
+    // A double step fails the int guard; the interpreter finishes the work
+    Value result = vm.call(sum, {Value::integer(3), Value::number(0.5)});
+    ASSERT_EQ(result.toNumber(), 7.5);
+    // Int overflow past 48 bits also deoptimizes instead of wrapping
+    result = vm.call(sum, {Value::integer(Value::kMaxInt), Value::integer(Value::kMaxInt - 1)});
+    ASSERT_EQ(result.toNumber(), static_cast<double>(Value::kMaxInt - 1));
+    if (BaselineJit::isSupported()) {
+        ASSERT_TRUE(protoOf(sum)->deoptCount > 0);
+    }
+    // Still correct for ints afterwards
+    ASSERT_EQ(vm.call(sum, {Value::integer(100), Value::integer(1)}).asInt(), 4950);
+}
+
+TEST_CASE(TestBaselineJitPropertyCaches) {
+    // get(o) = o.a + o.f, where f lives in the overflow slots
+    VM vm;
+    const char* names[] = {"a", "b", "c", "d", "e", "f"};
+    BytecodeBuilder b("get", 1);
+    b.emit(Opcode::GetProp, 1, 0, b.addPropertyCache(vm.intern("a")));
+    b.emit(Opcode::GetProp, 2, 0, b.addPropertyCache(vm.intern("f")));
+    b.emit(Opcode::Add, 1, 1, 2);
+    b.emit(Opcode::LoadInt, 3, 1);
+    b.emit(Opcode::SetProp, 0, b.addPropertyCache(vm.intern("a")), 3);
+    b.emit(Opcode::Return, 1);
+    Value get = Value::object(vm.adopt(b.finish()));
+
+    // Two shapes: properties added in different orders
+    Object* first = vm.getHeap().allocateObject(vm.getShapes().root());
+    Object* second = vm.getHeap().allocateObject(vm.getShapes().root());
+    for (int i = 0; i < 6; ++i) {
+        setProperty(vm.getHeap(), vm.getShapes(), first, vm.intern(names[i]), Value::integer(i));
+        setProperty(vm.getHeap(), vm.getShapes(), second, vm.intern(names[5 - i]), Value::integer(10 * (5 - i)));
+    }
+    ASSERT_NE(first->shape, second->shape);
+
+    for (int i = 0; i < static_cast<int>(2 * BaselineJit::kHotnessThreshold); ++i) {
+        Value firstResult = vm.call(get, {Value::object(first)});
+        Value secondResult = vm.call(get, {Value::object(second)});
+        ASSERT_EQ(firstResult.asInt(), i == 0 ? 5 : 6);
+        ASSERT_EQ(secondResult.asInt(), i == 0 ? 50 : 51);
+    }
+    ASSERT_EQ(protoOf(get)->jitCode != nullptr, BaselineJit::isSupported());
+
+    // Misses on non-objects raise the interpreter's error
+    bool threw = false;
+    try {
+        vm.call(get, {Value::null()});
+    } catch (const RuntimeError&) {
+        threw = true;
+    }
+    ASSERT_TRUE(threw);
+}
+
+TEST_CASE(TestBaselineJitCanBeDisabled) {
+    VM vm;
+    vm.setJitEnabled(false);
+    Value sum = defineLoopSum(vm);
+    ASSERT_EQ(vm.call(sum, {Value::integer(5000), Value::integer(1)}).asInt(), 12497500);
+    ASSERT_TRUE(protoOf(sum)->jitCode == nullptr);
+}
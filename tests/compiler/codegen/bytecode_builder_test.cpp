@@ -0,0 +1,86 @@
+#include "compiler/codegen/bytecode_builder.h"
+#include "compiler/codegen/literal_constants.h"
+#include "runtime/vm/vm.h"
+#include "test_runner.h"
+
+TEST_CASE(TestBytecodeBuilderResolvesLabels) {
+    BytecodeBuilder b("labels", 1);
+    auto end = b.newLabel();
+    auto top = b.newLabel();
+    b.bind(top);
+    b.emitJumpIfFalse(0, end);
+    b.emitJump(top);
+    b.bind(end);
+    b.emit(Opcode::Return, 0);
+    auto proto = b.finish();
+
+    ASSERT_EQ(proto->code.size(), 3u);
+    ASSERT_EQ(proto->code[0].b, 2); // JumpIfFalse -> end
+    ASSERT_EQ(proto->code[1].a, 0); // Jump -> top
+}
+
+TEST_CASE(TestBytecodeBuilderComputesRegisterWindow) {
+    BytecodeBuilder b("window", 2);
+    b.emit(Opcode::Add, 4, 0, 1);
+    b.emit(Opcode::Call, 2, 5, 3); // Arguments in r6..r8
+    auto proto = b.finish();
+
+    ASSERT_EQ(proto->numParams, 2);
+    ASSERT_EQ(proto->numRegisters, 9);
+}
+
+TEST_CASE(TestBytecodeBuilderAppendsImplicitReturn) {
+    BytecodeBuilder b("implicit", 0);
+    auto end = b.newLabel();
+    b.emit(Opcode::LoadTrue, 0);
+    b.emitJumpIfTrue(0, end);
+    b.emit(Opcode::Return, 0);
+    b.bind(end);
+    auto proto = b.finish();
+
+    ASSERT_EQ(proto->code.back().op, Opcode::ReturnUndefined);
+    ASSERT_EQ(proto->code[1].b, 3);
+}
+
+TEST_CASE(TestBytecodeBuilderDeduplicatesConstants) {
+    BytecodeBuilder b("constants", 0);
+    int first = b.addConstant(Value::number(1.5));
+    int second = b.addConstant(Value::number(2.5));
+    ASSERT_EQ(b.addConstant(Value::number(1.5)), first);
+    ASSERT_NE(first, second);
+}
+
+TEST_CASE(TestDisassembleListsOperands) {
+    BytecodeBuilder b("dis", 1);
+    b.emit(Opcode::LoadInt, 1, 7);
+    b.emit(Opcode::Add, 2, 0, 1);
+    b.emit(Opcode::Return, 2);
+    std::string text = disassemble(*b.finish());
+
+    ASSERT_TRUE(text.find("LoadInt r1 #7") != std::string::npos);
+    ASSERT_TRUE(text.find("Add r2 r0 r1") != std::string::npos);
+}
+
+TEST_CASE(TestLiteralConstantsMapOntoValues) {
+    VM vm;
+    Token intToken(TokenType::IntegerLiteral, "42", 1, 1);
+    Token floatToken(TokenType::FloatLiteral, "0.5", 1, 1);
+    Token stringToken(TokenType::StringLiteral, "hello", 1, 1);
+    Token identToken(TokenType::Identifier, "x", 1, 1);
+
+    auto integer = literalConstant(vm, IntegerLiteral(intToken, 42));
+    ASSERT_TRUE(integer.has_value() && integer->isInt());
+    ASSERT_EQ(integer->asInt(), 42);
+
+    // Integers beyond 48 bits become doubles
+    auto huge = literalConstant(vm, IntegerLiteral(intToken, int64_t(1) << 60));
+    ASSERT_TRUE(huge->isDouble());
+
+    auto floating = literalConstant(vm, FloatLiteral(floatToken, 0.5));
+    ASSERT_EQ(floating->asDouble(), 0.5);
+
+    auto string = literalConstant(vm, StringLiteral(stringToken, "hello"));
+    ASSERT_TRUE(*string == Value::object(vm.intern("hello")));
+
+    ASSERT_FALSE(literalConstant(vm, Identifier(identToken, "x")).has_value());
+}
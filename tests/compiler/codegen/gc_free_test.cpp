@@ -0,0 +1,107 @@
+#include "compiler/codegen/bytecode_builder.h"
+#include "compiler/codegen/gc_free.h"
+#include "runtime/vm/vm.h"
+#include "test_runner.h"
+
+#include <string>
+
+// sum(n) { s = 0; while (n > 0) { w = wild(...); s = s + step(n); destroy w; n = n - 1 } return s }
+static std::unique_ptr<FunctionProto> buildSum(int stepSlot) {
+    BytecodeBuilder b("sum", 1);
+    auto head = b.newLabel();
+    auto done = b.newLabel();
+    b.emit(Opcode::LoadInt, 1, 0);
+    b.emit(Opcode::LoadInt, 2, 1);
+    b.emit(Opcode::LoadInt, 3, 0);
+    b.bind(head);
+    b.emit(Opcode::Gt, 4, 0, 3);
+    b.emitJumpIfFalse(4, done);
+    b.emit(Opcode::NewWild, 5, 32);
+    b.emit(Opcode::GetGlobal, 6, stepSlot);
+    b.emit(Opcode::Move, 7, 0);
+    b.emit(Opcode::Call, 6, 6, 1);
+    b.emit(Opcode::Add, 1, 1, 6);
+    b.emit(Opcode::Destroy, 5);
+    b.emit(Opcode::Sub, 0, 0, 2);
+    b.emitJump(head);
+    b.bind(done);
+    b.emit(Opcode::Return, 1);
+    return b.finish();
+}
+
+// step(x) { return x + x }
+static std::unique_ptr<FunctionProto> buildStep() {
+    BytecodeBuilder b("step", 1);
+    b.emit(Opcode::Add, 1, 0, 0);
+    b.emit(Opcode::Return, 1);
+    return b.finish();
+}
+
+TEST_CASE(TestGcFreeNumericAndWildProgram) {
+    auto sum = buildSum(0);
+    auto step = buildStep();
+    GcFreeReport report = analyzeGcFree({sum.get(), step.get()}, {Value::undefined()});
+    ASSERT_TRUE(report.gcFree);
+    ASSERT_EQ(report.reason, "");
+}
+
+TEST_CASE(TestGcFreeFindsAllocations) {
+    BytecodeBuilder b("make", 0);
+    b.emit(Opcode::NewObject, 0);
+    b.emit(Opcode::Return, 0);
+    auto make = b.finish();
+    GcFreeReport report = analyzeGcFree({make.get()}, {});
+    ASSERT_FALSE(report.gcFree);
+    ASSERT_EQ(report.reason, "function make, instruction 0: object creation");
+
+    // A string literal stored in a global reaches `step` through the
+    // global, so step's Add may concatenate
+    VM vm;
+    BytecodeBuilder p("publish", 0);
+    p.emit(Opcode::LoadConst, 0, p.addConstant(Value::object(vm.intern("x"))));
+    p.emit(Opcode::SetGlobal, 1, 0);
+    auto publish = p.finish();
+    BytecodeBuilder r("read", 0);
+    r.emit(Opcode::GetGlobal, 0, 1);
+    r.emit(Opcode::LoadInt, 1, 1);
+    r.emit(Opcode::Add, 2, 0, 1);
+    r.emit(Opcode::Return, 2);
+    auto read = r.finish();
+    ASSERT_TRUE(analyzeGcFree({read.get()}, {}).gcFree);
+    report = analyzeGcFree({read.get(), publish.get()}, {});
+    ASSERT_FALSE(report.gcFree);
+    ASSERT_EQ(report.reason, "function read, instruction 2: string concatenation");
+    // So does a string the host left in a global
+    ASSERT_FALSE(analyzeGcFree({read.get()}, {Value::undefined(), Value::object(vm.intern("y"))}).gcFree);
+}
+
+TEST_CASE(TestGcFreeCollectorlessVM) {
+    VM vm;
+    int slot = vm.defineGlobal("step");
+    vm.setGlobal(slot, Value::object(vm.adopt(buildStep())));
+    FunctionObject* sum = vm.adopt(buildSum(slot));
+    ASSERT_TRUE(vm.enableCollectorless());
+    ASSERT_TRUE(vm.isCollectorless());
+    ASSERT_TRUE(vm.getHeap().isCollectionSuspended());
+    ASSERT_TRUE(sum->proto->gcFree);
+    ASSERT_TRUE(sum->proto->stackMap.empty());
+
+    // Long enough to tier up; compiled without polls or barriers
+    Value result = vm.call(Value::object(sum), {Value::integer(5000)});
+    ASSERT_EQ(result.asInt(), 5000 * 5001);
+    ASSERT_EQ(vm.getWildHeap().getStats().liveObjects, 0u);
+
+    // A function that allocates brings the collector back
+    BytecodeBuilder b("make", 0);
+    b.emit(Opcode::NewObject, 0);
+    b.emit(Opcode::Return, 0);
+    vm.adopt(b.finish());
+    ASSERT_FALSE(vm.isCollectorless());
+    ASSERT_FALSE(vm.getHeap().isCollectionSuspended());
+    ASSERT_FALSE(sum->proto->gcFree);
+    ASSERT_FALSE(sum->proto->stackMap.empty());
+
+    std::string reason;
+    ASSERT_FALSE(vm.enableCollectorless(&reason));
+    ASSERT_EQ(reason, "function make, instruction 0: object creation");
+}
@@ -0,0 +1,55 @@
+#include "compiler/codegen/bytecode_builder.h"
+#include "compiler/codegen/liveness.h"
+#include "test_runner.h"
+
+TEST_CASE(TestLivenessStraightLine) {
+    // r1 = 1; r2 = r0 + r1; return r2
+    BytecodeBuilder b("f", 1);
+    b.emit(Opcode::LoadInt, 1, 1);
+    b.emit(Opcode::Add, 2, 0, 1);
+    b.emit(Opcode::Return, 2);
+    auto proto = b.finish();
+    const StackMap& map = proto->stackMap;
+
+    ASSERT_EQ(map.instructionCount(), proto->code.size());
+    ASSERT_TRUE(map.isLive(0, 0));
+    ASSERT_FALSE(map.isLive(0, 1)); // Written before it is read
+    ASSERT_TRUE(map.isLive(1, 0));
+    ASSERT_TRUE(map.isLive(1, 1));
+    ASSERT_FALSE(map.isLive(2, 0)); // Dead after its last use
+    ASSERT_TRUE(map.isLive(2, 2));
+}
+
+TEST_CASE(TestLivenessLoopsAndCalls) {
+    // r1 = 0; loop: r2 = r1 < r0; if (!r2) goto done; r3 = g(r1); r1 = r1 + r3; goto loop
+    BytecodeBuilder b("g", 1);
+    auto loop = b.newLabel();
+    auto done = b.newLabel();
+    b.emit(Opcode::LoadInt, 1, 0);
+    b.emit(Opcode::LoadInt, 6, 7);
+    b.bind(loop);
+    b.emit(Opcode::Lt, 2, 1, 0);           // 2
+    b.emitJumpIfFalse(2, done);            // 3
+    b.emit(Opcode::GetGlobal, 4, 0);       // 4
+    b.emit(Opcode::Move, 5, 1);            // 5
+    b.emit(Opcode::Call, 3, 4, 1);         // 6
+    b.emit(Opcode::Add, 1, 1, 3);          // 7
+    b.emitJump(loop);                      // 8
+    b.bind(done);
+    b.emit(Opcode::Return, 1);             // 9
+    auto proto = b.finish();
+    const StackMap& map = proto->stackMap;
+
+    // r0 is live around the whole loop via the back-edge
+    ASSERT_TRUE(map.isLive(2, 0));
+    ASSERT_TRUE(map.isLive(7, 0));
+    // The callee and its argument are live into the call...
+    ASSERT_TRUE(map.isLive(6, 4));
+    ASSERT_TRUE(map.isLive(6, 5));
+    // ...and dead after it
+    ASSERT_FALSE(map.isLive(7, 4));
+    ASSERT_TRUE(map.isLive(7, 3));
+    // r6 is never read, and would be clobbered by the call anyway
+    ASSERT_FALSE(map.isLive(1, 6));
+    ASSERT_FALSE(map.isLive(6, 6));
+}
@@ -0,0 +1,131 @@
+#include "compiler/codegen/bytecode_builder.h"
+#include "compiler/codegen/ownership.h"
+#include "test_runner.h"
+
+#include <string>
+
+// Message of the OwnershipError raised by finish(), or "" if none
+static std::string ownershipError(BytecodeBuilder& b, int* instruction = nullptr) {
+    try {
+        b.finish();
+    } catch (const OwnershipError& e) {
+        if (instruction) {
+            *instruction = e.instruction;
+        }
+        return e.what();
+    }
+    return "";
+}
+
+TEST_CASE(TestOwnershipElidesChecksOnLocalObjects) {
+    // wild var w = ...; var r = ref w; r.x; r.y; destroy w
+    BytecodeBuilder b("f", 0);
+    b.emit(Opcode::NewWild, 0, 16);
+    b.emit(Opcode::Move, 1, 0);
+    b.emit(Opcode::WildCheck, 1);
+    b.emit(Opcode::LoadInt, 2, 1);
+    b.emit(Opcode::WildCheck, 1);
+    b.emit(Opcode::Destroy, 0);
+    b.emit(Opcode::ReturnUndefined);
+    auto proto = b.finish();
+
+    ASSERT_EQ(proto->code.size(), 5u);
+    ASSERT_EQ(proto->code[2].op, Opcode::LoadInt);
+    ASSERT_EQ(proto->code[3].op, Opcode::Destroy);
+    ASSERT_EQ(checkOwnership(*proto), 0);
+}
+
+TEST_CASE(TestOwnershipKeepsChecksItCannotProve) {
+    BytecodeBuilder b("g", 2);
+    auto merge = b.newLabel();
+    b.emit(Opcode::NewWild, 2, 8);
+    b.emitJumpIfFalse(0, merge);
+    b.emit(Opcode::Destroy, 2);
+    b.bind(merge);
+    b.emit(Opcode::WildCheck, 2);      // 3: destroyed on one path only
+    b.emit(Opcode::NewWild, 3, 8);
+    b.emit(Opcode::Move, 5, 3);
+    b.emit(Opcode::Move, 4, 1);
+    b.emit(Opcode::Call, 4, 4, 1);     // The callee may destroy r3's object
+    b.emit(Opcode::WildCheck, 3);      // 8
+    b.emit(Opcode::GetGlobal, 6, 0);
+    b.emit(Opcode::WildCheck, 6);      // 10: untracked
+    b.emit(Opcode::ReturnUndefined);
+    auto proto = b.finish();
+    ASSERT_EQ(proto->code.size(), 12u);
+    ASSERT_EQ(checkOwnership(*proto), 0);
+    ASSERT_EQ(proto->code[3].op, Opcode::WildCheck);
+    ASSERT_EQ(proto->code[8].op, Opcode::WildCheck);
+    ASSERT_EQ(proto->code[10].op, Opcode::WildCheck);
+
+    // A loop that destroys what it allocated keeps the check at its head
+    BytecodeBuilder l("loop", 1);
+    auto head = l.newLabel();
+    auto done = l.newLabel();
+    l.emit(Opcode::NewWild, 1, 8);
+    l.bind(head);
+    l.emitJumpIfFalse(0, done);
+    l.emit(Opcode::WildCheck, 1);
+    l.emit(Opcode::Destroy, 1);
+    l.emitJump(head);
+    l.bind(done);
+    l.emit(Opcode::ReturnUndefined);
+    proto = l.finish();
+    ASSERT_EQ(proto->code.size(), 6u);
+    ASSERT_EQ(proto->code[2].op, Opcode::WildCheck);
+}
+
+TEST_CASE(TestOwnershipTransferMovesTheProof) {
+    // wild var a = ...; wild var b = transfer a; b.x; destroy b
+    BytecodeBuilder b("t", 0);
+    b.emit(Opcode::NewWild, 0, 8);
+    b.emit(Opcode::Transfer, 1, 0);
+    b.emit(Opcode::WildCheck, 1);
+    b.emit(Opcode::Destroy, 1);
+    b.emit(Opcode::ReturnUndefined);
+    auto proto = b.finish();
+    ASSERT_EQ(proto->code.size(), 4u);
+    ASSERT_EQ(proto->code[2].op, Opcode::Destroy);
+}
+
+TEST_CASE(TestOwnershipReportsDefiniteViolations) {
+    int instruction = -1;
+    BytecodeBuilder useAfterDestroy("a", 0);
+    useAfterDestroy.emit(Opcode::NewWild, 0, 8);
+    useAfterDestroy.emit(Opcode::Move, 1, 0);
+    useAfterDestroy.emit(Opcode::Destroy, 0);
+    useAfterDestroy.emit(Opcode::WildRetain, 1); // Through an alias
+    ASSERT_EQ(ownershipError(useAfterDestroy, &instruction), "Reference to destroyed wild object in function a");
+    ASSERT_EQ(instruction, 3);
+
+    BytecodeBuilder doubleDestroy("b", 0);
+    doubleDestroy.emit(Opcode::NewWild, 0, 8);
+    doubleDestroy.emit(Opcode::Destroy, 0);
+    doubleDestroy.emit(Opcode::Destroy, 0);
+    ASSERT_EQ(ownershipError(doubleDestroy), "Wild object already destroyed in function b");
+
+    // Transferred on both branches
+    BytecodeBuilder useAfterTransfer("c", 1);
+    auto other = useAfterTransfer.newLabel();
+    auto join = useAfterTransfer.newLabel();
+    useAfterTransfer.emit(Opcode::NewWild, 1, 8);
+    useAfterTransfer.emitJumpIfFalse(0, other);
+    useAfterTransfer.emit(Opcode::Transfer, 2, 1);
+    useAfterTransfer.emitJump(join);
+    useAfterTransfer.bind(other);
+    useAfterTransfer.emit(Opcode::Transfer, 3, 1);
+    useAfterTransfer.bind(join);
+    useAfterTransfer.emit(Opcode::WildCheck, 1);
+    ASSERT_EQ(ownershipError(useAfterTransfer, &instruction), "Accessed transferred wild object in function c");
+    ASSERT_EQ(instruction, 5);
+
+    // Unreachable code is not checked
+    BytecodeBuilder dead("d", 0);
+    auto end = dead.newLabel();
+    dead.emit(Opcode::NewWild, 0, 8);
+    dead.emit(Opcode::Destroy, 0);
+    dead.emitJump(end);
+    dead.emit(Opcode::Destroy, 0);
+    dead.bind(end);
+    ASSERT_EQ(ownershipError(dead), "");
+}
@@ -0,0 +1,68 @@
+#include "compiler/codegen/bytecode_builder.h"
+#include "compiler/codegen/wild_refcount.h"
+#include "test_runner.h"
+
+TEST_CASE(TestWildRefPairsCancelInStraightLine) {
+    // r1 = ref r0; r2 = r0 + r0; release r1; return r2
+    BytecodeBuilder b("f", 1);
+    b.emit(Opcode::Move, 1, 0);
+    b.emit(Opcode::WildRetain, 1);
+    b.emit(Opcode::Add, 2, 0, 0);
+    b.emit(Opcode::WildRelease, 1);
+    b.emit(Opcode::Return, 2);
+    auto proto = b.finish();
+
+    ASSERT_EQ(proto->code.size(), 4u);
+    ASSERT_EQ(proto->code[1].op, Opcode::WildCheck);
+    ASSERT_EQ(proto->code[2].op, Opcode::Add);
+    ASSERT_EQ(proto->code[3].op, Opcode::Return);
+}
+
+TEST_CASE(TestWildRefPairsKeptAcrossCallsAndDestroy) {
+    BytecodeBuilder b("g", 2);
+    b.emit(Opcode::WildRetain, 0);
+    b.emit(Opcode::Call, 2, 1, 0); // Callee could destroy the object
+    b.emit(Opcode::WildRelease, 0);
+    b.emit(Opcode::WildRetain, 0);
+    b.emit(Opcode::Destroy, 1);
+    b.emit(Opcode::WildRelease, 0);
+    b.emit(Opcode::WildRetain, 0);
+    b.emit(Opcode::Move, 0, 1); // Register reused for another value
+    b.emit(Opcode::WildRelease, 0);
+    b.emit(Opcode::ReturnUndefined);
+    auto proto = b.finish();
+
+    ASSERT_EQ(proto->code.size(), 10u);
+    ASSERT_EQ(proto->code[0].op, Opcode::WildRetain);
+    ASSERT_EQ(proto->code[3].op, Opcode::WildRetain);
+    ASSERT_EQ(proto->code[6].op, Opcode::WildRetain);
+}
+
+TEST_CASE(TestWildRefPairsRemapJumpTargets) {
+    // Nested pairs cancel; the loop's targets move with the deleted releases
+    BytecodeBuilder b("h", 2);
+    auto loop = b.newLabel();
+    auto done = b.newLabel();
+    b.emit(Opcode::WildRetain, 0);       // 0
+    b.emit(Opcode::WildRetain, 0);       // 1
+    b.emit(Opcode::WildRelease, 0);      // 2 (removed)
+    b.emit(Opcode::WildRelease, 0);      // 3 (removed)
+    b.bind(loop);
+    b.emitJumpIfFalse(1, done);          // 4 -> 2
+    b.emit(Opcode::WildRetain, 0);       // 5 -> 3
+    b.emit(Opcode::WildRelease, 0);      // 6 (removed)
+    b.emitJump(loop);                    // 7 -> 4
+    b.bind(done);
+    b.emit(Opcode::ReturnUndefined);     // 8 -> 5
+    auto proto = b.finish();
+
+    ASSERT_EQ(cancelWildRefPairs(*proto), 0); // Already applied by finish()
+    ASSERT_EQ(proto->code.size(), 6u);
+    ASSERT_EQ(proto->code[0].op, Opcode::WildCheck);
+    ASSERT_EQ(proto->code[1].op, Opcode::WildCheck);
+    ASSERT_EQ(proto->code[2].op, Opcode::JumpIfFalse);
+    ASSERT_EQ(proto->code[2].b, 5);
+    ASSERT_EQ(proto->code[3].op, Opcode::WildCheck);
+    ASSERT_EQ(proto->code[4].op, Opcode::Jump);
+    ASSERT_EQ(proto->code[4].a, 2);
+}
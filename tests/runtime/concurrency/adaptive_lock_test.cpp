@@ -0,0 +1,196 @@
+#include "runtime/concurrency/adaptive_lock.h"
+#include "test_runner.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// A task that increments a counter under the lock
+struct Increment : LockWaiter {
+    AdaptiveLock* lock = nullptr;
+    LockSite* site = nullptr;
+    int* value = nullptr;
+    WaitGroup* group = nullptr;
+
+    Increment() : LockWaiter(&resume) {}
+
+    void start() {
+        if (lock->lockAsync(this, site)) {
+            critical();
+        }
+    }
+
+    static void resume(Task* task) {
+        auto* self = static_cast<Increment*>(static_cast<LockWaiter*>(task));
+        if (self->acquired || self->lock->lockAsync(self, self->site)) {
+            self->critical();
+        }
+    }
+
+    void critical() {
+        ++*value;
+        WaitGroup* done = group;
+        lock->unlock();
+        done->done();
+    }
+};
+
+void waitUntil(const std::atomic<uint64_t>& counter, uint64_t target) {
+    while (counter.load() < target) {
+        std::this_thread::yield();
+    }
+}
+
+} // namespace
+
+TEST_CASE(TestAdaptiveLockUncontended) {
+    AdaptiveLock lock;
+    LockSite site;
+    ASSERT_FALSE(lock.isLocked());
+    {
+        LockGuard guard(lock, &site);
+        ASSERT_TRUE(lock.isLocked());
+        ASSERT_FALSE(lock.tryLock());
+    }
+    ASSERT_FALSE(lock.isLocked());
+    ASSERT_TRUE(lock.tryLock());
+    lock.unlock();
+    // Nothing was contended, so the site never saw the acquisitions
+    LockStats stats = site.getStats();
+    ASSERT_EQ(stats.contended, 0u);
+    ASSERT_EQ(stats.parks, 0u);
+}
+
+TEST_CASE(TestAdaptiveLockMutualExclusion) {
+    AdaptiveLock lock;
+    LockSite site;
+    constexpr int kThreads = 8;
+    constexpr int kIterations = 20000;
+    int64_t counter = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < kIterations; ++i) {
+                LockGuard guard(lock, &site);
+                ++counter;
+                if (i % 1000 == 0) {
+                    std::this_thread::yield(); // Long hold now and then, so some waiters park
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQ(counter, int64_t(kThreads) * kIterations);
+    ASSERT_FALSE(lock.isLocked());
+    LockStats stats = site.getStats();
+    ASSERT_TRUE(stats.spinAcquired <= stats.contended);
+    ASSERT_TRUE(site.spinBudget() >= LockSite::kMinSpins);
+    ASSERT_TRUE(site.spinBudget() <= LockSite::kMaxSpins);
+}
+
+TEST_CASE(TestAdaptiveLockParksTasksNotThreads) {
+    AdaptiveLock lock;
+    LockSite site;
+    constexpr int kTasks = 100;
+    std::vector<Increment> tasks(kTasks);
+    int value = 0;
+    WaitGroup group;
+    group.add(kTasks);
+    {
+        Scheduler scheduler(Scheduler::Options{2, nullptr});
+        lock.lock();
+        for (Increment& task : tasks) {
+            task.lock = &lock;
+            task.site = &site;
+            task.value = &value;
+            task.group = &group;
+            task.scheduler = &scheduler;
+            scheduler.spawn([&task] { task.start(); });
+        }
+        waitUntil(site.parks, kTasks);
+
+        // Every task is parked, yet both workers are free for other work
+        WaitGroup other;
+        other.add(2);
+        std::atomic<int> ran{0};
+        for (int i = 0; i < 2; ++i) {
+            scheduler.spawn([&] {
+                ran.fetch_add(1);
+                other.done();
+            });
+        }
+        other.wait();
+        ASSERT_EQ(ran.load(), 2);
+        ASSERT_EQ(value, 0);
+
+        lock.unlock();
+        scheduler.wait(group);
+    }
+    ASSERT_EQ(value, kTasks);
+    ASSERT_FALSE(lock.isLocked());
+    ASSERT_EQ(site.getStats().contended, uint64_t(kTasks));
+}
+
+TEST_CASE(TestAdaptiveLockHandsOffToStarvedWaiter) {
+    AdaptiveLock lock;
+    LockSite site;
+    lock.lock();
+    std::atomic<bool> acquired{false};
+    std::atomic<bool> done{false};
+    std::thread waiter([&] {
+        lock.lock(&site);
+        acquired.store(true);
+        while (!done.load()) {
+            std::this_thread::yield();
+        }
+        lock.unlock();
+    });
+    waitUntil(site.parks, 1);
+    // Past the fairness window the release passes the lock on, still
+    // held, so this thread cannot barge back in
+    std::this_thread::sleep_for(std::chrono::milliseconds(3));
+    lock.unlock();
+    bool barged = lock.tryLock();
+    if (barged) {
+        lock.unlock();
+    }
+    done.store(true);
+    waiter.join();
+    ASSERT_FALSE(barged);
+    ASSERT_TRUE(acquired.load());
+    ASSERT_EQ(site.getStats().handoffs, 1u);
+}
+
+TEST_CASE(TestAdaptiveLockCancel) {
+    AdaptiveLock lock;
+    std::vector<Increment> tasks(2);
+    int value = 0;
+    WaitGroup group;
+    group.add(1);
+    lock.lock();
+    for (Increment& task : tasks) {
+        task.lock = &lock;
+        task.value = &value;
+        task.group = &group;
+        task.start(); // Parked; resumed by the unlocking thread
+    }
+    ASSERT_TRUE(lock.cancel(&tasks[0]));
+    ASSERT_FALSE(lock.cancel(&tasks[0]));
+    lock.unlock();
+    ASSERT_EQ(value, 1); // Only the waiter still parked ran
+    ASSERT_FALSE(lock.cancel(&tasks[1]));
+
+    // With its last waiter cancelled the lock is plain again
+    lock.lock();
+    tasks[0].start();
+    ASSERT_TRUE(lock.cancel(&tasks[0]));
+    lock.unlock();
+    ASSERT_TRUE(lock.tryLock());
+    lock.unlock();
+    ASSERT_EQ(value, 1);
+}
@@ -0,0 +1,337 @@
+#include "runtime/concurrency/channel.h"
+#include "test_runner.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// A task that receives one item, parking while the channel is empty
+struct Receiver : ChannelWaiter {
+    Channel<int>* channel = nullptr;
+    int value = 0;
+    std::atomic<int>* parked = nullptr;
+    std::atomic<int64_t>* sum = nullptr;
+    WaitGroup* group = nullptr;
+
+    Receiver() : ChannelWaiter(&resume) {}
+
+    static void resume(Task* task) { static_cast<Receiver*>(static_cast<ChannelWaiter*>(task))->run(); }
+
+    void run() {
+        std::atomic<int>* parks = parked; // This task may be gone once parked
+        if (channel->receiveOrPark(value, this) == ChannelStatus::Parked) {
+            parks->fetch_add(1);
+            return;
+        }
+        sum->fetch_add(value);
+        group->done();
+    }
+};
+
+// A task selecting over two channels
+struct Selector : ChannelWaiter {
+    Select select;
+    int first = 0;
+    int second = 0;
+    Select::Result result;
+    std::atomic<bool> done{false};
+
+    Selector(Channel<int>& a, Channel<int>& b) : ChannelWaiter(&resume) {
+        select.receive(a, &first);
+        select.receive(b, &second);
+    }
+
+    static void resume(Task* task) { static_cast<Selector*>(static_cast<ChannelWaiter*>(task))->run(); }
+
+    void run() {
+        Select::Result selected = select.selectOrPark(this);
+        if (selected.status != ChannelStatus::Parked) {
+            result = selected;
+            done.store(true);
+        }
+    }
+};
+
+} // namespace
+
+TEST_CASE(TestChannelTrySendReceive) {
+    Channel<int> channel(4);
+    ASSERT_EQ(channel.capacity(), size_t(4));
+    int out = 0;
+    ASSERT_TRUE(channel.tryReceive(out) == ChannelStatus::WouldBlock);
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(channel.trySend(i) == ChannelStatus::Ok);
+    }
+    ASSERT_TRUE(channel.trySend(4) == ChannelStatus::WouldBlock);
+    ASSERT_EQ(channel.size(), size_t(4));
+    // FIFO across several laps of the ring
+    for (int i = 0; i < 40; ++i) {
+        ASSERT_TRUE(channel.tryReceive(out) == ChannelStatus::Ok);
+        ASSERT_EQ(out, i);
+        ASSERT_TRUE(channel.trySend(i + 4) == ChannelStatus::Ok);
+    }
+    ASSERT_EQ(channel.size(), size_t(4));
+}
+
+TEST_CASE(TestChannelBatches) {
+    Channel<int> channel(8);
+    int items[12];
+    for (int i = 0; i < 12; ++i) {
+        items[i] = i;
+    }
+    size_t sent = 0;
+    ASSERT_TRUE(channel.trySendBatch(items, 5, sent) == ChannelStatus::Ok);
+    ASSERT_EQ(sent, size_t(5));
+    // Only what fits goes in
+    ASSERT_TRUE(channel.trySendBatch(items + 5, 7, sent) == ChannelStatus::Ok);
+    ASSERT_EQ(sent, size_t(3));
+
+    int out[16] = {};
+    size_t received = 0;
+    ASSERT_TRUE(channel.tryReceiveBatch(out, 6, received) == ChannelStatus::Ok);
+    ASSERT_EQ(received, size_t(6));
+    ASSERT_TRUE(channel.trySendBatch(items + 8, 4, sent) == ChannelStatus::Ok); // Wraps around
+    ASSERT_EQ(sent, size_t(4));
+    ASSERT_TRUE(channel.tryReceiveBatch(out + 6, 16, received) == ChannelStatus::Ok);
+    ASSERT_EQ(received, size_t(6));
+    for (int i = 0; i < 12; ++i) {
+        ASSERT_EQ(out[i], i);
+    }
+}
+
+TEST_CASE(TestChannelClose) {
+    Channel<int> channel(4);
+    ASSERT_TRUE(channel.trySend(1) == ChannelStatus::Ok);
+    ASSERT_TRUE(channel.trySend(2) == ChannelStatus::Ok);
+    ASSERT_TRUE(channel.close());
+    ASSERT_FALSE(channel.close());
+    ASSERT_TRUE(channel.isClosed());
+    ASSERT_TRUE(channel.trySend(3) == ChannelStatus::Closed);
+
+    // Items sent before the close still arrive
+    int out = 0;
+    ASSERT_TRUE(channel.receive(out) == ChannelStatus::Ok);
+    ASSERT_EQ(out, 1);
+    ASSERT_TRUE(channel.tryReceive(out) == ChannelStatus::Ok);
+    ASSERT_EQ(out, 2);
+    ASSERT_TRUE(channel.tryReceive(out) == ChannelStatus::Closed);
+    ASSERT_TRUE(channel.receive(out) == ChannelStatus::Closed);
+}
+
+TEST_CASE(TestChannelCloseWakesBlockedThreads) {
+    Channel<int> channel(1);
+    std::atomic<int> closed{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&] {
+            int out;
+            if (channel.receive(out) == ChannelStatus::Closed) {
+                closed.fetch_add(1);
+            }
+        });
+    }
+    std::this_thread::yield();
+    channel.close();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQ(closed.load(), 4);
+}
+
+TEST_CASE(TestChannelManyProducersManyConsumers) {
+    Channel<int> channel(16);
+    constexpr int kProducers = 4;
+    constexpr int kConsumers = 4;
+    constexpr int kItems = 20000;
+    std::vector<std::atomic<int>> seen(kProducers * kItems);
+    for (std::atomic<int>& count : seen) {
+        count.store(0);
+    }
+
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < kConsumers; ++c) {
+        consumers.emplace_back([&, c] {
+            int out[8];
+            size_t received = 0;
+            for (;;) {
+                // Half the consumers take batches
+                ChannelStatus status = c % 2 ? channel.receiveBatch(out, 8, received) : channel.receive(out[0]);
+                if (status == ChannelStatus::Closed) {
+                    return;
+                }
+                for (size_t i = 0; i < (c % 2 ? received : 1); ++i) {
+                    seen[out[i]].fetch_add(1);
+                }
+            }
+        });
+    }
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&, p] {
+            for (int i = 0; i < kItems; i += 4) {
+                if (p % 2) {
+                    int batch[4] = {p * kItems + i, p * kItems + i + 1, p * kItems + i + 2, p * kItems + i + 3};
+                    size_t total = 0;
+                    while (total < 4) {
+                        size_t sent = 0;
+                        channel.sendBatch(batch + total, 4 - total, sent);
+                        total += sent;
+                    }
+                } else {
+                    for (int k = 0; k < 4; ++k) {
+                        channel.send(p * kItems + i + k);
+                    }
+                }
+            }
+        });
+    }
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+    channel.close();
+    for (std::thread& consumer : consumers) {
+        consumer.join();
+    }
+    // Every item arrived exactly once
+    bool exactlyOnce = true;
+    for (std::atomic<int>& count : seen) {
+        exactlyOnce = exactlyOnce && count.load() == 1;
+    }
+    ASSERT_TRUE(exactlyOnce);
+}
+
+TEST_CASE(TestChannelParksTasksNotThreads) {
+    Channel<int> channel(4);
+    constexpr int kTasks = 50;
+    std::vector<Receiver> tasks(kTasks);
+    std::atomic<int> parked{0};
+    std::atomic<int64_t> sum{0};
+    WaitGroup group;
+    group.add(kTasks);
+    {
+        Scheduler scheduler(Scheduler::Options{2, nullptr});
+        for (Receiver& task : tasks) {
+            task.channel = &channel;
+            task.parked = &parked;
+            task.sum = &sum;
+            task.group = &group;
+            task.scheduler = &scheduler;
+            scheduler.spawn([&task] { task.run(); });
+        }
+        while (parked.load() < kTasks) {
+            std::this_thread::yield();
+        }
+
+        // Every task waits on the channel, yet both workers are free
+        WaitGroup other;
+        other.add(2);
+        for (int i = 0; i < 2; ++i) {
+            scheduler.spawn([&] { other.done(); });
+        }
+        other.wait();
+        ASSERT_EQ(sum.load(), int64_t(0));
+
+        for (int i = 1; i <= kTasks; ++i) {
+            channel.send(i);
+        }
+        scheduler.wait(group);
+    }
+    ASSERT_EQ(sum.load(), int64_t(kTasks) * (kTasks + 1) / 2);
+    ASSERT_EQ(channel.size(), size_t(0));
+}
+
+TEST_CASE(TestChannelSelect) {
+    Channel<int> a(2);
+    Channel<int> b(2);
+    int fromA = 0;
+    int fromB = 0;
+    Select select;
+    int caseA = select.receive(a, &fromA);
+    int caseB = select.receive(b, &fromB);
+    ASSERT_EQ(select.trySelect().index, -1);
+
+    ASSERT_TRUE(b.trySend(7) == ChannelStatus::Ok);
+    Select::Result result = select.trySelect();
+    ASSERT_EQ(result.index, caseB);
+    ASSERT_TRUE(result.status == ChannelStatus::Ok);
+    ASSERT_EQ(fromB, 7);
+
+    // Ready cases take turns
+    ASSERT_TRUE(a.trySend(1) == ChannelStatus::Ok);
+    ASSERT_TRUE(b.trySend(2) == ChannelStatus::Ok);
+    ASSERT_EQ(select.trySelect().index, caseA);
+    ASSERT_EQ(select.trySelect().index, caseB);
+
+    // A closed channel makes its case ready
+    a.close();
+    result = select.select();
+    ASSERT_EQ(result.index, caseA);
+    ASSERT_TRUE(result.status == ChannelStatus::Closed);
+
+    // Sends and receives mix
+    Channel<int> full(1);
+    ASSERT_TRUE(full.trySend(0) == ChannelStatus::Ok);
+    int value = 5;
+    Select mixed;
+    mixed.send(full, &value);
+    int caseReceive = mixed.receive(b, &fromB);
+    ASSERT_TRUE(b.trySend(9) == ChannelStatus::Ok);
+    result = mixed.trySelect();
+    ASSERT_EQ(result.index, caseReceive);
+    ASSERT_EQ(fromB, 9);
+}
+
+TEST_CASE(TestChannelSelectParksTask) {
+    Channel<int> a(1);
+    Channel<int> b(1);
+    Selector selector(a, b);
+    selector.run(); // Parks on both; resumed by the sending thread
+    ASSERT_FALSE(selector.done.load());
+    std::thread sender([&] { b.send(42); });
+    sender.join();
+    ASSERT_TRUE(selector.done.load());
+    ASSERT_EQ(selector.result.index, 1);
+    ASSERT_EQ(selector.second, 42);
+    // Its node on `a` is gone: a later send wakes nobody and stays buffered
+    ASSERT_TRUE(a.trySend(1) == ChannelStatus::Ok);
+    ASSERT_EQ(a.size(), size_t(1));
+}
+
+TEST_CASE(TestChannelSelectAcrossThreads) {
+    Channel<int> a(4);
+    Channel<int> b(4);
+    constexpr int kItems = 10000;
+    std::thread producerA([&] {
+        for (int i = 0; i < kItems; ++i) {
+            a.send(1);
+        }
+        a.close();
+    });
+    std::thread producerB([&] {
+        for (int i = 0; i < kItems; ++i) {
+            b.send(2);
+        }
+        b.close();
+    });
+    int64_t sum = 0;
+    bool open[2] = {true, true};
+    while (open[0] || open[1]) {
+        int fromA = 0;
+        int fromB = 0;
+        Select select;
+        int caseA = open[0] ? select.receive(a, &fromA) : -1;
+        int caseB = open[1] ? select.receive(b, &fromB) : -1;
+        Select::Result result = select.select();
+        if (result.status == ChannelStatus::Closed) {
+            open[result.index == caseA ? 0 : 1] = false;
+        } else {
+            sum += result.index == caseA ? fromA : fromB;
+        }
+        (void)caseB;
+    }
+    producerA.join();
+    producerB.join();
+    ASSERT_EQ(sum, int64_t(kItems) * 3);
+}
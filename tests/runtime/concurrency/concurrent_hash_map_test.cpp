@@ -0,0 +1,150 @@
+#include "runtime/concurrency/concurrent_hash_map.h"
+#include "test_runner.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE(TestConcurrentHashMapBasics) {
+    EpochDomain domain;
+    ConcurrentHashMap<std::string, int> map(domain);
+    ASSERT_TRUE(map.set("a", 1));
+    ASSERT_FALSE(map.set("a", 2));
+    ASSERT_FALSE(map.insert("a", 3));
+    ASSERT_TRUE(map.insert("b", 4));
+
+    int value = 0;
+    ASSERT_TRUE(map.get("a", &value));
+    ASSERT_EQ(value, 2);
+    ASSERT_FALSE(map.get("c", &value));
+    ASSERT_EQ(map.size(), static_cast<size_t>(2));
+
+    ASSERT_TRUE(map.erase("a"));
+    ASSERT_FALSE(map.erase("a"));
+    ASSERT_FALSE(map.contains("a"));
+    ASSERT_TRUE(map.contains("b"));
+
+    // Growing keeps every entry
+    size_t initialBuckets = map.bucketCount();
+    for (int i = 0; i < 10000; ++i) {
+        map.set(std::to_string(i), i);
+    }
+    ASSERT_TRUE(map.bucketCount() > initialBuckets);
+    ASSERT_EQ(map.size(), static_cast<size_t>(10001));
+    bool found = true;
+    for (int i = 0; i < 10000; ++i) {
+        found = found && map.get(std::to_string(i), &value) && value == i;
+    }
+    ASSERT_TRUE(found);
+    int64_t sum = 0;
+    map.forEach([&](const std::string&, int v) { sum += v; });
+    ASSERT_EQ(sum, int64_t(9999) * 10000 / 2 + 4);
+}
+
+TEST_CASE(TestConcurrentHashMapParallelWriters) {
+    EpochDomain domain;
+    ConcurrentHashMap<int, int> map(domain);
+    constexpr int kWriters = 4;
+    constexpr int kPerWriter = 20000;
+    std::atomic<bool> writing{true};
+    std::atomic<bool> consistent{true};
+
+    // Readers run throughout growth and see either nothing or the final value
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 2; ++r) {
+        readers.emplace_back([&] {
+            while (writing.load()) {
+                for (int key = 0; key < kWriters * kPerWriter; key += 97) {
+                    int value = 0;
+                    if (map.get(key, &value) && value != key * 2) {
+                        consistent.store(false);
+                    }
+                }
+            }
+        });
+    }
+    std::vector<std::thread> writers;
+    for (int w = 0; w < kWriters; ++w) {
+        writers.emplace_back([&, w] {
+            for (int i = 0; i < kPerWriter; ++i) {
+                int key = w * kPerWriter + i;
+                map.set(key, key * 2);
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    writing.store(false);
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    ASSERT_TRUE(consistent.load());
+    ASSERT_EQ(map.size(), static_cast<size_t>(kWriters * kPerWriter));
+    bool found = true;
+    for (int key = 0; key < kWriters * kPerWriter; ++key) {
+        int value = 0;
+        found = found && map.get(key, &value) && value == key * 2;
+    }
+    ASSERT_TRUE(found);
+}
+
+TEST_CASE(TestConcurrentHashMapContendedKeys) {
+    // Every thread overwrites and erases the same few keys
+    EpochDomain domain;
+    ConcurrentHashMap<int, std::string> map(domain);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 20000; ++i) {
+                int key = i % 8;
+                if (i % 3 == 0) {
+                    map.erase(key);
+                } else {
+                    map.set(key, std::to_string(t));
+                }
+                std::string value;
+                if (map.get(key, &value)) {
+                    // A torn or freed string would not be a single digit
+                    if (value.size() != 1) {
+                        map.set(-1, "torn");
+                    }
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    ASSERT_FALSE(map.contains(-1));
+    size_t live = 0;
+    map.forEach([&](int, const std::string&) { ++live; });
+    ASSERT_EQ(live, map.size());
+    ASSERT_TRUE(live <= 8);
+}
+
+TEST_CASE(TestConcurrentHashSet) {
+    EpochDomain domain;
+    ConcurrentHashSet<int> set(domain);
+    std::vector<std::thread> threads;
+    std::atomic<int> added{0};
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 5000; ++i) {
+                if (set.insert(i)) {
+                    added.fetch_add(1);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    // Each value won by exactly one thread
+    ASSERT_EQ(added.load(), 5000);
+    ASSERT_EQ(set.size(), static_cast<size_t>(5000));
+    ASSERT_TRUE(set.contains(4999));
+    ASSERT_TRUE(set.erase(4999));
+    ASSERT_FALSE(set.contains(4999));
+}
@@ -0,0 +1,70 @@
+#include "runtime/concurrency/epoch.h"
+#include "test_runner.h"
+
+#include <atomic>
+#include <thread>
+
+namespace {
+
+std::atomic<int> freed{0};
+
+struct Counted {
+    ~Counted() { freed.fetch_add(1); }
+};
+
+// Enough collections for the epoch to move past any retirement
+void collectAll(EpochDomain& domain) {
+    for (int i = 0; i < 4; ++i) {
+        domain.collect();
+    }
+}
+
+} // namespace
+
+TEST_CASE(TestEpochGuardDefersFree) {
+    freed.store(0);
+    EpochDomain domain;
+    {
+        EpochDomain::Guard guard(domain);
+        domain.retire(new Counted());
+        collectAll(domain);
+        // Our own pin keeps the epoch from moving twice
+        ASSERT_EQ(freed.load(), 0);
+        ASSERT_EQ(domain.pendingCount(), static_cast<size_t>(1));
+    }
+    collectAll(domain);
+    ASSERT_EQ(freed.load(), 1);
+    ASSERT_EQ(domain.pendingCount(), static_cast<size_t>(0));
+
+    // Whatever is left is freed with the domain
+    {
+        EpochDomain scoped;
+        scoped.retire(new Counted());
+        scoped.retire(new Counted());
+    }
+    ASSERT_EQ(freed.load(), 3);
+}
+
+TEST_CASE(TestEpochWaitsForOtherReaders) {
+    freed.store(0);
+    EpochDomain domain;
+    std::atomic<int> step{0};
+    std::thread reader([&] {
+        EpochDomain::Guard guard(domain);
+        step.store(1);
+        while (step.load() != 2) {
+            std::this_thread::yield();
+        }
+    });
+    while (step.load() != 1) {
+        std::this_thread::yield();
+    }
+    domain.retire(new Counted());
+    collectAll(domain);
+    ASSERT_EQ(freed.load(), 0);
+
+    step.store(2);
+    reader.join();
+    collectAll(domain);
+    ASSERT_EQ(freed.load(), 1);
+}
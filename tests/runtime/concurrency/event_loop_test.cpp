@@ -0,0 +1,259 @@
+#include "runtime/concurrency/event_loop.h"
+#include "test_runner.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+struct Completion : IoOp {
+    std::atomic<bool> done{false};
+    int worker = -2;
+    int id = 0;
+    std::vector<int>* order = nullptr;
+    Scheduler* scheduler = nullptr;
+    WaitGroup* group = nullptr;
+
+    Completion() : IoOp(&finish) {}
+
+    static void finish(Task* task) {
+        auto* self = static_cast<Completion*>(static_cast<IoOp*>(task));
+        if (self->scheduler) {
+            self->worker = self->scheduler->currentWorker();
+        }
+        if (self->order) {
+            self->order->push_back(self->id);
+        }
+        self->done.store(true, std::memory_order_release);
+        if (self->group) {
+            self->group->done();
+        }
+    }
+};
+
+// Polls until nothing is pending
+void drain(EventLoop& loop) {
+    while (loop.pending() != 0) {
+        loop.poll(-1);
+    }
+}
+
+// Both backends where the platform has them
+std::vector<EventLoop::Options> backends() {
+    std::vector<EventLoop::Options> options(2);
+    options[1].allowIoUring = false;
+    return options;
+}
+
+int makeTempFile() {
+    char path[] = "/tmp/event_loop_testXXXXXX";
+    int fd = mkstemp(path);
+    unlink(path);
+    return fd;
+}
+
+} // namespace
+
+TEST_CASE(TestEventLoopReadsAndWritesFiles) {
+    for (EventLoop::Options options : backends()) {
+        EventLoop loop(options);
+        ASSERT_TRUE(options.allowIoUring || loop.backend() != EventLoop::Backend::IoUring);
+        int fd = makeTempFile();
+        ASSERT_TRUE(fd >= 0);
+
+        // A batch of positional writes, submitted together
+        std::vector<std::string> chunks = {"lang.md ", "examples ", "depend on ", "async I/O"};
+        std::vector<Completion> writes(chunks.size());
+        int64_t offset = 0;
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            loop.write(&writes[i], fd, chunks[i].data(), static_cast<uint32_t>(chunks[i].size()), offset);
+            offset += static_cast<int64_t>(chunks[i].size());
+        }
+        ASSERT_EQ(loop.pending(), chunks.size());
+        drain(loop);
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            ASSERT_TRUE(writes[i].done.load());
+            ASSERT_EQ(writes[i].result, static_cast<int64_t>(chunks[i].size()));
+        }
+
+        char buffer[64] = {};
+        Completion read;
+        loop.read(&read, fd, buffer, sizeof(buffer), 0);
+        drain(loop);
+        ASSERT_EQ(read.result, offset);
+        ASSERT_TRUE(std::string(buffer) == "lang.md examples depend on async I/O");
+
+        // Into a registered buffer
+        std::vector<char> fixed(4096);
+        ASSERT_EQ(loop.registerBuffers({{fixed.data(), fixed.size()}}), 0);
+        Completion fixedRead;
+        loop.readFixed(&fixedRead, fd, 0, 7, 8);
+        drain(loop);
+        ASSERT_EQ(fixedRead.result, 7);
+        ASSERT_TRUE(std::string(static_cast<char*>(loop.registeredBuffer(0)), 7) == "example");
+
+        // Errors come back as -errno
+        Completion bad;
+        loop.read(&bad, -1, buffer, sizeof(buffer), 0);
+        drain(loop);
+        ASSERT_TRUE(bad.result < 0);
+        close(fd);
+    }
+}
+
+TEST_CASE(TestEventLoopWaitsForPipes) {
+    for (EventLoop::Options options : backends()) {
+        EventLoop loop(options);
+        int fds[2];
+        ASSERT_EQ(pipe(fds), 0);
+        char buffer[16] = {};
+        Completion read;
+        loop.read(&read, fds[0], buffer, sizeof(buffer));
+        ASSERT_EQ(loop.poll(0), 0u); // Nothing written yet
+        ASSERT_FALSE(read.done.load());
+
+        // A write from another thread completes the read of a blocked poll
+        std::thread writer([&] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            ssize_t written = ::write(fds[1], "ping", 4);
+            (void)written;
+        });
+        drain(loop);
+        writer.join();
+        ASSERT_EQ(read.result, 4);
+        ASSERT_TRUE(std::string(buffer) == "ping");
+
+        Completion write;
+        loop.write(&write, fds[1], "pong", 4);
+        drain(loop);
+        ASSERT_EQ(write.result, 4);
+        close(fds[0]);
+        close(fds[1]);
+    }
+}
+
+TEST_CASE(TestEventLoopTimers) {
+    for (EventLoop::Options options : backends()) {
+        EventLoop loop(options);
+        std::vector<int> order;
+        std::vector<Completion> sleeps(3);
+        int delays[] = {30, 10, 20};
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 3; ++i) {
+            sleeps[i].id = delays[i];
+            sleeps[i].order = &order;
+            loop.sleep(&sleeps[i], static_cast<uint64_t>(delays[i]));
+        }
+        drain(loop);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        ASSERT_TRUE(elapsed >= std::chrono::milliseconds(30));
+        ASSERT_EQ(order.size(), 3u);
+        ASSERT_EQ(order[0], 10);
+        ASSERT_EQ(order[1], 20);
+        ASSERT_EQ(order[2], 30);
+
+        // wake() interrupts a poll with nothing to deliver
+        std::thread waker([&] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            loop.wake();
+        });
+        ASSERT_EQ(loop.poll(-1), 0u);
+        waker.join();
+    }
+}
+
+TEST_CASE(TestEventLoopConnects) {
+    // db.connect() against a local stand-in
+    for (EventLoop::Options options : backends()) {
+        EventLoop loop(options);
+        int server = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t size = sizeof(address);
+        ASSERT_EQ(bind(server, reinterpret_cast<sockaddr*>(&address), size), 0);
+        ASSERT_EQ(listen(server, 1), 0);
+        ASSERT_EQ(getsockname(server, reinterpret_cast<sockaddr*>(&address), &size), 0);
+
+        int client = socket(AF_INET, SOCK_STREAM, 0);
+        Completion connect;
+        loop.connect(&connect, client, reinterpret_cast<sockaddr*>(&address), size);
+        drain(loop);
+        ASSERT_EQ(connect.result, 0);
+        int accepted = accept(server, nullptr, nullptr);
+        ASSERT_TRUE(accepted >= 0);
+
+        char reply[8] = {};
+        Completion read, write;
+        loop.read(&read, client, reply, sizeof(reply));
+        loop.write(&write, accepted, "ready", 5);
+        drain(loop);
+        ASSERT_EQ(write.result, 5);
+        ASSERT_EQ(read.result, 5);
+        ASSERT_TRUE(std::string(reply) == "ready");
+        close(accepted);
+        close(client);
+        close(server);
+    }
+}
+
+TEST_CASE(TestEventLoopResumesTasksOnWorkers) {
+    for (EventLoop::Options options : backends()) {
+        EventLoop loop(options);
+        int fd = makeTempFile();
+        std::string contents(1000, 'x');
+        ASSERT_EQ(pwrite(fd, contents.data(), contents.size(), 0), static_cast<ssize_t>(contents.size()));
+
+        constexpr int kTasks = 200;
+        std::vector<Completion> reads(kTasks);
+        std::vector<Completion> sleeps(kTasks);
+        std::vector<char> buffers(kTasks * 8);
+        WaitGroup group;
+        group.add(2 * kTasks);
+        {
+            Scheduler scheduler(Scheduler::Options{4, &loop});
+            for (int i = 0; i < kTasks; ++i) {
+                reads[i].scheduler = sleeps[i].scheduler = &scheduler;
+                reads[i].group = sleeps[i].group = &group;
+                // Tasks suspending on a file read and a short sleep
+                scheduler.spawn([&, i] {
+                    loop.read(&reads[i], fd, &buffers[static_cast<size_t>(i) * 8], 8, i);
+                    loop.sleep(&sleeps[i], static_cast<uint64_t>(i % 5));
+                });
+            }
+            scheduler.wait(group);
+        }
+        ASSERT_EQ(loop.pending(), 0u);
+        for (int i = 0; i < kTasks; ++i) {
+            ASSERT_EQ(reads[i].result, 8);
+            // Resumed by a worker, not by some I/O thread
+            ASSERT_TRUE(reads[i].worker >= 0);
+            ASSERT_TRUE(sleeps[i].worker >= 0);
+        }
+        close(fd);
+    }
+}
+
+TEST_CASE(TestSchedulerWaitsForPendingIo) {
+    EventLoop loop;
+    Completion sleep;
+    {
+        Scheduler scheduler(Scheduler::Options{2, &loop});
+        sleep.scheduler = &scheduler;
+        scheduler.spawn([&] { loop.sleep(&sleep, 20); });
+    }
+    // The destructor ran the completion before stopping the workers
+    ASSERT_TRUE(sleep.done.load());
+    ASSERT_TRUE(sleep.worker >= 0);
+}
@@ -0,0 +1,144 @@
+#include "runtime/concurrency/parallel.h"
+#include "test_runner.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+TEST_CASE(TestParallelMapKeepsOrder) {
+    Scheduler scheduler(Scheduler::Options{4});
+    std::vector<int64_t> input(1000000);
+    std::iota(input.begin(), input.end(), 0);
+
+    std::vector<int64_t> squares = parallelMap(scheduler, input, [](int64_t x) { return x * x; });
+    ASSERT_EQ(squares.size(), input.size());
+    bool ordered = true;
+    for (size_t i = 0; i < input.size(); ++i) {
+        ordered = ordered && squares[i] == input[i] * input[i];
+    }
+    ASSERT_TRUE(ordered);
+
+    std::atomic<int64_t> sum{0};
+    parallelForEach(scheduler, input, [&](int64_t x) { sum.fetch_add(x, std::memory_order_relaxed); });
+    ASSERT_EQ(sum.load(), int64_t(999999) * 1000000 / 2);
+
+    // Every index exactly once, whatever the grain
+    std::vector<std::atomic<int>> seen(10007);
+    parallelFor(scheduler, seen.size(), [&](size_t i) { seen[i].fetch_add(1, std::memory_order_relaxed); },
+                ParallelOptions{3, 0});
+    bool once = true;
+    for (auto& count : seen) {
+        once = once && count.load() == 1;
+    }
+    ASSERT_TRUE(once);
+    ASSERT_TRUE(parallelMap(scheduler, std::vector<int>(), [](int x) { return x; }).empty());
+}
+
+TEST_CASE(TestParallelFilterAndReduce) {
+    Scheduler scheduler(Scheduler::Options{4});
+    std::vector<int> input(200000);
+    std::iota(input.begin(), input.end(), 0);
+
+    std::vector<int> multiples = parallelFilter(scheduler, input, [](int x) { return x % 7 == 0; });
+    ASSERT_EQ(multiples.size(), static_cast<size_t>((199999 / 7) + 1));
+    bool ordered = true;
+    for (size_t i = 0; i < multiples.size(); ++i) {
+        ordered = ordered && multiples[i] == static_cast<int>(7 * i);
+    }
+    ASSERT_TRUE(ordered);
+
+    int64_t sum = parallelReduce(scheduler, input, int64_t(0), [](int64_t acc, int x) { return acc + x; },
+                                 [](int64_t a, int64_t b) { return a + b; });
+    ASSERT_EQ(sum, int64_t(199999) * 200000 / 2);
+
+    // Concatenation is not commutative: blocks must be joined in order
+    std::vector<int> digits(5000);
+    for (size_t i = 0; i < digits.size(); ++i) {
+        digits[i] = static_cast<int>(i % 10);
+    }
+    std::string joined = parallelReduce(
+        scheduler, digits, std::string(), [](std::string acc, int d) { return acc += static_cast<char>('0' + d); },
+        [](std::string a, const std::string& b) { return a += b; }, ParallelOptions{16, 0});
+    std::string expected;
+    for (int d : digits) {
+        expected += static_cast<char>('0' + d);
+    }
+    ASSERT_TRUE(joined == expected);
+
+    // any/all: bool partials, one per block, written concurrently
+    auto all = [&](auto pred) {
+        return parallelReduce(scheduler, input, true, [&](bool acc, int x) { return acc && pred(x); },
+                              [](bool a, bool b) { return a && b; }, ParallelOptions{64, 0});
+    };
+    auto any = [&](auto pred) {
+        return parallelReduce(scheduler, input, false, [&](bool acc, int x) { return acc || pred(x); },
+                              [](bool a, bool b) { return a || b; }, ParallelOptions{64, 0});
+    };
+    ASSERT_TRUE(all([](int x) { return x >= 0; }));
+    ASSERT_FALSE(all([](int x) { return x != 150000; }));
+    ASSERT_TRUE(any([](int x) { return x == 199999; }));
+    ASSERT_FALSE(any([](int x) { return x < 0; }));
+
+    // Predicate maps: neighbouring results come from different blocks
+    std::vector<bool> odd = parallelMap(scheduler, input, [](int x) { return x % 2 == 1; }, ParallelOptions{1, 0});
+    ASSERT_EQ(odd.size(), input.size());
+    bool matches = true;
+    for (size_t i = 0; i < odd.size(); ++i) {
+        matches = matches && odd[i] == (i % 2 == 1);
+    }
+    ASSERT_TRUE(matches);
+}
+
+TEST_CASE(TestParallelMapConcurrencyLimit) {
+    // I/O-bound bodies: never more than two in flight, results in order
+    Scheduler scheduler(Scheduler::Options{4});
+    std::vector<int> requests(40);
+    std::iota(requests.begin(), requests.end(), 0);
+    std::atomic<int> inFlight{0};
+    std::atomic<int> peak{0};
+    std::vector<int> responses = parallelMap(scheduler, requests, [&](int request) {
+        int now = inFlight.fetch_add(1) + 1;
+        for (int seen = peak.load(); now > seen && !peak.compare_exchange_weak(seen, now);) {
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        inFlight.fetch_sub(1);
+        return request * 10;
+    }, ParallelOptions{0, 2});
+    ASSERT_TRUE(peak.load() <= 2);
+    bool ordered = true;
+    for (size_t i = 0; i < responses.size(); ++i) {
+        ordered = ordered && responses[i] == static_cast<int>(10 * i);
+    }
+    ASSERT_TRUE(ordered);
+}
+
+TEST_CASE(TestParallelLoopCancelsOnError) {
+    Scheduler scheduler(Scheduler::Options{4});
+    constexpr size_t kCount = 1000000;
+    for (size_t concurrency : {size_t(0), size_t(3)}) {
+        std::atomic<size_t> processed{0};
+        bool threw = false;
+        try {
+            parallelFor(scheduler, kCount, [&](size_t i) {
+                if (i == 100) {
+                    throw std::runtime_error("bad element");
+                }
+                processed.fetch_add(1, std::memory_order_relaxed);
+            }, ParallelOptions{concurrency == 0 ? size_t(0) : size_t(1000), concurrency});
+        } catch (const std::runtime_error& e) {
+            threw = std::string(e.what()) == "bad element";
+        }
+        ASSERT_TRUE(threw);
+        ASSERT_TRUE(processed.load() < kCount - 1);
+    }
+
+    // The scheduler is still usable afterwards
+    std::vector<int> ones(1000, 1);
+    ASSERT_EQ(parallelReduce(scheduler, ones, 0, [](int a, int b) { return a + b; },
+                             [](int a, int b) { return a + b; }),
+              1000);
+}
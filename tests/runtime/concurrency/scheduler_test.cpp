@@ -0,0 +1,131 @@
+#include "runtime/concurrency/scheduler.h"
+#include "test_runner.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <thread>
+
+TEST_CASE(TestSchedulerRunsInjectedTasks) {
+    std::atomic<int64_t> sum{0};
+    WaitGroup group;
+    Scheduler scheduler(Scheduler::Options{4});
+    ASSERT_EQ(scheduler.workerCount(), 4u);
+    ASSERT_EQ(scheduler.currentWorker(), -1);
+    constexpr int kTasks = 100000;
+    group.add(kTasks);
+    for (int i = 0; i < kTasks; ++i) {
+        scheduler.spawn([&, i] {
+            sum.fetch_add(i, std::memory_order_relaxed);
+            group.done();
+        });
+    }
+    scheduler.wait(group);
+    ASSERT_EQ(sum.load(), int64_t(kTasks) * (kTasks - 1) / 2);
+    SchedulerStats stats = scheduler.getStats();
+    ASSERT_EQ(stats.injected, static_cast<uint64_t>(kTasks));
+    ASSERT_EQ(stats.tasksRun, static_cast<uint64_t>(kTasks));
+}
+
+// Spawns a binary tree of tasks `depth` levels deep from inside tasks,
+// counting the leaves
+static void spawnTree(Scheduler& scheduler, WaitGroup& group, std::atomic<int>& leaves, int depth) {
+    if (depth == 0) {
+        leaves.fetch_add(1, std::memory_order_relaxed);
+        group.done();
+        return;
+    }
+    group.add(2);
+    for (int i = 0; i < 2; ++i) {
+        scheduler.spawn([&scheduler, &group, &leaves, depth] { spawnTree(scheduler, group, leaves, depth - 1); });
+    }
+    group.done();
+}
+
+TEST_CASE(TestSchedulerTasksSpawnTasks) {
+    Scheduler scheduler(Scheduler::Options{4});
+    std::atomic<int> leaves{0};
+    WaitGroup group;
+    group.add();
+    scheduler.spawn([&] { spawnTree(scheduler, group, leaves, 16); });
+    scheduler.wait(group);
+    ASSERT_EQ(leaves.load(), 1 << 16);
+    // Only the root came from outside; the rest were pushed on worker deques
+    ASSERT_EQ(scheduler.getStats().injected, 1u);
+}
+
+TEST_CASE(TestSchedulerWaitInsideTask) {
+    // A task waiting for its children keeps its worker busy with other tasks
+    // instead of blocking it, so even one worker makes progress
+    Scheduler scheduler(Scheduler::Options{1});
+    std::atomic<int> children{0};
+    std::atomic<int> worker{-2};
+    WaitGroup outer;
+    outer.add();
+    scheduler.spawn([&] {
+        WaitGroup inner;
+        inner.add(100);
+        for (int i = 0; i < 100; ++i) {
+            scheduler.spawn([&] {
+                children.fetch_add(1);
+                inner.done();
+            });
+        }
+        scheduler.wait(inner);
+        worker.store(scheduler.currentWorker());
+        outer.done();
+    });
+    outer.wait();
+    ASSERT_EQ(children.load(), 100);
+    ASSERT_EQ(worker.load(), 0);
+}
+
+TEST_CASE(TestSchedulerWaitSleepsWhenNothingToSteal) {
+    // A task waiting on a long task running on the other worker has
+    // nothing to help with: it must sleep, not spin its core
+    Scheduler scheduler(Scheduler::Options{2});
+    std::atomic<bool> started{false};
+    WaitGroup slow;
+    slow.add();
+    scheduler.spawn([&] {
+        started.store(true);
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        slow.done();
+    });
+    while (!started.load()) {
+        std::this_thread::yield();
+    }
+    uint64_t parksBefore = scheduler.getStats().parks;
+    std::atomic<double> cpuSeconds{-1.0};
+    WaitGroup waiter;
+    waiter.add();
+    scheduler.spawn([&] {
+        timespec begin;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &begin);
+        scheduler.wait(slow);
+        timespec end;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+        cpuSeconds.store(static_cast<double>(end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) * 1e-9);
+        waiter.done();
+    });
+    waiter.wait();
+    ASSERT_TRUE(slow.finished());
+    ASSERT_TRUE(cpuSeconds.load() >= 0.0 && cpuSeconds.load() < 0.05);
+    ASSERT_TRUE(scheduler.getStats().parks > parksBefore);
+}
+
+TEST_CASE(TestSchedulerDestructorDrainsTasks) {
+    std::atomic<int> count{0};
+    {
+        Scheduler scheduler(Scheduler::Options{3});
+        for (int i = 0; i < 1000; ++i) {
+            scheduler.spawn([&scheduler, &count] {
+                // Spawned while the destructor may already be waiting
+                scheduler.spawn([&count] { count.fetch_add(1); });
+                count.fetch_add(1);
+            });
+        }
+    }
+    ASSERT_EQ(count.load(), 2000);
+}
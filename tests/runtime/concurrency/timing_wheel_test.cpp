@@ -0,0 +1,100 @@
+#include "runtime/concurrency/timing_wheel.h"
+#include "test_runner.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct TestTimer : TimerNode {
+    uint64_t firedAt = 0;
+    bool fired = false;
+};
+
+} // namespace
+
+TEST_CASE(TestTimingWheelFiresAtDeadlines) {
+    TimingWheel wheel;
+    // Deadlines on both sides of every level boundary, and past the top
+    std::vector<uint64_t> deadlines = {1, 5, 63, 64, 65, 100, 4095, 4096, 4097, 262143, 262144, 300000,
+                                       (uint64_t(1) << 24) - 1, (uint64_t(1) << 24) + 5, uint64_t(1) << 30};
+    std::vector<TestTimer> timers(deadlines.size());
+    for (size_t i = 0; i < timers.size(); ++i) {
+        wheel.schedule(&timers[i], deadlines[i]);
+    }
+    ASSERT_EQ(wheel.size(), timers.size());
+    ASSERT_EQ(wheel.nextEvent(), 1u);
+
+    auto fire = [&](TimerNode* node) {
+        auto* timer = static_cast<TestTimer*>(node);
+        timer->fired = true;
+        timer->firedAt = wheel.now();
+    };
+    wheel.advance(100, fire);
+    ASSERT_TRUE(timers[5].fired);
+    ASSERT_FALSE(timers[6].fired);
+    // The next event is never later than the next deadline
+    ASSERT_TRUE(wheel.nextEvent() <= 4095u);
+    wheel.advance(uint64_t(1) << 31, fire);
+    ASSERT_EQ(wheel.size(), 0u);
+    ASSERT_EQ(wheel.nextEvent(), TimingWheel::kNever);
+    for (size_t i = 0; i < timers.size(); ++i) {
+        ASSERT_TRUE(timers[i].fired);
+        ASSERT_EQ(timers[i].firedAt, deadlines[i]);
+    }
+}
+
+TEST_CASE(TestTimingWheelRandomSchedule) {
+    // Timers started at random points, the wheel advanced by random steps
+    TimingWheel wheel(12345);
+    std::mt19937_64 rng(7);
+    std::vector<TestTimer> timers(5000);
+    size_t started = 0;
+    uint64_t end = wheel.now();
+    auto fire = [&](TimerNode* node) {
+        auto* timer = static_cast<TestTimer*>(node);
+        timer->fired = true;
+        timer->firedAt = wheel.now();
+    };
+    while (started < timers.size()) {
+        for (int i = 0; i < 50 && started < timers.size(); ++i) {
+            uint64_t delay = rng() % (rng() % 2 ? 100 : 1000000);
+            wheel.schedule(&timers[started++], wheel.now() + delay);
+            end = std::max(end, wheel.now() + delay);
+        }
+        wheel.advance(wheel.now() + rng() % 5000, fire);
+    }
+    wheel.advance(end, fire);
+    for (const TestTimer& timer : timers) {
+        ASSERT_TRUE(timer.fired);
+        ASSERT_EQ(timer.firedAt, timer.deadline);
+    }
+}
+
+TEST_CASE(TestTimingWheelCancelAndReschedule) {
+    TimingWheel wheel;
+    TestTimer a, b, c;
+    wheel.schedule(&a, 10);
+    wheel.schedule(&b, 5000);
+    wheel.schedule(&c, 0); // Already due
+    wheel.cancel(&b);
+    wheel.cancel(&b); // No longer pending: ignored
+    ASSERT_EQ(wheel.size(), 2u);
+    ASSERT_EQ(wheel.nextEvent(), 0u);
+
+    int fired = 0;
+    wheel.advance(0, [&](TimerNode* node) {
+        ASSERT_TRUE(node == &c);
+        ++fired;
+        // Timers may be started from fire()
+        wheel.schedule(&b, 20);
+    });
+    ASSERT_EQ(fired, 1);
+    std::vector<TimerNode*> order;
+    wheel.advance(10000, [&](TimerNode* node) { order.push_back(node); });
+    ASSERT_EQ(order.size(), 2u);
+    ASSERT_TRUE(order[0] == &a);
+    ASSERT_TRUE(order[1] == &b);
+}
@@ -0,0 +1,70 @@
+#include "runtime/concurrency/work_stealing_deque.h"
+#include "test_runner.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+TEST_CASE(TestDequeOwnerLifoThiefFifo) {
+    WorkStealingDeque<int*> deque(4);
+    std::vector<int> items(100);
+    ASSERT_TRUE(deque.pop() == nullptr);
+    ASSERT_TRUE(deque.steal() == nullptr);
+    // Grows past the initial capacity
+    for (int& item : items) {
+        deque.push(&item);
+    }
+    ASSERT_EQ(deque.size(), 100u);
+    ASSERT_TRUE(deque.pop() == &items[99]);
+    ASSERT_TRUE(deque.steal() == &items[0]);
+    ASSERT_TRUE(deque.steal() == &items[1]);
+    ASSERT_TRUE(deque.pop() == &items[98]);
+    for (int i = 97; i >= 2; --i) {
+        ASSERT_TRUE(deque.pop() == &items[i]);
+    }
+    ASSERT_TRUE(deque.empty());
+    ASSERT_TRUE(deque.pop() == nullptr);
+}
+
+TEST_CASE(TestDequeConcurrentSteals) {
+    // The owner pushes and pops while thieves steal: every item must be
+    // taken exactly once
+    constexpr int kItems = 200000;
+    constexpr int kThieves = 3;
+    WorkStealingDeque<int*> deque(8);
+    std::vector<int> items(kItems);
+    std::vector<std::atomic<int>> taken(kItems);
+    std::atomic<bool> done{false};
+    auto take = [&](int* item) { taken[static_cast<size_t>(item - items.data())].fetch_add(1); };
+
+    std::vector<std::thread> thieves;
+    for (int t = 0; t < kThieves; ++t) {
+        thieves.emplace_back([&] {
+            while (!done.load()) {
+                if (int* item = deque.steal()) {
+                    take(item);
+                }
+            }
+        });
+    }
+    for (int i = 0; i < kItems; ++i) {
+        deque.push(&items[i]);
+        if (i % 3 == 0) {
+            if (int* item = deque.pop()) {
+                take(item);
+            }
+        }
+    }
+    while (int* item = deque.pop()) {
+        take(item);
+    }
+    done.store(true);
+    for (std::thread& thief : thieves) {
+        thief.join();
+    }
+    int wrong = 0;
+    for (std::atomic<int>& count : taken) {
+        wrong += count.load() != 1;
+    }
+    ASSERT_EQ(wrong, 0);
+}
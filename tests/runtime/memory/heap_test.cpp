@@ -0,0 +1,350 @@
+#include "compiler/codegen/bytecode_builder.h"
+#include "runtime/concurrency/scheduler.h"
+#include "runtime/memory/heap.h"
+#include "runtime/vm/object.h"
+#include "runtime/vm/vm.h"
+#include "test_runner.h"
+
+#include <string>
+
+static constexpr size_t kSmallNursery = 64 * 1024;
+
+// Allocates short-lived strings until the nursery has been filled `times` times
+static void churn(Heap& heap, int times) {
+    for (size_t bytes = 0; bytes < kSmallNursery * times; bytes += 64) {
+        heap.allocateString(40);
+    }
+}
+
+TEST_CASE(TestHeapMinorCollectionPromotesSurvivors) {
+    VM vm(kSmallNursery);
+    Heap& heap = vm.getHeap();
+    Object* obj = heap.allocateObject(vm.getShapes().root());
+    setProperty(heap, vm.getShapes(), obj, vm.intern("name"), Value::object(heap.allocateString("survivor")));
+    ASSERT_TRUE(heap.isYoung(obj));
+
+    Rooted rooted(heap, Value::object(obj));
+    churn(heap, 2);
+    ASSERT_TRUE(heap.collectionRequested());
+    heap.collect();
+
+    ASSERT_EQ(heap.getStats().minorCollections, 1u);
+    ASSERT_EQ(heap.nurseryBytesUsed(), 0u);
+    Object* moved = asPlainObject(rooted.get());
+    ASSERT_NE(moved, obj);
+    ASSERT_FALSE(heap.isYoung(moved));
+    Value name = getProperty(moved, vm.intern("name"));
+    ASSERT_FALSE(heap.isYoung(name.asObject()));
+    ASSERT_EQ(std::string(asString(name)->view()), "survivor");
+}
+
+TEST_CASE(TestHeapWriteBarrierRemembersOldToYoungStores) {
+    VM vm(kSmallNursery);
+    Heap& heap = vm.getHeap();
+    Rooted rooted(heap, Value::object(heap.allocateObject(vm.getShapes().root())));
+    heap.collectMinor();
+    Object* old = asPlainObject(rooted.get());
+    ASSERT_FALSE(heap.isYoung(old));
+
+    // The only reference to these young strings is from the old object,
+    // in both an inline and an overflow slot
+    const char* keys[] = {"a", "b", "c", "d", "e", "f"};
+    for (const char* key : keys) {
+        setProperty(heap, vm.getShapes(), old, vm.intern(key), Value::object(heap.allocateString(key)));
+    }
+    heap.collectMinor();
+    for (const char* key : keys) {
+        Value value = getProperty(old, vm.intern(key));
+        ASSERT_FALSE(heap.isYoung(value.asObject()));
+        ASSERT_EQ(std::string(asString(value)->view()), key);
+    }
+}
+
+TEST_CASE(TestHeapMajorCollectionReclaimsGarbage) {
+    VM vm(kSmallNursery);
+    Heap& heap = vm.getHeap();
+    Rooted kept(heap, Value::object(heap.allocateString("kept")));
+    for (int i = 0; i < 1000; ++i) {
+        heap.allocateTenuredString(std::string(256, 'x'));
+        Rooted garbage(heap, Value::object(heap.allocateString(128)));
+    }
+    size_t before = heap.oldGenerationBytes();
+    heap.collectMajor();
+
+    ASSERT_EQ(heap.getStats().majorCollections, 1u);
+    ASSERT_TRUE(heap.getStats().bytesFreed > 0);
+    ASSERT_TRUE(heap.oldGenerationBytes() < before);
+    ASSERT_EQ(std::string(asString(kept.get())->view()), "kept");
+
+    // Interned strings and adopted functions are roots
+    ASSERT_EQ(std::string(vm.intern("kept")->view()), "kept");
+    size_t old = heap.oldGenerationBytes();
+    heap.collectMajor();
+    ASSERT_EQ(heap.oldGenerationBytes(), old);
+}
+
+TEST_CASE(TestHeapCollectsWhileScriptsRun) {
+    // head = null; for (i = 0; i < n; i = i + 1) { o = {}; o.next = head;
+    // o.value = i; t = {}; t.label = "item" + i; head = o } ... then sums
+    // the list from a second loop. Only the list survives; t churns.
+    VM vm(kSmallNursery);
+    String* next = vm.intern("next");
+    String* value = vm.intern("value");
+    String* label = vm.intern("label");
+    BytecodeBuilder b("build", 1);
+    auto loop = b.newLabel();
+    auto sumLoop = b.newLabel();
+    auto done = b.newLabel();
+    b.emit(Opcode::LoadNull, 1);  // head
+    b.emit(Opcode::LoadInt, 2, 0); // i
+    b.emit(Opcode::LoadInt, 3, 1);
+    b.emit(Opcode::LoadInt, 8, 0);  // sum
+    b.emit(Opcode::LoadConst, 7, b.addConstant(Value::object(vm.getHeap().allocateString("item"))));
+    b.bind(loop);
+    b.emit(Opcode::Lt, 4, 2, 0);
+    b.emitJumpIfFalse(4, sumLoop);
+    b.emit(Opcode::NewObject, 5);
+    b.emit(Opcode::SetProp, 5, b.addPropertyCache(next), 1);
+    b.emit(Opcode::SetProp, 5, b.addPropertyCache(value), 2);
+    b.emit(Opcode::Add, 6, 7, 2);
+    b.emit(Opcode::NewObject, 9);
+    b.emit(Opcode::SetProp, 9, b.addPropertyCache(label), 6);
+    b.emit(Opcode::Move, 1, 5);
+    b.emit(Opcode::Add, 2, 2, 3);
+    b.emitJump(loop);
+    // while (head != null) { sum = sum + head.value; head = head.next }
+    b.bind(sumLoop);
+    b.emit(Opcode::LoadNull, 4);
+    b.emit(Opcode::Eq, 4, 1, 4);
+    b.emitJumpIfTrue(4, done);
+    b.emit(Opcode::GetProp, 6, 1, b.addPropertyCache(value));
+    b.emit(Opcode::Add, 8, 8, 6);
+    b.emit(Opcode::GetProp, 1, 1, b.addPropertyCache(next));
+    b.emitJump(sumLoop);
+    b.bind(done);
+    b.emit(Opcode::Return, 8);
+    Value build = Value::object(vm.adopt(b.finish()));
+
+    ASSERT_EQ(vm.call(build, {Value::integer(20000)}).asInt(), 199990000);
+    const GcStats& stats = vm.getHeap().getStats();
+    ASSERT_TRUE(stats.minorCollections > 10);
+    // The temporaries died young; only the list nodes were promoted
+    ASSERT_TRUE(stats.bytesPromoted < vm.getHeap().bytesAllocated() / 2);
+}
+
+TEST_CASE(TestHeapIncrementalMarkingKeepsSnapshot) {
+    VM vm(kSmallNursery);
+    Heap& heap = vm.getHeap();
+    ShapeTree& shapes = vm.getShapes();
+    String* key = vm.intern("x");
+    Rooted holder(heap, Value::object(heap.allocateObject(shapes.root())));
+    setProperty(heap, shapes, asPlainObject(holder.get()), key, Value::object(heap.allocateString("moved")));
+    heap.allocateTenuredString(std::string(256, 'g')); // Garbage
+    heap.collectMinor();
+
+    heap.requestMajorCollection();
+    ASSERT_TRUE(heap.collectionRequested());
+    heap.collect();
+    ASSERT_TRUE(heap.getPhase() == GcPhase::Marking);
+    ASSERT_TRUE(heap.isMarking());
+
+    // Move the string from the (not yet traced) old holder into a young
+    // object the collector never scans; the pre-write barrier must keep it
+    Object* old = asPlainObject(holder.get());
+    Rooted young(heap, Value::object(heap.allocateObject(shapes.root())));
+    setProperty(heap, shapes, asPlainObject(young.get()), key, getProperty(old, key));
+    setProperty(heap, shapes, old, key, Value::null());
+    // Allocated black while marking
+    Rooted tenured(heap, Value::object(heap.allocateTenuredString("tenured")));
+
+    int slices = 1;
+    while (heap.getPhase() != GcPhase::Idle) {
+        heap.collect();
+        ++slices;
+    }
+    ASSERT_TRUE(slices >= 3); // Start, marking, sweeping
+    ASSERT_FALSE(heap.isMarking());
+    ASSERT_EQ(heap.getStats().majorCollections, 1u);
+    ASSERT_TRUE(heap.getStats().bytesFreed >= 256);
+    Value moved = getProperty(asPlainObject(young.get()), key);
+    ASSERT_TRUE(moved.asObject()->kind == ObjectKind::String);
+    ASSERT_EQ(std::string(asString(moved)->view()), "moved");
+    ASSERT_EQ(std::string(asString(tenured.get())->view()), "tenured");
+
+    // Both survive the next full collection too
+    heap.collectMajor();
+    ASSERT_EQ(std::string(asString(getProperty(asPlainObject(young.get()), key))->view()), "moved");
+    ASSERT_EQ(std::string(asString(tenured.get())->view()), "tenured");
+}
+
+// Builds a forest under `root` in the old generation: wide arrays of
+// strings and long chains, with every other tree left unreachable
+static void buildForest(Heap& heap, Rooted& root) {
+    constexpr uint32_t kTrees = 256;
+    ValueArray* forest = heap.allocateValueArray(kTrees);
+    root.set(Value::object(forest));
+    for (uint32_t t = 0; t < kTrees; ++t) {
+        HeapObject* tree;
+        if (t % 4 < 2) {
+            ValueArray* leaves = heap.allocateValueArray(64);
+            for (uint32_t i = 0; i < 64; ++i) {
+                leaves->items()[i] = Value::object(heap.allocateString("leaf " + std::to_string(t * 64 + i)));
+                heap.writeBarrier(leaves, leaves->items()[i]);
+            }
+            tree = leaves;
+        } else {
+            // A chain is marked one link at a time, whoever holds it
+            Value next = Value::null();
+            for (uint32_t i = 0; i < 64; ++i) {
+                ValueArray* link = heap.allocateValueArray(2);
+                link->items()[0] = Value::object(heap.allocateString("link " + std::to_string(t * 64 + i)));
+                link->items()[1] = next;
+                heap.writeBarrier(link, link->items()[0]);
+                heap.writeBarrier(link, next);
+                next = Value::object(link);
+            }
+            tree = next.asObject();
+        }
+        forest->items()[t] = Value::object(tree);
+        heap.writeBarrier(forest, forest->items()[t]);
+    }
+    heap.collectMinor();
+    forest = static_cast<ValueArray*>(root.get().asObject());
+    for (uint32_t t = 1; t < kTrees; t += 2) {
+        forest->items()[t] = Value::null();
+    }
+}
+
+static bool forestIntact(Rooted& root) {
+    auto* forest = static_cast<ValueArray*>(root.get().asObject());
+    for (uint32_t t = 0; t < forest->length; t += 2) {
+        HeapObject* tree = forest->items()[t].asObject();
+        for (uint32_t i = 0; i < 64; ++i) {
+            std::string expected;
+            Value leaf;
+            auto* array = static_cast<ValueArray*>(tree);
+            if (t % 4 < 2) {
+                expected = "leaf " + std::to_string(t * 64 + i);
+                leaf = array->items()[i];
+            } else {
+                expected = "link " + std::to_string(t * 64 + 63 - i);
+                leaf = array->items()[0];
+                tree = array->items()[1].isObject() ? array->items()[1].asObject() : nullptr;
+            }
+            if (std::string(asString(leaf)->view()) != expected) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+TEST_CASE(TestHeapParallelMajorCollection) {
+    Heap serial;
+    Rooted serialRoot(serial, Value::null());
+    buildForest(serial, serialRoot);
+    serial.collectMajor();
+
+    Scheduler scheduler(Scheduler::Options{4, nullptr});
+    Heap parallel;
+    parallel.setScheduler(&scheduler);
+    Rooted parallelRoot(parallel, Value::null());
+    buildForest(parallel, parallelRoot);
+    parallel.collectMajor();
+
+    // The workers reach exactly what a single marker does
+    ASSERT_EQ(serial.getStats().parallelSlices, 0u);
+    ASSERT_TRUE(parallel.getStats().parallelSlices > 0);
+    ASSERT_TRUE(parallel.getStats().bytesFreed > 0);
+    ASSERT_EQ(parallel.getStats().bytesFreed, serial.getStats().bytesFreed);
+    ASSERT_EQ(parallel.oldGenerationBytes(), serial.oldGenerationBytes());
+    ASSERT_TRUE(forestIntact(parallelRoot));
+
+    // Nothing is marked twice or left marked: a second cycle frees nothing
+    size_t freed = parallel.getStats().bytesFreed;
+    parallel.collectMajor();
+    ASSERT_EQ(parallel.getStats().bytesFreed, freed);
+    ASSERT_TRUE(forestIntact(parallelRoot));
+}
+
+TEST_CASE(TestHeapParallelMarkingSlices) {
+    Scheduler scheduler(Scheduler::Options{4, nullptr});
+    Heap heap;
+    heap.setScheduler(&scheduler);
+    Rooted root(heap, Value::null());
+    buildForest(heap, root);
+    size_t before = heap.oldGenerationBytes();
+
+    // Incremental cycle: slices stop at their budget and leave the rest grey
+    heap.requestMajorCollection();
+    int slices = 0;
+    do {
+        heap.collect();
+        ++slices;
+    } while (heap.getPhase() != GcPhase::Idle);
+    ASSERT_TRUE(slices >= 3);
+    ASSERT_EQ(heap.getStats().majorCollections, 1u);
+    ASSERT_TRUE(heap.oldGenerationBytes() < before);
+    ASSERT_TRUE(forestIntact(root));
+}
+
+TEST_CASE(TestHeapSuspensionDefersCollection) {
+    VM vm(kSmallNursery);
+    Heap& heap = vm.getHeap();
+    heap.suspendCollection();
+    heap.suspendCollection();
+    churn(heap, 2);
+    ASSERT_FALSE(heap.collectionRequested());
+    heap.collect();
+    ASSERT_EQ(heap.getStats().minorCollections, 0u);
+
+    heap.resumeCollection();
+    ASSERT_FALSE(heap.collectionRequested());
+    heap.resumeCollection();
+    ASSERT_TRUE(heap.collectionRequested());
+    heap.collect();
+    ASSERT_EQ(heap.getStats().minorCollections, 1u);
+}
+
+TEST_CASE(TestHeapWildFunctionSuspendsCollection) {
+    VM vm(kSmallNursery);
+    // alloc(n): for (i = 0; i < n; i = i + 1) { o = {} }
+    BytecodeBuilder a("alloc", 1);
+    auto loop = a.newLabel();
+    auto done = a.newLabel();
+    a.emit(Opcode::LoadInt, 1, 0);
+    a.emit(Opcode::LoadInt, 2, 1);
+    a.bind(loop);
+    a.emit(Opcode::Lt, 3, 1, 0);
+    a.emitJumpIfFalse(3, done);
+    a.emit(Opcode::NewObject, 4);
+    a.emit(Opcode::Add, 1, 1, 2);
+    a.emitJump(loop);
+    a.bind(done);
+    a.emit(Opcode::Return, 1);
+    Value alloc = Value::object(vm.adopt(a.finish()));
+
+    // wild function run(f, n) { return f(n) }
+    BytecodeBuilder w("run", 2);
+    w.setWild();
+    w.emit(Opcode::Move, 3, 0);
+    w.emit(Opcode::Move, 4, 1);
+    w.emit(Opcode::Call, 2, 3, 1);
+    w.emit(Opcode::Return, 2);
+    Value run = Value::object(vm.adopt(w.finish()));
+
+    const GcStats& stats = vm.getHeap().getStats();
+    ASSERT_EQ(vm.call(run, {alloc, Value::integer(20000)}).asInt(), 20000);
+    ASSERT_EQ(stats.minorCollections, 0u);
+    ASSERT_FALSE(vm.getHeap().isCollectionSuspended());
+    ASSERT_TRUE(vm.getHeap().collectionRequested());
+
+    // Outside the wild region the pending collection runs
+    ASSERT_EQ(vm.call(alloc, {Value::integer(20000)}).asInt(), 20000);
+    ASSERT_TRUE(stats.minorCollections > 0);
+
+    // Every minor collection's pause was recorded
+    ASSERT_EQ(stats.minorPauses.count(), stats.minorCollections);
+    ASSERT_TRUE(stats.minorPauses.max().count() > 0);
+    ASSERT_TRUE(stats.minorPauses.percentileMicros(0.5) <= stats.minorPauses.percentileMicros(1.0));
+}
@@ -0,0 +1,144 @@
+#include "compiler/codegen/bytecode_builder.h"
+#include "runtime/memory/region.h"
+#include "runtime/vm/vm.h"
+#include "runtime/vm/wild_object.h"
+#include "test_runner.h"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE(TestRegionNestedScopesAndCleanupOrder) {
+    RegionArena arena;
+    std::vector<int> order;
+    auto record = [](void* p) {
+        auto* entry = static_cast<std::pair<std::vector<int>*, int>*>(p);
+        entry->first->push_back(entry->second);
+    };
+    std::pair<std::vector<int>*, int> entries[] = {{&order, 1}, {&order, 2}, {&order, 3}};
+
+    arena.enter();
+    void* outer = arena.allocate(24);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(outer) % 16, 0u);
+    std::memset(outer, 0xAB, 24);
+    arena.addCleanup(record, &entries[0]);
+    arena.enter();
+    void* inner = arena.allocate(100);
+    arena.addCleanup(record, &entries[1]);
+    arena.addCleanup(record, &entries[2]);
+    ASSERT_EQ(arena.depth(), 2u);
+    ASSERT_EQ(arena.bytesInUse(), 32u + 112u + 3 * 32u); // Cleanups live in the region too
+    arena.exit();
+    ASSERT_TRUE(order == (std::vector<int>{3, 2}));
+
+    // The inner scope's memory is reused; the outer allocation is intact
+    arena.enter();
+    ASSERT_EQ(arena.allocate(100), inner);
+    arena.exit();
+    ASSERT_EQ(static_cast<unsigned char*>(outer)[23], 0xABu);
+    arena.exit();
+    ASSERT_TRUE(order == (std::vector<int>{3, 2, 1}));
+    ASSERT_EQ(arena.bytesInUse(), 0u);
+}
+
+TEST_CASE(TestRegionReusedAcrossIterations) {
+    RegionArena arena;
+    arena.enter();
+    arena.allocate(64);
+    size_t chunks = 0;
+    for (int iteration = 0; iteration < 100; ++iteration) {
+        arena.enter();
+        for (int i = 0; i < 2000; ++i) {
+            arena.allocate(48); // Spans a couple of chunks
+        }
+        arena.allocate(RegionArena::kChunkSize * 2); // Own chunk, freed at exit
+        if (iteration == 0) {
+            chunks = arena.chunkCount();
+        }
+        ASSERT_EQ(arena.chunkCount(), chunks);
+        arena.exit();
+    }
+    ASSERT_EQ(arena.bytesInUse(), 64u);
+    arena.exit();
+
+    bool threw = false;
+    try {
+        arena.allocate(8);
+    } catch (const std::logic_error&) {
+        threw = true;
+    }
+    ASSERT_TRUE(threw);
+}
+
+TEST_CASE(TestRegionReferencedObjectsOutliveTheirScope) {
+    RegionArena arena;
+    arena.enter();
+    WildObject* kept = WildObject::createScoped(arena, 32);
+    WildObject* dropped = WildObject::createScoped(arena, 32);
+    kept->retain();
+    std::memset(kept->data(), 7, 32);
+    arena.exit();
+
+    // The referenced object's chunk was handed over to it
+    ASSERT_EQ(arena.chunkCount(), 0u);
+    ASSERT_TRUE(kept->isDestroyed());
+    ASSERT_EQ(kept->data()[31], 7);
+    (void)dropped;
+
+    // The next scope starts on fresh memory
+    arena.enter();
+    WildObject* next = WildObject::createScoped(arena, 32);
+    ASSERT_NE(next, kept);
+    // The last release (from any thread) frees the old chunk
+    std::thread([kept] { kept->release(); }).join();
+    arena.exit();
+    ASSERT_EQ(arena.chunkCount(), 1u);
+}
+
+TEST_CASE(TestRegionOpcodes) {
+    VM vm;
+    // loop(n) { while (n > 0) { wild(scope) var a, b; destroy a; n = n - 1 } }
+    BytecodeBuilder b("loop", 1);
+    auto head = b.newLabel();
+    auto done = b.newLabel();
+    b.emit(Opcode::LoadInt, 1, 0);
+    b.emit(Opcode::LoadInt, 2, 1);
+    b.bind(head);
+    b.emit(Opcode::Gt, 3, 0, 1);
+    b.emitJumpIfFalse(3, done);
+    b.emit(Opcode::EnterRegion);
+    b.emit(Opcode::NewScopedWild, 4, 256);
+    b.emit(Opcode::NewScopedWild, 5, 256);
+    b.emit(Opcode::Destroy, 4); // Explicit destroy before the scope ends
+    b.emit(Opcode::ExitRegion);
+    b.emit(Opcode::Sub, 0, 0, 2);
+    b.emitJump(head);
+    b.bind(done);
+    b.emit(Opcode::ReturnUndefined);
+    Value loop = Value::object(vm.adopt(b.finish()));
+    vm.call(loop, {Value::integer(1000)});
+    ASSERT_EQ(vm.getRegions().depth(), 0u);
+    ASSERT_EQ(vm.getRegions().chunkCount(), 1u);
+    ASSERT_EQ(vm.getWildHeap().getStats().liveObjects, 0u);
+
+    // An error leaves the scopes its frames opened
+    BytecodeBuilder f("fail", 0);
+    f.emit(Opcode::EnterRegion);
+    f.emit(Opcode::NewScopedWild, 0, 8);
+    f.emit(Opcode::Destroy, 0);
+    f.emit(Opcode::LoadInt, 1, 1);
+    f.emit(Opcode::Destroy, 1);
+    f.emit(Opcode::ExitRegion);
+    Value fail = Value::object(vm.adopt(f.finish()));
+    std::string error;
+    try {
+        vm.call(fail, {});
+    } catch (const RuntimeError& e) {
+        error = e.what();
+    }
+    ASSERT_EQ(error, "Only wild objects can be destroyed");
+    ASSERT_EQ(vm.getRegions().depth(), 0u);
+}
@@ -0,0 +1,156 @@
+#include "runtime/memory/wild_heap.h"
+#include "test_runner.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <thread>
+#include <vector>
+
+TEST_CASE(TestWildHeapSizeClasses) {
+    for (size_t bytes = 1; bytes <= WildHeap::kMaxSmallSize; ++bytes) {
+        size_t sizeClass = WildHeap::sizeClassOf(bytes);
+        ASSERT_TRUE(sizeClass < WildHeap::kSizeClasses);
+        // The smallest class that fits
+        ASSERT_TRUE(WildHeap::classSize(sizeClass) >= bytes);
+        ASSERT_TRUE(sizeClass == 0 || WildHeap::classSize(sizeClass - 1) < bytes);
+    }
+    ASSERT_EQ(WildHeap::classSize(0), 16u);
+    ASSERT_EQ(WildHeap::classSize(4), 80u);
+    ASSERT_EQ(WildHeap::classSize(WildHeap::kSizeClasses - 1), WildHeap::kMaxSmallSize);
+}
+
+TEST_CASE(TestWildHeapAllocateAndReuse) {
+    WildHeap heap;
+    std::vector<void*> objects;
+    for (int i = 0; i < 1000; ++i) {
+        void* p = heap.allocate(40);
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(p) % 16, 0u);
+        ASSERT_EQ(WildHeap::usableSize(p), 48u);
+        std::memset(p, i & 0xFF, 40);
+        objects.push_back(p);
+    }
+    ASSERT_EQ(std::set<void*>(objects.begin(), objects.end()).size(), objects.size());
+    WildHeapStats stats = heap.getStats();
+    ASSERT_EQ(stats.liveObjects, 1000u);
+    ASSERT_EQ(stats.liveBytes, 48000u);
+    ASSERT_TRUE(stats.mappedBytes >= WildHeap::kSegmentSize);
+    ASSERT_TRUE(stats.fragmentation() < 0.5);
+
+    void* last = objects.back();
+    heap.free(last);
+    ASSERT_EQ(heap.allocate(33), last); // Same class, most recently freed slot first
+
+    for (void* p : objects) {
+        heap.free(p);
+    }
+    heap.free(nullptr);
+    stats = heap.getStats();
+    ASSERT_EQ(stats.liveObjects, 0u);
+    ASSERT_EQ(stats.liveBytes, 0u);
+}
+
+TEST_CASE(TestWildHeapLargeObjects) {
+    WildHeap heap;
+    size_t bytes = WildHeap::kMaxSmallSize * 4;
+    auto* p = static_cast<char*>(heap.allocate(bytes));
+    ASSERT_TRUE(WildHeap::usableSize(p) >= bytes);
+    std::memset(p, 0x5A, bytes);
+    WildHeapStats stats = heap.getStats();
+    ASSERT_EQ(stats.liveObjects, 1u);
+    ASSERT_TRUE(stats.largeBytes >= bytes);
+    heap.free(p);
+    stats = heap.getStats();
+    ASSERT_EQ(stats.largeBytes, 0u);
+    ASSERT_EQ(stats.mappedBytes, 0u);
+}
+
+TEST_CASE(TestWildHeapCrossThreadFrees) {
+    WildHeap heap;
+    std::vector<void*> objects;
+    for (int i = 0; i < 4000; ++i) {
+        objects.push_back(heap.allocate(64));
+    }
+    std::set<void*> original(objects.begin(), objects.end());
+
+    // Another thread frees everything; its batches reach the slabs once
+    // flushed (or when the thread exits)
+    std::thread freer([&] {
+        for (void* p : objects) {
+            heap.free(p);
+        }
+    });
+    freer.join();
+    ASSERT_EQ(heap.getStats().liveObjects, 0u);
+    ASSERT_TRUE(heap.getStats().slabBytes > WildHeap::kSlabSize);
+
+    // Slabs the remote frees emptied go back to the pool; only the active
+    // one stays with the owner
+    heap.flushThreadCache();
+    ASSERT_EQ(heap.getStats().slabBytes, WildHeap::kSlabSize);
+
+    // The owner reclaims the remotely freed slots instead of mapping more
+    // (after using up the never-touched tail of its active slab)
+    size_t mapped = heap.getStats().mappedBytes;
+    size_t reused = 0;
+    for (int i = 0; i < 4000; ++i) {
+        reused += original.count(heap.allocate(64));
+    }
+    ASSERT_TRUE(reused > 3000);
+    ASSERT_EQ(heap.getStats().mappedBytes, mapped);
+}
+
+TEST_CASE(TestWildHeapConcurrentProducersAndConsumers) {
+    WildHeap heap;
+    constexpr int kThreads = 4;
+    constexpr int kPerThread = 20000;
+    std::vector<std::vector<void*>> produced(kThreads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < kPerThread; ++i) {
+                auto* p = static_cast<uint32_t*>(heap.allocate(16 + (i % 7) * 24));
+                *p = static_cast<uint32_t>(t * kPerThread + i);
+                produced[t].push_back(p);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+    // Each thread frees another thread's objects
+    std::atomic<bool> intact{true};
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t] {
+            const auto& victims = produced[(t + 1) % kThreads];
+            int owner = (t + 1) % kThreads;
+            for (int i = 0; i < kPerThread; ++i) {
+                if (*static_cast<uint32_t*>(victims[i]) != static_cast<uint32_t>(owner * kPerThread + i)) {
+                    intact = false;
+                }
+                heap.free(victims[i]);
+            }
+            heap.flushThreadCache();
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    ASSERT_TRUE(intact);
+    ASSERT_EQ(heap.getStats().liveObjects, 0u);
+}
+
+TEST_CASE(TestWildHeapHugePageOption) {
+    // Falls back to ordinary pages when none are reserved
+    WildHeap::Options options;
+    options.hugePages = true;
+    WildHeap heap(options);
+    void* p = heap.allocate(100);
+    std::memset(p, 1, 100);
+    WildHeapStats stats = heap.getStats();
+    ASSERT_TRUE(stats.mappedBytes >= WildHeap::kSegmentSize);
+    ASSERT_TRUE(stats.hugePageSegments <= 1);
+    heap.free(p);
+}
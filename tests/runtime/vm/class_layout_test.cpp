@@ -0,0 +1,225 @@
+#include "compiler/codegen/bytecode_builder.h"
+#include "runtime/vm/class_layout.h"
+#include "runtime/vm/object.h"
+#include "runtime/vm/vm.h"
+#include "test_runner.h"
+
+#include <stdexcept>
+#include <string>
+
+TEST_CASE(TestClassLayoutPacksFields) {
+    VM vm;
+    const ClassLayout* point = vm.defineClass("Point", {{"visible", FieldType::Boolean},
+                                                        {"x", FieldType::Int32},
+                                                        {"label", FieldType::Any},
+                                                        {"weight", FieldType::Float64},
+                                                        {"y", FieldType::Int32}});
+    ASSERT_EQ(point->fieldCount(), 5u);
+    ASSERT_EQ(point->fieldIndex(vm.intern("label")), 2);
+    ASSERT_EQ(point->fieldIndex(vm.intern("z")), -1);
+
+    // Any, then Float64, Int32 and Boolean fields; no padding in between
+    uint32_t base = sizeof(Instance);
+    ASSERT_EQ(point->field(2).offset, base);
+    ASSERT_EQ(point->field(3).offset, base + 8);
+    ASSERT_EQ(point->field(1).offset, base + 16);
+    ASSERT_EQ(point->field(4).offset, base + 20);
+    ASSERT_EQ(point->field(0).offset, base + 24);
+    ASSERT_EQ(point->fieldBytes(), 32u);
+    ASSERT_EQ(point->valueFieldCount(), 1u);
+
+    bool threw = false;
+    try {
+        vm.defineClass("Twice", {{"a", FieldType::Any}, {"a", FieldType::Int32}});
+    } catch (const std::logic_error&) {
+        threw = true;
+    }
+    ASSERT_TRUE(threw);
+
+    // New instances start out zeroed
+    Instance* instance = vm.getHeap().allocateInstance(point);
+    ASSERT_TRUE(loadField(instance, point->field(2)).isUndefined());
+    ASSERT_EQ(loadField(instance, point->field(1)).asInt(), 0);
+    ASSERT_EQ(loadField(instance, point->field(3)).toNumber(), 0.0);
+    ASSERT_FALSE(loadField(instance, point->field(0)).asBoolean());
+}
+
+TEST_CASE(TestClassFieldAccess) {
+    // f(n) { p = new Point; p.x = n; p.weight = 0.5; p.label = "pt"; p.extra = n;
+    //        return p.x + p.weight + p.extra }
+    VM vm;
+    const ClassLayout* point = vm.defineClass("Point", {{"x", FieldType::Int32},
+                                                        {"weight", FieldType::Float64},
+                                                        {"label", FieldType::Any}});
+    BytecodeBuilder b("f", 1);
+    b.emit(Opcode::NewInstance, 1, b.addClass(point));
+    b.emit(Opcode::SetField, 1, b.addFieldRef(point, vm.intern("x")), 0);
+    b.emit(Opcode::LoadConst, 2, b.addConstant(Value::number(0.5)));
+    b.emit(Opcode::SetField, 1, b.addFieldRef(point, vm.intern("weight")), 2);
+    b.emit(Opcode::LoadConst, 2, b.addConstant(Value::object(vm.intern("pt"))));
+    b.emit(Opcode::SetField, 1, b.addFieldRef(point, vm.intern("label")), 2);
+    b.emit(Opcode::SetProp, 1, b.addPropertyCache(vm.intern("extra")), 0);
+    b.emit(Opcode::GetField, 3, 1, b.addFieldRef(point, vm.intern("x")));
+    b.emit(Opcode::GetField, 4, 1, b.addFieldRef(point, vm.intern("weight")));
+    b.emit(Opcode::Add, 3, 3, 4);
+    b.emit(Opcode::GetProp, 4, 1, b.addPropertyCache(vm.intern("extra")));
+    b.emit(Opcode::Add, 3, 3, 4);
+    b.emit(Opcode::Return, 3);
+    auto proto = b.finish();
+    ASSERT_EQ(proto->fieldRefs.size(), 3u);
+    Value f = Value::object(vm.adopt(std::move(proto)));
+
+    ASSERT_EQ(vm.call(f, {Value::integer(20)}).toNumber(), 40.5);
+
+    // Typed fields reject values of other types
+    bool threw = false;
+    try {
+        vm.call(f, {Value::object(vm.intern("twenty"))});
+    } catch (const RuntimeError& e) {
+        threw = std::string(e.what()).find("int32 field 'x'") != std::string::npos;
+    }
+    ASSERT_TRUE(threw);
+    threw = false;
+    try {
+        vm.call(f, {Value::integer(int64_t(1) << 40)});
+    } catch (const RuntimeError&) {
+        threw = true;
+    }
+    ASSERT_TRUE(threw);
+
+    // Undeclared builder fields are a compile-time error
+    threw = false;
+    try {
+        BytecodeBuilder other("g", 0);
+        other.addFieldRef(point, vm.intern("z"));
+    } catch (const std::logic_error&) {
+        threw = true;
+    }
+    ASSERT_TRUE(threw);
+}
+
+TEST_CASE(TestClassFieldAccessOnOtherValues) {
+    // get(o) = o.x: instances of another class and plain objects go by name
+    VM vm;
+    const ClassLayout* point = vm.defineClass("Point", {{"x", FieldType::Int32}});
+    const ClassLayout* other = vm.defineClass("Other", {{"y", FieldType::Any}, {"x", FieldType::Any}});
+    BytecodeBuilder b("get", 1);
+    b.emit(Opcode::GetField, 1, 0, b.addFieldRef(point, vm.intern("x")));
+    b.emit(Opcode::Return, 1);
+    Value get = Value::object(vm.adopt(b.finish()));
+
+    Instance* instance = vm.getHeap().allocateInstance(other);
+    setInstanceProperty(vm.getHeap(), vm.getShapes(), instance, vm.intern("x"), Value::integer(7));
+    ASSERT_EQ(vm.call(get, {Value::object(instance)}).asInt(), 7);
+    Object* obj = vm.getHeap().allocateObject(vm.getShapes().root());
+    setProperty(vm.getHeap(), vm.getShapes(), obj, vm.intern("x"), Value::integer(9));
+    ASSERT_EQ(vm.call(get, {Value::object(obj)}).asInt(), 9);
+    ASSERT_TRUE(getInstanceProperty(instance, vm.intern("missing")).isUndefined());
+}
+
+TEST_CASE(TestClassFieldsInCompiledLoop) {
+    // sum(n) { c = new Counter; while (c.i < n) { c.total = c.total + c.i; c.i = c.i + 1 }
+    //          return c.total }
+    VM vm;
+    const ClassLayout* counter = vm.defineClass("Counter", {{"i", FieldType::Int32}, {"total", FieldType::Any}});
+    BytecodeBuilder b("sum", 1);
+    auto loop = b.newLabel();
+    auto done = b.newLabel();
+    int fieldI = b.addFieldRef(counter, vm.intern("i"));
+    int fieldTotal = b.addFieldRef(counter, vm.intern("total"));
+    b.emit(Opcode::NewInstance, 1, b.addClass(counter));
+    b.emit(Opcode::LoadInt, 2, 0);
+    b.emit(Opcode::SetField, 1, fieldTotal, 2);
+    b.emit(Opcode::LoadInt, 5, 1);
+    b.bind(loop);
+    b.emit(Opcode::GetField, 2, 1, fieldI);
+    b.emit(Opcode::Lt, 3, 2, 0);
+    b.emitJumpIfFalse(3, done);
+    b.emit(Opcode::GetField, 4, 1, fieldTotal);
+    b.emit(Opcode::Add, 4, 4, 2);
+    b.emit(Opcode::SetField, 1, fieldTotal, 4);
+    b.emit(Opcode::Add, 2, 2, 5);
+    b.emit(Opcode::SetField, 1, fieldI, 2);
+    b.emitJump(loop);
+    b.bind(done);
+    b.emit(Opcode::GetField, 4, 1, fieldTotal);
+    b.emit(Opcode::Return, 4);
+    Value sum = Value::object(vm.adopt(b.finish()));
+
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_EQ(vm.call(sum, {Value::integer(10000)}).asInt(), 49995000);
+    }
+    ASSERT_EQ(asFunction(sum)->proto->jitCode != nullptr, BaselineJit::isSupported());
+
+    // set(c, v) { c.i = v; return c.i }: compiled code deoptimizes on
+    // values it cannot store and the interpreter raises the error
+    BytecodeBuilder s("set", 2);
+    s.emit(Opcode::SetField, 0, s.addFieldRef(counter, vm.intern("i")), 1);
+    s.emit(Opcode::GetField, 2, 0, s.addFieldRef(counter, vm.intern("i")));
+    s.emit(Opcode::Return, 2);
+    Value set = Value::object(vm.adopt(s.finish()));
+    Value instance = Value::object(vm.getHeap().allocateInstance(counter));
+    for (int i = 0; i < static_cast<int>(2 * BaselineJit::kHotnessThreshold); ++i) {
+        ASSERT_EQ(vm.call(set, {instance, Value::integer(-i)}).asInt(), -i);
+    }
+    ASSERT_EQ(asFunction(set)->proto->jitCode != nullptr, BaselineJit::isSupported());
+    bool threw = false;
+    try {
+        vm.call(set, {instance, Value::integer(int64_t(1) << 31)});
+    } catch (const RuntimeError&) {
+        threw = true;
+    }
+    ASSERT_TRUE(threw);
+    ASSERT_EQ(vm.call(set, {instance, Value::integer(INT32_MIN)}).asInt(), INT32_MIN);
+}
+
+TEST_CASE(TestClassInstancesSurviveCollection) {
+    // Builds a linked list of n Node instances, each with a fresh string
+    // label, then sums the values: node.next and node.label must be traced
+    VM vm(64 * 1024);
+    const ClassLayout* node = vm.defineClass("Node", {{"value", FieldType::Int32},
+                                                      {"next", FieldType::Any},
+                                                      {"label", FieldType::Any}});
+    BytecodeBuilder b("build", 1);
+    int value = b.addFieldRef(node, vm.intern("value"));
+    int next = b.addFieldRef(node, vm.intern("next"));
+    int label = b.addFieldRef(node, vm.intern("label"));
+    auto loop = b.newLabel();
+    auto sumLoop = b.newLabel();
+    auto done = b.newLabel();
+    b.emit(Opcode::LoadNull, 1);  // head
+    b.emit(Opcode::LoadInt, 2, 0); // i
+    b.emit(Opcode::LoadInt, 3, 1);
+    b.emit(Opcode::LoadInt, 8, 0);  // sum
+    b.emit(Opcode::LoadConst, 7, b.addConstant(Value::object(vm.getHeap().allocateString("item"))));
+    b.bind(loop);
+    b.emit(Opcode::Lt, 4, 2, 0);
+    b.emitJumpIfFalse(4, sumLoop);
+    b.emit(Opcode::NewInstance, 5, b.addClass(node));
+    b.emit(Opcode::SetField, 5, next, 1);
+    b.emit(Opcode::SetField, 5, value, 2);
+    b.emit(Opcode::Add, 6, 7, 2);
+    b.emit(Opcode::SetField, 5, label, 6);
+    b.emit(Opcode::Move, 1, 5);
+    b.emit(Opcode::Add, 2, 2, 3);
+    b.emitJump(loop);
+    // while (head != null) { sum = sum + head.value + head.label.length; head = head.next }
+    b.bind(sumLoop);
+    b.emit(Opcode::LoadNull, 4);
+    b.emit(Opcode::Eq, 4, 1, 4);
+    b.emitJumpIfTrue(4, done);
+    b.emit(Opcode::GetField, 6, 1, value);
+    b.emit(Opcode::Add, 8, 8, 6);
+    b.emit(Opcode::GetField, 6, 1, label);
+    b.emit(Opcode::GetProp, 6, 6, b.addPropertyCache(vm.intern("length")));
+    b.emit(Opcode::Add, 8, 8, 6);
+    b.emit(Opcode::GetField, 1, 1, next);
+    b.emitJump(sumLoop);
+    b.bind(done);
+    b.emit(Opcode::Return, 8);
+    Value build = Value::object(vm.adopt(b.finish()));
+
+    // Labels "item0" .. "item19999": 10 * 5 + 90 * 6 + 900 * 7 + 9000 * 8 + 10000 * 9 characters
+    ASSERT_EQ(vm.call(build, {Value::integer(20000)}).asInt(), 199990000 + 168890);
+    ASSERT_TRUE(vm.getHeap().getStats().minorCollections > 10);
+}
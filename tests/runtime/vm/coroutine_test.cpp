@@ -0,0 +1,318 @@
+#include "compiler/codegen/bytecode_builder.h"
+#include "runtime/vm/string_ops.h"
+#include "runtime/vm/vm.h"
+#include "test_runner.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace {
+
+// async f(p, n) { v = await p; return v + n }
+Value makeAddAfterAwait(VM& vm) {
+    BytecodeBuilder b("addAfterAwait", 2);
+    b.setAsync();
+    b.emit(Opcode::Await, 2, 0);
+    b.emit(Opcode::Add, 2, 2, 1);
+    b.emit(Opcode::Return, 2);
+    return Value::object(vm.adopt(b.finish()));
+}
+
+} // namespace
+
+TEST_CASE(TestAwaitOfSettledValueContinuesSynchronously) {
+    VM vm;
+    Value f = makeAddAfterAwait(vm);
+
+    // Plain values and settled promises never suspend: the call returns an
+    // already fulfilled promise and queues nothing
+    Value promise = vm.call(f, {Value::integer(40), Value::integer(2)});
+    ASSERT_TRUE(isPromise(promise));
+    ASSERT_TRUE(asPromise(promise)->isSettled());
+    ASSERT_FALSE(asPromise(promise)->isRejected());
+    ASSERT_EQ(asPromise(promise)->result.asInt(), 42);
+
+    Value settled = vm.newPromise();
+    vm.resolvePromise(settled, Value::integer(10));
+    promise = vm.call(f, {settled, Value::integer(5)});
+    ASSERT_EQ(asPromise(promise)->result.asInt(), 15);
+    ASSERT_FALSE(vm.hasPendingJobs());
+
+    // Await is only valid in async functions
+    bool threw = false;
+    try {
+        BytecodeBuilder b("sync", 1);
+        b.emit(Opcode::Await, 1, 0);
+        b.finish();
+    } catch (const std::logic_error&) {
+        threw = true;
+    }
+    ASSERT_TRUE(threw);
+}
+
+TEST_CASE(TestAwaitSuspendsUntilResolved) {
+    VM vm;
+    Value f = makeAddAfterAwait(vm);
+    // async g(p) { r = await f(p, 1); return r * 10 }
+    BytecodeBuilder b("outer", 1);
+    b.setAsync();
+    b.emit(Opcode::LoadConst, 1, b.addConstant(f));
+    b.emit(Opcode::Move, 2, 0);
+    b.emit(Opcode::LoadInt, 3, 1);
+    b.emit(Opcode::Call, 1, 1, 2);
+    b.emit(Opcode::Await, 1, 1);
+    b.emit(Opcode::LoadInt, 2, 10);
+    b.emit(Opcode::Mul, 1, 1, 2);
+    b.emit(Opcode::Return, 1);
+    Value g = Value::object(vm.adopt(b.finish()));
+
+    Value pending = vm.newPromise();
+    Value outer = vm.call(g, {pending});
+    ASSERT_TRUE(isCoroutine(outer));
+    ASSERT_TRUE(asCoroutine(outer)->isSuspended());
+    ASSERT_FALSE(asPromise(outer)->isSettled());
+
+    // The frame is the coroutine object itself, sized to the register window
+    FunctionProto* proto = asFunction(g)->proto;
+    ASSERT_EQ(Heap::objectSize(asCoroutine(outer)),
+              Heap::allocationSize(sizeof(Coroutine) + sizeof(Value) * static_cast<size_t>(proto->numRegisters)));
+
+    // Resolving queues f; f finishing queues g
+    vm.resolvePromise(pending, Value::integer(4));
+    ASSERT_TRUE(vm.hasPendingJobs());
+    ASSERT_EQ(vm.runPendingJobs(), 2u);
+    ASSERT_TRUE(asPromise(outer)->isSettled());
+    ASSERT_EQ(asPromise(outer)->result.asInt(), 50);
+
+    // Settling twice changes nothing
+    vm.resolvePromise(pending, Value::integer(7));
+    ASSERT_FALSE(vm.hasPendingJobs());
+}
+
+TEST_CASE(TestRejectionsPropagate) {
+    VM vm;
+    Value f = makeAddAfterAwait(vm);
+    Value pending = vm.newPromise();
+    Value first = vm.call(f, {pending, Value::integer(1)});
+    Value second = vm.call(f, {pending, Value::integer(2)});
+    vm.rejectPromise(pending, Value::object(vm.getHeap().allocateString("connection reset")));
+    ASSERT_EQ(vm.runPendingJobs(), 2u);
+    for (Value promise : {first, second}) {
+        ASSERT_TRUE(asPromise(promise)->isRejected());
+        ASSERT_EQ(toUtf8(asString(asPromise(promise)->result)), std::string("connection reset"));
+    }
+
+    // Errors thrown by an async function reject its promise instead
+    BytecodeBuilder b("throws", 1);
+    b.setAsync();
+    b.emit(Opcode::GetProp, 1, 0, b.addPropertyCache(vm.intern("x")));
+    b.emit(Opcode::Return, 1);
+    Value throws = Value::object(vm.adopt(b.finish()));
+    Value rejected = vm.call(throws, {Value::undefined()});
+    ASSERT_TRUE(asPromise(rejected)->isRejected());
+    ASSERT_TRUE(isString(asPromise(rejected)->result));
+}
+
+TEST_CASE(TestManySuspendedCoroutines) {
+    // async worker(p, i) { o = {}; o.i = i; v = await p; total = total + o.i + v }
+    // Every worker stays suspended on one promise across many collections
+    VM vm(256 * 1024);
+    int total = vm.defineGlobal("total");
+    vm.setGlobal(total, Value::integer(0));
+    BytecodeBuilder b("worker", 2);
+    b.setAsync();
+    int key = b.addPropertyCache(vm.intern("i"));
+    b.emit(Opcode::NewObject, 2);
+    b.emit(Opcode::SetProp, 2, key, 1);
+    b.emit(Opcode::Await, 3, 0);
+    b.emit(Opcode::GetProp, 4, 2, b.addPropertyCache(vm.intern("i")));
+    b.emit(Opcode::Add, 3, 3, 4);
+    b.emit(Opcode::GetGlobal, 4, total);
+    b.emit(Opcode::Add, 3, 3, 4);
+    b.emit(Opcode::SetGlobal, total, 3);
+    b.emit(Opcode::ReturnUndefined);
+    Value worker = Value::object(vm.adopt(b.finish()));
+
+    constexpr int kWorkers = 100000;
+    Value gate = vm.newPromise();
+    vm.setGlobal(vm.defineGlobal("gate"), gate); // Keeps the promise rooted
+    for (int i = 0; i < kWorkers; ++i) {
+        vm.call(worker, {vm.getGlobal(vm.lookupGlobal("gate")), Value::integer(i)});
+    }
+    ASSERT_TRUE(vm.getHeap().getStats().minorCollections > 0);
+
+    vm.resolvePromise(vm.getGlobal(vm.lookupGlobal("gate")), Value::integer(1));
+    ASSERT_EQ(vm.runPendingJobs(), static_cast<size_t>(kWorkers));
+    int64_t expected = int64_t(kWorkers) * (kWorkers - 1) / 2 + kWorkers;
+    ASSERT_EQ(vm.getGlobal(total).asInt(), expected);
+}
+
+TEST_CASE(TestWildAsyncFunctionLetsCollectorRunAtAwait) {
+    VM vm(64 * 1024);
+    // alloc(n): for (i = 0; i < n; i = i + 1) { o = {} }
+    BytecodeBuilder a("alloc", 1);
+    auto loop = a.newLabel();
+    auto done = a.newLabel();
+    a.emit(Opcode::LoadInt, 1, 0);
+    a.emit(Opcode::LoadInt, 2, 1);
+    a.bind(loop);
+    a.emit(Opcode::Lt, 3, 1, 0);
+    a.emitJumpIfFalse(3, done);
+    a.emit(Opcode::NewObject, 4);
+    a.emit(Opcode::Add, 1, 1, 2);
+    a.emitJump(loop);
+    a.bind(done);
+    a.emit(Opcode::Return, 1);
+    Value alloc = Value::object(vm.adopt(a.finish()));
+
+    // wild async function batch(f, p, n) { f(n); v = await p; f(n); return v }
+    BytecodeBuilder w("batch", 3);
+    w.setWild();
+    w.setAsync();
+    w.emit(Opcode::Move, 5, 0);
+    w.emit(Opcode::Move, 6, 2);
+    w.emit(Opcode::Call, 4, 5, 1);
+    w.emit(Opcode::Await, 3, 1);
+    w.emit(Opcode::Move, 5, 0);
+    w.emit(Opcode::Move, 6, 2);
+    w.emit(Opcode::Call, 4, 5, 1);
+    w.emit(Opcode::Return, 3);
+    Value batch = Value::object(vm.adopt(w.finish()));
+
+    Heap& heap = vm.getHeap();
+    const GcStats& stats = heap.getStats();
+    Value gate = vm.newPromise();
+    vm.setGlobal(vm.defineGlobal("gate"), gate);
+    Value result = vm.call(batch, {alloc, gate, Value::integer(20000)});
+    vm.setGlobal(vm.defineGlobal("result"), result);
+
+    // The body held the collector off; parked at the await it no longer does
+    ASSERT_EQ(stats.minorCollections, 0u);
+    ASSERT_TRUE(asCoroutine(result)->isSuspended());
+    ASSERT_FALSE(heap.isCollectionSuspended());
+    ASSERT_TRUE(heap.collectionRequested());
+    ASSERT_EQ(vm.call(alloc, {Value::integer(20000)}).asInt(), 20000);
+    size_t whileParked = stats.minorCollections;
+    ASSERT_TRUE(whileParked > 0);
+
+    // Resumed, the body holds it off again until it returns
+    vm.resolvePromise(vm.getGlobal(vm.lookupGlobal("gate")), Value::integer(7));
+    ASSERT_EQ(vm.runPendingJobs(), 1u);
+    result = vm.getGlobal(vm.lookupGlobal("result"));
+    ASSERT_EQ(asPromise(result)->result.asInt(), 7);
+    ASSERT_EQ(stats.minorCollections, whileParked);
+    ASSERT_FALSE(heap.isCollectionSuspended());
+    ASSERT_TRUE(heap.collectionRequested());
+}
+
+TEST_CASE(TestCompiledAsyncFunctionAwaits) {
+    // async sum(p, n) { s = 0; i = 0; while (i < n) { s = s + i; i = i + 1 } return s + await p }
+    VM vm;
+    BytecodeBuilder b("sum", 2);
+    b.setAsync();
+    auto loop = b.newLabel();
+    auto done = b.newLabel();
+    b.emit(Opcode::LoadInt, 2, 0);
+    b.emit(Opcode::LoadInt, 3, 0);
+    b.emit(Opcode::LoadInt, 5, 1);
+    b.bind(loop);
+    b.emit(Opcode::Lt, 4, 3, 1);
+    b.emitJumpIfFalse(4, done);
+    b.emit(Opcode::Add, 2, 2, 3);
+    b.emit(Opcode::Add, 3, 3, 5);
+    b.emitJump(loop);
+    b.bind(done);
+    b.emit(Opcode::Await, 4, 0);
+    b.emit(Opcode::Add, 2, 2, 4);
+    b.emit(Opcode::Return, 2);
+    Value sum = Value::object(vm.adopt(b.finish()));
+
+    Value pending = vm.newPromise();
+    Value promise = vm.call(sum, {pending, Value::integer(10000)});
+    ASSERT_EQ(asFunction(sum)->proto->jitCode != nullptr, BaselineJit::isSupported());
+    ASSERT_FALSE(asPromise(promise)->isSettled());
+    vm.resolvePromise(pending, Value::integer(5));
+    ASSERT_EQ(vm.runPendingJobs(), 1u);
+    ASSERT_EQ(asPromise(promise)->result.asInt(), 49995005);
+}
+
+TEST_CASE(TestRunLockSuspendsCoroutines) {
+    // async update(obj, p) {
+    //     using (await Run.lock(obj)) { v = await p; log = log * 10 + v }
+    // }
+    VM vm;
+    int log = vm.defineGlobal("log");
+    vm.setGlobal(log, Value::integer(0));
+    BytecodeBuilder b("update", 2);
+    b.setAsync();
+    int site = b.addLockSite();
+    b.emit(Opcode::Lock, 2, 0, site);
+    b.emit(Opcode::Await, 2, 2);
+    b.emit(Opcode::Await, 3, 1);
+    b.emit(Opcode::GetGlobal, 4, log);
+    b.emit(Opcode::LoadInt, 5, 10);
+    b.emit(Opcode::Mul, 4, 4, 5);
+    b.emit(Opcode::Add, 4, 4, 3);
+    b.emit(Opcode::SetGlobal, log, 4);
+    b.emit(Opcode::Unlock, 2);
+    b.emit(Opcode::ReturnUndefined);
+    Value update = Value::object(vm.adopt(b.finish()));
+    LockSite& counters = asFunction(update)->proto->lockSites[static_cast<size_t>(site)];
+
+    WildObject* shared = WildObject::create(vm.getWildHeap(), 16);
+    Value first = vm.newPromise();
+    Value second = vm.newPromise();
+    vm.setGlobal(vm.defineGlobal("first"), first); // Rooted
+    vm.setGlobal(vm.defineGlobal("second"), second);
+    Value a = vm.call(update, {Value::wild(shared), first});
+    Value b2 = vm.call(update, {Value::wild(shared), second});
+    ASSERT_TRUE(shared->lock.isLocked());
+    ASSERT_EQ(counters.getStats().parks, 1u);
+
+    // The second update waits for the lock, not for its own promise
+    vm.resolvePromise(vm.getGlobal(vm.lookupGlobal("second")), Value::integer(2));
+    ASSERT_EQ(vm.runPendingJobs(), 0u);
+    vm.resolvePromise(vm.getGlobal(vm.lookupGlobal("first")), Value::integer(1));
+    ASSERT_EQ(vm.runPendingJobs(), 2u);
+    ASSERT_EQ(vm.getGlobal(log).asInt(), 12);
+    ASSERT_TRUE(asPromise(a)->isSettled());
+    ASSERT_TRUE(asPromise(b2)->isSettled());
+    ASSERT_FALSE(shared->lock.isLocked());
+
+    // Held by another thread: the coroutine suspends, and the VM picks the
+    // lock up once that thread releases it
+    shared->lock.lock();
+    Value settled = vm.newPromise();
+    vm.resolvePromise(settled, Value::integer(3));
+    Value c = vm.call(update, {Value::wild(shared), settled});
+    ASSERT_FALSE(asPromise(c)->isSettled());
+    std::thread holder([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        shared->lock.unlock();
+    });
+    vm.waitForLocks();
+    ASSERT_TRUE(vm.hasPendingJobs());
+    while (vm.hasPendingJobs()) {
+        vm.runPendingJobs();
+    }
+    holder.join();
+    ASSERT_TRUE(asPromise(c)->isSettled());
+    ASSERT_FALSE(asPromise(c)->isRejected());
+    ASSERT_EQ(vm.getGlobal(log).asInt(), 123);
+    ASSERT_EQ(counters.getStats().contended, 2u);
+
+    // `using` exit on an object nobody locked
+    BytecodeBuilder u("unlock", 1);
+    u.emit(Opcode::Unlock, 0);
+    Value unlock = Value::object(vm.adopt(u.finish()));
+    bool threw = false;
+    try {
+        vm.call(unlock, {Value::wild(shared)});
+    } catch (const RuntimeError&) {
+        threw = true;
+    }
+    ASSERT_TRUE(threw);
+    shared->destroy();
+}
@@ -0,0 +1,179 @@
+#include "compiler/codegen/bytecode_builder.h"
+#include "runtime/vm/slow_paths.h"
+#include "runtime/vm/vm.h"
+#include "test_programs.h"
+#include "test_runner.h"
+
+#include <string>
+
+TEST_CASE(TestInterpreterRecursiveFib) {
+    VM vm;
+    int fibSlot = defineFib(vm);
+    Value result = vm.call(vm.getGlobal(fibSlot), {Value::integer(20)});
+    ASSERT_TRUE(result.isInt());
+    ASSERT_EQ(result.asInt(), 6765);
+}
+
+TEST_CASE(TestInterpreterLoopSum) {
+    // sum = 0; for (i = 0; i < n; i = i + 1) sum = sum + i; return sum
+    VM vm;
+    BytecodeBuilder b("sum", 1);
+    auto loop = b.newLabel();
+    auto done = b.newLabel();
+    b.emit(Opcode::LoadInt, 1, 0); // sum
+    b.emit(Opcode::LoadInt, 2, 0); // i
+    b.emit(Opcode::LoadInt, 3, 1); // step
+    b.bind(loop);
+    b.emit(Opcode::Lt, 4, 2, 0);
+    b.emitJumpIfFalse(4, done);
+    b.emit(Opcode::Add, 1, 1, 2);
+    b.emit(Opcode::Add, 2, 2, 3);
+    b.emitJump(loop);
+    b.bind(done);
+    b.emit(Opcode::Return, 1);
+    Value fn = Value::object(vm.adopt(b.finish()));
+
+    Value result = vm.call(fn, {Value::integer(1000)});
+    ASSERT_EQ(result.asInt(), 499500);
+}
+
+TEST_CASE(TestInterpreterIntOverflowFallsBackToDouble) {
+    VM vm;
+    BytecodeBuilder b("overflow", 2);
+    b.emit(Opcode::Add, 2, 0, 1);
+    b.emit(Opcode::Return, 2);
+    Value fn = Value::object(vm.adopt(b.finish()));
+
+    // Ints are 48 bits wide, so 32-bit overflow stays an int
+    Value result = vm.call(fn, {Value::integer(2147483647), Value::integer(1)});
+    ASSERT_TRUE(result.isInt());
+    ASSERT_EQ(result.asInt(), 2147483648);
+
+    result = vm.call(fn, {Value::integer(Value::kMaxInt), Value::integer(1)});
+    ASSERT_TRUE(result.isDouble());
+    ASSERT_EQ(result.asDouble(), 140737488355328.0);
+
+    result = vm.call(fn, {Value::number(0.5), Value::integer(1)});
+    ASSERT_EQ(result.asDouble(), 1.5);
+}
+
+TEST_CASE(TestInterpreterDivisionAndModulo) {
+    VM vm;
+    BytecodeBuilder b("divmod", 2);
+    b.emit(Opcode::Div, 2, 0, 1);
+    b.emit(Opcode::Mod, 3, 0, 1);
+    b.emit(Opcode::Add, 4, 2, 3);
+    b.emit(Opcode::Return, 4);
+    Value fn = Value::object(vm.adopt(b.finish()));
+
+    // 12 / 4 + 12 % 4 stays an int
+    Value result = vm.call(fn, {Value::integer(12), Value::integer(4)});
+    ASSERT_TRUE(result.isInt());
+    ASSERT_EQ(result.asInt(), 3);
+
+    // 7 / 2 + 7 % 2 = 3.5 + 1
+    result = vm.call(fn, {Value::integer(7), Value::integer(2)});
+    ASSERT_EQ(result.toNumber(), 4.5);
+}
+
+TEST_CASE(TestInterpreterStringConcatenation) {
+    VM vm;
+    BytecodeBuilder b("greet", 1);
+    int hello = b.addConstant(Value::object(vm.intern("Task ")));
+    b.emit(Opcode::LoadConst, 1, hello);
+    b.emit(Opcode::Add, 2, 1, 0);
+    b.emit(Opcode::Return, 2);
+    Value fn = Value::object(vm.adopt(b.finish()));
+
+    Value result = vm.call(fn, {Value::integer(7)});
+    ASSERT_TRUE(isString(result));
+    ASSERT_EQ(std::string(asString(result)->view()), "Task 7");
+
+    result = vm.call(fn, {Value::number(0.25)});
+    ASSERT_EQ(std::string(asString(result)->view()), "Task 0.25");
+}
+
+TEST_CASE(TestInterpreterPropertyAccess) {
+    VM vm;
+    BytecodeBuilder b("props", 0);
+    String* visits = vm.intern("visits");
+    String* name = vm.intern("name");
+    b.emit(Opcode::NewObject, 0);
+    b.emit(Opcode::LoadInt, 1, 41);
+    b.emit(Opcode::SetProp, 0, b.addPropertyCache(visits), 1);
+    b.emit(Opcode::LoadNull, 2);
+    b.emit(Opcode::SetProp, 0, b.addPropertyCache(name), 2);
+    b.emit(Opcode::GetProp, 3, 0, b.addPropertyCache(visits));
+    b.emit(Opcode::LoadInt, 4, 1);
+    b.emit(Opcode::Add, 3, 3, 4);
+    b.emit(Opcode::SetProp, 0, b.addPropertyCache(visits), 3);
+    b.emit(Opcode::GetProp, 5, 0, b.addPropertyCache(visits));
+    b.emit(Opcode::Return, 5);
+    Value fn = Value::object(vm.adopt(b.finish()));
+
+    ASSERT_EQ(vm.call(fn, {}).asInt(), 42);
+}
+
+TEST_CASE(TestInterpreterComparisonsAndEquality) {
+    VM vm;
+    BytecodeBuilder b("cmp", 2);
+    b.emit(Opcode::Le, 2, 0, 1);
+    b.emit(Opcode::Return, 2);
+    Value le = Value::object(vm.adopt(b.finish()));
+
+    ASSERT_TRUE(vm.call(le, {Value::integer(3), Value::integer(3)}).asBoolean());
+    ASSERT_FALSE(vm.call(le, {Value::number(3.5), Value::integer(3)}).asBoolean());
+    ASSERT_TRUE(vm.call(le, {Value::object(vm.intern("abc")), Value::object(vm.intern("abd"))}).asBoolean());
+
+    ASSERT_TRUE(strictEquals(Value::integer(2), Value::number(2.0)));
+    ASSERT_TRUE(strictEquals(Value::object(vm.getHeap().allocateString("x")), Value::object(vm.intern("x"))));
+    ASSERT_FALSE(strictEquals(Value::null(), Value::undefined()));
+}
+
+TEST_CASE(TestInterpreterMissingArgumentsAreUndefined) {
+    VM vm;
+    BytecodeBuilder b("second", 2);
+    b.emit(Opcode::Return, 1);
+    Value fn = Value::object(vm.adopt(b.finish()));
+
+    ASSERT_TRUE(vm.call(fn, {Value::integer(1)}).isUndefined());
+}
+
+TEST_CASE(TestInterpreterRuntimeErrors) {
+    VM vm;
+    BytecodeBuilder b("callNull", 0);
+    b.emit(Opcode::LoadNull, 0);
+    b.emit(Opcode::Call, 0, 0, 0);
+    b.emit(Opcode::Return, 0);
+    Value fn = Value::object(vm.adopt(b.finish()));
+
+    bool threw = false;
+    try {
+        vm.call(fn, {});
+    } catch (const RuntimeError&) {
+        threw = true;
+    }
+    ASSERT_TRUE(threw);
+
+    // The VM remains usable after an error unwound its frames
+    int fibSlot = defineFib(vm);
+    ASSERT_EQ(vm.call(vm.getGlobal(fibSlot), {Value::integer(10)}).asInt(), 55);
+}
+
+TEST_CASE(TestInterpreterStackOverflow) {
+    VM vm;
+    int slot = vm.defineGlobal("forever");
+    BytecodeBuilder b("forever", 0);
+    b.emit(Opcode::GetGlobal, 0, slot);
+    b.emit(Opcode::Call, 0, 0, 0);
+    b.emit(Opcode::Return, 0);
+    vm.setGlobal(slot, Value::object(vm.adopt(b.finish())));
+
+    bool threw = false;
+    try {
+        vm.call(vm.getGlobal(slot), {});
+    } catch (const RuntimeError& e) {
+        threw = std::string(e.what()) == "Maximum call stack size exceeded";
+    }
+    ASSERT_TRUE(threw);
+}
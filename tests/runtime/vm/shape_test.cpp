@@ -0,0 +1,189 @@
+#include "compiler/codegen/bytecode_builder.h"
+#include "runtime/vm/object.h"
+#include "runtime/vm/shape.h"
+#include "runtime/vm/vm.h"
+#include "test_runner.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE(TestShapesAreSharedAlongTransitions) {
+    VM vm;
+    ShapeTree& shapes = vm.getShapes();
+    String* name = vm.intern("name");
+    String* visits = vm.intern("visits");
+
+    Object* a = vm.getHeap().allocateObject(shapes.root());
+    Object* b = vm.getHeap().allocateObject(shapes.root());
+    setProperty(vm.getHeap(), shapes, a, name, Value::integer(1));
+    setProperty(vm.getHeap(), shapes, a, visits, Value::integer(2));
+    setProperty(vm.getHeap(), shapes, b, name, Value::integer(3));
+    setProperty(vm.getHeap(), shapes, b, visits, Value::integer(4));
+
+    // Same keys in the same order give the same shape
+    ASSERT_TRUE(a->shape == b->shape);
+    ASSERT_EQ(a->shape->getSlotCount(), 2u);
+    ASSERT_EQ(a->shape->lookup(name), 0);
+    ASSERT_EQ(a->shape->lookup(visits), 1);
+    ASSERT_EQ(a->shape->lookup(vm.intern("missing")), -1);
+    ASSERT_EQ(getProperty(b, visits).asInt(), 4);
+
+    // A different insertion order is a different shape
+    Object* c = vm.getHeap().allocateObject(shapes.root());
+    setProperty(vm.getHeap(), shapes, c, visits, Value::integer(5));
+    setProperty(vm.getHeap(), shapes, c, name, Value::integer(6));
+    ASSERT_TRUE(c->shape != a->shape);
+    ASSERT_EQ(getProperty(c, name).asInt(), 6);
+}
+
+TEST_CASE(TestObjectsGrowIntoOverflowSlots) {
+    VM vm;
+    Object* obj = vm.getHeap().allocateObject(vm.getShapes().root());
+    for (int i = 0; i < 20; ++i) {
+        setProperty(vm.getHeap(), vm.getShapes(), obj, vm.intern("p" + std::to_string(i)), Value::integer(i));
+    }
+    ASSERT_TRUE(obj->overflow != nullptr);
+    ASSERT_FALSE(obj->shape->isDictionary());
+    for (int i = 0; i < 20; ++i) {
+        ASSERT_EQ(getProperty(obj, vm.intern("p" + std::to_string(i))).asInt(), i);
+    }
+}
+
+TEST_CASE(TestLargeObjectsSwitchToDictionaryMode) {
+    VM vm;
+    Object* obj = vm.getHeap().allocateObject(vm.getShapes().root());
+    int count = static_cast<int>(ShapeTree::kMaxFastProperties) + 10;
+    for (int i = 0; i < count; ++i) {
+        setProperty(vm.getHeap(), vm.getShapes(), obj, vm.intern("k" + std::to_string(i)), Value::integer(i));
+    }
+    ASSERT_TRUE(obj->shape->isDictionary());
+    ASSERT_EQ(obj->shape->getSlotCount(), static_cast<uint32_t>(count));
+    for (int i = 0; i < count; ++i) {
+        ASSERT_EQ(getProperty(obj, vm.intern("k" + std::to_string(i))).asInt(), i);
+    }
+}
+
+// Builds `function (o) { return o.x; }` and returns it with its cache
+static Value buildGetX(VM& vm, FunctionProto*& proto) {
+    BytecodeBuilder b("getX", 1);
+    b.emit(Opcode::GetProp, 1, 0, b.addPropertyCache(vm.intern("x")));
+    b.emit(Opcode::Return, 1);
+    auto finished = b.finish();
+    proto = finished.get();
+    return Value::object(vm.adopt(std::move(finished)));
+}
+
+// Creates an object whose properties are `prefix` keys followed by x = value
+static Value makeObject(VM& vm, int prefix, int value) {
+    Object* obj = vm.getHeap().allocateObject(vm.getShapes().root());
+    for (int i = 0; i < prefix; ++i) {
+        setProperty(vm.getHeap(), vm.getShapes(), obj, vm.intern("pad" + std::to_string(i)), Value::null());
+    }
+    setProperty(vm.getHeap(), vm.getShapes(), obj, vm.intern("x"), Value::integer(value));
+    return Value::object(obj);
+}
+
+TEST_CASE(TestInlineCacheStates) {
+    VM vm;
+    FunctionProto* proto = nullptr;
+    Value getX = buildGetX(vm, proto);
+    const PropertyCache& cache = proto->propertyCaches[0];
+
+    // Monomorphic: repeated calls with one shape keep a single entry
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_EQ(vm.call(getX, {makeObject(vm, 0, i)}).asInt(), i);
+    }
+    ASSERT_EQ(cache.count, 1);
+    ASSERT_FALSE(cache.megamorphic);
+
+    // Polymorphic: each new shape adds an entry
+    for (int shape = 1; shape < PropertyCache::kMaxEntries; ++shape) {
+        ASSERT_EQ(vm.call(getX, {makeObject(vm, shape, 10 + shape)}).asInt(), 10 + shape);
+    }
+    ASSERT_EQ(cache.count, PropertyCache::kMaxEntries);
+
+    // Megamorphic: too many shapes stop caching but still give right answers
+    for (int shape = PropertyCache::kMaxEntries; shape < 10; ++shape) {
+        ASSERT_EQ(vm.call(getX, {makeObject(vm, shape, 20 + shape)}).asInt(), 20 + shape);
+    }
+    ASSERT_TRUE(cache.megamorphic);
+    ASSERT_EQ(vm.call(getX, {makeObject(vm, 0, 99)}).asInt(), 99);
+}
+
+TEST_CASE(TestStoreCacheFollowsTransitions) {
+    VM vm;
+    // function (o, v) { o.a = v; o.b = v; o.c = v; o.d = v; o.e = v; }
+    BytecodeBuilder b("init", 2);
+    const char* keys[] = {"a", "b", "c", "d", "e"};
+    for (const char* key : keys) {
+        b.emit(Opcode::SetProp, 0, b.addPropertyCache(vm.intern(key)), 1);
+    }
+    b.emit(Opcode::ReturnUndefined);
+    auto finished = b.finish();
+    FunctionProto* proto = finished.get();
+    Value init = Value::object(vm.adopt(std::move(finished)));
+
+    Object* first = vm.getHeap().allocateObject(vm.getShapes().root());
+    Object* second = vm.getHeap().allocateObject(vm.getShapes().root());
+    vm.call(init, {Value::object(first), Value::integer(1)});
+    size_t shapesAfterFirst = vm.getShapes().shapeCount();
+    vm.call(init, {Value::object(second), Value::integer(2)});
+
+    // The second object reuses the cached transitions, including the one
+    // that spills into overflow storage
+    ASSERT_EQ(vm.getShapes().shapeCount(), shapesAfterFirst);
+    ASSERT_TRUE(first->shape == second->shape);
+    ASSERT_EQ(getProperty(second, vm.intern("e")).asInt(), 2);
+    ASSERT_TRUE(proto->propertyCaches[0].entries[0].newShape != nullptr);
+}
+
+TEST_CASE(TestConcurrentWritesToDifferentProperties) {
+    // userData.visits and userData.lastLogin updated by their own tasks
+    // while another one keeps adding properties: growing overflow storage,
+    // then switching to dictionary mode
+    VM vm;
+    Heap& heap = vm.getHeap();
+    ShapeTree& shapes = vm.getShapes();
+    Object* userData = heap.allocateObject(shapes.root());
+    std::vector<String*> counters = {vm.intern("visits"), vm.intern("lastLogin"), vm.intern("c2"), vm.intern("c3"),
+                                     vm.intern("c4"), vm.intern("c5")}; // The last two in overflow slots
+    for (String* key : counters) {
+        setProperty(heap, shapes, userData, key, Value::integer(0));
+    }
+    int added = static_cast<int>(ShapeTree::kMaxFastProperties) + 20;
+    std::vector<String*> extra;
+    for (int i = 0; i < added; ++i) {
+        extra.push_back(vm.intern("extra" + std::to_string(i)));
+    }
+
+    constexpr int kIncrements = 20000;
+    std::vector<std::thread> threads;
+    for (String* key : counters) {
+        threads.emplace_back([&, key] {
+            for (int i = 0; i < kIncrements; ++i) {
+                int64_t current = getProperty(userData, key).asInt();
+                setProperty(heap, shapes, userData, key, Value::integer(current + 1));
+            }
+        });
+    }
+    threads.emplace_back([&] {
+        for (int i = 0; i < added; ++i) {
+            setProperty(heap, shapes, userData, extra[static_cast<size_t>(i)], Value::integer(i));
+            std::this_thread::yield();
+        }
+    });
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // No update was lost to a racing store or to storage being replaced
+    ASSERT_TRUE(userData->shape->isDictionary());
+    for (String* key : counters) {
+        ASSERT_EQ(getProperty(userData, key).asInt(), kIncrements);
+    }
+    for (int i = 0; i < added; ++i) {
+        ASSERT_EQ(getProperty(userData, extra[static_cast<size_t>(i)]).asInt(), i);
+    }
+    ASSERT_EQ(userData->length % 2, 0u); // Shape lock released
+}
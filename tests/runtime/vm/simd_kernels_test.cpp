@@ -0,0 +1,124 @@
+#include "runtime/memory/array_buffer.h"
+#include "runtime/vm/simd_kernels.h"
+#include "test_runner.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// Runs `check` once per instruction set the machine supports
+template <typename Check>
+static void forEachSimdLevel(Check check) {
+    SimdLevel saved = simdLevel();
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2}) {
+        if (level <= maxSimdLevel()) {
+            setSimdLevel(level);
+            check();
+        }
+    }
+    setSimdLevel(saved);
+}
+
+TEST_CASE(TestSimdFillAndCompare) {
+    forEachSimdLevel([] {
+        ArrayBuffer buffer(512);
+        for (size_t start = 0; start < 8; ++start) {
+            for (size_t count : {0u, 1u, 7u, 31u, 33u, 100u}) {
+                std::memset(buffer.data(), 0, buffer.byteLength());
+                uint32_t pattern = 0xA1B2C3D4;
+                uint32_t* elements = reinterpret_cast<uint32_t*>(buffer.data()) + start;
+                fillElements(elements, &pattern, sizeof(pattern), count);
+                for (size_t i = 0; i < count; ++i) {
+                    ASSERT_EQ(elements[i], pattern);
+                }
+                ASSERT_EQ(elements[count], 0u);
+            }
+        }
+
+        std::vector<uint8_t> a(200, 7);
+        std::vector<uint8_t> b(a);
+        ASSERT_EQ(compareBytes(a.data(), b.data(), a.size()), 0);
+        for (size_t at : {0u, 15u, 16u, 31u, 32u, 150u, 199u}) {
+            b = a;
+            b[at] = 9;
+            ASSERT_EQ(compareBytes(a.data(), b.data(), a.size()), -1);
+            ASSERT_EQ(compareBytes(b.data(), a.data(), a.size()), 1);
+            ASSERT_EQ(compareBytes(a.data(), b.data(), at), 0);
+        }
+    });
+}
+
+TEST_CASE(TestSimdIndexOf) {
+    forEachSimdLevel([] {
+        std::vector<uint8_t> bytes(100);
+        std::vector<uint16_t> shorts(100);
+        std::vector<uint32_t> ints(100);
+        std::vector<float> floats(100);
+        std::vector<double> doubles(100);
+        for (size_t i = 0; i < 100; ++i) {
+            bytes[i] = static_cast<uint8_t>(i);
+            shorts[i] = static_cast<uint16_t>(i * 300);
+            ints[i] = static_cast<uint32_t>(i) * 100000u;
+            floats[i] = static_cast<float>(i) * 0.5f;
+            doubles[i] = static_cast<double>(i) * 0.25;
+        }
+        for (size_t i : {0u, 1u, 17u, 63u, 64u, 98u, 99u}) {
+            ASSERT_EQ(indexOfU8(bytes.data(), bytes.size(), bytes[i]), static_cast<ptrdiff_t>(i));
+            ASSERT_EQ(indexOfU16(shorts.data(), shorts.size(), shorts[i]), static_cast<ptrdiff_t>(i));
+            ASSERT_EQ(indexOfU32(ints.data(), ints.size(), ints[i]), static_cast<ptrdiff_t>(i));
+            ASSERT_EQ(indexOfF32(floats.data(), floats.size(), floats[i]), static_cast<ptrdiff_t>(i));
+            ASSERT_EQ(indexOfF64(doubles.data(), doubles.size(), doubles[i]), static_cast<ptrdiff_t>(i));
+        }
+        ASSERT_EQ(indexOfU8(bytes.data(), bytes.size(), 200), -1);
+        ASSERT_EQ(indexOfU32(ints.data(), 50, ints[60]), -1);
+
+        // Numeric equality: -0 finds 0, NaN finds nothing
+        ASSERT_EQ(indexOfF64(doubles.data(), doubles.size(), -0.0), 0);
+        doubles[70] = NAN;
+        ASSERT_EQ(indexOfF64(doubles.data(), doubles.size(), NAN), -1);
+        ASSERT_EQ(indexOfF32(floats.data(), floats.size(), -0.0f), 0);
+    });
+}
+
+TEST_CASE(TestSimdSumAndMap) {
+    forEachSimdLevel([] {
+        std::vector<int32_t> ints(1001);
+        std::vector<uint32_t> unsignedInts(1001);
+        int64_t expected = 0;
+        uint64_t expectedUnsigned = 0;
+        for (size_t i = 0; i < ints.size(); ++i) {
+            ints[i] = (i % 2 ? 1 : -1) * static_cast<int32_t>(i * 2000003);
+            unsignedInts[i] = 0xF0000000u + static_cast<uint32_t>(i);
+            expected += ints[i];
+            expectedUnsigned += unsignedInts[i];
+        }
+        ASSERT_EQ(sumI32(ints.data(), ints.size()), expected);
+        ASSERT_EQ(sumU32(unsignedInts.data(), unsignedInts.size()), expectedUnsigned);
+
+        std::vector<double> doubles(37);
+        std::vector<float> floats(37);
+        for (size_t i = 0; i < doubles.size(); ++i) {
+            doubles[i] = static_cast<double>(i) / 3;
+            floats[i] = static_cast<float>(i) / 7;
+        }
+        std::vector<double> mappedDoubles(doubles.size());
+        std::vector<float> mappedFloats(floats.size());
+        for (NumericOp op : {NumericOp::Add, NumericOp::Sub, NumericOp::Mul, NumericOp::Div}) {
+            mapF64(mappedDoubles.data(), doubles.data(), doubles.size(), op, 1.1);
+            mapF32(mappedFloats.data(), floats.data(), floats.size(), op, 1.1);
+            for (size_t i = 0; i < doubles.size(); ++i) {
+                double x = doubles[i];
+                double y = floats[i];
+                double want = op == NumericOp::Add ? x + 1.1 : op == NumericOp::Sub ? x - 1.1
+                            : op == NumericOp::Mul ? x * 1.1 : x / 1.1;
+                double wantFloat = op == NumericOp::Add ? y + 1.1 : op == NumericOp::Sub ? y - 1.1
+                                 : op == NumericOp::Mul ? y * 1.1 : y / 1.1;
+                ASSERT_EQ(mappedDoubles[i], want);
+                ASSERT_EQ(mappedFloats[i], static_cast<float>(wantFloat));
+            }
+        }
+        // In place
+        mapF64(doubles.data(), doubles.data(), doubles.size(), NumericOp::Mul, 3);
+        ASSERT_EQ(doubles[36], 36.0);
+    });
+}
@@ -0,0 +1,203 @@
+#include "compiler/codegen/bytecode_builder.h"
+#include "runtime/memory/wild_heap.h"
+#include "runtime/vm/class_layout.h"
+#include "runtime/vm/object.h"
+#include "runtime/vm/snapshot.h"
+#include "runtime/vm/vm.h"
+#include "runtime/vm/wild_object.h"
+#include "test_runner.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+constexpr int kChainLength = 10000;  // Objects enough for several runs
+constexpr uint32_t kBigArray = 40000; // A run of its own
+
+std::string imagePath(const char* name) {
+    return "/tmp/superecma_" + std::to_string(::getpid()) + "_" + name + ".image";
+}
+
+// What a script's top level would leave behind: objects in globals, a
+// class instance, and `main`, which reads them back
+void initialize(VM& vm) {
+    const ClassLayout* point = vm.defineClass("Point", {{"x", FieldType::Int32}, {"label", FieldType::Any}});
+    int configSlot = vm.defineGlobal("config");
+    int pointSlot = vm.defineGlobal("point");
+
+    // setup() { config = {k0: 0, ..., k5: 5}; point = new Point; point.x = 7; point.label = "pt" }
+    BytecodeBuilder setup("setup", 0);
+    setup.emit(Opcode::NewObject, 0);
+    for (int i = 0; i < 6; ++i) {
+        setup.emit(Opcode::LoadInt, 1, i);
+        setup.emit(Opcode::SetProp, 0, setup.addPropertyCache(vm.intern("k" + std::to_string(i))), 1);
+    }
+    setup.emit(Opcode::SetGlobal, configSlot, 0);
+    setup.emit(Opcode::NewInstance, 1, setup.addClass(point));
+    setup.emit(Opcode::LoadInt, 2, 7);
+    setup.emit(Opcode::SetField, 1, setup.addFieldRef(point, vm.intern("x")), 2);
+    setup.emit(Opcode::LoadConst, 2, setup.addConstant(Value::object(vm.intern("pt"))));
+    setup.emit(Opcode::SetField, 1, setup.addFieldRef(point, vm.intern("label")), 2);
+    setup.emit(Opcode::SetGlobal, pointSlot, 1);
+    setup.emit(Opcode::Return, 0);
+    vm.call(Value::object(vm.adopt(setup.finish())), {});
+
+    // main() { return config.k5 + point.x }
+    int mainSlot = vm.defineGlobal("main");
+    BytecodeBuilder main("main", 0);
+    main.emit(Opcode::GetGlobal, 0, configSlot);
+    main.emit(Opcode::GetProp, 0, 0, main.addPropertyCache(vm.intern("k5")));
+    main.emit(Opcode::GetGlobal, 1, pointSlot);
+    main.emit(Opcode::GetField, 1, 1, main.addFieldRef(point, vm.intern("x")));
+    main.emit(Opcode::Add, 0, 0, 1);
+    main.emit(Opcode::Return, 0);
+    vm.setGlobal(mainSlot, Value::object(vm.adopt(main.finish())));
+    ASSERT_EQ(vm.call(vm.getGlobal(mainSlot), {}).asInt(), 12);
+
+    // Host-built state: a dictionary-mode object, a rope, a long chain and
+    // an array too big to share a run
+    Heap& heap = vm.getHeap();
+    int dictSlot = vm.defineGlobal("dict");
+    vm.setGlobal(dictSlot, Value::object(heap.allocateObject(vm.getShapes().root())));
+    for (uint32_t i = 0; i < ShapeTree::kMaxFastProperties + 8; ++i) {
+        setProperty(heap, vm.getShapes(), asPlainObject(vm.getGlobal(dictSlot)),
+                    vm.intern("d" + std::to_string(i)), Value::integer(i));
+    }
+    int ropeSlot = vm.defineGlobal("greeting");
+    vm.setGlobal(ropeSlot, Value::object(heap.allocateRope(heap.allocateString("hello, "),
+                                                           heap.allocateString("snapshot"))));
+    int chainSlot = vm.defineGlobal("chain");
+    String* next = vm.intern("next");
+    for (int i = 0; i < kChainLength; ++i) {
+        Object* link = heap.allocateObject(vm.getShapes().root());
+        setProperty(heap, vm.getShapes(), link, next, vm.getGlobal(chainSlot));
+        vm.setGlobal(chainSlot, Value::object(link));
+    }
+    int arraySlot = vm.defineGlobal("numbers");
+    ValueArray* numbers = heap.allocateValueArray(kBigArray);
+    for (uint32_t i = 0; i < kBigArray; ++i) {
+        numbers->items()[i] = Value::integer(i);
+    }
+    vm.setGlobal(arraySlot, Value::object(numbers));
+}
+
+bool writeFails(VM& vm, const std::string& path) {
+    try {
+        Snapshot::write(vm, path);
+    } catch (const SnapshotError&) {
+        return true;
+    }
+    return false;
+}
+
+bool loadFails(const std::string& path) {
+    try {
+        Snapshot::load(path);
+    } catch (const SnapshotError&) {
+        return true;
+    }
+    return false;
+}
+
+} // namespace
+
+TEST_CASE(TestSnapshotRoundTrip) {
+    std::string path = imagePath("round_trip");
+    {
+        VM vm;
+        initialize(vm);
+        Snapshot::write(vm, path);
+    }
+    ASSERT_TRUE(Snapshot::isImage(path));
+    std::unique_ptr<VM> vm = Snapshot::load(path);
+    std::remove(path.c_str());
+
+    // Compiled code runs against the restored objects, shapes and classes
+    Value main = vm->getGlobal(vm->lookupGlobal("main"));
+    ASSERT_EQ(vm->call(main, {}).asInt(), 12);
+
+    // Atoms stay unique: interning finds the restored keys
+    Object* config = asPlainObject(vm->getGlobal(vm->lookupGlobal("config")));
+    ASSERT_EQ(getProperty(config, vm->intern("k0")).asInt(), 0);
+    ASSERT_EQ(getProperty(config, vm->intern("k4")).asInt(), 4);
+    Object* dict = asPlainObject(vm->getGlobal(vm->lookupGlobal("dict")));
+    ASSERT_EQ(getProperty(dict, vm->intern("d70")).asInt(), 70);
+    Instance* point = asInstance(vm->getGlobal(vm->lookupGlobal("point")));
+    ASSERT_EQ(std::string(point->layout->name()), "Point");
+    ASSERT_TRUE(loadField(point, point->layout->field(1)) == Value::object(vm->intern("pt")));
+
+    String* greeting = asString(vm->getGlobal(vm->lookupGlobal("greeting")));
+    ASSERT_TRUE(greeting->isRope());
+    ASSERT_EQ(std::string(asString(asRope(greeting)->right)->view()), "snapshot");
+
+    // The restored heap is an ordinary one: it collects, and code keeps working
+    vm->getHeap().collectMajor();
+    int length = 0;
+    String* next = vm->intern("next");
+    for (Value link = vm->getGlobal(vm->lookupGlobal("chain")); isPlainObject(link);
+         link = getProperty(asPlainObject(link), next)) {
+        ++length;
+    }
+    ASSERT_EQ(length, kChainLength);
+    auto* numbers = static_cast<ValueArray*>(vm->getGlobal(vm->lookupGlobal("numbers")).asObject());
+    ASSERT_EQ(numbers->length, kBigArray);
+    ASSERT_EQ(numbers->items()[kBigArray - 1].asInt(), int64_t(kBigArray - 1));
+    ASSERT_EQ(vm->call(main, {}).asInt(), 12);
+}
+
+TEST_CASE(TestSnapshotRejectsWildObjects) {
+    VM vm;
+    int slot = vm.defineGlobal("resource");
+    WildObject* resource = WildObject::create(vm.getWildHeap(), 16);
+    vm.setGlobal(slot, Value::wild(resource));
+    std::string path = imagePath("wild");
+    ASSERT_TRUE(writeFails(vm, path));
+    std::remove(path.c_str());
+    resource->destroy();
+}
+
+TEST_CASE(TestSnapshotRejectsBadImages) {
+    ASSERT_TRUE(loadFails(imagePath("missing")));
+
+    std::string path = imagePath("bad");
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "not an image";
+    }
+    ASSERT_FALSE(Snapshot::isImage(path));
+    ASSERT_TRUE(loadFails(path));
+
+    // A cut-off image is caught before anything is read past its end
+    {
+        VM vm;
+        initialize(vm);
+        Snapshot::write(vm, path);
+    }
+    std::ifstream in(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(bytes.data(), static_cast<std::streamsize>(bytes.size() / 2));
+    }
+    ASSERT_TRUE(Snapshot::isImage(path));
+    ASSERT_TRUE(loadFails(path));
+
+    // So is one flipped bit anywhere past the header: in the stored
+    // objects, the relocations or the globals at the very end
+    bool allRejected = true;
+    for (size_t at : {size_t(40), bytes.size() / 4, bytes.size() / 2, bytes.size() - 1}) {
+        std::string flipped = bytes;
+        flipped[at] = static_cast<char>(flipped[at] ^ 0x10);
+        {
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            file.write(flipped.data(), static_cast<std::streamsize>(flipped.size()));
+        }
+        allRejected = allRejected && loadFails(path);
+    }
+    ASSERT_TRUE(allRejected);
+    std::remove(path.c_str());
+}
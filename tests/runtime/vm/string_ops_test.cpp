@@ -0,0 +1,109 @@
+#include "runtime/memory/heap.h"
+#include "runtime/vm/string_ops.h"
+#include "runtime/vm/vm.h"
+#include "test_runner.h"
+
+#include <string>
+
+TEST_CASE(TestStringConcatenationBuildsRopes) {
+    VM vm;
+    Heap& heap = vm.getHeap();
+    String* shortResult = concatStrings(heap, heap.allocateString("Task "), heap.allocateString("7"));
+    ASSERT_FALSE(shortResult->isRope());
+    ASSERT_EQ(std::string(shortResult->view()), "Task 7");
+
+    String* left = heap.allocateString("Hello, ");
+    String* rope = concatStrings(heap, left, heap.allocateString("world!"));
+    ASSERT_TRUE(rope->isRope());
+    ASSERT_EQ(rope->length, 13u);
+    ASSERT_TRUE(flatContents(rope) == nullptr);
+    ASSERT_EQ(toUtf8(rope), "Hello, world!");
+    ASSERT_TRUE(equalStrings(rope, heap.allocateString("Hello, world!")));
+    ASSERT_TRUE(compareStrings(rope, heap.allocateString("Hello, x")) < 0);
+    ASSERT_TRUE(concatStrings(heap, left, heap.allocateString("")) == left);
+
+    uint32_t hash = stringHash(rope);
+    String* flat = flattenString(heap, rope);
+    ASSERT_FALSE(flat->isRope());
+    ASSERT_EQ(std::string(flat->view()), "Hello, world!");
+    ASSERT_EQ(flat->hash, hash);
+    ASSERT_TRUE(flatContents(rope) == flat);
+    ASSERT_TRUE(flattenString(heap, rope) == flat);
+}
+
+TEST_CASE(TestStringDeepRopesSurviveCollection) {
+    VM vm(64 * 1024);
+    Heap& heap = vm.getHeap();
+    std::string expected;
+    Rooted text(heap, Value::object(heap.allocateString("")));
+    for (int i = 0; i < 5000; ++i) {
+        std::string piece = "item" + std::to_string(i) + ";";
+        expected += piece;
+        text.set(Value::object(concatStrings(heap, asString(text.get()), heap.allocateString(piece))));
+        if (heap.collectionRequested()) {
+            heap.collect();
+        }
+    }
+    heap.collectMajor();
+
+    String* rope = asString(text.get());
+    ASSERT_TRUE(rope->isRope());
+    ASSERT_EQ(rope->length, static_cast<uint32_t>(expected.size()));
+    ASSERT_EQ(toUtf8(rope), expected);
+    flattenString(heap, rope);
+    heap.collectMajor();
+    const String* flat = flatContents(asString(text.get()));
+    ASSERT_TRUE(flat != nullptr);
+    ASSERT_EQ(std::string(flat->view()), expected);
+}
+
+TEST_CASE(TestStringEncodings) {
+    VM vm;
+    Heap& heap = vm.getHeap();
+    String* latin1 = newString(heap, "h\xC3\xA9llo"); // "héllo"
+    ASSERT_FALSE(latin1->isTwoByte());
+    ASSERT_EQ(latin1->length, 5u);
+    ASSERT_EQ(latin1->charAt(1), static_cast<char16_t>(0xE9));
+    ASSERT_EQ(toUtf8(latin1), "h\xC3\xA9llo");
+
+    String* euro = newString(heap, "\xE2\x82\xAC"); // U+20AC
+    ASSERT_TRUE(euro->isTwoByte());
+    ASSERT_EQ(euro->length, 1u);
+    ASSERT_EQ(euro->charAt(0), static_cast<char16_t>(0x20AC));
+
+    String* emoji = newString(heap, "\xF0\x9F\x98\x80"); // U+1F600, a surrogate pair
+    ASSERT_EQ(emoji->length, 2u);
+    ASSERT_EQ(toUtf8(emoji), "\xF0\x9F\x98\x80");
+    ASSERT_EQ(newString(heap, "a\xFF")->charAt(1), static_cast<char16_t>(0xFFFD));
+
+    // Mixed concatenations widen, and compare equal to the same text in
+    // either encoding
+    String* mixed = concatStrings(heap, latin1, euro);
+    ASSERT_TRUE(mixed->isTwoByte());
+    ASSERT_TRUE(equalStrings(mixed, newString(heap, "h\xC3\xA9llo\xE2\x82\xAC")));
+    String* pairs = concatStrings(heap, heap.allocateString("smile, please: "), emoji);
+    ASSERT_TRUE(pairs->isRope());
+    ASSERT_EQ(toUtf8(pairs), "smile, please: \xF0\x9F\x98\x80");
+
+    String* wide = concatStrings(heap, euro, heap.allocateString("x"));
+    String* narrow = heap.allocateString("x");
+    ASSERT_EQ(stringHash(concatStrings(heap, heap.allocateString("x"), newString(heap, "y"))),
+              stringHash(heap.allocateString("xy")));
+    ASSERT_TRUE(compareStrings(narrow, wide) < 0);
+    ASSERT_TRUE(compareStrings(wide, euro) > 0);
+}
+
+TEST_CASE(TestStringInterning) {
+    VM vm;
+    String* name = vm.intern("name");
+    ASSERT_TRUE(vm.intern("name") == name);
+    ASSERT_TRUE(name->isInterned());
+    ASSERT_NE(name->hash, 0u);
+    ASSERT_FALSE(equalStrings(name, vm.intern("nome")));
+    ASSERT_TRUE(equalStrings(name, vm.getHeap().allocateString("name")));
+
+    String* accented = vm.intern("caf\xC3\xA9");
+    ASSERT_TRUE(vm.intern("caf\xC3\xA9") == accented);
+    ASSERT_EQ(accented->length, 4u);
+    ASSERT_FALSE(accented->isTwoByte());
+}
@@ -0,0 +1,127 @@
+#include "runtime/memory/array_buffer.h"
+#include "runtime/vm/typed_array.h"
+#include "runtime/vm/vm.h"
+#include "test_runner.h"
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+TEST_CASE(TestArrayBufferIsAlignedAndZeroed) {
+    ArrayBuffer buffer(1024 * 1024);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(buffer.data()) % ArrayBuffer::kAlignment, 0u);
+    ASSERT_EQ(buffer.byteLength(), 1024u * 1024u);
+    for (size_t i = 0; i < buffer.byteLength(); i += 4096) {
+        ASSERT_EQ(buffer.data()[i], 0);
+    }
+    ArrayBuffer empty(0);
+    ASSERT_EQ(empty.byteLength(), 0u);
+}
+
+TEST_CASE(TestTypedArrayConversions) {
+    ArrayBuffer buffer(64);
+    TypedArray bytes(buffer, TypedArrayKind::Int8Array, 0, 4);
+    bytes.set(0, 200);
+    bytes.set(1, -1.9);
+    bytes.set(2, NAN);
+    ASSERT_EQ(bytes.get(0), -56.0);
+    ASSERT_EQ(bytes.get(1), -1.0);
+    ASSERT_EQ(bytes.get(2), 0.0);
+
+    TypedArray clamped(buffer, TypedArrayKind::Uint8ClampedArray, 8, 4);
+    clamped.set(0, 300);
+    clamped.set(1, -5);
+    clamped.set(2, 2.5);
+    clamped.set(3, 3.5);
+    ASSERT_EQ(clamped.get(0), 255.0);
+    ASSERT_EQ(clamped.get(1), 0.0);
+    ASSERT_EQ(clamped.get(2), 2.0);
+    ASSERT_EQ(clamped.get(3), 4.0);
+
+    TypedArray words(buffer, TypedArrayKind::Uint32Array, 16, 2);
+    words.set(0, -1);
+    words.set(1, 4294967296.0 + 5);
+    ASSERT_EQ(words.get(0), 4294967295.0);
+    ASSERT_EQ(words.get(1), 5.0);
+
+    TypedArray floats(buffer, TypedArrayKind::Float32Array, 24, 1);
+    floats.set(0, 0.1);
+    ASSERT_EQ(floats.get(0), static_cast<double>(0.1f));
+
+    // Views share the buffer's bytes
+    TypedArray all(buffer, TypedArrayKind::Uint8Array);
+    ASSERT_EQ(all.length(), 64u);
+    ASSERT_EQ(all.get(0), 200.0);
+    ASSERT_EQ(all.get(8), 255.0);
+}
+
+TEST_CASE(TestTypedArrayRangeErrors) {
+    ArrayBuffer buffer(10);
+    auto throws = [&](auto make, const std::string& message) {
+        try {
+            make();
+        } catch (const RuntimeError& e) {
+            return std::string(e.what()) == message;
+        }
+        return false;
+    };
+    ASSERT_TRUE(throws([&] { TypedArray(buffer, TypedArrayKind::Int32Array, 2, 1); },
+                       "Start offset of Int32Array should be a multiple of 4"));
+    ASSERT_TRUE(throws([&] { TypedArray(buffer, TypedArrayKind::Int16Array, 2, 5); }, "Invalid typed array length: 5"));
+    ASSERT_TRUE(throws([&] { TypedArray(buffer, TypedArrayKind::Float64Array); },
+                       "Byte length of Float64Array should be a multiple of 8"));
+    TypedArray bytes(buffer, TypedArrayKind::Uint8Array);
+    TypedArray small(buffer, TypedArrayKind::Uint8Array, 0, 4);
+    ASSERT_TRUE(throws([&] { bytes.set(small, 7); }, "Offset is out of bounds"));
+}
+
+TEST_CASE(TestTypedArrayBuiltins) {
+    ArrayBuffer buffer(4096);
+    TypedArray ints(buffer, TypedArrayKind::Int32Array, 0, 100);
+    ints.fill(7, 0, 100);
+    ints.fill(-3, 10, 20);
+    ints.fill(1, 95, 1000); // End clamped to the length
+    ASSERT_EQ(ints.get(9), 7.0);
+    ASSERT_EQ(ints.get(10), -3.0);
+    ASSERT_EQ(ints.get(19), -3.0);
+    ASSERT_EQ(ints.get(20), 7.0);
+    ASSERT_EQ(ints.get(99), 1.0);
+    ASSERT_EQ(ints.sum(), 7.0 * 85 - 3.0 * 10 + 5.0);
+
+    ASSERT_EQ(ints.indexOf(-3), 10);
+    ASSERT_EQ(ints.indexOf(-3, 15), 15);
+    ASSERT_EQ(ints.indexOf(-3, 20), -1);
+    ASSERT_EQ(ints.indexOf(7.5), -1);
+    ASSERT_EQ(ints.indexOf(4294967293.0), -1); // -3 as uint32 is not -3
+
+    ints.copyWithin(0, 10, 13);
+    ASSERT_EQ(ints.get(0), -3.0);
+    ASSERT_EQ(ints.get(2), -3.0);
+    ASSERT_EQ(ints.get(3), 7.0);
+
+    // Converting set, including from an overlapping view of the same buffer
+    TypedArray doubles(buffer, TypedArrayKind::Float64Array, 1024, 4);
+    TypedArray overlap(buffer, TypedArrayKind::Int32Array, 1024, 4);
+    overlap.fill(5, 0, 4);
+    doubles.set(overlap, 0);
+    ASSERT_EQ(doubles.get(0), 5.0);
+    ASSERT_EQ(doubles.get(3), 5.0);
+    ASSERT_EQ(doubles.indexOf(-0.0), -1);
+    ASSERT_EQ(doubles.indexOf(5), 0);
+
+    doubles.map(doubles, NumericOp::Mul, 0.5);
+    ASSERT_EQ(doubles.sum(), 10.0);
+    TypedArray halves(buffer, TypedArrayKind::Uint8Array, 2048, 4);
+    doubles.map(halves, NumericOp::Add, 0.75);
+    ASSERT_EQ(halves.get(0), 3.0);
+
+    TypedArray a(buffer, TypedArrayKind::Uint8Array, 3000, 40);
+    TypedArray b(buffer, TypedArrayKind::Uint8Array, 3100, 40);
+    a.fill(1, 0, 40);
+    b.fill(1, 0, 40);
+    ASSERT_EQ(a.compare(b), 0);
+    b.set(39, 2);
+    ASSERT_TRUE(a.compare(b) < 0);
+    TypedArray prefix(buffer, TypedArrayKind::Uint8Array, 3000, 10);
+    ASSERT_TRUE(prefix.compare(a) < 0);
+}
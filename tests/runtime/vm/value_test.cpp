@@ -0,0 +1,90 @@
+#include "runtime/vm/heap_object.h"
+#include "runtime/vm/value.h"
+#include "test_runner.h"
+
+#include <cmath>
+#include <limits>
+
+TEST_CASE(TestValueIsOneWord) {
+    ASSERT_EQ(sizeof(Value), 8u);
+}
+
+TEST_CASE(TestValueImmediates) {
+    ASSERT_TRUE(Value().isUndefined());
+    ASSERT_TRUE(Value::null().isNull());
+    ASSERT_TRUE(Value::null().isNullish());
+    ASSERT_FALSE(Value::null().isUndefined());
+    ASSERT_TRUE(Value::boolean(true).isBoolean());
+    ASSERT_TRUE(Value::boolean(true).asBoolean());
+    ASSERT_FALSE(Value::boolean(false).asBoolean());
+    ASSERT_FALSE(Value::boolean(false).isNumber());
+    ASSERT_TRUE(Value::undefined().getTag() == Value::Tag::Undefined);
+    ASSERT_TRUE(Value::boolean(false).getTag() == Value::Tag::Boolean);
+}
+
+TEST_CASE(TestValueIntegersAre48Bit) {
+    Value minusOne = Value::integer(-1);
+    ASSERT_TRUE(minusOne.isInt());
+    ASSERT_FALSE(minusOne.isDouble());
+    ASSERT_EQ(minusOne.asInt(), -1);
+
+    ASSERT_EQ(Value::integer(Value::kMaxInt).asInt(), Value::kMaxInt);
+    ASSERT_EQ(Value::integer(Value::kMinInt).asInt(), Value::kMinInt);
+
+    // Out of range int64s become doubles
+    Value big = Value::fromInt64(int64_t(1) << 50);
+    ASSERT_TRUE(big.isDouble());
+    ASSERT_EQ(big.asDouble(), 1125899906842624.0);
+    ASSERT_TRUE(Value::fromInt64(123).isInt());
+}
+
+TEST_CASE(TestValueDoubles) {
+    Value pi = Value::number(3.14);
+    ASSERT_TRUE(pi.isDouble());
+    ASSERT_TRUE(pi.isNumber());
+    ASSERT_EQ(pi.asDouble(), 3.14);
+
+    Value negInf = Value::number(-std::numeric_limits<double>::infinity());
+    ASSERT_TRUE(negInf.isDouble());
+    ASSERT_TRUE(std::isinf(negInf.asDouble()));
+
+    // Every NaN, including the negative ones hardware produces, is
+    // canonicalized so it can never be mistaken for a boxed value
+    Value nan = Value::number(-std::numeric_limits<double>::quiet_NaN());
+    ASSERT_TRUE(nan.isDouble());
+    ASSERT_TRUE(std::isnan(nan.asDouble()));
+    ASSERT_EQ(nan.rawBits(), Value::kCanonicalNaN);
+    Value zeroOverZero = Value::number(std::nan(""));
+    ASSERT_EQ(zeroOverZero.rawBits(), Value::kCanonicalNaN);
+}
+
+TEST_CASE(TestValueFromDoubleNormalizesIntegralValues) {
+    ASSERT_TRUE(Value::fromDouble(4.0).isInt());
+    ASSERT_TRUE(Value::fromDouble(4.5).isDouble());
+    ASSERT_TRUE(Value::fromDouble(-0.0).isDouble()); // -0 has no int encoding
+    ASSERT_TRUE(Value::fromDouble(1e300).isDouble());
+}
+
+TEST_CASE(TestValuePointers) {
+    alignas(8) static HeapObject header{};
+    Value gc = Value::object(&header);
+    ASSERT_TRUE(gc.isObject());
+    ASSERT_FALSE(gc.isWild());
+    ASSERT_TRUE(gc.asObject() == &header);
+    ASSERT_TRUE(gc.getTag() == Value::Tag::Object);
+
+    alignas(8) static char storage[16];
+    auto* wildPtr = reinterpret_cast<WildObject*>(storage);
+    Value wild = Value::wild(wildPtr);
+    ASSERT_TRUE(wild.isWild());
+    ASSERT_FALSE(wild.isObject());
+    ASSERT_TRUE(wild.asWild() == wildPtr);
+    ASSERT_TRUE(wild.getTag() == Value::Tag::WildObject);
+}
+
+TEST_CASE(TestValueIdentity) {
+    ASSERT_TRUE(Value::integer(5) == Value::integer(5));
+    ASSERT_TRUE(Value::integer(5) != Value::number(5.0)); // Different encodings
+    ASSERT_TRUE(Value::bothInt(Value::integer(1), Value::integer(2)));
+    ASSERT_FALSE(Value::bothInt(Value::integer(1), Value::number(2)));
+}
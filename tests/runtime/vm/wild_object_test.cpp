@@ -0,0 +1,176 @@
+#include "compiler/codegen/bytecode_builder.h"
+#include "runtime/memory/wild_heap.h"
+#include "runtime/vm/vm.h"
+#include "runtime/vm/wild_object.h"
+#include "test_runner.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+static bool throwsRuntimeError(void (*fn)(WildObject*), WildObject* obj, const std::string& message) {
+    try {
+        fn(obj);
+    } catch (const RuntimeError& e) {
+        return e.what() == message;
+    }
+    return false;
+}
+
+TEST_CASE(TestWildObjectOwnerCounting) {
+    WildHeap heap;
+    WildObject* obj = WildObject::create(heap, 32);
+    obj->retain();
+    obj->retain();
+    obj->retain();
+    obj->release();
+    ASSERT_EQ(obj->refCount(), 2);
+    ASSERT_EQ(obj->sharedRefs.load(), 0); // Owner counts stay unshared
+
+    // Destroy with live references keeps the memory until they are gone
+    obj->destroy();
+    ASSERT_TRUE(obj->isDestroyed());
+    ASSERT_EQ(obj->refCount(), 2);
+    ASSERT_EQ(heap.getStats().liveObjects, 1u);
+    ASSERT_TRUE(throwsRuntimeError([](WildObject* o) { o->retain(); }, obj, "Reference to destroyed wild object"));
+    ASSERT_TRUE(throwsRuntimeError([](WildObject* o) { o->destroy(); }, obj, "Wild object already destroyed"));
+    obj->release();
+    ASSERT_EQ(heap.getStats().liveObjects, 1u);
+    obj->release();
+    ASSERT_EQ(heap.getStats().liveObjects, 0u);
+
+    // Without references destroy frees at once
+    WildObject::create(heap, 0)->destroy();
+    ASSERT_EQ(heap.getStats().liveObjects, 0u);
+}
+
+TEST_CASE(TestWildObjectCrossThreadReferences) {
+    WildHeap heap;
+    WildObject* obj = WildObject::create(heap, 8);
+    obj->retain(); // Biased; released by another thread below
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([obj] {
+            for (int i = 0; i < 10000; ++i) {
+                obj->retain();
+                obj->release();
+            }
+        });
+    }
+    for (int i = 0; i < 10000; ++i) {
+        obj->retain();
+        obj->release();
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::thread([obj] { obj->release(); }).join();
+    ASSERT_EQ(obj->sharedRefs.load(), -1);
+    ASSERT_EQ(obj->refCount(), 0);
+
+    // Only the owner may destroy; the merged total is zero, so it frees
+    bool threw = false;
+    std::thread([obj, &threw] {
+        try {
+            obj->destroy();
+        } catch (const RuntimeError&) {
+            threw = true;
+        }
+    }).join();
+    ASSERT_TRUE(threw);
+    obj->destroy();
+    ASSERT_EQ(heap.getStats().liveObjects, 0u);
+}
+
+TEST_CASE(TestWildObjectLastRemoteReleaseFrees) {
+    WildHeap heap;
+    WildObject* obj = WildObject::create(heap, 8);
+    std::thread holder([obj] { obj->retain(); });
+    holder.join();
+    obj->destroy();
+    ASSERT_EQ(heap.getStats().liveObjects, 1u);
+    std::thread([obj] { obj->release(); }).join();
+    ASSERT_EQ(heap.getStats().liveObjects, 0u);
+}
+
+TEST_CASE(TestWildObjectOpcodes) {
+    VM vm;
+    // destroyer(x) { destroy x }
+    BytecodeBuilder d("destroyer", 1);
+    d.emit(Opcode::Destroy, 0);
+    d.emit(Opcode::ReturnUndefined);
+    Value destroyer = Value::object(vm.adopt(d.finish()));
+    // noop(x) {}
+    BytecodeBuilder n("noop", 1);
+    n.emit(Opcode::ReturnUndefined);
+    Value noop = Value::object(vm.adopt(n.finish()));
+
+    // run(f) { wild var w = ...; var r = ref w; f(w); check r; release r; destroy w }
+    BytecodeBuilder b("run", 1);
+    b.emit(Opcode::NewWild, 1, 64);
+    b.emit(Opcode::Move, 2, 1);
+    b.emit(Opcode::WildRetain, 2);
+    b.emit(Opcode::Move, 4, 0);
+    b.emit(Opcode::Move, 5, 1);
+    b.emit(Opcode::Call, 3, 4, 1);
+    b.emit(Opcode::WildCheck, 2);
+    b.emit(Opcode::WildRelease, 2);
+    b.emit(Opcode::Destroy, 1);
+    b.emit(Opcode::ReturnUndefined);
+    Value run = Value::object(vm.adopt(b.finish()));
+
+    vm.call(run, {noop});
+    ASSERT_EQ(vm.getWildHeap().getStats().liveObjects, 0u);
+
+    std::string error;
+    try {
+        vm.call(run, {destroyer});
+    } catch (const RuntimeError& e) {
+        error = e.what();
+    }
+    ASSERT_EQ(error, "Reference to destroyed wild object");
+    // The reference taken by `run` keeps the destroyed object's memory
+    ASSERT_EQ(vm.getWildHeap().getStats().liveObjects, 1u);
+
+    error.clear();
+    try {
+        vm.call(destroyer, {Value::integer(1)});
+    } catch (const RuntimeError& e) {
+        error = e.what();
+    }
+    ASSERT_EQ(error, "Only wild objects can be destroyed");
+}
+
+TEST_CASE(TestWildObjectTransfer) {
+    VM vm;
+    // move(c) { wild var a = ...; if (c) b = transfer a; check a; destroy a }
+    // The analysis cannot prove the check, so it stays a runtime check
+    BytecodeBuilder b("move", 1);
+    auto skip = b.newLabel();
+    b.emit(Opcode::NewWild, 1, 8);
+    b.emitJumpIfFalse(0, skip);
+    b.emit(Opcode::Transfer, 2, 1);
+    b.bind(skip);
+    b.emit(Opcode::WildCheck, 1);
+    b.emit(Opcode::Destroy, 1);
+    b.emit(Opcode::ReturnUndefined);
+    Value move = Value::object(vm.adopt(b.finish()));
+
+    vm.call(move, {Value::boolean(false)});
+    ASSERT_EQ(vm.getWildHeap().getStats().liveObjects, 0u);
+    std::string error;
+    try {
+        vm.call(move, {Value::boolean(true)});
+    } catch (const RuntimeError& e) {
+        error = e.what();
+    }
+    ASSERT_EQ(error, "Accessed transferred wild object");
+
+    // The marker is never counted or freed
+    WildObject* marker = WildObject::transferred();
+    ASSERT_TRUE(marker->isDestroyed());
+    marker->release();
+    ASSERT_TRUE(throwsRuntimeError([](WildObject* o) { o->retain(); }, marker, "Accessed transferred wild object"));
+    ASSERT_TRUE(throwsRuntimeError([](WildObject* o) { o->destroy(); }, marker, "Accessed transferred wild object"));
+}
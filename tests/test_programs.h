@@ -0,0 +1,33 @@
+#ifndef TEST_PROGRAMS_H
+#define TEST_PROGRAMS_H
+
+#include "compiler/codegen/bytecode_builder.h"
+#include "runtime/vm/vm.h"
+
+// Bytecode programs shared by the tests and benchmarks
+
+// Builds fib(n) as a global function and returns its slot
+inline int defineFib(VM& vm) {
+    int fibSlot = vm.defineGlobal("fib");
+    BytecodeBuilder b("fib", 1);
+    auto recurse = b.newLabel();
+    b.emit(Opcode::LoadInt, 1, 2);
+    b.emit(Opcode::Lt, 2, 0, 1);
+    b.emitJumpIfFalse(2, recurse);
+    b.emit(Opcode::Return, 0);
+    b.bind(recurse);
+    b.emit(Opcode::GetGlobal, 3, fibSlot);
+    b.emit(Opcode::LoadInt, 5, 1);
+    b.emit(Opcode::Sub, 4, 0, 5);
+    b.emit(Opcode::Call, 3, 3, 1);
+    b.emit(Opcode::GetGlobal, 4, fibSlot);
+    b.emit(Opcode::LoadInt, 6, 2);
+    b.emit(Opcode::Sub, 5, 0, 6);
+    b.emit(Opcode::Call, 4, 4, 1);
+    b.emit(Opcode::Add, 3, 3, 4);
+    b.emit(Opcode::Return, 3);
+    vm.setGlobal(fibSlot, Value::object(vm.adopt(b.finish())));
+    return fibSlot;
+}
+
+#endif // TEST_PROGRAMS_H